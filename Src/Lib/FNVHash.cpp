@@ -25,5 +25,5 @@ unsigned int CalcFNVHash( const char *text, unsigned int hash )
 // Calculate FNV hash for a wide string
 unsigned int CalcFNVHash( const wchar_t *text, unsigned int hash )
 {
-	return CalcFNVHash(text,Strlen(text)*2,hash);
+	return CalcFNVHash(text,Strlen(text)*(int)sizeof(wchar_t),hash);
 }
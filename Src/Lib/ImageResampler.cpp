@@ -0,0 +1,287 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "ImageResampler.h"
+#include <math.h>
+
+// x86 and x64 with MSVC, GCC or Clang. 32-bit GCC builds need -msse2
+#if ((defined(_M_AMD64) || defined(_M_IX86)) && !defined(_M_ARM64EC)) || defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define RESAMPLER_SIMD
+#include <emmintrin.h>
+#endif
+
+static bool g_bResamplerSIMD=true;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static float CubicWeight( float x )
+{
+	// Catmull-Rom spline (a=-0.5)
+	x=fabsf(x);
+	if (x<1)
+		return (1.5f*x-2.5f)*x*x+1;
+	if (x<2)
+		return ((-0.5f*x+2.5f)*x-4)*x+2;
+	return 0;
+}
+
+void CResampleFilter::Init( int srcSize, int dstSize )
+{
+	m_SrcSize=srcSize;
+	m_DstSize=dstSize;
+	m_First.clear();
+	m_Weights.clear();
+	if (srcSize<=0 || dstSize<=0)
+	{
+		m_Taps=0;
+		return;
+	}
+
+	float scale=(float)srcSize/dstSize;
+	bool bShrink=dstSize<srcSize;
+	m_Taps=bShrink?(int)ceilf(scale)+1:4;
+	if (m_Taps>srcSize) m_Taps=srcSize;
+	m_First.resize(dstSize);
+	m_Weights.resize(dstSize*m_Taps,0);
+
+	std::vector<float> weights(m_Taps);
+	for (int i=0;i<dstSize;i++)
+	{
+		for (int t=0;t<m_Taps;t++)
+			weights[t]=0;
+		int first;
+		if (bShrink)
+		{
+			// the destination pixel covers the source from start to end
+			float start=i*scale, end=(i+1)*scale;
+			first=(int)floorf(start);
+			if (first>srcSize-m_Taps) first=srcSize-m_Taps;
+			for (int j=(int)floorf(start);j<end && j<srcSize;j++)
+			{
+				float overlap=(j+1<end?j+1:end)-(j>start?j:start);
+				weights[j-first]+=overlap/scale;
+			}
+		}
+		else
+		{
+			float center=(i+0.5f)*scale-0.5f;
+			int base=(int)floorf(center);
+			first=base-1;
+			if (first>srcSize-m_Taps) first=srcSize-m_Taps;
+			if (first<0) first=0;
+			for (int j=base-1;j<=base+2;j++)
+			{
+				// the pixels outside of the image are the same as the edge
+				int k=j<0?0:(j>=srcSize?srcSize-1:j);
+				weights[k-first]+=CubicWeight(center-j);
+			}
+		}
+		m_First[i]=first;
+
+		// convert to fixed point. the rounding error goes into the biggest weight so the sum is exact
+		short *pWeights=&m_Weights[i*m_Taps];
+		int sum=0, biggest=0;
+		for (int t=0;t<m_Taps;t++)
+		{
+			pWeights[t]=(short)floorf(weights[t]*(1<<WEIGHT_BITS)+0.5f);
+			sum+=pWeights[t];
+			if (pWeights[t]>pWeights[biggest])
+				biggest=t;
+		}
+		pWeights[biggest]+=(short)((1<<WEIGHT_BITS)-sum);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Rounds the filtered channels and makes sure the colors don't exceed the alpha (possible with the negative lobes of the bicubic filter)
+static unsigned int PackPixel( const int *acc )
+{
+	int c[4];
+	for (int i=0;i<4;i++)
+	{
+		int v=(acc[i]+(1<<(CResampleFilter::WEIGHT_BITS-1)))>>CResampleFilter::WEIGHT_BITS;
+		c[i]=v<0?0:(v>255?255:v);
+	}
+	for (int i=0;i<3;i++)
+		if (c[i]>c[3]) c[i]=c[3];
+	return c[0]|(c[1]<<8)|(c[2]<<16)|(c[3]<<24);
+}
+
+static void ResizeRowX( const unsigned int *src, unsigned int *dst, const CResampleFilter &filter )
+{
+	int taps=filter.GetTaps();
+	for (int x=0;x<filter.GetDstSize();x++)
+	{
+		const unsigned int *pixels=src+filter.GetFirst(x);
+		const short *weights=filter.GetWeights(x);
+		int acc[4]={0};
+		for (int t=0;t<taps;t++)
+		{
+			unsigned int pixel=pixels[t];
+			for (int i=0;i<4;i++)
+				acc[i]+=weights[t]*(int)((pixel>>(i*8))&255);
+		}
+		dst[x]=PackPixel(acc);
+	}
+}
+
+static void ResizeColumnY( const unsigned int *const *rows, const short *weights, int taps, unsigned int *dst, int x0, int width )
+{
+	for (int x=x0;x<width;x++)
+	{
+		int acc[4]={0};
+		for (int t=0;t<taps;t++)
+		{
+			unsigned int pixel=rows[t][x];
+			for (int i=0;i<4;i++)
+				acc[i]+=weights[t]*(int)((pixel>>(i*8))&255);
+		}
+		dst[x]=PackPixel(acc);
+	}
+}
+
+#ifdef RESAMPLER_SIMD
+
+// Takes 4 32-bit sums for one pixel or 8 for two pixels and returns the packed pixels in the low bytes
+static __m128i PackPixelsSSE2( __m128i acc0, __m128i acc1 )
+{
+	const __m128i round=_mm_set1_epi32(1<<(CResampleFilter::WEIGHT_BITS-1));
+	acc0=_mm_srai_epi32(_mm_add_epi32(acc0,round),CResampleFilter::WEIGHT_BITS);
+	acc1=_mm_srai_epi32(_mm_add_epi32(acc1,round),CResampleFilter::WEIGHT_BITS);
+	__m128i v=_mm_packs_epi32(acc0,acc1);
+	// limit the colors to the alpha
+	__m128i a=_mm_shufflehi_epi16(_mm_shufflelo_epi16(v,_MM_SHUFFLE(3,3,3,3)),_MM_SHUFFLE(3,3,3,3));
+	v=_mm_min_epi16(v,a);
+	return _mm_packus_epi16(v,v);
+}
+
+static int PairWeights( const short *weights )
+{
+	return (int)((unsigned short)weights[0]|((unsigned int)(unsigned short)weights[1]<<16));
+}
+
+// The weights are used in pairs, so the pixels of two taps are interleaved and multiplied with _mm_madd_epi16
+static void ResizeRowXSSE2( const unsigned int *src, unsigned int *dst, const CResampleFilter &filter )
+{
+	int taps=filter.GetTaps();
+	const __m128i zero=_mm_setzero_si128();
+	for (int x=0;x<filter.GetDstSize();x++)
+	{
+		const unsigned int *pixels=src+filter.GetFirst(x);
+		const short *weights=filter.GetWeights(x);
+		__m128i acc=zero;
+		int t=0;
+		for (;t+2<=taps;t+=2)
+		{
+			__m128i v=_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(pixels+t)),zero);
+			v=_mm_unpacklo_epi16(v,_mm_unpackhi_epi64(v,v));
+			__m128i w=_mm_set1_epi32(PairWeights(weights+t));
+			acc=_mm_add_epi32(acc,_mm_madd_epi16(v,w));
+		}
+		if (t<taps)
+		{
+			__m128i v=_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(pixels[t]),zero),zero);
+			acc=_mm_add_epi32(acc,_mm_madd_epi16(v,_mm_set1_epi32((unsigned short)weights[t])));
+		}
+		dst[x]=_mm_cvtsi128_si32(PackPixelsSSE2(acc,zero));
+	}
+}
+
+static void ResizeColumnYSSE2( const unsigned int *const *rows, const short *weights, int taps, unsigned int *dst, int width )
+{
+	const __m128i zero=_mm_setzero_si128();
+	int x=0;
+	for (;x+2<=width;x+=2)
+	{
+		__m128i acc0=zero, acc1=zero;
+		int t=0;
+		for (;t+2<=taps;t+=2)
+		{
+			__m128i v0=_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(rows[t]+x)),zero);
+			__m128i v1=_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(rows[t+1]+x)),zero);
+			__m128i w=_mm_set1_epi32(PairWeights(weights+t));
+			acc0=_mm_add_epi32(acc0,_mm_madd_epi16(_mm_unpacklo_epi16(v0,v1),w));
+			acc1=_mm_add_epi32(acc1,_mm_madd_epi16(_mm_unpackhi_epi16(v0,v1),w));
+		}
+		if (t<taps)
+		{
+			__m128i v0=_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(rows[t]+x)),zero);
+			__m128i w=_mm_set1_epi32((unsigned short)weights[t]);
+			acc0=_mm_add_epi32(acc0,_mm_madd_epi16(_mm_unpacklo_epi16(v0,zero),w));
+			acc1=_mm_add_epi32(acc1,_mm_madd_epi16(_mm_unpackhi_epi16(v0,zero),w));
+		}
+		_mm_storel_epi64((__m128i*)(dst+x),PackPixelsSSE2(acc0,acc1));
+	}
+	ResizeColumnY(rows,weights,taps,dst,x,width);
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool SetResamplerSIMD( bool bEnable )
+{
+	bool bOld=g_bResamplerSIMD;
+	g_bResamplerSIMD=bEnable;
+	return bOld;
+}
+
+bool IsResamplerSIMD( void )
+{
+#ifdef RESAMPLER_SIMD
+	return g_bResamplerSIMD;
+#else
+	return false;
+#endif
+}
+
+void ResizePixels( const unsigned int *src, int srcStride, unsigned int *dst, int dstStride, const CResampleFilter &filterX, const CResampleFilter &filterY )
+{
+	int srcHeight=filterY.GetSrcSize();
+	int dstWidth=filterX.GetDstSize();
+	int dstHeight=filterY.GetDstSize();
+	if (dstWidth<=0 || dstHeight<=0 || srcHeight<=0 || filterX.GetSrcSize()<=0)
+		return;
+
+	// resize all rows horizontally, then resize the columns
+	std::vector<unsigned int> temp(srcHeight*dstWidth);
+	for (int y=0;y<srcHeight;y++)
+	{
+#ifdef RESAMPLER_SIMD
+		if (g_bResamplerSIMD)
+		{
+			ResizeRowXSSE2(src+y*srcStride,&temp[y*dstWidth],filterX);
+			continue;
+		}
+#endif
+		ResizeRowX(src+y*srcStride,&temp[y*dstWidth],filterX);
+	}
+
+	int taps=filterY.GetTaps();
+	std::vector<const unsigned int*> rows(taps);
+	for (int y=0;y<dstHeight;y++)
+	{
+		int first=filterY.GetFirst(y);
+		for (int t=0;t<taps;t++)
+			rows[t]=&temp[(first+t)*dstWidth];
+#ifdef RESAMPLER_SIMD
+		if (g_bResamplerSIMD)
+		{
+			ResizeColumnYSSE2(&rows[0],filterY.GetWeights(y),taps,dst+y*dstStride,dstWidth);
+			continue;
+		}
+#endif
+		ResizeColumnY(&rows[0],filterY.GetWeights(y),taps,dst+y*dstStride,0,dstWidth);
+	}
+}
+
+void ResizePixels( const unsigned int *src, int srcWidth, int srcHeight, int srcStride, unsigned int *dst, int dstWidth, int dstHeight, int dstStride )
+{
+	CResampleFilter filterX, filterY;
+	filterX.Init(srcWidth,dstWidth);
+	filterY.Init(srcHeight,dstHeight);
+	ResizePixels(src,srcStride,dst,dstStride,filterX,filterY);
+}
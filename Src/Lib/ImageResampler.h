@@ -0,0 +1,45 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include <vector>
+
+// ImageResampler.h - resizes 32-bit images with premultiplied alpha using a separable filter
+// Shrinking uses a box filter (the average of the covered area) and enlarging uses a bicubic (Catmull-Rom) filter.
+// The image is filtered horizontally and then vertically. The inner loops use SSE2 on x86 and x64. The resampler doesn't depend on the OS
+
+// CResampleFilter - the weights for resizing one dimension. Can be reused for all images with the same sizes
+class CResampleFilter
+{
+public:
+	CResampleFilter( void ) { m_SrcSize=m_DstSize=m_Taps=0; }
+
+	void Init( int srcSize, int dstSize );
+	int GetSrcSize( void ) const { return m_SrcSize; }
+	int GetDstSize( void ) const { return m_DstSize; }
+	int GetTaps( void ) const { return m_Taps; }
+	// the first source pixel for the destination pixel
+	int GetFirst( int dst ) const { return m_First[dst]; }
+	// GetTaps() weights for the destination pixel, with 14 bits of precision
+	const short *GetWeights( int dst ) const { return &m_Weights[dst*m_Taps]; }
+
+	enum { WEIGHT_BITS=14 };
+
+private:
+	int m_SrcSize, m_DstSize;
+	int m_Taps; // number of source pixels for each destination pixel
+	std::vector<int> m_First;
+	std::vector<short> m_Weights;
+};
+
+// Resizes the pixels. The stride is in pixels
+void ResizePixels( const unsigned int *src, int srcWidth, int srcHeight, int srcStride, unsigned int *dst, int dstWidth, int dstHeight, int dstStride );
+// Resizes the pixels with filters that are already initialized
+void ResizePixels( const unsigned int *src, int srcStride, unsigned int *dst, int dstStride, const CResampleFilter &filterX, const CResampleFilter &filterY );
+
+// Enables or disables the SSE2 code and returns the old state. The tests and benchmarks use it to compare the SSE2 code with the scalar code
+bool SetResamplerSIMD( bool bEnable );
+// Returns true if the resampler uses the SSE2 code
+bool IsResamplerSIMD( void );
@@ -0,0 +1,406 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "PixelOps.h"
+
+// x86 and x64 with MSVC, GCC or Clang. 32-bit GCC builds need -msse2
+#if ((defined(_M_AMD64) || defined(_M_IX86)) && !defined(_M_ARM64EC)) || defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define PIXEL_OPS_SIMD
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX2_FUNC
+#else
+// GCC and Clang compile the AVX2 code only in functions marked for it
+#define AVX2_FUNC __attribute__((target("avx2")))
+#endif
+#include <immintrin.h>
+#endif
+
+static int g_PixelOpsLimit=PIXEL_OPS_AVX2;
+
+///////////////////////////////////////////////////////////////////////////////
+// Scalar code - the reference for the vector kernels, and used for the last few pixels of each row
+
+static bool IsGrayPixel( unsigned int pixel )
+{
+	int a=(pixel>>24)&255;
+	int r=(pixel>>16)&255;
+	int g=(pixel>>8)&255;
+	int b=(pixel)&255;
+	return !(abs(a-r)>2 || abs(r-g)>2 || abs(r-b)>2 || abs(g-b)>2);
+}
+
+// Processes one row. Returns false if a colored pixel is found
+static bool DetectGrayscaleRow( const unsigned int *bits, int width, int &transparent )
+{
+	for (int x=0;x<width;x++)
+	{
+		unsigned int pixel=bits[x];
+		if (!IsGrayPixel(pixel))
+			return false; // found colored pixel
+		if (!(pixel&0xFF000000))
+			transparent++;
+	}
+	return true;
+}
+
+static void CreateMonochromeRow( unsigned int *bits, int width, int r0, int g0, int b0 )
+{
+	for (int x=0;x<width;x++)
+	{
+		unsigned int &pixel=bits[x];
+		int a=pixel>>24;
+		int r=(r0*a)/255;
+		int g=(g0*a)/255;
+		int b=(b0*a)/255;
+		pixel=(a<<24)|(r<<16)|(g<<8)|b;
+	}
+}
+
+static void PremultiplyRow( unsigned int *bits, int count, int mr, int mg, int mb )
+{
+	for (int i=0;i<count;i++)
+	{
+		unsigned int &pixel=bits[i];
+		int a=(pixel>>24);
+		int r=(pixel>>16)&255;
+		int g=(pixel>>8)&255;
+		int b=(pixel)&255;
+		r=(r*a*mr)/(255*255);
+		g=(g*a*mg)/(255*255);
+		b=(b*a*mb)/(255*255);
+		pixel=(a<<24)|(r<<16)|(g<<8)|b;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Vector kernels
+// Gray test: the absolute differences of the bytes b-g, g-r, r-a (the pixel shifted by 8) and b-r (shifted by 16) must not exceed 2
+// Division by 255: for 0<=x<=255*255, x/255 == (x+1+(x>>8))>>8, which fits in 16 bits
+// Division by 255*255: the float estimate is off by at most one, and is corrected by checking the remainder. q*65025 is calculated as (q<<16)-(q<<9)+q
+// Premultiplication: the alpha channel is multiplied by 255 (and the color by 255), so it stays unchanged
+
+#ifdef PIXEL_OPS_SIMD
+
+static int g_SimdLevel=-1; // 0 - SSE2, 1 - AVX2
+
+static int GetSimdLevel( void )
+{
+	if (g_SimdLevel<0)
+	{
+		int level=0;
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info,0);
+		if (info[0]>=7)
+		{
+			__cpuid(info,1);
+			// the OS must save the AVX registers
+			if ((info[2]&(1<<27)) && (info[2]&(1<<28)) && (_xgetbv(0)&6)==6)
+			{
+				__cpuidex(info,7,0);
+				if (info[1]&(1<<5))
+					level=1;
+			}
+		}
+#else
+		// also checks that the OS saves the AVX registers
+		if (__builtin_cpu_supports("avx2"))
+			level=1;
+#endif
+		g_SimdLevel=level;
+	}
+	return g_SimdLevel;
+}
+
+static int CountBits( int bits )
+{
+#ifdef _MSC_VER
+	return __popcnt(bits);
+#else
+	return __builtin_popcount(bits);
+#endif
+}
+
+static bool DetectGrayscaleRowSSE2( const unsigned int *bits, int width, int &transparent )
+{
+	const __m128i mask1=_mm_set1_epi32(0x00FFFFFF);
+	const __m128i mask2=_mm_set1_epi32(0x000000FF);
+	const __m128i alphaMask=_mm_set1_epi32(0xFF000000);
+	const __m128i two=_mm_set1_epi8(2);
+	const __m128i zero=_mm_setzero_si128();
+	int x=0;
+	for (;x+4<=width;x+=4)
+	{
+		__m128i v=_mm_loadu_si128((const __m128i*)(bits+x));
+		__m128i v1=_mm_srli_epi32(v,8);
+		__m128i v2=_mm_srli_epi32(v,16);
+		__m128i d1=_mm_or_si128(_mm_subs_epu8(v,v1),_mm_subs_epu8(v1,v));
+		__m128i d2=_mm_or_si128(_mm_subs_epu8(v,v2),_mm_subs_epu8(v2,v));
+		__m128i d=_mm_max_epu8(_mm_and_si128(d1,mask1),_mm_and_si128(d2,mask2));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(d,two),zero))!=0xFFFF)
+			return false; // found colored pixel
+		__m128i t=_mm_cmpeq_epi32(_mm_and_si128(v,alphaMask),zero);
+		int bits4=_mm_movemask_ps(_mm_castsi128_ps(t));
+		transparent+=(bits4&1)+((bits4>>1)&1)+((bits4>>2)&1)+((bits4>>3)&1);
+	}
+	return DetectGrayscaleRow(bits+x,width-x,transparent);
+}
+
+AVX2_FUNC static bool DetectGrayscaleRowAVX2( const unsigned int *bits, int width, int &transparent )
+{
+	const __m256i mask1=_mm256_set1_epi32(0x00FFFFFF);
+	const __m256i mask2=_mm256_set1_epi32(0x000000FF);
+	const __m256i alphaMask=_mm256_set1_epi32(0xFF000000);
+	const __m256i two=_mm256_set1_epi8(2);
+	const __m256i zero=_mm256_setzero_si256();
+	int x=0;
+	for (;x+8<=width;x+=8)
+	{
+		__m256i v=_mm256_loadu_si256((const __m256i*)(bits+x));
+		__m256i v1=_mm256_srli_epi32(v,8);
+		__m256i v2=_mm256_srli_epi32(v,16);
+		__m256i d1=_mm256_or_si256(_mm256_subs_epu8(v,v1),_mm256_subs_epu8(v1,v));
+		__m256i d2=_mm256_or_si256(_mm256_subs_epu8(v,v2),_mm256_subs_epu8(v2,v));
+		__m256i d=_mm256_max_epu8(_mm256_and_si256(d1,mask1),_mm256_and_si256(d2,mask2));
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_subs_epu8(d,two),zero))!=-1)
+			return false; // found colored pixel
+		__m256i t=_mm256_cmpeq_epi32(_mm256_and_si256(v,alphaMask),zero);
+		transparent+=CountBits(_mm256_movemask_ps(_mm256_castsi256_ps(t)));
+	}
+	_mm256_zeroupper(); // the SSE2 code is slow while the upper halves of the registers are in use
+	return DetectGrayscaleRowSSE2(bits+x,width-x,transparent);
+}
+
+static __m128i CreateMonochromeSSE2( __m128i v16, __m128i color16, __m128i one )
+{
+	__m128i a=_mm_shufflehi_epi16(_mm_shufflelo_epi16(v16,_MM_SHUFFLE(3,3,3,3)),_MM_SHUFFLE(3,3,3,3));
+	__m128i x=_mm_mullo_epi16(a,color16);
+	x=_mm_add_epi16(x,_mm_add_epi16(one,_mm_srli_epi16(x,8)));
+	return _mm_srli_epi16(x,8);
+}
+
+static void CreateMonochromeRowSSE2( unsigned int *bits, int width, int r0, int g0, int b0 )
+{
+	// the alpha is multiplied by 255/255 to keep it unchanged
+	const __m128i color16=_mm_setr_epi16((short)b0,(short)g0,(short)r0,255,(short)b0,(short)g0,(short)r0,255);
+	const __m128i one=_mm_set1_epi16(1);
+	const __m128i zero=_mm_setzero_si128();
+	int x=0;
+	for (;x+4<=width;x+=4)
+	{
+		__m128i v=_mm_loadu_si128((const __m128i*)(bits+x));
+		__m128i lo=CreateMonochromeSSE2(_mm_unpacklo_epi8(v,zero),color16,one);
+		__m128i hi=CreateMonochromeSSE2(_mm_unpackhi_epi8(v,zero),color16,one);
+		_mm_storeu_si128((__m128i*)(bits+x),_mm_packus_epi16(lo,hi));
+	}
+	CreateMonochromeRow(bits+x,width-x,r0,g0,b0);
+}
+
+AVX2_FUNC static __m256i CreateMonochromeAVX2( __m256i v16, __m256i color16, __m256i one )
+{
+	__m256i a=_mm256_shufflehi_epi16(_mm256_shufflelo_epi16(v16,_MM_SHUFFLE(3,3,3,3)),_MM_SHUFFLE(3,3,3,3));
+	__m256i x=_mm256_mullo_epi16(a,color16);
+	x=_mm256_add_epi16(x,_mm256_add_epi16(one,_mm256_srli_epi16(x,8)));
+	return _mm256_srli_epi16(x,8);
+}
+
+AVX2_FUNC static void CreateMonochromeRowAVX2( unsigned int *bits, int width, int r0, int g0, int b0 )
+{
+	const __m256i color16=_mm256_setr_epi16((short)b0,(short)g0,(short)r0,255,(short)b0,(short)g0,(short)r0,255,(short)b0,(short)g0,(short)r0,255,(short)b0,(short)g0,(short)r0,255);
+	const __m256i one=_mm256_set1_epi16(1);
+	const __m256i zero=_mm256_setzero_si256();
+	int x=0;
+	for (;x+8<=width;x+=8)
+	{
+		// unpack and pack work within the 128-bit lanes, so the pixels stay in order
+		__m256i v=_mm256_loadu_si256((const __m256i*)(bits+x));
+		__m256i lo=CreateMonochromeAVX2(_mm256_unpacklo_epi8(v,zero),color16,one);
+		__m256i hi=CreateMonochromeAVX2(_mm256_unpackhi_epi8(v,zero),color16,one);
+		_mm256_storeu_si256((__m256i*)(bits+x),_mm256_packus_epi16(lo,hi));
+	}
+	_mm256_zeroupper(); // the SSE2 code is slow while the upper halves of the registers are in use
+	CreateMonochromeRowSSE2(bits+x,width-x,r0,g0,b0);
+}
+
+static __m128i GetAlphaFactorSSE2( __m128i v16, __m128i alphaMask16, __m128i alpha255 )
+{
+	__m128i a=_mm_shufflehi_epi16(_mm_shufflelo_epi16(v16,_MM_SHUFFLE(3,3,3,3)),_MM_SHUFFLE(3,3,3,3));
+	return _mm_or_si128(_mm_andnot_si128(alphaMask16,a),alpha255);
+}
+
+static __m128i Div65025SSE2( __m128i y )
+{
+	__m128i q=_mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(y),_mm_set1_ps(1/65025.f)));
+	__m128i r=_mm_sub_epi32(y,_mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(q,16),_mm_slli_epi32(q,9)),q));
+	q=_mm_add_epi32(q,_mm_cmpgt_epi32(_mm_setzero_si128(),r));
+	return _mm_sub_epi32(q,_mm_cmpgt_epi32(r,_mm_set1_epi32(65024)));
+}
+
+static void PremultiplyRowSSE2( unsigned int *bits, int count, int mr, int mg, int mb )
+{
+	const __m128i alphaMask16=_mm_setr_epi16(0,0,0,-1,0,0,0,-1);
+	const __m128i alpha255=_mm_setr_epi16(0,0,0,255,0,0,0,255);
+	const __m128i color16=_mm_setr_epi16((short)mb,(short)mg,(short)mr,255,(short)mb,(short)mg,(short)mr,255);
+	const __m128i one=_mm_set1_epi16(1);
+	const __m128i zero=_mm_setzero_si128();
+	bool bColor=(mr&mg&mb)!=255;
+	int x=0;
+	for (;x+4<=count;x+=4)
+	{
+		__m128i v=_mm_loadu_si128((const __m128i*)(bits+x));
+		__m128i lo=_mm_unpacklo_epi8(v,zero);
+		__m128i hi=_mm_unpackhi_epi8(v,zero);
+		lo=_mm_mullo_epi16(lo,GetAlphaFactorSSE2(lo,alphaMask16,alpha255));
+		hi=_mm_mullo_epi16(hi,GetAlphaFactorSSE2(hi,alphaMask16,alpha255));
+		if (bColor)
+		{
+			__m128i lo1=_mm_mullo_epi16(lo,color16), lo2=_mm_mulhi_epu16(lo,color16);
+			__m128i hi1=_mm_mullo_epi16(hi,color16), hi2=_mm_mulhi_epu16(hi,color16);
+			lo=_mm_packs_epi32(Div65025SSE2(_mm_unpacklo_epi16(lo1,lo2)),Div65025SSE2(_mm_unpackhi_epi16(lo1,lo2)));
+			hi=_mm_packs_epi32(Div65025SSE2(_mm_unpacklo_epi16(hi1,hi2)),Div65025SSE2(_mm_unpackhi_epi16(hi1,hi2)));
+		}
+		else
+		{
+			lo=_mm_srli_epi16(_mm_add_epi16(lo,_mm_add_epi16(one,_mm_srli_epi16(lo,8))),8);
+			hi=_mm_srli_epi16(_mm_add_epi16(hi,_mm_add_epi16(one,_mm_srli_epi16(hi,8))),8);
+		}
+		_mm_storeu_si128((__m128i*)(bits+x),_mm_packus_epi16(lo,hi));
+	}
+	PremultiplyRow(bits+x,count-x,mr,mg,mb);
+}
+
+AVX2_FUNC static __m256i GetAlphaFactorAVX2( __m256i v16, __m256i alphaMask16, __m256i alpha255 )
+{
+	__m256i a=_mm256_shufflehi_epi16(_mm256_shufflelo_epi16(v16,_MM_SHUFFLE(3,3,3,3)),_MM_SHUFFLE(3,3,3,3));
+	return _mm256_or_si256(_mm256_andnot_si256(alphaMask16,a),alpha255);
+}
+
+AVX2_FUNC static __m256i Div65025AVX2( __m256i y )
+{
+	__m256i q=_mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(y),_mm256_set1_ps(1/65025.f)));
+	__m256i r=_mm256_sub_epi32(y,_mm256_add_epi32(_mm256_sub_epi32(_mm256_slli_epi32(q,16),_mm256_slli_epi32(q,9)),q));
+	q=_mm256_add_epi32(q,_mm256_cmpgt_epi32(_mm256_setzero_si256(),r));
+	return _mm256_sub_epi32(q,_mm256_cmpgt_epi32(r,_mm256_set1_epi32(65024)));
+}
+
+AVX2_FUNC static void PremultiplyRowAVX2( unsigned int *bits, int count, int mr, int mg, int mb )
+{
+	const __m256i alphaMask16=_mm256_setr_epi16(0,0,0,-1,0,0,0,-1,0,0,0,-1,0,0,0,-1);
+	const __m256i alpha255=_mm256_setr_epi16(0,0,0,255,0,0,0,255,0,0,0,255,0,0,0,255);
+	const __m256i color16=_mm256_setr_epi16((short)mb,(short)mg,(short)mr,255,(short)mb,(short)mg,(short)mr,255,(short)mb,(short)mg,(short)mr,255,(short)mb,(short)mg,(short)mr,255);
+	const __m256i one=_mm256_set1_epi16(1);
+	const __m256i zero=_mm256_setzero_si256();
+	bool bColor=(mr&mg&mb)!=255;
+	int x=0;
+	for (;x+8<=count;x+=8)
+	{
+		// all unpack and pack operations work within the 128-bit lanes, so the pixels stay in order
+		__m256i v=_mm256_loadu_si256((const __m256i*)(bits+x));
+		__m256i lo=_mm256_unpacklo_epi8(v,zero);
+		__m256i hi=_mm256_unpackhi_epi8(v,zero);
+		lo=_mm256_mullo_epi16(lo,GetAlphaFactorAVX2(lo,alphaMask16,alpha255));
+		hi=_mm256_mullo_epi16(hi,GetAlphaFactorAVX2(hi,alphaMask16,alpha255));
+		if (bColor)
+		{
+			__m256i lo1=_mm256_mullo_epi16(lo,color16), lo2=_mm256_mulhi_epu16(lo,color16);
+			__m256i hi1=_mm256_mullo_epi16(hi,color16), hi2=_mm256_mulhi_epu16(hi,color16);
+			lo=_mm256_packs_epi32(Div65025AVX2(_mm256_unpacklo_epi16(lo1,lo2)),Div65025AVX2(_mm256_unpackhi_epi16(lo1,lo2)));
+			hi=_mm256_packs_epi32(Div65025AVX2(_mm256_unpacklo_epi16(hi1,hi2)),Div65025AVX2(_mm256_unpackhi_epi16(hi1,hi2)));
+		}
+		else
+		{
+			lo=_mm256_srli_epi16(_mm256_add_epi16(lo,_mm256_add_epi16(one,_mm256_srli_epi16(lo,8))),8);
+			hi=_mm256_srli_epi16(_mm256_add_epi16(hi,_mm256_add_epi16(one,_mm256_srli_epi16(hi,8))),8);
+		}
+		_mm256_storeu_si256((__m256i*)(bits+x),_mm256_packus_epi16(lo,hi));
+	}
+	_mm256_zeroupper(); // the SSE2 code is slow while the upper halves of the registers are in use
+	PremultiplyRowSSE2(bits+x,count-x,mr,mg,mb);
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+int SetPixelOpsLimit( int limit )
+{
+	int old=g_PixelOpsLimit;
+	g_PixelOpsLimit=limit;
+	return old;
+}
+
+int GetPixelOpsLevel( void )
+{
+#ifdef PIXEL_OPS_SIMD
+	int level=GetSimdLevel()>0?PIXEL_OPS_AVX2:PIXEL_OPS_SSE2;
+#else
+	int level=PIXEL_OPS_SCALAR;
+#endif
+	return level<g_PixelOpsLimit?level:g_PixelOpsLimit;
+}
+
+bool DetectGrayscaleImage( const unsigned int *bits, int stride, int width, int height )
+{
+	if (width==0 || height==0)
+		return false;
+	bool (*detectRow)( const unsigned int *bits, int width, int &transparent )=DetectGrayscaleRow;
+#ifdef PIXEL_OPS_SIMD
+	int level=GetPixelOpsLevel();
+	if (level==PIXEL_OPS_AVX2)
+		detectRow=DetectGrayscaleRowAVX2;
+	else if (level==PIXEL_OPS_SSE2)
+		detectRow=DetectGrayscaleRowSSE2;
+#endif
+	int transparent=0;
+	for (int y=0;y<height;y++,bits+=stride)
+	{
+		if (!detectRow(bits,width,transparent))
+			return false;
+	}
+	if ((transparent*100)/(width*height)<5)
+		return false; // less than 5% transparent pixels
+	return true;
+}
+
+void CreateMonochromeImage( unsigned int *bits, int stride, int width, int height, unsigned int color )
+{
+	int r0=(color)&255;
+	int g0=(color>>8)&255;
+	int b0=(color>>16)&255;
+	void (*createRow)( unsigned int *bits, int width, int r0, int g0, int b0 )=CreateMonochromeRow;
+#ifdef PIXEL_OPS_SIMD
+	int level=GetPixelOpsLevel();
+	if (level==PIXEL_OPS_AVX2)
+		createRow=CreateMonochromeRowAVX2;
+	else if (level==PIXEL_OPS_SSE2)
+		createRow=CreateMonochromeRowSSE2;
+#endif
+	for (int y=0;y<height;y++,bits+=stride)
+		createRow(bits,width,r0,g0,b0);
+}
+
+void PremultiplyPixels( unsigned int *bits, int count, unsigned int color )
+{
+	int mr=(color)&255;
+	int mg=(color>>8)&255;
+	int mb=(color>>16)&255;
+#ifdef PIXEL_OPS_SIMD
+	int level=GetPixelOpsLevel();
+	if (level==PIXEL_OPS_AVX2)
+		PremultiplyRowAVX2(bits,count,mr,mg,mb);
+	else if (level==PIXEL_OPS_SSE2)
+		PremultiplyRowSSE2(bits,count,mr,mg,mb);
+	else
+#endif
+		PremultiplyRow(bits,count,mr,mg,mb);
+}
+
+void SetOpaquePixels( unsigned int *bits, int count )
+{
+	// simple enough for the compiler to vectorize
+	for (int i=0;i<count;i++)
+		bits[i]|=0xFF000000;
+}
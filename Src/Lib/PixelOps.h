@@ -0,0 +1,34 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+// PixelOps.h - processing kernels for 32-bit BGRA pixels
+// On x86 and x64 the kernels use SSE2, or AVX2 if the CPU supports it. The results are identical to the scalar code used on the other platforms.
+// The stride is in pixels
+
+// The instruction sets used by the kernels
+enum
+{
+	PIXEL_OPS_SCALAR,
+	PIXEL_OPS_SSE2,
+	PIXEL_OPS_AVX2,
+};
+
+// Limits the kernels to the given instruction set and returns the old limit. The tests and benchmarks use it to compare the kernels
+int SetPixelOpsLimit( int limit );
+// Returns the instruction set that the kernels use - the best one the CPU supports, up to the limit
+int GetPixelOpsLevel( void );
+
+// Returns true if all pixels are gray (the color channels and the alpha are within 2 of each other) and at least 5% of them are transparent
+bool DetectGrayscaleImage( const unsigned int *bits, int stride, int width, int height );
+
+// Replaces the color of all pixels with the given color (0xBBGGRR), premultiplied by the alpha of the pixel
+void CreateMonochromeImage( unsigned int *bits, int stride, int width, int height, unsigned int color );
+
+// Multiplies the color channels by the alpha and by the given color (0xBBGGRR) as (c*a*m)/(255*255). With the default color it is (c*a)/255
+void PremultiplyPixels( unsigned int *bits, int count, unsigned int color=0xFFFFFF );
+
+// Sets the alpha of all pixels to 255
+void SetOpaquePixels( unsigned int *bits, int count );
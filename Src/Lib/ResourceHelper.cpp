@@ -8,6 +8,8 @@
 #include "Settings.h"
 #include "Translations.h"
 #include "ResourceHelper.h"
+#include "PixelOps.h"
+#include "ImageResampler.h"
 #include "Assert.h"
 #include <vector>
 #include <wincodec.h>
@@ -335,23 +337,8 @@ void PremultiplyBitmap( HBITMAP hBitmap, COLORREF rgb )
 	if (hBitmap == NULL) return;
 	BITMAP info;
 	GetObject(hBitmap,sizeof(info),&info);
-	int n=info.bmWidth*info.bmHeight;
-	int mr=(rgb)&255;
-	int mg=(rgb>>8)&255;
-	int mb=(rgb>>16)&255;
 	// pre-multiply the alpha
-	for (int i=0;i<n;i++)
-	{
-		unsigned int &pixel=((unsigned int*)info.bmBits)[i];
-		int a=(pixel>>24);
-		int r=(pixel>>16)&255;
-		int g=(pixel>>8)&255;
-		int b=(pixel)&255;
-		r=(r*a*mr)/(255*255);
-		g=(g*a*mg)/(255*255);
-		b=(b*a*mb)/(255*255);
-		pixel=(a<<24)|(r<<16)|(g<<8)|b;
-	}
+	PremultiplyPixels((unsigned int*)info.bmBits,info.bmWidth*info.bmHeight,rgb);
 }
 
 // Creates a grayscale version of an icon
@@ -502,6 +489,18 @@ HBITMAP LoadImageFile( const wchar_t *path, const SIZE *pSize, bool bUseAlpha, b
 	HBITMAP bmp=CreateDIBSection(hdc,&bi,DIB_RGB_COLORS,(void**)&pBits,NULL,0);
 	DeleteDC(hdc);
 
+	// premultiplied images are resized with our own filter. the weights are the same for all frames
+	bool bResize=(frameWidthS!=frameWidthD || frameHeightS!=frameHeightD);
+	bool bResample=(bResize && bPremultiply && frameWidthS>0 && frameHeightS>0);
+	CResampleFilter filterX, filterY;
+	std::vector<unsigned int> frameBits;
+	if (bResample)
+	{
+		filterX.Init(frameWidthS,frameWidthD);
+		filterY.Init(frameHeightS,frameHeightD);
+		frameBits.resize(frameWidthS*frameHeightS);
+	}
+
 	for (int frame=0;frame<frameCount;frame++)
 	{
 		CComPtr<IWICBitmapSource> pFrame=pBitmap;
@@ -518,7 +517,15 @@ HBITMAP LoadImageFile( const wchar_t *path, const SIZE *pSize, bool bUseAlpha, b
 			pClipper->Initialize(pBitmap,&rect);
 			pFrame=pClipper;
 		}
-		if (frameWidthS!=frameWidthD || frameHeightS!=frameHeightD)
+		int stride=frameWidthD*4;
+		int frameSize=frameHeightD*stride;
+		if (bResample)
+		{
+			pFrame->CopyPixels(NULL,frameWidthS*4,frameWidthS*frameHeightS*4,(BYTE*)&frameBits[0]);
+			ResizePixels(&frameBits[0],frameWidthS,(unsigned int*)(pBits+frameSize*frame),frameWidthD,filterX,filterY);
+			continue;
+		}
+		if (bResize)
 		{
 			CComPtr<IWICBitmapScaler> pScaler;
 			if (FAILED(pFactory->CreateBitmapScaler(&pScaler)))
@@ -530,8 +537,6 @@ HBITMAP LoadImageFile( const wchar_t *path, const SIZE *pSize, bool bUseAlpha, b
 			pScaler->Initialize(pFrame,frameWidthD,frameHeightD,WICBitmapInterpolationModeFant);
 			pFrame=pScaler;
 		}
-		int stride=frameWidthD*4;
-		int frameSize=frameHeightD*stride;
 		pFrame->CopyPixels(NULL,stride,frameSize,pBits+frameSize*frame);
 	}
 
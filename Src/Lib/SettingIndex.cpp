@@ -0,0 +1,174 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "SettingIndex.h"
+#include "FNVHash.h"
+#include "Assert.h"
+#include <algorithm>
+
+static wchar_t FoldChar( wchar_t c )
+{
+	return (c>='a' && c<='z')?c-'a'+'A':c;
+}
+
+static bool CompareNames( const wchar_t *name1, const wchar_t *name2 )
+{
+	for (;*name1;name1++,name2++)
+	{
+		if (FoldChar(*name1)!=FoldChar(*name2))
+			return false;
+	}
+	return *name2==0;
+}
+
+// FNV hash of the folded name
+unsigned int CSettingIndex::CalcHash( const wchar_t *name )
+{
+	unsigned int hash=FNV_HASH0;
+	for (;*name;name++)
+	{
+		wchar_t c=FoldChar(*name);
+		hash=(hash^(c&255))*16777619;
+		hash=(hash^(c>>8))*16777619;
+	}
+	return hash;
+}
+
+unsigned int CSettingIndex::GetSlot( unsigned int hash, unsigned int displacement ) const
+{
+	// mix the hash with the displacement so every displacement gives a different permutation
+	hash^=displacement*0x9E3779B9;
+	hash^=hash>>16;
+	hash*=0x85EBCA6B;
+	hash^=hash>>13;
+	return hash&m_Mask;
+}
+
+void CSettingIndex::Build( const std::vector<const wchar_t*> &names )
+{
+	m_Names=names;
+	std::vector<unsigned int> hashes(names.size());
+	std::vector<std::pair<unsigned int,int>> sorted; // hash, position
+	for (size_t i=0;i<names.size();i++)
+	{
+		if (!names[i]) continue;
+		hashes[i]=CalcHash(names[i]);
+		sorted.push_back(std::pair<unsigned int,int>(hashes[i],(int)i));
+	}
+
+	// skip the duplicate names, the first one wins
+	std::sort(sorted.begin(),sorted.end());
+	std::vector<bool> skip(names.size(),false);
+	bool bCollision=false; // two different names have the same hash
+	for (size_t i=1;i<sorted.size();i++)
+	{
+		for (size_t j=i;j>0 && sorted[j-1].first==sorted[i].first;j--)
+		{
+			if (CompareNames(names[sorted[i].second],names[sorted[j-1].second]))
+			{
+				skip[sorted[i].second]=true;
+				break;
+			}
+			bCollision=true;
+		}
+	}
+	Assert(!bCollision);
+	m_bLinear=false;
+	m_Slots.clear();
+	m_Displacements.clear();
+	if (bCollision)
+	{
+		// the names would go to the same slot for every displacement
+		m_bLinear=true;
+		return;
+	}
+	int count=0;
+	for (size_t i=0;i<names.size();i++)
+		if (names[i] && !skip[i]) count++;
+
+	// use at least twice as many slots as names, so a displacement is found quickly
+	int slotCount=16;
+	while (slotCount<count*2)
+		slotCount*=2;
+	int bucketCount=count/4+1;
+
+	for (int attempt=0;;attempt++)
+	{
+		if (attempt==4)
+		{
+			// very unlikely. give up and search the names one by one
+			m_Slots.clear();
+			m_Displacements.clear();
+			m_bLinear=true;
+			return;
+		}
+		m_Mask=slotCount-1;
+		m_Slots.assign(slotCount,-1);
+		m_Displacements.assign(bucketCount,0);
+
+		// place the biggest buckets first
+		std::vector<std::vector<int>> buckets(bucketCount);
+		for (size_t i=0;i<names.size();i++)
+			if (names[i] && !skip[i]) buckets[hashes[i]%bucketCount].push_back((int)i);
+		std::vector<std::pair<int,int>> order; // -size, bucket
+		for (int b=0;b<bucketCount;b++)
+			order.push_back(std::pair<int,int>(-(int)buckets[b].size(),b));
+		std::sort(order.begin(),order.end());
+
+		bool bFailed=false;
+		std::vector<unsigned int> slots;
+		for (std::vector<std::pair<int,int>>::const_iterator it=order.begin();it!=order.end() && it->first<0 && !bFailed;++it)
+		{
+			const std::vector<int> &bucket=buckets[it->second];
+			bool bFound=false;
+			for (unsigned int d=0;d<65536 && !bFound;d++)
+			{
+				slots.clear();
+				bFound=true;
+				for (std::vector<int>::const_iterator it2=bucket.begin();it2!=bucket.end();++it2)
+				{
+					unsigned int slot=GetSlot(hashes[*it2],d);
+					if (m_Slots[slot]>=0 || std::find(slots.begin(),slots.end(),slot)!=slots.end())
+					{
+						bFound=false;
+						break;
+					}
+					slots.push_back(slot);
+				}
+				if (bFound)
+				{
+					m_Displacements[it->second]=(unsigned short)d;
+					for (size_t i=0;i<bucket.size();i++)
+						m_Slots[slots[i]]=bucket[i];
+				}
+			}
+			bFailed=!bFound;
+		}
+		if (!bFailed)
+			break;
+		// unlikely. try again with more slots
+		slotCount*=2;
+	}
+}
+
+int CSettingIndex::Find( const wchar_t *name ) const
+{
+	if (m_bLinear)
+	{
+		for (size_t i=0;i<m_Names.size();i++)
+		{
+			if (m_Names[i] && CompareNames(name,m_Names[i]))
+				return (int)i;
+		}
+		return -1;
+	}
+	if (m_Displacements.empty())
+		return -1;
+	unsigned int hash=CalcHash(name);
+	int index=m_Slots[GetSlot(hash,m_Displacements[hash%m_Displacements.size()])];
+	if (index>=0 && CompareNames(name,m_Names[index]))
+		return index;
+	return -1;
+}
@@ -0,0 +1,32 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include <vector>
+
+// CSettingIndex - finds a name in a fixed list in constant time, using a perfect hash
+// The names are hashed into buckets, and every bucket gets a displacement that sends its names to unused slots.
+// A lookup calculates one hash, reads one displacement and compares one string.
+// The names are case-insensitive (only the ASCII letters are folded). The index doesn't depend on the OS
+class CSettingIndex
+{
+public:
+	CSettingIndex( void ) { m_Mask=0; m_bLinear=false; }
+
+	// builds the index for the given names. NULL names are skipped. the strings must stay valid while the index is used
+	void Build( const std::vector<const wchar_t*> &names );
+	// returns the position of the name in the list, or -1 if the name is not found
+	int Find( const wchar_t *name ) const;
+
+private:
+	std::vector<unsigned short> m_Displacements; // one for each bucket
+	std::vector<int> m_Slots; // position of the name, or -1 if the slot is empty
+	std::vector<const wchar_t*> m_Names;
+	unsigned int m_Mask; // number of slots - 1
+	bool m_bLinear; // no perfect hash was found. the names are searched one by one
+
+	static unsigned int CalcHash( const wchar_t *name );
+	unsigned int GetSlot( unsigned int hash, unsigned int displacement ) const;
+};
@@ -0,0 +1,97 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "SettingKeyIndex.h"
+#include "FNVHash.h"
+#include "Assert.h"
+#include <wchar.h>
+
+static wchar_t FoldKeyChar( wchar_t c )
+{
+	return (c>='a' && c<='z')?c-'a'+'A':c;
+}
+
+static unsigned int CalcKeyHash( const wchar_t *key, size_t len )
+{
+	unsigned int hash=FNV_HASH0;
+	for (size_t i=0;i<len;i++)
+	{
+		wchar_t c=FoldKeyChar(key[i]);
+		hash=(hash^(c&255))*16777619;
+		hash=(hash^(c>>8))*16777619;
+	}
+	return hash;
+}
+
+static bool CompareKeys( const wchar_t *key1, const wchar_t *key2, size_t len )
+{
+	for (size_t i=0;i<len;i++)
+	{
+		if (FoldKeyChar(key1[i])!=FoldKeyChar(key2[i]))
+			return false;
+	}
+	return true;
+}
+
+// Returns the length of the text before '=', without the trailing whitespace. Returns -1 if the line has no '='
+static int GetKeyLength( const wchar_t *line )
+{
+	const wchar_t *end=wcschr(line,'=');
+	if (!end) return -1;
+	while (end>line && (end[-1]==' ' || end[-1]=='\t'))
+		end--;
+	return (int)(end-line);
+}
+
+void CSettingKeyIndex::Build( const std::vector<const wchar_t*> &lines )
+{
+	unsigned int size=16;
+	while (size<lines.size()*2)
+		size*=2;
+	KeyEntry empty={0,0,-1};
+	m_Entries.assign(size,empty);
+	for (int i=0;i<(int)lines.size();i++)
+	{
+		const wchar_t *line=lines[i];
+		int len=GetKeyLength(line);
+		if (len<0) continue;
+		unsigned int hash=CalcKeyHash(line,len);
+		for (unsigned int slot=hash&(size-1);;slot=(slot+1)&(size-1))
+		{
+			KeyEntry &entry=m_Entries[slot];
+			if (entry.line<0)
+			{
+				entry.hash=hash;
+				entry.keyLen=len;
+				entry.line=i;
+				break;
+			}
+			if (entry.hash==hash && entry.keyLen==len && CompareKeys(lines[entry.line],line,len))
+			{
+				entry.line=i; // the last definition wins
+				break;
+			}
+		}
+	}
+}
+
+int CSettingKeyIndex::Find( const std::vector<const wchar_t*> &lines, const wchar_t *key, size_t len ) const
+{
+	Assert(len==0 || (key[len-1]!=' ' && key[len-1]!='\t'));
+	if (m_Entries.empty())
+		return -1;
+	unsigned int hash=CalcKeyHash(key,len);
+	unsigned int mask=(unsigned int)m_Entries.size()-1;
+	for (unsigned int slot=hash&mask;m_Entries[slot].line>=0;slot=(slot+1)&mask)
+	{
+		const KeyEntry &entry=m_Entries[slot];
+		if (entry.hash!=hash || entry.keyLen!=(int)len)
+			continue;
+		Assert(entry.line<(int)lines.size());
+		if (CompareKeys(key,lines[entry.line],len))
+			return entry.line;
+	}
+	return -1;
+}
@@ -0,0 +1,30 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include <vector>
+
+// CSettingKeyIndex - hash table of the keys in a list of "key=value" lines. The key is the text before the first '=', without the trailing whitespace
+// Finds the last line with a given key, like searching the lines backwards. The keys are case-insensitive (only the ASCII letters are folded).
+// The index doesn't depend on the OS
+class CSettingKeyIndex
+{
+public:
+	// builds the index for the given lines
+	void Build( const std::vector<const wchar_t*> &lines );
+	void Clear( void ) { m_Entries.clear(); }
+	// returns the index of the last line with the given key, or -1 if there is none. lines must be the same as in Build
+	// the key must not end with whitespace
+	int Find( const std::vector<const wchar_t*> &lines, const wchar_t *key, size_t len ) const;
+
+private:
+	struct KeyEntry
+	{
+		unsigned int hash;
+		int keyLen;
+		int line; // index of the last line with this key. -1 - the entry is empty
+	};
+	std::vector<KeyEntry> m_Entries;
+};
@@ -0,0 +1,59 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+// SettingRef.h - included by Settings.h after ResolveSetting, GetSettingsGeneration, ReadSettingInt and ReadSettingString.
+// Doesn't depend on the rest of the settings, so it can be tested with a fake settings table
+
+// CSettingRef - a setting that is found by name only once, for the settings that are read very often
+// Declare it as a static or global variable: static CSettingRef<bool> s_SearchTrack(L"SearchTrack");
+// The setting is resolved the first time it is read, and again after the settings are initialized again.
+// A name that is not found is remembered too, so it is looked up (and reported) only once per generation.
+// The values are read from the current snapshot, like the GetSetting#### functions. Before the settings are initialized the default is returned
+template<class T> class CSettingRef
+{
+public:
+	CSettingRef( const wchar_t *name ) { m_Name=name; m_State=0; }
+
+	T Get( void ) const;
+	operator T( void ) const { return Get(); }
+
+private:
+	const wchar_t *m_Name;
+	// the generation in the high 32 bits, and the index of the setting+1 in the low 32 bits (0 - not found)
+	// they are stored with a single 64-bit write, so a reader never gets an index that was resolved in a different generation
+	mutable volatile LONG64 m_State;
+
+	int Resolve( CSetting::Type type ) const
+	{
+		DWORD generation=(DWORD)GetSettingsGeneration();
+		LONG64 state=ReadNoFence64(&m_State);
+		if ((DWORD)(state>>32)!=generation)
+		{
+			int index=ResolveSetting(m_Name,type);
+			state=(LONG64)(((unsigned __int64)generation<<32)|(DWORD)(index+1));
+			WriteNoFence64(&m_State,state);
+		}
+		return (int)(DWORD)state-1;
+	}
+};
+
+template<> inline bool CSettingRef<bool>::Get( void ) const
+{
+	int index=Resolve(CSetting::TYPE_BOOL);
+	return index>=0 && ReadSettingInt(index)==1;
+}
+
+template<> inline int CSettingRef<int>::Get( void ) const
+{
+	int index=Resolve(CSetting::TYPE_INT);
+	return index>=0?ReadSettingInt(index):0;
+}
+
+template<> inline CString CSettingRef<CString>::Get( void ) const
+{
+	int index=Resolve(CSetting::TYPE_STRING);
+	return index>=0?ReadSettingString(index):CString();
+}
@@ -10,6 +10,10 @@
 #include "ResourceHelper.h"
 #include "StringUtils.h"
 #include "FNVHash.h"
+#include "SettingIndex.h"
+#include "SettingsSnapshot.h"
+#include "SettingsStore.h"
+#include "XmlStream.h"
 #include <Uxtheme.h>
 #include <VSStyle.h>
 #include <propkey.h>
@@ -24,7 +28,10 @@
 // Read/Write lock for accessing the settings. Can't be acquired recursively. Only the main UI thread (the one displaying the settings UI)
 // can write the settings, and because of that it shouldn't lock when reading the settings. The settings editing code shouldn't use
 // GetSettings#### at all to avoid deadlocks
+// The GetSettings#### functions don't use the lock. They read the last snapshot, which is published when the write lock is released
 static SRWLOCK g_SettingsLock;
+static CSnapshotPublisher g_SettingsSnapshots;
+static void PublishSettingsSnapshot( void );
 
 #ifdef _DEBUG
 static _declspec(thread) int g_LockState; // 0 - none, 1 - read, 2 - write
@@ -64,6 +71,7 @@ CSettingsLockWrite::~CSettingsLockWrite( void )
 	Assert(g_LockState==2);
 	g_LockState=0;
 #endif
+	PublishSettingsSnapshot();
 	ReleaseSRWLockExclusive(&g_SettingsLock);
 }
 
@@ -151,13 +159,13 @@ bool CSetting::ShouldLoad( bool bShared ) const
 	return (flags&FLAG_SHARED)?bShared:!bShared;
 }
 
-bool CSetting::ReadValue( CRegKey &regKey, const wchar_t *valName )
+bool CSetting::ReadValue( const ISettingsStore &store, const wchar_t *valName )
 {
 	// bool, int, hotkey, color
 	if (type==CSetting::TYPE_BOOL || (type==CSetting::TYPE_INT && this[1].type!=CSetting::TYPE_RADIO) || type==CSetting::TYPE_HOTKEY || type==CSetting::TYPE_HOTKEY_ANY || type==CSetting::TYPE_COLOR)
 	{
 		DWORD val;
-		if (regKey.QueryDWORDValue(valName,val)==ERROR_SUCCESS)
+		if (store.QueryDWORD(valName,val))
 		{
 			if (type==CSetting::TYPE_BOOL)
 				value=CComVariant(val?1:0);
@@ -171,13 +179,10 @@ bool CSetting::ReadValue( CRegKey &regKey, const wchar_t *valName )
 	// radio
 	if (type==CSetting::TYPE_INT && this[1].type==CSetting::TYPE_RADIO)
 	{
-		ULONG len;
+		CString text;
 		DWORD val;
-		if (regKey.QueryStringValue(valName,NULL,&len)==ERROR_SUCCESS)
+		if (store.QueryString(valName,text))
 		{
-			CString text;
-			regKey.QueryStringValue(valName,text.GetBuffer(len),&len);
-			text.ReleaseBuffer(len);
 			val=0;
 			for (const CSetting *pRadio=this+1;pRadio->type==CSetting::TYPE_RADIO;pRadio++,val++)
 			{
@@ -188,7 +193,7 @@ bool CSetting::ReadValue( CRegKey &regKey, const wchar_t *valName )
 				}
 			}
 		}
-		else if (regKey.QueryDWORDValue(valName,val)==ERROR_SUCCESS)
+		else if (store.QueryDWORD(valName,val))
 		{
 			value=CComVariant((int)val);
 			return true;
@@ -199,12 +204,10 @@ bool CSetting::ReadValue( CRegKey &regKey, const wchar_t *valName )
 	// string
 	if (type>=CSetting::TYPE_STRING && type!=CSetting::TYPE_MULTISTRING)
 	{
-		ULONG len;
-		if (regKey.QueryStringValue(valName,NULL,&len)==ERROR_SUCCESS)
+		CString text;
+		if (store.QueryString(valName,text))
 		{
-			value.vt=VT_BSTR;
-			value.bstrVal=SysAllocStringLen(NULL,len-1);
-			regKey.QueryStringValue(valName,value.bstrVal,&len);
+			value=CComVariant(text.GetString());
 			return true;
 		}
 		return false;
@@ -213,27 +216,16 @@ bool CSetting::ReadValue( CRegKey &regKey, const wchar_t *valName )
 	// multistring
 	if (type==CSetting::TYPE_MULTISTRING)
 	{
-		ULONG len;
-		if (regKey.QueryMultiStringValue(valName,NULL,&len)==ERROR_SUCCESS)
+		CString text;
+		if (store.QueryMultiString(valName,text))
 		{
-			value.vt=VT_BSTR;
-			value.bstrVal=SysAllocStringLen(NULL,len-1);
-			regKey.QueryMultiStringValue(valName,value.bstrVal,&len);
-			for (int i=0;i<(int)len-1;i++)
-				if (value.bstrVal[i]==0)
-					value.bstrVal[i]='\n';
+			value=CComVariant(text.GetString());
 			return true;
 		}
-		else if (regKey.QueryStringValue(valName,NULL,&len)==ERROR_SUCCESS)
+		else if (store.QueryString(valName,text))
 		{
-			value.vt=VT_BSTR;
-			value.bstrVal=SysAllocStringLen(NULL,len);
-			regKey.QueryStringValue(valName,value.bstrVal,&len);
-			if (len>0)
-			{
-				value.bstrVal[len-1]='\n';
-				value.bstrVal[len]=0;
-			}
+			text+=L'\n';
+			value=CComVariant(text.GetString());
 			return true;
 		}
 		return false;
@@ -244,6 +236,27 @@ bool CSetting::ReadValue( CRegKey &regKey, const wchar_t *valName )
 }
 
 void CSetting::LoadValue( CRegKey &regSettings, CRegKey &regSettingsUser, CRegKey &regPolicy, CRegKey &regPolicyUser )
+{
+	CRegSettingsStore settings(regSettings), settingsUser(regSettingsUser), policy(regPolicy), policyUser(regPolicyUser);
+	LoadValue(regSettings?&settings:NULL,regSettingsUser?&settingsUser:NULL,regPolicy?&policy:NULL,regPolicyUser?&policyUser:NULL);
+}
+
+// reads the values of a setting for LoadSettingValue
+class CSettingValueReader: public ISettingValueReader
+{
+public:
+	CSettingValueReader( CSetting &setting ): m_Setting(setting) {}
+
+	virtual bool ReadValue( const ISettingsStore &store, const wchar_t *valName ) { return m_Setting.ReadValue(store,valName); }
+	virtual void SetDefault( void ) { m_Setting.defValue=m_Setting.value; }
+
+private:
+	CSetting &m_Setting;
+
+	void operator=( const CSettingValueReader& );
+};
+
+void CSetting::LoadValue( const ISettingsStore *pSettings, const ISettingsStore *pSettingsUser, const ISettingsStore *pPolicy, const ISettingsStore *pPolicyUser )
 {
 	if (!(flags&CSetting::FLAG_NODEFAULT))
 		flags|=CSetting::FLAG_DEFAULT;
@@ -251,102 +264,14 @@ void CSetting::LoadValue( CRegKey &regSettings, CRegKey &regSettingsUser, CRegKe
 	value=defValue;
 	flags&=~CSetting::FLAG_FORCED_DEFAULT;
 
-	wchar_t name2[256];
-
-	// load HKLM group policies
-	if (regPolicy)
-	{
-		Sprintf(name2,_countof(name2),L"%s_State",name);
-		DWORD val;
-		if (regPolicy.QueryDWORDValue(name2,val)==ERROR_SUCCESS && val<=2)
-		{
-			if (ReadValue(regPolicy,name))
-			{
-				if (val==0) // locked to value
-				{
-					flags|=CSetting::FLAG_LOCKED_REG;
-					flags&=~CSetting::FLAG_DEFAULT;
-					return;
-				}
-				else if (val==1) // locked to default
-				{
-					flags|=CSetting::FLAG_LOCKED_REG;
-					return;
-				}
-				else // change default
-				{
-					defValue=value;
-					flags|=CSetting::FLAG_FORCED_DEFAULT;
-				}
-			}
-		}
-	}
-
-	if (regSettings)
-	{
-		// load HKLM settings
-		DWORD val;
-		if (regSettings.QueryDWORDValue(name,val)==ERROR_SUCCESS && val==0xDEFA)
-		{
-			flags|=CSetting::FLAG_LOCKED_REG;
-			return;
-		}
-		else if (ReadValue(regSettings,name))
-		{
-			flags|=CSetting::FLAG_LOCKED_REG;
-			flags&=~CSetting::FLAG_DEFAULT;
-			return;
-		}
-		else
-		{
-			// check if a default value is selected in HKLM
-			Sprintf(name2,_countof(name2),L"%s_Default",name);
-			if (ReadValue(regSettings,name2))
-			{
-				defValue=value;
-				flags|=CSetting::FLAG_FORCED_DEFAULT;
-			}
-		}
-	}
-
-	// load HKCU group policies
-	if (regPolicyUser)
-	{
-		Sprintf(name2,_countof(name2),L"%s_State",name);
-		DWORD val;
-		if (regPolicyUser.QueryDWORDValue(name2,val)==ERROR_SUCCESS && val<=2)
-		{
-			if (ReadValue(regPolicyUser,name))
-			{
-				if (val==0) // locked to value
-				{
-					flags|=CSetting::FLAG_LOCKED_REG;
-					flags&=~CSetting::FLAG_DEFAULT;
-					return;
-				}
-				else if (val==1) // locked to default
-				{
-					flags|=CSetting::FLAG_LOCKED_REG;
-					return;
-				}
-				else // change default
-				{
-					defValue=value;
-					flags|=CSetting::FLAG_FORCED_DEFAULT;
-				}
-			}
-		}
-	}
-
-	// load HKCU settings
-	if (regSettingsUser)
-	{
-		if (ReadValue(regSettingsUser,name))
-		{
-			flags&=~CSetting::FLAG_DEFAULT;
-			return;
-		}
-	}
+	CSettingValueReader reader(*this);
+	int result=LoadSettingValue(name,reader,pSettings,pSettingsUser,pPolicy,pPolicyUser);
+	if (!(result&SETTING_LOAD_DEFAULT))
+		flags&=~CSetting::FLAG_DEFAULT;
+	if (result&SETTING_LOAD_FORCED_DEFAULT)
+		flags|=CSetting::FLAG_FORCED_DEFAULT;
+	if (result&SETTING_LOAD_LOCKED)
+		flags|=CSetting::FLAG_LOCKED_REG;
 }
 
 class CSettingsManager
@@ -369,6 +294,9 @@ public:
 	void ResetSettings( void );
 
 	CSetting *GetSettings( void ) const { return m_pSettings; }
+	// finds a setting by name (case-insensitive). returns NULL if the setting doesn't exist
+	CSetting *FindSettingByName( const wchar_t *name ) const;
+	void PublishSnapshot( void );
 	ICustomSettings *GetCustom( void ) const { return m_pCustom; }
 	bool SetSettingsStyle( int style, int mask ) { if (m_SettingsStyle==style && m_SettingsMask==mask) return false; m_SettingsStyle=style; m_SettingsMask=mask; return true; }
 	void GetSettingsStyle( int &style, int &mask ) const { style=m_SettingsStyle; mask=m_SettingsMask; }
@@ -389,9 +317,32 @@ private:
 	const wchar_t *m_GpPathShared;
 	const wchar_t *m_CompName;
 	const wchar_t *m_XMLName;
+	CSettingIndex m_Index; // all settings with type>=0, by name
 };
 
 static CSettingsManager g_SettingsManager;
+static volatile LONG g_SettingsGeneration;
+
+static void PublishSettingsSnapshot( void )
+{
+	g_SettingsManager.PublishSnapshot();
+}
+
+// Returns the value of the setting from the snapshot, or NULL if there is no snapshot yet
+static const CSettingsSnapshot::Value *GetSnapshotValue( const CSnapshotReader &reader, int index )
+{
+#ifdef _DEBUG
+	Assert(g_LockState==0); // the snapshot doesn't contain the changes made under the write lock
+#endif
+	const CSettingsSnapshot *pSnapshot=(const CSettingsSnapshot*)reader.GetSnapshot();
+	if (!pSnapshot) return NULL;
+	return (index>=0 && index<pSnapshot->GetCount())?&pSnapshot->GetValue(index):NULL;
+}
+
+static const CSettingsSnapshot::Value *GetSnapshotValue( const CSnapshotReader &reader, const CSetting *pSetting )
+{
+	return GetSnapshotValue(reader,(int)(pSetting-g_SettingsManager.GetSettings()));
+}
 
 CSettingsManager::CSettingsManager( void )
 {
@@ -456,6 +407,13 @@ void CSettingsManager::Init( CSetting *pSettings, TSettingsComponent component,
 	m_pSettings=pSettings;
 	m_pCustom=pCustom;
 	m_SettingsStyle=m_SettingsMask=0;
+	{
+		std::vector<const wchar_t*> names;
+		for (const CSetting *pSetting=m_pSettings;pSetting->name;pSetting++)
+			names.push_back(pSetting->type>=0?pSetting->name:NULL);
+		m_Index.Build(names);
+	}
+	InterlockedIncrement(&g_SettingsGeneration);
 	InitializeSRWLock(&g_SettingsLock);
 	CSettingsLockWrite lock;
 	for (CSetting *pSetting=m_pSettings;pSetting->name;pSetting++)
@@ -490,16 +448,33 @@ CSettingsManager::~CSettingsManager( void )
 	ResetImageList();
 }
 
+// Publishes a copy of the current values. Must be called with the write lock
+void CSettingsManager::PublishSnapshot( void )
+{
+	if (!m_pSettings) return;
+	g_SettingsSnapshots.Publish(new CSettingsSnapshot(m_pSettings,g_SettingsSnapshots.GetNextVersion()));
+}
+
+CSetting *CSettingsManager::FindSettingByName( const wchar_t *name ) const
+{
+	int index=m_Index.Find(name);
+	return index>=0?m_pSettings+index:NULL;
+}
+
+static bool IsIntSetting( const CSetting *pSetting )
+{
+	return pSetting->type==CSetting::TYPE_INT || pSetting->type==CSetting::TYPE_HOTKEY || pSetting->type==CSetting::TYPE_HOTKEY_ANY || pSetting->type==CSetting::TYPE_COLOR;
+}
+
 bool CSettingsManager::GetSettingBool( const wchar_t *name ) const
 {
-	for (const CSetting *pSetting=m_pSettings;pSetting->name;pSetting++)
+	const CSetting *pSetting=FindSettingByName(name);
+	if (pSetting && pSetting->type==CSetting::TYPE_BOOL)
 	{
-		if (pSetting->type==CSetting::TYPE_BOOL && _wcsicmp(pSetting->name,name)==0)
-		{
-			Assert(!pSetting->pLinkTo);
-			CSettingsLockRead lock;
-			return IsVariantTrue(pSetting->value);
-		}
+		Assert(!pSetting->pLinkTo);
+		CSnapshotReader reader(g_SettingsSnapshots);
+		const CSettingsSnapshot::Value *pValue=GetSnapshotValue(reader,pSetting);
+		return pValue && pValue->intVal==1;
 	}
 	Assert(0);
 	return false;
@@ -507,15 +482,14 @@ bool CSettingsManager::GetSettingBool( const wchar_t *name ) const
 
 bool CSettingsManager::GetSettingBool( const wchar_t *name, bool &bDef ) const
 {
-	for (const CSetting *pSetting=m_pSettings;pSetting->name;pSetting++)
+	const CSetting *pSetting=FindSettingByName(name);
+	if (pSetting && pSetting->type==CSetting::TYPE_BOOL)
 	{
-		if (pSetting->type==CSetting::TYPE_BOOL && _wcsicmp(pSetting->name,name)==0)
-		{
-			Assert(!pSetting->pLinkTo);
-			CSettingsLockRead lock;
-			bDef=pSetting->IsDefault() && !pSetting->IsForcedDefault();
-			return IsVariantTrue(pSetting->value);
-		}
+		Assert(!pSetting->pLinkTo);
+		CSnapshotReader reader(g_SettingsSnapshots);
+		const CSettingsSnapshot::Value *pValue=GetSnapshotValue(reader,pSetting);
+		bDef=pValue && (pValue->flags&(CSetting::FLAG_DEFAULT|CSetting::FLAG_FORCED_DEFAULT))==CSetting::FLAG_DEFAULT;
+		return pValue && pValue->intVal==1;
 	}
 	Assert(0);
 	bDef=false;
@@ -524,15 +498,14 @@ bool CSettingsManager::GetSettingBool( const wchar_t *name, bool &bDef ) const
 
 int CSettingsManager::GetSettingInt( const wchar_t *name ) const
 {
-	for (const CSetting *pSetting=m_pSettings;pSetting->name;pSetting++)
+	const CSetting *pSetting=FindSettingByName(name);
+	if (pSetting && IsIntSetting(pSetting))
 	{
-		if ((pSetting->type==CSetting::TYPE_INT || pSetting->type==CSetting::TYPE_HOTKEY || pSetting->type==CSetting::TYPE_HOTKEY_ANY || pSetting->type==CSetting::TYPE_COLOR) && _wcsicmp(pSetting->name,name)==0)
-		{
-			Assert(!pSetting->pLinkTo);
-			CSettingsLockRead lock;
-			Assert(pSetting->value.vt==VT_I4);
-			return pSetting->value.intVal;
-		}
+		Assert(!pSetting->pLinkTo);
+		CSnapshotReader reader(g_SettingsSnapshots);
+		const CSettingsSnapshot::Value *pValue=GetSnapshotValue(reader,pSetting);
+		Assert(!pValue || !pValue->str);
+		return pValue?pValue->intVal:0;
 	}
 	Assert(0);
 	return 0;
@@ -540,16 +513,15 @@ int CSettingsManager::GetSettingInt( const wchar_t *name ) const
 
 int CSettingsManager::GetSettingInt( const wchar_t *name, bool &bDef ) const
 {
-	for (const CSetting *pSetting=m_pSettings;pSetting->name;pSetting++)
+	const CSetting *pSetting=FindSettingByName(name);
+	if (pSetting && IsIntSetting(pSetting))
 	{
-		if ((pSetting->type==CSetting::TYPE_INT || pSetting->type==CSetting::TYPE_HOTKEY || pSetting->type==CSetting::TYPE_HOTKEY_ANY || pSetting->type==CSetting::TYPE_COLOR) && _wcsicmp(pSetting->name,name)==0)
-		{
-			Assert(!pSetting->pLinkTo);
-			CSettingsLockRead lock;
-			Assert(pSetting->value.vt==VT_I4);
-			bDef=pSetting->IsDefault() && !pSetting->IsForcedDefault();
-			return pSetting->value.intVal;
-		}
+		Assert(!pSetting->pLinkTo);
+		CSnapshotReader reader(g_SettingsSnapshots);
+		const CSettingsSnapshot::Value *pValue=GetSnapshotValue(reader,pSetting);
+		Assert(!pValue || !pValue->str);
+		bDef=pValue && (pValue->flags&(CSetting::FLAG_DEFAULT|CSetting::FLAG_FORCED_DEFAULT))==CSetting::FLAG_DEFAULT;
+		return pValue?pValue->intVal:0;
 	}
 	Assert(0);
 	bDef=false;
@@ -558,15 +530,14 @@ int CSettingsManager::GetSettingInt( const wchar_t *name, bool &bDef ) const
 
 CString CSettingsManager::GetSettingString( const wchar_t *name ) const
 {
-	for (const CSetting *pSetting=m_pSettings;pSetting->name;pSetting++)
+	const CSetting *pSetting=FindSettingByName(name);
+	if (pSetting && pSetting->type>=CSetting::TYPE_STRING)
 	{
-		if (pSetting->type>=CSetting::TYPE_STRING && _wcsicmp(pSetting->name,name)==0)
-		{
-			Assert(!pSetting->pLinkTo);
-			CSettingsLockRead lock;
-			Assert(pSetting->value.vt==VT_BSTR);
-			return pSetting->value.bstrVal;
-		}
+		Assert(!pSetting->pLinkTo);
+		CSnapshotReader reader(g_SettingsSnapshots);
+		const CSettingsSnapshot::Value *pValue=GetSnapshotValue(reader,pSetting);
+		Assert(!pValue || pValue->str);
+		return (pValue && pValue->str)?pValue->str:L"";
 	}
 	Assert(0);
 	return CString();
@@ -601,10 +572,17 @@ void CSettingsManager::LoadSettings( bool bShared )
 	CRegKey regSettings, regSettingsUser, regPolicy, regPolicyUser;
 	bool bUpgrade=OpenSettingsKeys(bShared?m_RegPathShared:m_RegPath, bShared?m_GpPathShared:m_GpPath, regSettings, regSettingsUser, regPolicy, regPolicyUser);
 
+	// read every key once, instead of querying it for each setting
+	CSettingsValueMap settings, settingsUser, policy, policyUser;
+	const ISettingsStore *pSettings=(regSettings && settings.Load(regSettings))?&settings:NULL;
+	const ISettingsStore *pSettingsUser=(regSettingsUser && settingsUser.Load(regSettingsUser))?&settingsUser:NULL;
+	const ISettingsStore *pPolicy=(regPolicy && policy.Load(regPolicy))?&policy:NULL;
+	const ISettingsStore *pPolicyUser=(regPolicyUser && policyUser.Load(regPolicyUser))?&policyUser:NULL;
+
 	for (CSetting *pSetting=m_pSettings;pSetting->name;pSetting++)
 	{
 		if (pSetting->ShouldLoad(bShared))
-			pSetting->LoadValue(regSettings,regSettingsUser,regPolicy,regPolicyUser);
+			pSetting->LoadValue(pSettings,pSettingsUser,pPolicy,pPolicyUser);
 	}
 	if (bUpgrade)
 		UpgradeSettings(bShared);
@@ -696,145 +674,147 @@ void CSettingsManager::SaveSettings( bool bShared )
 	}
 }
 
-static CComBSTR g_bstrValue(L"value");
-static CComBSTR g_bstrTab(L"\n\t");
+static const wchar_t *g_XmlValue=L"value";
+static const wchar_t *g_XmlTab=L"\n\t";
+
+// one child of the Settings element, collected before the settings are changed
+struct CXmlSettingValue
+{
+	CString name;
+	bool bValue; // the value attribute is present
+	CString value;
+	std::vector<wchar_t> lines; // the text of the child elements, one per line
+};
 
 CString CSettingsManager::LoadSettingsXml( const wchar_t *fname )
 {
-	CSettingsLockWrite lock;
-	CComPtr<IXMLDOMDocument> pDoc;
-	if (FAILED(pDoc.CoCreateInstance(L"Msxml2.FreeThreadedDOMDocument")))
-		return L"Failed to initialize XML parser";
-	pDoc->put_async(VARIANT_FALSE);
-	VARIANT_BOOL loaded;
-	if (pDoc->load(CComVariant(fname),&loaded)!=S_OK || loaded!=VARIANT_TRUE)
+	std::vector<unsigned char> buf;
+	{
+		FILE *f=NULL;
+		if (_wfopen_s(&f,fname,L"rb") || !f)
+			return CString(L"XML parsing error: The system cannot locate the object specified.");
+		fseek(f,0,SEEK_END);
+		int size=ftell(f);
+		fseek(f,0,SEEK_SET);
+		buf.resize(size+1);
+		bool bRead=(size==0 || fread(&buf[0],1,size,f)==size);
+		fclose(f);
+		if (!bRead)
+			return CString(L"XML parsing error: The system cannot locate the object specified.");
+		buf.resize(size);
+	}
+
+	// read the whole document first, so the settings are not touched if it is not valid
+	CXmlReader reader;
+	if (!reader.Load(buf.empty()?NULL:&buf[0],(int)buf.size()))
+		return CString(L"XML parsing error: ")+reader.GetError();
+	buf.clear();
+	if (reader.Read()!=CXmlReader::NODE_ELEMENT)
+		return CString(L"XML parsing error: ")+reader.GetError();
+	if (wcscmp(reader.GetName(),L"Settings")!=0)
+		return CString(L"XML parsing error: The tag 'Settings' is missing.");
+
+	const wchar_t *component=reader.GetAttribute(L"component");
+	if (!component)
+		return CString(L"XML parsing error: The tag 'Settings' is missing the 'component' attribute.");
+	if (_wcsicmp(component,m_CompName)!=0)
 	{
-		CComPtr<IXMLDOMParseError> pError;
-		pDoc->get_parseError(&pError);
-		CComBSTR reason;
-		if (pError && SUCCEEDED(pError->get_reason(&reason)))
-		{
-			return CString(L"XML parsing error: ")+reason;
-		}
-		return CString(L"XML parsing error");
+		CString error;
+		error.Format(L"XML parsing error: This settings file is intended for another component '%s'.",component);
+		return error;
 	}
 
-	CComPtr<IXMLDOMNode> node;
-	HRESULT res=pDoc->selectSingleNode(CComBSTR(L"Settings"),&node);
-	if (res!=S_OK)
-		return CString(L"XML parsing error: The tag 'Settings' is missing.");
-
 	DWORD ver=0;
+	const wchar_t *version=reader.GetAttribute(L"version");
+	if (version)
 	{
-		CComVariant value;
-		CComQIPtr<IXMLDOMElement> element(node);
-		if (!element || element->getAttribute(CComBSTR(L"component"),&value)!=S_OK || value.vt!=VT_BSTR)
-			return CString(L"XML parsing error: The tag 'Settings' is missing the 'component' attribute.");
-		if (_wcsicmp(value.bstrVal,m_CompName)!=0)
-		{
-			CString error;
-			error.Format(L"XML parsing error: This settings file is intended for another component '%s'.",value.bstrVal);
-			return error;
-		}
+		wchar_t token[10];
+		const wchar_t *str=GetToken(version,token,_countof(token),L".");
+		ver=(_wtol(token)&0xFF)<<24;
+		str=GetToken(str,token,_countof(token),L".");
+		ver|=(_wtol(token)&0xFF)<<16;
+		ver|=_wtol(str)&0xFFFF;
+	}
 
-		value.Clear();
-		if (element && element->getAttribute(CComBSTR(L"version"),&value)==S_OK && value.vt==VT_BSTR)
+	std::vector<CXmlSettingValue> values;
+	while (1)
+	{
+		CXmlReader::TNode node=reader.Read();
+		if (node==CXmlReader::NODE_EOF)
+			break;
+		if (node==CXmlReader::NODE_ERROR)
+			return CString(L"XML parsing error: ")+reader.GetError();
+		int depth=reader.GetDepth();
+		if (node==CXmlReader::NODE_ELEMENT && depth==2)
+		{
+			// a setting
+			values.resize(values.size()+1);
+			CXmlSettingValue &value=values.back();
+			value.name=reader.GetName();
+			const wchar_t *attribute=reader.GetAttribute(g_XmlValue);
+			value.bValue=(attribute!=NULL);
+			if (attribute)
+				value.value=attribute;
+		}
+		else if (values.empty() || depth<2)
+			continue;
+		else if (node==CXmlReader::NODE_END_ELEMENT && depth==2)
+			values.back().lines.push_back('\n'); // the end of a line
+		else if (node==CXmlReader::NODE_TEXT && (depth>2 || !reader.IsWhiteSpace()))
 		{
-			wchar_t token[10];
-			const wchar_t *str=GetToken(value.bstrVal,token,_countof(token),L".");
-			ver=(_wtol(token)&0xFF)<<24;
-			str=GetToken(str,token,_countof(token),L".");
-			ver|=(_wtol(token)&0xFF)<<16;
-			ver|=_wtol(str)&0xFFFF;
+			std::vector<wchar_t> &lines=values.back().lines;
+			lines.insert(lines.end(),reader.GetText(),reader.GetText()+reader.GetTextLength());
+			if (depth==2)
+				lines.push_back('\n'); // text directly in the setting is a separate line
 		}
 	}
 
+	CSettingsLockWrite lock;
 	ResetSettings();
-	CComPtr<IXMLDOMNode> child;
-	node->get_firstChild(&child);
-	while (child)
+	for (std::vector<CXmlSettingValue>::iterator it=values.begin();it!=values.end();++it)
 	{
-		CComBSTR name;
-		child->get_nodeName(&name);
-
-		for (CSetting *pSetting=g_SettingsManager.GetSettings();pSetting->name;pSetting++)
+		CSetting *pSetting=FindSettingByName(it->name);
+		if (!pSetting || pSetting->type==CSetting::TYPE_GROUP || pSetting->type==CSetting::TYPE_RADIO || pSetting->pLinkTo)
+			continue;
+		if (pSetting->flags&(CSetting::FLAG_LOCKED_REG|CSetting::FLAG_SHARED))
+			continue;
+		if (pSetting->type==CSetting::TYPE_MULTISTRING)
 		{
-			if (pSetting->type==CSetting::TYPE_GROUP || pSetting->type==CSetting::TYPE_RADIO || pSetting->pLinkTo)
-				continue;
-			if (pSetting->type>=0 && _wcsicmp(pSetting->name,name)==0)
+			it->lines.push_back(0);
+			pSetting->value=CComVariant(&it->lines[0]);
+			pSetting->flags&=~CSetting::FLAG_DEFAULT;
+		}
+		else if (it->bValue)
+		{
+			const wchar_t *value=it->value;
+			if (pSetting->type>=CSetting::TYPE_STRING)
 			{
-				if (pSetting->flags&(CSetting::FLAG_LOCKED_REG|CSetting::FLAG_SHARED))
-					break;
-				if (pSetting->type==CSetting::TYPE_MULTISTRING)
-				{
-					// load Lines
-					CComPtr<IXMLDOMNode> child2;
-					child->get_firstChild(&child2);
-					std::vector<wchar_t> string;
-					while (child2)
-					{
-						CComBSTR text;
-						if (child2->get_text(&text)==S_OK)
-						{
-							int len=(int)text.Length();
-							int pos=(int)string.size();
-							string.resize(pos+len+1);
-							memcpy(&string[pos],(const wchar_t*)text,len*2);
-							string[pos+len]='\n';
-						}
-						CComPtr<IXMLDOMNode> next;
-						child2->get_nextSibling(&next);
-						child2=std::move(next);
-					}
-					string.push_back(0);
-					pSetting->value=CComVariant(&string[0]);
-					pSetting->flags&=~CSetting::FLAG_DEFAULT;
-				}
+				pSetting->value=CComVariant(value);
+				pSetting->flags&=~CSetting::FLAG_DEFAULT;
+			}
+			else if (pSetting->type==CSetting::TYPE_BOOL || (pSetting->type==CSetting::TYPE_INT && pSetting[1].type!=CSetting::TYPE_RADIO) || pSetting->type==CSetting::TYPE_HOTKEY || pSetting->type==CSetting::TYPE_HOTKEY_ANY || pSetting->type==CSetting::TYPE_COLOR)
+			{
+				int val=_wtol(value);
+				if (pSetting->type==CSetting::TYPE_BOOL)
+					pSetting->value=CComVariant(val?1:0);
 				else
+					pSetting->value=CComVariant(val);
+				pSetting->flags&=~CSetting::FLAG_DEFAULT;
+			}
+			else if (pSetting->type==CSetting::TYPE_INT && pSetting[1].type==CSetting::TYPE_RADIO)
+			{
+				int val=0;
+				for (CSetting *pRadio=pSetting+1;pRadio->type==CSetting::TYPE_RADIO;pRadio++,val++)
 				{
-					CComQIPtr<IXMLDOMElement> element(child);
-					if (element)
+					if (_wcsicmp(pRadio->name,value)==0)
 					{
-						CComVariant value;
-						if (element->getAttribute(g_bstrValue,&value)==S_OK && value.vt==VT_BSTR)
-						{
-							if (pSetting->type>=CSetting::TYPE_STRING)
-							{
-								pSetting->value=value;
-								pSetting->flags&=~CSetting::FLAG_DEFAULT;
-							}
-							else if (pSetting->type==CSetting::TYPE_BOOL || (pSetting->type==CSetting::TYPE_INT && pSetting[1].type!=CSetting::TYPE_RADIO) || pSetting->type==CSetting::TYPE_HOTKEY || pSetting->type==CSetting::TYPE_HOTKEY_ANY || pSetting->type==CSetting::TYPE_COLOR)
-							{
-								int val=_wtol(value.bstrVal);
-								if (pSetting->type==CSetting::TYPE_BOOL)
-									pSetting->value=CComVariant(val?1:0);
-								else
-									pSetting->value=CComVariant(val);
-								pSetting->flags&=~CSetting::FLAG_DEFAULT;
-							}
-							else if (pSetting->type==CSetting::TYPE_INT && pSetting[1].type==CSetting::TYPE_RADIO)
-							{
-								int val=0;
-								for (CSetting *pRadio=pSetting+1;pRadio->type==CSetting::TYPE_RADIO;pRadio++,val++)
-								{
-									if (_wcsicmp(pRadio->name,value.bstrVal)==0)
-									{
-										pSetting->value=CComVariant(val);
-										pSetting->flags&=~CSetting::FLAG_DEFAULT;
-										break;
-									}
-								}
-							}
-						}
+						pSetting->value=CComVariant(val);
+						pSetting->flags&=~CSetting::FLAG_DEFAULT;
+						break;
 					}
 				}
 			}
 		}
-
-		CComPtr<IXMLDOMNode> next;
-		if (child->get_nextSibling(&next)!=S_OK)
-			break;
-		child=std::move(next);
 	}
 	if (ver<0x03090000)
 		UpgradeSettings(false);
@@ -842,17 +822,19 @@ CString CSettingsManager::LoadSettingsXml( const wchar_t *fname )
 	return CString();
 }
 
-static void SaveSettingValue( IXMLDOMDocument *pDoc, IXMLDOMNode *pParent, const wchar_t *name, const CComVariant &value )
+static void SaveSettingValue( CXmlWriter &writer, const wchar_t *name, const CComVariant &value )
 {
-	CComPtr<IXMLDOMElement> setting;
-	pDoc->createElement(CComBSTR(name),&setting);
-	setting->setAttribute(g_bstrValue,value);
-	CComPtr<IXMLDOMText> text;
-	CComPtr<IXMLDOMNode> nu;
-	pDoc->createTextNode(g_bstrTab,&text);
-	pParent->appendChild(text,&nu);
-	nu=NULL;
-	pParent->appendChild(setting,&nu);
+	writer.WriteText(g_XmlTab);
+	writer.StartElement(name);
+	if (value.vt==VT_I4)
+	{
+		wchar_t text[20];
+		Sprintf(text,_countof(text),L"%d",value.intVal);
+		writer.WriteAttribute(g_XmlValue,text);
+	}
+	else if (value.vt==VT_BSTR)
+		writer.WriteAttribute(g_XmlValue,value.bstrVal?value.bstrVal:L"");
+	writer.EndElement();
 }
 
 CString CSettingsManager::SaveSettingsXml( const wchar_t *fname )
@@ -860,31 +842,15 @@ CString CSettingsManager::SaveSettingsXml( const wchar_t *fname )
 	// doesn't need to acquire the lock because it can only run from the UI editing code
 	Assert(g_bUIThread);
 
-	CComPtr<IXMLDOMDocument> pDoc;
-	HRESULT res=pDoc.CoCreateInstance(L"Msxml2.FreeThreadedDOMDocument");
-	if (FAILED(res))
-		return L"Failed to initialize XML parser";
-
-	CComPtr<IXMLDOMElement> pRoot;
-	pDoc->createElement(CComBSTR(L"Settings"),&pRoot);
-	CComPtr<IXMLDOMProcessingInstruction> pi;
-	if (SUCCEEDED(pDoc->createProcessingInstruction(CComBSTR(L"xml"),CComBSTR(L"version=\"1.0\""),&pi)))
-	{
-		CComPtr<IXMLDOMNode> nu;
-		pDoc->appendChild(pi,&nu);
-	}
-
-	{
-		CComPtr<IXMLDOMNode> nu;
-		pDoc->appendChild(pRoot,&nu);
-	}
-
-	pRoot->setAttribute(CComBSTR(L"component"),CComVariant(m_CompName));
+	CXmlWriter writer;
+	writer.WriteDeclaration();
+	writer.StartElement(L"Settings");
+	writer.WriteAttribute(L"component",m_CompName);
 
 	wchar_t version[100];
 	DWORD ver=GetVersionEx(g_Instance);
 	Sprintf(version,_countof(version),L"%d.%d.%d",ver>>24,(ver>>16)&0xFF,ver&0xFFFF);
-	pRoot->setAttribute(CComBSTR(L"version"),CComVariant(version));
+	writer.WriteAttribute(L"version",version);
 
 	for (const CSetting *pSetting=m_pSettings;pSetting->name;pSetting++)
 	{
@@ -894,17 +860,9 @@ CString CSettingsManager::SaveSettingsXml( const wchar_t *fname )
 			continue;
 		if (pSetting->type==CSetting::TYPE_MULTISTRING)
 		{
-			CComPtr<IXMLDOMElement> setting;
-			pDoc->createElement(CComBSTR(pSetting->name),&setting);
-			CComPtr<IXMLDOMText> text;
-			CComPtr<IXMLDOMNode> nu;
-			pDoc->createTextNode(g_bstrTab,&text);
-			pRoot->appendChild(text,&nu);
-			nu=NULL;
-			pRoot->appendChild(setting,&nu);
-			CComBSTR tabs(L"\n\t\t");
-			CComBSTR name(L"Line");
-			if (pSetting->value.vt==VT_BSTR)
+			writer.WriteText(g_XmlTab);
+			writer.StartElement(pSetting->name);
+			if (pSetting->value.vt==VT_BSTR && pSetting->value.bstrVal)
 			{
 				for (const wchar_t *str=pSetting->value.bstrVal;*str;)
 				{
@@ -914,28 +872,21 @@ CString CSettingsManager::SaveSettingsXml( const wchar_t *fname )
 						len=(int)(end-str);
 					else
 						len=Strlen(str);
-					CComPtr<IXMLDOMElement> line;
-					pDoc->createElement(name,&line);
-					line->put_text(CComBSTR(len,str));
-					nu=NULL;
-					text=NULL;
-					pDoc->createTextNode(tabs,&text);
-					setting->appendChild(text,&nu);
-					nu=NULL;
-					setting->appendChild(line,&nu);
+					writer.WriteText(L"\n\t\t");
+					writer.StartElement(L"Line");
+					writer.WriteText(str,len);
+					writer.EndElement();
 					if (!end) break;
 					str=end+1;
 				}
 			}
-			nu=NULL;
-			text=NULL;
-			pDoc->createTextNode(g_bstrTab,&text);
-			setting->appendChild(text,&nu);
+			writer.WriteText(g_XmlTab);
+			writer.EndElement();
 			continue;
 		}
 		else if (pSetting->type==CSetting::TYPE_BOOL || (pSetting->type==CSetting::TYPE_INT && pSetting[1].type!=CSetting::TYPE_RADIO) || pSetting->type>=CSetting::TYPE_HOTKEY || pSetting->type>=CSetting::TYPE_HOTKEY_ANY || pSetting->type>=CSetting::TYPE_STRING)
 		{
-			SaveSettingValue(pDoc,pRoot,pSetting->name,pSetting->value);
+			SaveSettingValue(writer,pSetting->name,pSetting->value);
 		}
 		else if (pSetting->type==CSetting::TYPE_INT && pSetting[1].type==CSetting::TYPE_RADIO)
 		{
@@ -946,17 +897,23 @@ CString CSettingsManager::SaveSettingsXml( const wchar_t *fname )
 			{
 				if (val==0)
 				{
-					SaveSettingValue(pDoc,pRoot,pSetting->name,CComVariant(pRadio->name));
+					SaveSettingValue(writer,pSetting->name,CComVariant(pRadio->name));
 					break;
 				}
 			}
 		}
 	}
-	CComPtr<IXMLDOMText> text;
-	CComPtr<IXMLDOMNode> nu;
-	pDoc->createTextNode(CComBSTR(L"\n"),&text);
-	pRoot->appendChild(text,&nu);
-	if (FAILED(pDoc->save(CComVariant(fname))))
+	writer.WriteText(L"\n");
+	writer.EndElement();
+
+	const std::vector<char> &data=writer.GetData();
+	FILE *f=NULL;
+	if (_wfopen_s(&f,fname,L"wb") || !f)
+		return CString(L"Failed to save XML file ")+fname;
+	bool bWritten=(fwrite(&data[0],1,data.size(),f)==data.size());
+	if (fclose(f)!=0)
+		bWritten=false;
+	if (!bWritten)
 		return CString(L"Failed to save XML file ")+fname;
 	return CString();
 }
@@ -2000,11 +1957,22 @@ void InitSettings( CSetting *pSettings, TSettingsComponent component, ICustomSet
 	g_SettingsManager.Init(pSettings,component,pCustom);
 }
 
-void LoadSettings( void )
+void LoadSettings( CSettingChanges *pChanges )
 {
 	CSettingsLockWrite lock;
-	g_SettingsManager.LoadSettings(false);
-	g_SettingsManager.LoadSettings(true);
+	if (pChanges)
+	{
+		const CSetting *pSettings=g_SettingsManager.GetSettings();
+		CSettingsSnapshot oldValues(pSettings,0);
+		g_SettingsManager.LoadSettings(false);
+		g_SettingsManager.LoadSettings(true);
+		pChanges->Compare(pSettings,oldValues,CSettingsSnapshot(pSettings,0));
+	}
+	else
+	{
+		g_SettingsManager.LoadSettings(false);
+		g_SettingsManager.LoadSettings(true);
+	}
 }
 
 void SaveSettings( void )
@@ -2058,39 +2026,80 @@ const wchar_t *GetSettingsRegPath( void )
 	return g_SettingsManager.GetRegPath();
 }
 
+int ResolveSetting( const wchar_t *name, CSetting::Type type )
+{
+	const CSetting *pSetting=g_SettingsManager.FindSettingByName(name);
+	if (pSetting)
+	{
+		Assert(!pSetting->pLinkTo);
+		int index=(int)(pSetting-g_SettingsManager.GetSettings());
+		if (type==CSetting::TYPE_BOOL && pSetting->type==CSetting::TYPE_BOOL)
+			return index;
+		if (type==CSetting::TYPE_INT && IsIntSetting(pSetting))
+			return index;
+		if (type==CSetting::TYPE_STRING && pSetting->type>=CSetting::TYPE_STRING)
+			return index;
+	}
+	Assert(0);
+	return -1;
+}
+
+int GetSettingsGeneration( void )
+{
+	return g_SettingsGeneration;
+}
+
+int ReadSettingInt( int index )
+{
+	CSnapshotReader reader(g_SettingsSnapshots);
+	const CSettingsSnapshot::Value *pValue=GetSnapshotValue(reader,index);
+	Assert(!pValue || !pValue->str);
+	return pValue?pValue->intVal:0;
+}
+
+CString ReadSettingString( int index )
+{
+	CSnapshotReader reader(g_SettingsSnapshots);
+	const CSettingsSnapshot::Value *pValue=GetSnapshotValue(reader,index);
+	Assert(!pValue || pValue->str);
+	return (pValue && pValue->str)?pValue->str:L"";
+}
+
 // Finds a setting by name
 CSetting *FindSetting( const wchar_t *name )
 {
 	Assert(g_LockState==2); // must be locked for writing
-	for (CSetting *pSetting=g_SettingsManager.GetSettings();pSetting->name;pSetting++)
-		if (pSetting->type>=0 && wcscmp(pSetting->name,name)==0)
-			return pSetting;
+	CSetting *pSetting=g_SettingsManager.FindSettingByName(name);
+	if (pSetting && wcscmp(pSetting->name,name)==0)
+		return pSetting;
 	Assert(0);
 	return NULL;
 }
 
 bool IsSettingLocked( const wchar_t *name )
 {
-	for (CSetting *pSetting=g_SettingsManager.GetSettings();pSetting->name;pSetting++)
-		if (pSetting->type>=0 && wcscmp(pSetting->name,name)==0)
-		{
-			Assert(!pSetting->pLinkTo);
-			CSettingsLockRead lock;
-			return (pSetting->flags&CSetting::FLAG_LOCKED_MASK)!=0;
-		}
+	const CSetting *pSetting=g_SettingsManager.FindSettingByName(name);
+	if (pSetting && wcscmp(pSetting->name,name)==0)
+	{
+		Assert(!pSetting->pLinkTo);
+		CSnapshotReader reader(g_SettingsSnapshots);
+		const CSettingsSnapshot::Value *pValue=GetSnapshotValue(reader,pSetting);
+		return pValue && (pValue->flags&CSetting::FLAG_LOCKED_MASK)!=0;
+	}
 	Assert(0);
 	return false;
 }
 
 bool IsSettingForcedDefault( const wchar_t *name )
 {
-	for (CSetting *pSetting=g_SettingsManager.GetSettings();pSetting->name;pSetting++)
-		if (pSetting->type>=0 && wcscmp(pSetting->name,name)==0)
-		{
-			Assert(!pSetting->pLinkTo);
-			CSettingsLockRead lock;
-			return pSetting->IsForcedDefault();
-		}
+	const CSetting *pSetting=g_SettingsManager.FindSettingByName(name);
+	if (pSetting && wcscmp(pSetting->name,name)==0)
+	{
+		Assert(!pSetting->pLinkTo);
+		CSnapshotReader reader(g_SettingsSnapshots);
+		const CSettingsSnapshot::Value *pValue=GetSnapshotValue(reader,pSetting);
+		return pValue && (pValue->flags&CSetting::FLAG_FORCED_DEFAULT)!=0;
+	}
 	Assert(0);
 	return false;
 }
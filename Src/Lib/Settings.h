@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include "Assert.h"
+
 class ISettingsPanel
 {
 public:
@@ -12,6 +14,9 @@ public:
 	virtual bool Validate( HWND parent )=0;
 };
 
+class ISettingsStore;
+class CSettingChanges;
+
 struct CSetting
 {
 	enum Type
@@ -90,9 +95,13 @@ struct CSetting
 	const CComVariant &GetValue( void ) const { return pLinkTo?pLinkTo->value:value; }
 
 	void LoadValue( CRegKey &regSettings, CRegKey &regSettingsUser, CRegKey &regPolicy, CRegKey &regPolicyUser );
+	// the stores can be NULL if the key doesn't exist
+	void LoadValue( const ISettingsStore *pSettings, const ISettingsStore *pSettingsUser, const ISettingsStore *pPolicy, const ISettingsStore *pPolicyUser );
 
 private:
-	bool ReadValue( CRegKey &regKey, const wchar_t *valName );
+	bool ReadValue( const ISettingsStore &store, const wchar_t *valName );
+
+	friend class CSettingValueReader;
 };
 
 // Images in the tree image list
@@ -126,7 +135,8 @@ public:
 };
 
 void InitSettings( CSetting *pSettings, TSettingsComponent component, ICustomSettings *pCustom );
-void LoadSettings( void );
+// Reloads the settings from the registry. If pChanges is not NULL, it receives the list of settings that changed
+void LoadSettings( CSettingChanges *pChanges=NULL );
 void SaveSettings( void );
 void UpdateDefaultSettings( void );
 void EditSettings( const wchar_t *title, bool bModal, int tab, const wchar_t *appId = nullptr );
@@ -165,12 +175,24 @@ bool IsSettingForcedDefault( const wchar_t *name );
 int GetSettingInt( const wchar_t *name, bool &bDef );
 bool GetSettingBool( const wchar_t *name, bool &bDef );
 
+// Finds a setting of the given type by name for CSettingRef (TYPE_INT also matches the hotkey and color settings, TYPE_STRING matches all string types)
+// Returns the index of the setting, or -1 if it is not found
+int ResolveSetting( const wchar_t *name, CSetting::Type type );
+// Increases every time the settings are initialized
+int GetSettingsGeneration( void );
+// Read the value of the setting with the given index from the current snapshot
+int ReadSettingInt( int index );
+CString ReadSettingString( int index );
+
+#include "SettingRef.h"
+
 struct CSettingsLockRead
 {
 	CSettingsLockRead( void );
 	~CSettingsLockRead( void );
 };
 
+// Releasing the write lock publishes a copy of the values, which is what the GetSetting#### functions read
 struct CSettingsLockWrite
 {
 	CSettingsLockWrite( void );
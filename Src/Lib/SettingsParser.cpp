@@ -6,6 +6,9 @@
 #include "SettingsParser.h"
 #include "ResourceHelper.h"
 #include "StringUtils.h"
+#include "Assert.h"
+#include "SkinConditions.h"
+#include "TextDecoder.h"
 #include <algorithm>
 
 const int MAX_TREE_LEVEL=10;
@@ -13,22 +16,29 @@ const int MAX_TREE_LEVEL=10;
 // Reads a file into m_Text
 bool CSettingsParser::LoadText( const wchar_t *fname )
 {
-	// read settings file into buf
-	FILE *f=NULL;
-	if (_wfopen_s(&f,fname,L"rb")) return false;
-	if (!f) return false;
-	fseek(f,0,SEEK_END);
-	int size=ftell(f);
-	fseek(f,0,SEEK_SET);
-	std::vector<unsigned char> buf(size);
-	if (size<4 || fread(&buf[0],1,size,f)!=size)
+	// map the file and decode the text directly from the view, instead of reading it into a temporary buffer first
+	// don't allow writing while the file is mapped. another process could truncate it and reading the view would fault
+	HANDLE hFile=CreateFile(fname,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_FLAG_SEQUENTIAL_SCAN,NULL);
+	if (hFile==INVALID_HANDLE_VALUE) return false;
+	bool res=false;
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(hFile,&size) && size.QuadPart>=4 && size.QuadPart<0x40000000)
 	{
-		fclose(f);
-		return false;
+		HANDLE hMapping=CreateFileMapping(hFile,NULL,PAGE_READONLY,0,0,NULL);
+		if (hMapping)
+		{
+			const unsigned char *buf=(const unsigned char*)MapViewOfFile(hMapping,FILE_MAP_READ,0,0,0);
+			if (buf)
+			{
+				LoadText(buf,(int)size.QuadPart);
+				UnmapViewOfFile(buf);
+				res=true;
+			}
+			CloseHandle(hMapping);
+		}
 	}
-	fclose(f);
-	LoadText(&buf[0],size);
-	return true;
+	CloseHandle(hFile);
+	return res;
 }
 
 // Reads a text resource into m_Text
@@ -44,31 +54,7 @@ bool CSettingsParser::LoadText( HMODULE hMod, HRSRC hResInfo )
 
 void CSettingsParser::LoadText( const unsigned char *buf, int size )
 {
-	// copy buf to text and convert to UTF16
-	if (buf[0]==0xFF && buf[1]==0xFE)
-	{
-		// UTF16
-		int len=(size-2)/2;
-		m_Text.resize(len+1);
-		memcpy(&m_Text[0],&buf[2],size-2);
-		m_Text[len]=0;
-	}
-	else if (buf[0]==0xEF && buf[1]==0xBB && buf[2]==0xBF)
-	{
-		// UTF8
-		int len=MultiByteToWideChar(CP_UTF8,0,(const char*)&buf[3],size-3,NULL,0);
-		m_Text.resize(len+1);
-		MultiByteToWideChar(CP_UTF8,0,(const char*)&buf[3],size-3,&m_Text[0],len);
-		m_Text[len]=0;
-	}
-	else
-	{
-		// ACP
-		int len=MultiByteToWideChar(CP_ACP,0,(const char*)&buf[0],size,NULL,0);
-		m_Text.resize(len+1);
-		MultiByteToWideChar(CP_UTF8,0,(const char*)&buf[0],size,&m_Text[0],len);
-		m_Text[len]=0;
-	}
+	DecodeText(buf,size,m_Text);
 }
 
 void CSettingsParser::LoadText( const wchar_t *buf, int size )
@@ -109,6 +95,7 @@ void CSettingsParser::ParseText( void )
 		*end=0;
 		str=next;
 	}
+	InvalidateIndex();
 }
 
 // Filters the settings that belong to the given language
@@ -136,6 +123,7 @@ void CSettingsParser::FilterLanguages( const wchar_t *languages )
 		}
 	}
 	std::reverse(m_Lines.begin(),m_Lines.end());
+	InvalidateIndex();
 }
 
 // Returns a setting with the given name. If no setting is found, returns def
@@ -152,23 +140,43 @@ const wchar_t *CSettingsParser::FindSettingDirect( const wchar_t *name )
 
 const wchar_t *CSettingsParser::FindSettingInt( const wchar_t *name, size_t len )
 {
-	for (std::vector<const wchar_t*>::const_reverse_iterator it=m_Lines.rbegin();it!=m_Lines.rend();++it)
+	if (len>0 && (name[len-1]==' ' || name[len-1]=='\t'))
 	{
-		const wchar_t *str=*it;
-		if (_wcsnicmp(name,str,len)==0)
+		// the keys in the index don't end with whitespace. such names are very rare, so just scan the lines
+		for (std::vector<const wchar_t*>::const_reverse_iterator it=m_Lines.rbegin();it!=m_Lines.rend();++it)
 		{
-			str+=len;
-			while (*str==' ' || *str=='\t')
-				str++;
-			if (*str!='=') continue;
-			str++;
-			while (*str==' ' || *str=='\t')
+			const wchar_t *str=*it;
+			if (_wcsnicmp(name,str,len)==0)
+			{
+				str+=len;
+				while (*str==' ' || *str=='\t')
+					str++;
+				if (*str!='=') continue;
 				str++;
-			return str;
+				while (*str==' ' || *str=='\t')
+					str++;
+				return str;
+			}
 		}
+		return NULL;
 	}
 
-	return NULL;
+	if (!m_bIndexValid)
+	{
+		m_Index.Build(m_Lines);
+		m_bIndexValid=true;
+	}
+	int index=m_Index.Find(m_Lines,name,len);
+	if (index<0)
+		return NULL;
+	const wchar_t *str=m_Lines[index]+len;
+	while (*str==' ' || *str=='\t')
+		str++;
+	Assert(*str=='=');
+	str++;
+	while (*str==' ' || *str=='\t')
+		str++;
+	return str;
 }
 
 // Frees all resources
@@ -176,6 +184,7 @@ void CSettingsParser::Reset( void )
 {
 	m_Lines.clear();
 	m_Text.clear();
+	InvalidateIndex();
 }
 
 // Parses a tree structure of items. The rootName setting must be a list of item names.
@@ -257,6 +266,7 @@ bool CSkinParser::LoadVariation( const wchar_t *fname )
 		lines.push_back(L"[TRUE]");
 		ParseText();
 		m_Lines.insert(m_Lines.begin(),lines.begin(),lines.end());
+		InvalidateIndex();
 	}
 	m_VarText.swap(m_Text);
 	return res;
@@ -273,6 +283,7 @@ bool CSkinParser::LoadVariation( HMODULE hMod, HRSRC hResInfo )
 		lines.push_back(L"[TRUE]");
 		ParseText();
 		m_Lines.insert(m_Lines.begin(),lines.begin(),lines.end());
+		InvalidateIndex();
 	}
 	m_VarText.swap(m_Text);
 	return res;
@@ -345,31 +356,39 @@ void CSkinParser::FilterConditions( const wchar_t **values, int count )
 	std::vector<const wchar_t*> lines;
 	lines.swap(m_Lines);
 
-	bool bEnable=true;
-
+	// compile the conditions of all groups first, then evaluate them together. the same condition is evaluated only once
+	CSkinConditions conditions;
+	std::vector<int> groups(lines.size(),-1); // the condition for each group line. -1 - not a group, -2 - invalid group
 	for (size_t i=0;i<lines.size();i++)
 	{
 		const wchar_t *line=lines[i];
 		if (*line=='[')
 		{
-			bEnable=false;
-			wchar_t condition[256];
+			groups[i]=-2;
 			const wchar_t *end=wcschr(line,']');
 			if (!end) continue; // not closed
 			int len=(int)(end-line)-1;
-			if (len>_countof(condition)-1)
+			if (len>255)
 				continue; // too long
-			memcpy(condition,line+1,len*2);
-			condition[len]=0;
+			groups[i]=conditions.Add(line+1,len);
+		}
+	}
+	std::vector<char> results;
+	conditions.Evaluate(values,count,results);
+
+	bool bEnable=true;
 
-			// evaluate condition
-			if (EvalCondition(condition,values,count)==1)
-				bEnable=true;
+	for (size_t i=0;i<lines.size();i++)
+	{
+		if (groups[i]!=-1)
+		{
+			bEnable=(groups[i]>=0 && results[groups[i]]==1);
 			continue;
 		}
 		if (bEnable)
-			m_Lines.push_back(line);
+			m_Lines.push_back(lines[i]);
 	}
+	InvalidateIndex();
 }
 
 // Substitutes the provided macro strings
@@ -395,6 +414,7 @@ void CSkinParser::ApplyMacros( const std::vector<std::pair<CString,CString>> &ma
 			*it=string;
 		}
 	}
+	InvalidateIndex();
 }
 
 // Returns a setting with the given name
@@ -414,141 +434,13 @@ const wchar_t *CSkinParser::FindSetting( const wchar_t *name )
 
 ///////////////////////////////////////////////////////////////////////////////
 
-enum TType
-{
-	TYPE_AND,
-	TYPE_OR,
-	TYPE_NOT,
-	TYPE_PAR, // '('
-};
-
-static bool ApplyOperator( bool *valStack, int &vsp, TType op )
-{
-	switch (op)
-	{
-	case TYPE_AND:
-		if (vsp<2) return false;
-		vsp--;
-		valStack[vsp-1]=valStack[vsp-1] && valStack[vsp];
-		return true;
-	case TYPE_OR:
-		if (vsp<2) return false;
-		vsp--;
-		valStack[vsp-1]=valStack[vsp-1] || valStack[vsp];
-		return true;
-	case TYPE_NOT:
-		if (vsp<1) return false;
-		valStack[vsp-1]=!valStack[vsp-1];
-		return true;
-	}
-	return false;
-}
-
 // Evaluates a boolean condition. vars/count - a list of variable names that are TRUE. The rest are assumed FALSE
 // Returns: 0 - false, 1 - true, -1 - error
 int EvalCondition( const wchar_t *condition, const wchar_t *const *values, int count )
 {
-	wchar_t token[256];
-	TType opStack[16];
-	int osp=0;
-	bool valStack[16];
-	int vsp=0;
-
-	while (1)
-	{
-		// skip leading whitespace
-		while (*condition==' ' || *condition=='\t')
-			condition++;
-		if (!*condition) break;
-
-		if (*condition=='(')
-		{
-			if (osp>=_countof(opStack)) return -1; // too much nesting
-			opStack[osp]=TYPE_PAR;
-			osp++;
-			condition++;
-			continue;
-		}
-
-		if (*condition==')')
-		{
-			bool found=false;
-			while (osp>0)
-			{
-				osp--;
-				if (opStack[osp]==TYPE_PAR)
-				{
-					found=true;
-					break;
-				}
-				if (!ApplyOperator(valStack,vsp,opStack[osp])) return -1; // invalid operation
-			}
-			if (!found) return -1; // too many )
-			condition++;
-			continue;
-		}
-
-		// find token
-		const wchar_t *end=condition;
-		while (*end && *end!=' ' && *end!='\t' && *end!='(' && *end!=')')
-			end++;
-
-		int len=(int)(end-condition);
-		if (len>=sizeof(token)) return -1; // too long token
-		memcpy(token,condition,len*2);
-		token[len]=0;
-		condition=end;
-		while (*condition==' ' || *condition=='\t')
-			condition++;
-
-		if (_wcsicmp(token,L"and")==0 || _wcsicmp(token,L"or")==0)
-		{
-			while (osp>0 && opStack[osp-1]!=TYPE_PAR)
-			{
-				osp--;
-				if (!ApplyOperator(valStack,vsp,opStack[osp])) return -1; // invalid operation
-			}
-			if (osp>=_countof(opStack)) return -1; // too much nesting
-			opStack[osp]=(token[0]=='a' || token[0]=='A')?TYPE_AND:TYPE_OR;
-			osp++;
-		}
-		else if (_wcsicmp(token,L"not")==0)
-		{
-			while (osp>0 && opStack[osp-1]==TYPE_NOT)
-			{
-				osp--;
-				if (!ApplyOperator(valStack,vsp,opStack[osp])) return -1; // invalid operation
-			}
-			if (osp>=_countof(opStack)) return -1; // too much nesting
-			opStack[osp]=TYPE_NOT;
-			osp++;
-		}
-		else
-		{
-			if (vsp>=_countof(valStack)) return -1; // too much nesting
-			bool bValue=false;
-			if (_wcsicmp(token,L"true")==0)
-				bValue=true;
-			else
-			{
-				for (int i=0;i<count;i++)
-					if (_wcsicmp(token,values[i])==0)
-					{
-						bValue=true;
-						break;
-					}
-			}
-			valStack[vsp++]=bValue;
-		}
-	}
-
-	while (osp>0)
-	{
-		osp--;
-		if (opStack[osp]==TYPE_PAR) return -1; // unclosed (
-		if (!ApplyOperator(valStack,vsp,opStack[osp])) return -1; // invalid operation
-	}
-
-	if (vsp!=1) return -1; // unbalanced expression
-	return valStack[0]?1:0;
+	CSkinConditions conditions;
+	conditions.Add(condition);
+	std::vector<char> results;
+	conditions.Evaluate(values,count,results);
+	return results[0];
 }
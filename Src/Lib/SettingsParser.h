@@ -5,12 +5,15 @@
 #pragma once
 
 #include <vector>
+#include "SettingKeyIndex.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
 class CSettingsParser
 {
 public:
+	CSettingsParser( void ) { m_bIndexValid=false; }
+
 	// Reads a file into m_Text
 	bool LoadText( const wchar_t *fname );
 	// Reads a text resource into m_Text
@@ -50,7 +53,13 @@ protected:
 	std::vector<wchar_t> m_Text;
 	std::vector<const wchar_t*> m_Lines;
 
+	// must be called after m_Lines is modified
+	void InvalidateIndex( void ) { m_bIndexValid=false; }
+
 private:
+	CSettingKeyIndex m_Index; // the keys in m_Lines. built on the first lookup after m_Lines changes
+	bool m_bIndexValid;
+
 	const wchar_t *FindSettingInt( const wchar_t *name, size_t len );
 
 	int ParseTreeRec( const wchar_t *rootName, std::vector<TreeItem> &items, CString *names, int level );
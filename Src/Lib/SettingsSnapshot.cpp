@@ -0,0 +1,100 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "SettingsSnapshot.h"
+#include "Settings.h"
+
+CSettingsSnapshot::CSettingsSnapshot( const CSetting *pSettings, int version )
+{
+	m_Version=version;
+
+	// first find the total length of the strings, so the text doesn't move while the pointers are set
+	int count=0, len=0;
+	for (const CSetting *pSetting=pSettings;pSetting->name;pSetting++,count++)
+	{
+		if (pSetting->value.vt==VT_BSTR && pSetting->value.bstrVal)
+			len+=(int)wcslen(pSetting->value.bstrVal)+1;
+	}
+	m_Values.resize(count);
+	m_Text.resize(len);
+
+	wchar_t *text=len>0?&m_Text[0]:NULL;
+	for (int i=0;i<count;i++)
+	{
+		const CSetting &setting=pSettings[i];
+		Value &value=m_Values[i];
+		value.intVal=setting.value.vt==VT_I4?setting.value.intVal:0;
+		value.flags=setting.pLinkTo?setting.pLinkTo->flags:setting.flags;
+		value.str=NULL;
+		if (setting.value.vt==VT_BSTR)
+		{
+			if (setting.value.bstrVal)
+			{
+				int size=(int)wcslen(setting.value.bstrVal)+1;
+				memcpy(text,setting.value.bstrVal,size*sizeof(wchar_t));
+				value.str=text;
+				text+=size;
+			}
+			else
+				value.str=L"";
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CSettingChanges::Compare( const CSetting *pSettings, const CSettingsSnapshot &oldValues, const CSettingsSnapshot &newValues )
+{
+	m_Changes.clear();
+	Assert(oldValues.GetCount()==newValues.GetCount());
+	const int STATE_MASK=CSetting::FLAG_DEFAULT|CSetting::FLAG_FORCED_DEFAULT|CSetting::FLAG_LOCKED_MASK;
+	const CSetting *pGroup=NULL;
+	int count=min(oldValues.GetCount(),newValues.GetCount());
+	for (int i=0;i<count;i++)
+	{
+		const CSetting *pSetting=pSettings+i;
+		if (pSetting->type==CSetting::TYPE_GROUP)
+			pGroup=pSetting;
+		if (pSetting->type<0) continue;
+
+		const CSettingsSnapshot::Value &oldValue=oldValues.GetValue(i);
+		const CSettingsSnapshot::Value &newValue=newValues.GetValue(i);
+		int what=0;
+		if (oldValue.str || newValue.str)
+		{
+			if (!oldValue.str || !newValue.str || wcscmp(oldValue.str,newValue.str)!=0)
+				what|=CHANGE_VALUE;
+		}
+		else if (oldValue.intVal!=newValue.intVal)
+			what|=CHANGE_VALUE;
+		if ((oldValue.flags&STATE_MASK)!=(newValue.flags&STATE_MASK))
+			what|=CHANGE_STATE;
+		if (what)
+		{
+			Change change={pSetting,pGroup,what};
+			m_Changes.push_back(change);
+		}
+	}
+}
+
+bool CSettingChanges::IsChanged( const wchar_t *name ) const
+{
+	for (std::vector<Change>::const_iterator it=m_Changes.begin();it!=m_Changes.end();++it)
+	{
+		if (wcscmp(it->pSetting->name,name)==0)
+			return true;
+	}
+	return false;
+}
+
+bool CSettingChanges::IsGroupChanged( const wchar_t *group ) const
+{
+	for (std::vector<Change>::const_iterator it=m_Changes.begin();it!=m_Changes.end();++it)
+	{
+		if (it->pGroup && wcscmp(it->pGroup->name,group)==0)
+			return true;
+	}
+	return false;
+}
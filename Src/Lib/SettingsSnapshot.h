@@ -0,0 +1,73 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include "Assert.h"
+#include "SnapshotPublisher.h"
+#include <vector>
+
+struct CSetting;
+
+// SettingsSnapshot.h - immutable copies of the setting values that other threads can read without locking
+// The writer builds a new snapshot after every change and swaps it in. The readers never see a snapshot that is being modified.
+// Comparing two snapshots gives the list of settings that changed between them.
+
+// CSettingsSnapshot - the values of all settings at one point in time. Never changes after it is created
+class CSettingsSnapshot: public CPublishedSnapshot
+{
+public:
+	struct Value
+	{
+		int intVal; // for VT_I4 values
+		int flags; // the flags of the setting, or of the linked setting
+		const wchar_t *str; // for VT_BSTR values, NULL otherwise
+	};
+
+	// copies the current values. the caller must hold the write lock, so the values don't change
+	CSettingsSnapshot( const CSetting *pSettings, int version );
+
+	int GetVersion( void ) const { return m_Version; }
+	int GetCount( void ) const { return (int)m_Values.size(); }
+	const Value &GetValue( int index ) const { Assert(index>=0 && index<(int)m_Values.size()); return m_Values[index]; }
+
+private:
+	int m_Version;
+	std::vector<Value> m_Values; // one for each setting, in the same order
+	std::vector<wchar_t> m_Text; // all string values, zero-terminated
+};
+
+// CSettingChanges - the settings that are different between two snapshots
+// The consumers of the settings check the names (or the groups) they depend on and skip the work if none of them changed
+class CSettingChanges
+{
+public:
+	enum
+	{
+		CHANGE_VALUE=1,
+		CHANGE_STATE=2, // the setting became default/non-default, or was locked/unlocked
+	};
+
+	struct Change
+	{
+		const CSetting *pSetting;
+		const CSetting *pGroup; // the group that contains the setting
+		int what; // combination of CHANGE_VALUE and CHANGE_STATE
+	};
+
+	// finds the differences between two snapshots of the same settings
+	void Compare( const CSetting *pSettings, const CSettingsSnapshot &oldValues, const CSettingsSnapshot &newValues );
+	void Clear( void ) { m_Changes.clear(); }
+
+	bool IsEmpty( void ) const { return m_Changes.empty(); }
+	int GetCount( void ) const { return (int)m_Changes.size(); }
+	const Change &GetChange( int index ) const { return m_Changes[index]; }
+	// returns true if the setting with the given name changed
+	bool IsChanged( const wchar_t *name ) const;
+	// returns true if any setting in the group changed
+	bool IsGroupChanged( const wchar_t *group ) const;
+
+private:
+	std::vector<Change> m_Changes;
+};
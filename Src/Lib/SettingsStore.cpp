@@ -0,0 +1,69 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "SettingsStore.h"
+#include <vector>
+
+bool CRegSettingsStore::QueryDWORD( const wchar_t *name, DWORD &val ) const
+{
+	return m_RegKey.QueryDWORDValue(name,val)==ERROR_SUCCESS;
+}
+
+bool CRegSettingsStore::QueryString( const wchar_t *name, CString &text ) const
+{
+	ULONG len;
+	if (m_RegKey.QueryStringValue(name,NULL,&len)!=ERROR_SUCCESS)
+		return false;
+	LONG res=m_RegKey.QueryStringValue(name,text.GetBuffer(len),&len);
+	text.ReleaseBuffer();
+	return res==ERROR_SUCCESS;
+}
+
+bool CRegSettingsStore::QueryMultiString( const wchar_t *name, CString &text ) const
+{
+	ULONG len;
+	if (m_RegKey.QueryMultiStringValue(name,NULL,&len)!=ERROR_SUCCESS)
+		return false;
+	std::vector<wchar_t> data(len+1);
+	if (m_RegKey.QueryMultiStringValue(name,&data[0],&len)!=ERROR_SUCCESS)
+		return false;
+	text=MultiStringToText(&data[0],len);
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool CSettingsValueMap::Load( HKEY hKey )
+{
+	m_Values.clear();
+	DWORD count, maxNameLen, maxDataSize;
+	if (RegQueryInfoKey(hKey,NULL,NULL,NULL,NULL,NULL,NULL,&count,&maxNameLen,&maxDataSize,NULL,NULL)!=ERROR_SUCCESS)
+		return false;
+
+	std::vector<wchar_t> name(maxNameLen+1);
+	std::vector<wchar_t> data(maxDataSize/2+2); // room for 2 extra terminators
+	for (DWORD index=0;;index++)
+	{
+		DWORD nameLen=(DWORD)name.size(), type, size=(DWORD)(data.size()-2)*2;
+		LONG res=RegEnumValue(hKey,index,&name[0],&nameLen,NULL,&type,(BYTE*)&data[0],&size);
+		if (res==ERROR_NO_MORE_ITEMS)
+			break;
+		if (res==ERROR_MORE_DATA)
+		{
+			// a value was changed after the key was queried. grow the buffers and try again
+			if (RegQueryInfoKey(hKey,NULL,NULL,NULL,NULL,NULL,NULL,&count,&maxNameLen,&maxDataSize,NULL,NULL)!=ERROR_SUCCESS)
+				return false;
+			name.resize(max((DWORD)name.size(),maxNameLen+1));
+			data.resize(max((DWORD)data.size(),max(maxDataSize,size)/2+2));
+			index--;
+			continue;
+		}
+		if (res!=ERROR_SUCCESS)
+			continue;
+
+		SetRegValue(&name[0],type,&data[0],size);
+	}
+	return true;
+}
@@ -0,0 +1,98 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include <map>
+
+// SettingsStore.h - sources of the registry values that CSetting::LoadValue reads
+// CRegSettingsStore queries an open registry key directly. CSettingsValueMap holds all values of a key in memory, so loading all settings
+// enumerates the key once instead of querying it a few times for every setting. The values in the map can also be set directly,
+// which allows the loading and precedence logic to run without the registry.
+// Only CRegSettingsStore and CSettingsValueMap::Load use the registry. The rest is in SettingsValueMap.cpp and doesn't depend on the OS
+
+class ISettingsStore
+{
+public:
+	// REG_DWORD values
+	virtual bool QueryDWORD( const wchar_t *name, DWORD &val ) const=0;
+	// REG_SZ and REG_EXPAND_SZ values
+	virtual bool QueryString( const wchar_t *name, CString &text ) const=0;
+	// REG_MULTI_SZ values. every string in the list is followed by '\n'
+	virtual bool QueryMultiString( const wchar_t *name, CString &text ) const=0;
+};
+
+class CRegSettingsStore: public ISettingsStore
+{
+public:
+	CRegSettingsStore( CRegKey &regKey ): m_RegKey(regKey) {}
+
+	virtual bool QueryDWORD( const wchar_t *name, DWORD &val ) const;
+	virtual bool QueryString( const wchar_t *name, CString &text ) const;
+	virtual bool QueryMultiString( const wchar_t *name, CString &text ) const;
+
+private:
+	CRegKey &m_RegKey;
+
+	void operator=( const CRegSettingsStore& );
+};
+
+class CSettingsValueMap: public ISettingsStore
+{
+public:
+	// reads all values from the key. returns false if the key can't be enumerated
+	bool Load( HKEY hKey );
+	void Clear( void ) { m_Values.clear(); }
+	int GetCount( void ) const { return (int)m_Values.size(); }
+
+	void SetDWORD( const wchar_t *name, DWORD val );
+	void SetString( const wchar_t *name, const wchar_t *text );
+	// the strings in the list are separated with '\n'
+	void SetMultiString( const wchar_t *name, const wchar_t *text );
+	// sets a value from the raw registry data. size is in bytes. the data must have room for 2 more characters after it,
+	// because the registry doesn't always terminate the strings. the values of other types are ignored
+	void SetRegValue( const wchar_t *name, DWORD type, wchar_t *data, DWORD size );
+
+	virtual bool QueryDWORD( const wchar_t *name, DWORD &val ) const;
+	virtual bool QueryString( const wchar_t *name, CString &text ) const;
+	virtual bool QueryMultiString( const wchar_t *name, CString &text ) const;
+
+private:
+	struct Value
+	{
+		DWORD type; // REG_DWORD, REG_SZ or REG_MULTI_SZ
+		DWORD dword;
+		CString text;
+	};
+
+	std::map<CString,Value> m_Values; // the key is the upper case name, because the registry names are case-insensitive
+
+	Value &AddValue( const wchar_t *name, DWORD type );
+	const Value *FindValue( const wchar_t *name, DWORD type ) const;
+};
+
+// Converts the data of a REG_MULTI_SZ value to a list of strings separated with '\n'. len is the number of characters, including the final terminator
+CString MultiStringToText( const wchar_t *data, int len );
+
+// Reads the value of one setting from the stores. The reader converts the registry values to the type of the setting
+class ISettingValueReader
+{
+public:
+	// reads the value from the store. returns false if the store doesn't have a value of the right type
+	virtual bool ReadValue( const ISettingsStore &store, const wchar_t *valName )=0;
+	// the value that was just read becomes the default
+	virtual void SetDefault( void )=0;
+};
+
+enum
+{
+	SETTING_LOAD_DEFAULT=1, // the value is the default
+	SETTING_LOAD_FORCED_DEFAULT=2, // the default was changed by the administrator
+	SETTING_LOAD_LOCKED=4, // locked by HKLM or by a group policy
+};
+
+// Loads a setting in the order of precedence - HKLM policies, HKLM settings, HKCU policies and HKCU settings. The first one that has a value wins,
+// except for the "change default" policies and the HKLM "_Default" values, which only replace the default.
+// The value must be set to the default before the call. The stores can be NULL if the key doesn't exist. Returns a combination of the SETTING_LOAD_ flags
+int LoadSettingValue( const wchar_t *name, ISettingValueReader &reader, const ISettingsStore *pSettings, const ISettingsStore *pSettingsUser, const ISettingsStore *pPolicy, const ISettingsStore *pPolicyUser );
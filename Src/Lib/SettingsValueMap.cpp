@@ -0,0 +1,182 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "SettingsStore.h"
+
+CString MultiStringToText( const wchar_t *data, int len )
+{
+	CString text;
+	if (len>1)
+	{
+		wchar_t *buf=text.GetBuffer(len-1);
+		for (int i=0;i<len-1;i++)
+			buf[i]=data[i]?data[i]:'\n';
+		text.ReleaseBuffer(len-1);
+	}
+	return text;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CSettingsValueMap::SetRegValue( const wchar_t *name, DWORD type, wchar_t *data, DWORD size )
+{
+	// the string data is not always terminated
+	int len=size/sizeof(wchar_t);
+	data[len]=data[len+1]=0;
+	if (type==REG_DWORD && size==4)
+		SetDWORD(name,*(DWORD*)data);
+	else if (type==REG_SZ || type==REG_EXPAND_SZ)
+		SetString(name,data);
+	else if (type==REG_MULTI_SZ)
+	{
+		// the list must end with 2 terminators, one for the last string and one for the list
+		if (len>0 && data[len-1]!=0)
+			len++;
+		if (len>1 && data[len-2]!=0)
+			len++;
+		AddValue(name,REG_MULTI_SZ).text=MultiStringToText(data,len);
+	}
+}
+
+CSettingsValueMap::Value &CSettingsValueMap::AddValue( const wchar_t *name, DWORD type )
+{
+	CString key(name);
+	key.MakeUpper();
+	Value &value=m_Values[key];
+	value.type=type;
+	value.dword=0;
+	value.text.Empty();
+	return value;
+}
+
+const CSettingsValueMap::Value *CSettingsValueMap::FindValue( const wchar_t *name, DWORD type ) const
+{
+	CString key(name);
+	key.MakeUpper();
+	std::map<CString,Value>::const_iterator it=m_Values.find(key);
+	if (it==m_Values.end() || it->second.type!=type)
+		return NULL;
+	return &it->second;
+}
+
+void CSettingsValueMap::SetDWORD( const wchar_t *name, DWORD val )
+{
+	AddValue(name,REG_DWORD).dword=val;
+}
+
+void CSettingsValueMap::SetString( const wchar_t *name, const wchar_t *text )
+{
+	AddValue(name,REG_SZ).text=text;
+}
+
+void CSettingsValueMap::SetMultiString( const wchar_t *name, const wchar_t *text )
+{
+	AddValue(name,REG_MULTI_SZ).text=text;
+}
+
+bool CSettingsValueMap::QueryDWORD( const wchar_t *name, DWORD &val ) const
+{
+	const Value *pValue=FindValue(name,REG_DWORD);
+	if (!pValue) return false;
+	val=pValue->dword;
+	return true;
+}
+
+bool CSettingsValueMap::QueryString( const wchar_t *name, CString &text ) const
+{
+	const Value *pValue=FindValue(name,REG_SZ);
+	if (!pValue) return false;
+	text=pValue->text;
+	return true;
+}
+
+bool CSettingsValueMap::QueryMultiString( const wchar_t *name, CString &text ) const
+{
+	const Value *pValue=FindValue(name,REG_MULTI_SZ);
+	if (!pValue) return false;
+	text=pValue->text;
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Reads a group policy. Returns true if the setting is done
+static bool LoadPolicy( const wchar_t *name, ISettingValueReader &reader, const ISettingsStore &policy, int &result )
+{
+	wchar_t name2[256];
+	Strcpy(name2,_countof(name2),name);
+	Strcat(name2,_countof(name2),L"_State");
+	DWORD val;
+	if (policy.QueryDWORD(name2,val) && val<=2)
+	{
+		if (reader.ReadValue(policy,name))
+		{
+			if (val==0) // locked to value
+			{
+				result|=SETTING_LOAD_LOCKED;
+				result&=~SETTING_LOAD_DEFAULT;
+				return true;
+			}
+			else if (val==1) // locked to default
+			{
+				result|=SETTING_LOAD_LOCKED;
+				return true;
+			}
+			else // change default
+			{
+				reader.SetDefault();
+				result|=SETTING_LOAD_FORCED_DEFAULT;
+			}
+		}
+	}
+	return false;
+}
+
+int LoadSettingValue( const wchar_t *name, ISettingValueReader &reader, const ISettingsStore *pSettings, const ISettingsStore *pSettingsUser, const ISettingsStore *pPolicy, const ISettingsStore *pPolicyUser )
+{
+	int result=SETTING_LOAD_DEFAULT;
+
+	// load HKLM group policies
+	if (pPolicy && LoadPolicy(name,reader,*pPolicy,result))
+		return result;
+
+	if (pSettings)
+	{
+		// load HKLM settings
+		DWORD val;
+		if (pSettings->QueryDWORD(name,val) && val==0xDEFA)
+		{
+			result|=SETTING_LOAD_LOCKED;
+			return result;
+		}
+		else if (reader.ReadValue(*pSettings,name))
+		{
+			result|=SETTING_LOAD_LOCKED;
+			result&=~SETTING_LOAD_DEFAULT;
+			return result;
+		}
+		else
+		{
+			// check if a default value is selected in HKLM
+			wchar_t name2[256];
+			Strcpy(name2,_countof(name2),name);
+			Strcat(name2,_countof(name2),L"_Default");
+			if (reader.ReadValue(*pSettings,name2))
+			{
+				reader.SetDefault();
+				result|=SETTING_LOAD_FORCED_DEFAULT;
+			}
+		}
+	}
+
+	// load HKCU group policies
+	if (pPolicyUser && LoadPolicy(name,reader,*pPolicyUser,result))
+		return result;
+
+	// load HKCU settings
+	if (pSettingsUser && reader.ReadValue(*pSettingsUser,name))
+		result&=~SETTING_LOAD_DEFAULT;
+	return result;
+}
@@ -0,0 +1,225 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "SkinConditions.h"
+#include "Assert.h"
+#include <wchar.h>
+
+static wchar_t FoldChar( wchar_t c )
+{
+	return (c>='a' && c<='z')?c-'a'+'A':c;
+}
+
+// Compares a token with a zero-terminated name, ignoring the case
+static bool CompareToken( const wchar_t *token, int len, const wchar_t *name )
+{
+	for (int i=0;i<len;i++)
+	{
+		if (!name[i] || FoldChar(token[i])!=FoldChar(name[i]))
+			return false;
+	}
+	return name[len]==0;
+}
+
+int CSkinConditions::Add( const wchar_t *condition, int len )
+{
+	if (len<0)
+		len=(int)wcslen(condition);
+	for (std::vector<Program>::const_iterator it=m_Programs.begin();it!=m_Programs.end();++it)
+	{
+		if (it->textLen==len && (len==0 || memcmp(&m_Text[it->text],condition,len*sizeof(wchar_t))==0))
+			return (int)(it-m_Programs.begin());
+	}
+
+	Program program;
+	program.text=(int)m_Text.size();
+	program.textLen=len;
+	m_Text.insert(m_Text.end(),condition,condition+len);
+	program.code=(int)m_Code.size();
+	program.bValid=Compile(condition,condition+len);
+	if (!program.bValid)
+		m_Code.resize(program.code);
+	program.codeLen=(int)m_Code.size()-program.code;
+	m_Programs.push_back(program);
+	return (int)m_Programs.size()-1;
+}
+
+// Emits the operator, if the values it needs will be on the stack
+bool CSkinConditions::AddOperator( TOpcode op, int &vsp )
+{
+	if (op==OP_AND || op==OP_OR)
+	{
+		if (vsp<2) return false;
+		vsp--;
+	}
+	else if (op==OP_NOT)
+	{
+		if (vsp<1) return false;
+	}
+	else
+		return false;
+	m_Code.push_back(op);
+	return true;
+}
+
+int CSkinConditions::FindVariable( const wchar_t *name, int len )
+{
+	for (std::vector<int>::const_iterator it=m_Variables.begin();it!=m_Variables.end();++it)
+	{
+		if (CompareToken(name,len,&m_Names[*it]))
+			return (int)(it-m_Variables.begin());
+	}
+	m_Variables.push_back((int)m_Names.size());
+	m_Names.insert(m_Names.end(),name,name+len);
+	m_Names.push_back(0);
+	return (int)m_Variables.size()-1;
+}
+
+// Converts the condition to postfix order. The operators are emitted in the order they are applied during the evaluation.
+// The number of values on the stack is known at every step, so all errors are found here
+bool CSkinConditions::Compile( const wchar_t *condition, const wchar_t *end )
+{
+	TOpcode opStack[MAX_STACK];
+	int osp=0;
+	int vsp=0; // number of values on the stack when the program runs
+
+	while (1)
+	{
+		// skip leading whitespace
+		while (condition<end && (*condition==' ' || *condition=='\t'))
+			condition++;
+		if (condition>=end) break;
+
+		if (*condition=='(')
+		{
+			if (osp>=MAX_STACK) return false; // too much nesting
+			opStack[osp++]=OP_PAR;
+			condition++;
+			continue;
+		}
+
+		if (*condition==')')
+		{
+			bool found=false;
+			while (osp>0)
+			{
+				osp--;
+				if (opStack[osp]==OP_PAR)
+				{
+					found=true;
+					break;
+				}
+				if (!AddOperator(opStack[osp],vsp)) return false; // invalid operation
+			}
+			if (!found) return false; // too many )
+			condition++;
+			continue;
+		}
+
+		// find token
+		const wchar_t *token=condition;
+		while (condition<end && *condition!=' ' && *condition!='\t' && *condition!='(' && *condition!=')')
+			condition++;
+		int len=(int)(condition-token);
+
+		if (CompareToken(token,len,L"and") || CompareToken(token,len,L"or"))
+		{
+			while (osp>0 && opStack[osp-1]!=OP_PAR)
+			{
+				osp--;
+				if (!AddOperator(opStack[osp],vsp)) return false; // invalid operation
+			}
+			if (osp>=MAX_STACK) return false; // too much nesting
+			opStack[osp++]=(len==3)?OP_AND:OP_OR;
+		}
+		else if (CompareToken(token,len,L"not"))
+		{
+			while (osp>0 && opStack[osp-1]==OP_NOT)
+			{
+				osp--;
+				if (!AddOperator(opStack[osp],vsp)) return false; // invalid operation
+			}
+			if (osp>=MAX_STACK) return false; // too much nesting
+			opStack[osp++]=OP_NOT;
+		}
+		else
+		{
+			if (vsp>=MAX_STACK) return false; // too much nesting
+			if (CompareToken(token,len,L"true"))
+				m_Code.push_back(OP_TRUE);
+			else
+				m_Code.push_back(OP_VARIABLE|(FindVariable(token,len)<<OPCODE_BITS));
+			vsp++;
+		}
+	}
+
+	while (osp>0)
+	{
+		osp--;
+		if (opStack[osp]==OP_PAR) return false; // unclosed (
+		if (!AddOperator(opStack[osp],vsp)) return false; // invalid operation
+	}
+
+	return vsp==1; // unbalanced expression
+}
+
+void CSkinConditions::Evaluate( const wchar_t *const *values, int count, std::vector<char> &results ) const
+{
+	// find the value of each variable once
+	std::vector<bool> variables(m_Variables.size(),false);
+	for (size_t v=0;v<m_Variables.size();v++)
+	{
+		const wchar_t *name=&m_Names[m_Variables[v]];
+		int len=(int)wcslen(name);
+		for (int i=0;i<count;i++)
+		{
+			if (CompareToken(name,len,values[i]))
+			{
+				variables[v]=true;
+				break;
+			}
+		}
+	}
+
+	results.resize(m_Programs.size());
+	for (size_t i=0;i<m_Programs.size();i++)
+	{
+		const Program &program=m_Programs[i];
+		if (!program.bValid)
+		{
+			results[i]=-1;
+			continue;
+		}
+		// the compiler made sure the stack doesn't overflow and every operator has its values
+		bool stack[MAX_STACK];
+		int sp=0;
+		const unsigned int *code=&m_Code[program.code];
+		for (int pc=0;pc<program.codeLen;pc++)
+		{
+			switch (code[pc]&((1<<OPCODE_BITS)-1))
+			{
+			case OP_TRUE:
+				stack[sp++]=true;
+				break;
+			case OP_VARIABLE:
+				stack[sp++]=variables[code[pc]>>OPCODE_BITS];
+				break;
+			case OP_AND:
+				sp--;
+				stack[sp-1]=stack[sp-1] && stack[sp];
+				break;
+			case OP_OR:
+				sp--;
+				stack[sp-1]=stack[sp-1] || stack[sp];
+				break;
+			case OP_NOT:
+				stack[sp-1]=!stack[sp-1];
+				break;
+			}
+		}
+		Assert(sp==1);
+		results[i]=stack[0]?1:0;
+	}
+}
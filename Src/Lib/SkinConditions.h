@@ -0,0 +1,57 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include <vector>
+
+// CSkinConditions - the conditions of a skin (like "NOT SMALL_ICONS AND (TWO_COLUMNS OR TRUE)"), compiled to postfix programs
+// Every condition is parsed only once. The programs refer to a table of variable names shared by all conditions, so evaluating
+// the conditions for a set of true options looks up each name only once. The invalid conditions (unbalanced parentheses, missing
+// operands, more than 16 levels of nesting) are detected by the compiler. The class doesn't depend on the OS
+class CSkinConditions
+{
+public:
+	// compiles the condition and returns its index. the same text gets the same index. len=-1 - the text is zero-terminated
+	int Add( const wchar_t *condition, int len=-1 );
+	int GetCount( void ) const { return (int)m_Programs.size(); }
+
+	// evaluates all conditions. values/count - list of variable names that are TRUE. the rest are FALSE
+	// results[i] is the value of condition i: 0 - false, 1 - true, -1 - error
+	void Evaluate( const wchar_t *const *values, int count, std::vector<char> &results ) const;
+
+private:
+	enum TOpcode
+	{
+		OP_TRUE,
+		OP_VARIABLE, // the index of the variable is in the upper bits
+		OP_AND,
+		OP_OR,
+		OP_NOT,
+		OP_PAR, // '(', only on the compiler stack
+	};
+
+	enum
+	{
+		MAX_STACK=16,
+		OPCODE_BITS=3,
+	};
+
+	struct Program
+	{
+		int text, textLen; // the source in m_Text
+		int code, codeLen; // the instructions in m_Code
+		bool bValid;
+	};
+
+	std::vector<Program> m_Programs;
+	std::vector<unsigned int> m_Code; // opcode in the low bits
+	std::vector<wchar_t> m_Text;
+	std::vector<int> m_Variables; // offsets in m_Names
+	std::vector<wchar_t> m_Names; // zero-terminated variable names
+
+	bool Compile( const wchar_t *condition, const wchar_t *end );
+	bool AddOperator( TOpcode op, int &vsp );
+	int FindVariable( const wchar_t *name, int len );
+};
@@ -0,0 +1,106 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "SnapshotPublisher.h"
+
+CSnapshotPublisher::CSnapshotPublisher( void )
+{
+	for (int i=0;i<READER_SLOTS;i++)
+		m_Readers[i].count=0;
+	m_pCurrent=m_pRetired=NULL;
+	m_Reclaiming=0;
+	m_Version=0;
+}
+
+void CSnapshotPublisher::Publish( CPublishedSnapshot *pSnapshot )
+{
+	CPublishedSnapshot *pOld=(CPublishedSnapshot*)InterlockedExchangePointer((void *volatile*)&m_pCurrent,pSnapshot);
+	if (pOld)
+	{
+		pOld->m_pNextRetired=NULL;
+		Retire(pOld);
+	}
+	Reclaim();
+}
+
+void CSnapshotPublisher::Clear( void )
+{
+	Assert(!HasReaders());
+	CPublishedSnapshot *pOld=(CPublishedSnapshot*)InterlockedExchangePointer((void *volatile*)&m_pCurrent,NULL);
+	delete pOld;
+	FreeList((CPublishedSnapshot*)InterlockedExchangePointer((void *volatile*)&m_pRetired,NULL));
+}
+
+bool CSnapshotPublisher::HasReaders( void ) const
+{
+	for (int i=0;i<READER_SLOTS;i++)
+	{
+		if (ReadAcquire(&m_Readers[i].count)!=0)
+			return true;
+	}
+	return false;
+}
+
+// Adds a list of snapshots to the retired list. Can be called by the writer and by the readers at the same time
+void CSnapshotPublisher::Retire( CPublishedSnapshot *pList )
+{
+	CPublishedSnapshot *pLast=pList;
+	while (pLast->m_pNextRetired)
+		pLast=pLast->m_pNextRetired;
+	while (1)
+	{
+		CPublishedSnapshot *pHead=(CPublishedSnapshot*)ReadPointerAcquire((void *volatile*)&m_pRetired);
+		pLast->m_pNextRetired=pHead;
+		if (InterlockedCompareExchangePointer((void *volatile*)&m_pRetired,pList,pHead)==pHead)
+			break;
+	}
+}
+
+// Frees the retired snapshots if there are no readers. If there are, they stay in the list for the next attempt
+void CSnapshotPublisher::Reclaim( void )
+{
+	if (InterlockedCompareExchange(&m_Reclaiming,1,0)!=0)
+		return; // another thread is doing it
+	CPublishedSnapshot *pList=(CPublishedSnapshot*)InterlockedExchangePointer((void *volatile*)&m_pRetired,NULL);
+	if (pList)
+	{
+		// the snapshots in the list were replaced before they were taken, and the exchange above is a full barrier.
+		// a reader that starts now sees a newer snapshot, and a reader that started before is still counted.
+		// so if all counts are 0 now, nobody can be using the snapshots in the list
+		if (HasReaders())
+			Retire(pList);
+		else
+			FreeList(pList);
+	}
+	InterlockedExchange(&m_Reclaiming,0);
+}
+
+void CSnapshotPublisher::FreeList( CPublishedSnapshot *pList )
+{
+	while (pList)
+	{
+		CPublishedSnapshot *pNext=pList->m_pNextRetired;
+		delete pList;
+		pList=pNext;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+CSnapshotReader::CSnapshotReader( CSnapshotPublisher &publisher ): m_Publisher(publisher)
+{
+	// the thread ids are multiples of 4
+	m_Slot=(GetCurrentThreadId()>>2)%CSnapshotPublisher::READER_SLOTS;
+	// the increment is a full barrier, so the snapshot is loaded after the reader is counted
+	InterlockedIncrement(&m_Publisher.m_Readers[m_Slot].count);
+	m_pSnapshot=(const CPublishedSnapshot*)ReadPointerAcquire((void *volatile*)&m_Publisher.m_pCurrent);
+}
+
+CSnapshotReader::~CSnapshotReader( void )
+{
+	// the last reader in the slot may be the one that was keeping the retired snapshots alive
+	if (InterlockedDecrement(&m_Publisher.m_Readers[m_Slot].count)==0 && ReadPointerAcquire((void *volatile*)&m_Publisher.m_pRetired))
+		m_Publisher.Reclaim();
+}
@@ -0,0 +1,82 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+// SnapshotPublisher.h - publishes immutable snapshots to readers on other threads without locking
+// Doesn't depend on what is in the snapshots. Uses only GetCurrentThreadId and the Interlocked/ReadAcquire functions from the OS
+
+// CPublishedSnapshot - the base class for the snapshots. The publisher deletes them when they are no longer visible
+class CPublishedSnapshot
+{
+public:
+	CPublishedSnapshot( void ) { m_pNextRetired=NULL; }
+	virtual ~CPublishedSnapshot( void ) {}
+
+private:
+	CPublishedSnapshot *m_pNextRetired;
+
+	CPublishedSnapshot( const CPublishedSnapshot& );
+	void operator=( const CPublishedSnapshot& );
+
+	friend class CSnapshotPublisher;
+};
+
+// CSnapshotPublisher - holds the current snapshot and frees the old ones when no readers can see them (RCU-style)
+// The readers increment a reader count, load the current snapshot, and decrement the count when they are done. They never wait.
+// The counts are spread over a few slots by thread, so the readers on different threads don't write to the same cache line.
+// Publish swaps in the new snapshot and moves the old one to a retired list. The retired snapshots are freed when all counts are 0,
+// checked after every Publish and every time the last reader in a slot is done. The writers must be serialized by the caller
+class CSnapshotPublisher
+{
+public:
+	CSnapshotPublisher( void );
+	~CSnapshotPublisher( void ) { Clear(); }
+
+	// takes ownership of the snapshot
+	void Publish( CPublishedSnapshot *pSnapshot );
+	// frees all snapshots. there must be no readers
+	void Clear( void );
+	int GetNextVersion( void ) { return ++m_Version; }
+
+private:
+	enum { READER_SLOTS=16 };
+
+	struct __declspec(align(64)) ReaderSlot
+	{
+		volatile LONG count;
+	};
+
+	ReaderSlot m_Readers[READER_SLOTS];
+	CPublishedSnapshot *volatile m_pCurrent;
+	CPublishedSnapshot *volatile m_pRetired; // list of replaced snapshots that may still be in use
+	volatile LONG m_Reclaiming; // 1 while a thread is freeing the retired snapshots
+	int m_Version;
+
+	bool HasReaders( void ) const;
+	void Retire( CPublishedSnapshot *pList );
+	void Reclaim( void );
+	static void FreeList( CPublishedSnapshot *pList );
+
+	friend class CSnapshotReader;
+};
+
+// CSnapshotReader - keeps the current snapshot alive while the object is in scope. Don't keep it for long, because it delays freeing the old snapshots
+class CSnapshotReader
+{
+public:
+	CSnapshotReader( CSnapshotPublisher &publisher );
+	~CSnapshotReader( void );
+
+	// returns NULL if nothing is published yet
+	const CPublishedSnapshot *GetSnapshot( void ) const { return m_pSnapshot; }
+
+private:
+	CSnapshotPublisher &m_Publisher;
+	const CPublishedSnapshot *m_pSnapshot;
+	int m_Slot;
+
+	CSnapshotReader( const CSnapshotReader& );
+	void operator=( const CSnapshotReader& );
+};
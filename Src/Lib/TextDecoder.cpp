@@ -0,0 +1,30 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "TextDecoder.h"
+
+void DecodeText( const unsigned char *buf, int size, std::vector<wchar_t> &text )
+{
+	if (size>=2 && buf[0]==0xFF && buf[1]==0xFE)
+	{
+		// UTF16. a stray byte at the end is ignored
+		int len=(size-2)/2;
+		text.resize(len+1);
+		for (int i=0;i<len;i++)
+			text[i]=(wchar_t)(buf[i*2+2]|(buf[i*2+3]<<8));
+		text[len]=0;
+	}
+	else
+	{
+		// UTF8, with or without BOM. the text has no more characters than bytes, so it is converted in a single pass
+		int start=(size>=3 && buf[0]==0xEF && buf[1]==0xBB && buf[2]==0xBF)?3:0;
+		text.resize(size-start+1);
+		int len=0;
+		if (size>start)
+			len=MultiByteToWideChar(CP_UTF8,0,(const char*)&buf[start],size-start,&text[0],size-start);
+		text.resize(len+1);
+		text[len]=0;
+	}
+}
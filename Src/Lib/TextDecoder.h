@@ -0,0 +1,13 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include <vector>
+
+// TextDecoder.h - converts the contents of a text file or resource to UTF-16
+// The text can be UTF-16 (little endian) with a BOM, or UTF-8 with or without a BOM. Only the UTF-8 conversion depends on the OS
+
+// Decodes size bytes from buf and stores the text in text, followed by a 0. Never reads past the end of buf
+void DecodeText( const unsigned char *buf, int size, std::vector<wchar_t> &text );
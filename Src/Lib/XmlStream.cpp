@@ -0,0 +1,731 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "XmlStream.h"
+#include "Assert.h"
+#include <stdio.h>
+#include <wchar.h>
+
+static bool IsSpace( wchar_t c )
+{
+	return c==' ' || c=='\t' || c=='\r' || c=='\n';
+}
+
+static bool IsNameStart( wchar_t c )
+{
+	return (c>='A' && c<='Z') || (c>='a' && c<='z') || c=='_' || c==':' || c>=0x80;
+}
+
+static bool IsNameChar( wchar_t c )
+{
+	return IsNameStart(c) || (c>='0' && c<='9') || c=='.' || c=='-';
+}
+
+// Adds a code point to the text, as a surrogate pair if wchar_t is 16 bits
+static void PushChar( std::vector<wchar_t> &text, unsigned int c )
+{
+	if (sizeof(wchar_t)==2 && c>0xFFFF)
+	{
+		c-=0x10000;
+		text.push_back((wchar_t)(0xD800+(c>>10)));
+		text.push_back((wchar_t)(0xDC00+(c&0x3FF)));
+	}
+	else
+		text.push_back((wchar_t)c);
+}
+
+// the characters 0x80-0x9F of the Windows-1252 code page
+static const unsigned short g_Windows1252[32]={
+	0x20AC,0x0081,0x201A,0x0192,0x201E,0x2026,0x2020,0x2021,0x02C6,0x2030,0x0160,0x2039,0x0152,0x008D,0x017D,0x008F,
+	0x0090,0x2018,0x2019,0x201C,0x201D,0x2022,0x2013,0x2014,0x02DC,0x2122,0x0161,0x203A,0x0153,0x009D,0x017E,0x0178,
+};
+
+enum TEncoding
+{
+	ENCODING_UTF8,
+	ENCODING_LATIN1,
+	ENCODING_WINDOWS1252,
+	ENCODING_UNKNOWN,
+};
+
+// Finds the encoding from the XML declaration of an 8-bit document
+static TEncoding GetDeclaredEncoding( const unsigned char *buf, int size )
+{
+	if (size<5 || memcmp(buf,"<?xml",5)!=0)
+		return ENCODING_UTF8;
+	int end=5;
+	while (end+1<size && !(buf[end]=='?' && buf[end+1]=='>'))
+		end++;
+	for (int i=5;i+8<end;i++)
+	{
+		if (memcmp(buf+i,"encoding",8)!=0)
+			continue;
+		i+=8;
+		while (i<end && (buf[i]==' ' || buf[i]=='=' || buf[i]=='\t'))
+			i++;
+		if (i>=end || (buf[i]!='"' && buf[i]!='\''))
+			break;
+		char quote=buf[i++];
+		char name[32];
+		int len=0;
+		while (i<end && buf[i]!=quote && len<(int)sizeof(name)-1)
+		{
+			char c=buf[i++];
+			name[len++]=(c>='a' && c<='z')?c-'a'+'A':c;
+		}
+		name[len]=0;
+		if (strcmp(name,"UTF-8")==0 || strcmp(name,"UTF8")==0 || strcmp(name,"US-ASCII")==0 || strcmp(name,"ASCII")==0)
+			return ENCODING_UTF8;
+		if (strcmp(name,"ISO-8859-1")==0 || strcmp(name,"LATIN1")==0)
+			return ENCODING_LATIN1;
+		if (strcmp(name,"WINDOWS-1252")==0)
+			return ENCODING_WINDOWS1252;
+		return ENCODING_UNKNOWN;
+	}
+	return ENCODING_UTF8;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+CXmlReader::CXmlReader( void )
+{
+	m_Text.push_back(0);
+	m_Pos=m_End=&m_Text[0];
+	m_Node=NODE_EOF;
+	m_Buf.push_back(0);
+	m_TextLength=0;
+	m_bPendingEnd=m_bRootStarted=m_bRootDone=false;
+}
+
+bool CXmlReader::Load( const unsigned char *buf, int size )
+{
+	m_Node=NODE_TEXT;
+	m_Buf.clear();
+	m_Buf.push_back(0);
+	m_Attributes.clear();
+	m_TextLength=0;
+	m_ElementNames.clear();
+	m_OpenElements.clear();
+	m_bPendingEnd=m_bRootStarted=m_bRootDone=false;
+	m_Error.clear();
+	m_Text.clear();
+	m_Text.reserve(size+1);
+	const wchar_t *error=Decode(buf,size);
+	int len=(int)m_Text.size();
+	m_Text.push_back(0);
+	m_Pos=&m_Text[0];
+	m_End=m_Pos+len;
+	if (error)
+	{
+		// the error is reported at the end of the decoded text
+		m_Pos=m_End;
+		SetError(error);
+		return false;
+	}
+	return true;
+}
+
+// Converts the document to wchar_t. Returns the reason if it fails
+const wchar_t *CXmlReader::Decode( const unsigned char *buf, int size )
+{
+	// UTF-16, with a byte order mark or starting with '<'
+	bool bLittle=(size>=2 && ((buf[0]==0xFF && buf[1]==0xFE) || (buf[0]=='<' && buf[1]==0)));
+	bool bBig=(size>=2 && ((buf[0]==0xFE && buf[1]==0xFF) || (buf[0]==0 && buf[1]=='<')));
+	if (bLittle || bBig)
+	{
+		int start=(buf[0]=='<' || buf[1]=='<')?0:2;
+		for (int i=start;i+1<size;i+=2)
+		{
+			unsigned int c=bLittle?(buf[i]|(buf[i+1]<<8)):((buf[i]<<8)|buf[i+1]);
+			if (sizeof(wchar_t)>2 && c>=0xD800 && c<0xDC00 && i+3<size)
+			{
+				unsigned int c2=bLittle?(buf[i+2]|(buf[i+3]<<8)):((buf[i+2]<<8)|buf[i+3]);
+				if (c2>=0xDC00 && c2<0xE000)
+				{
+					c=0x10000+((c-0xD800)<<10)+(c2-0xDC00);
+					i+=2;
+				}
+			}
+			m_Text.push_back((wchar_t)c);
+		}
+		return NULL;
+	}
+
+	int start=0;
+	if (size>=3 && buf[0]==0xEF && buf[1]==0xBB && buf[2]==0xBF)
+		start=3;
+	else
+	{
+		TEncoding encoding=GetDeclaredEncoding(buf,size);
+		if (encoding==ENCODING_UNKNOWN)
+			return L"Switch from current encoding to specified encoding not supported.";
+		if (encoding!=ENCODING_UTF8)
+		{
+			for (int i=0;i<size;i++)
+			{
+				unsigned int c=buf[i];
+				if (encoding==ENCODING_WINDOWS1252 && c>=0x80 && c<0xA0)
+					c=g_Windows1252[c-0x80];
+				m_Text.push_back((wchar_t)c);
+			}
+			return NULL;
+		}
+	}
+
+	// UTF-8
+	for (int i=start;i<size;)
+	{
+		unsigned int c=buf[i++];
+		if (c<0x80)
+		{
+			m_Text.push_back((wchar_t)c);
+			continue;
+		}
+		int count;
+		unsigned int min;
+		if ((c&0xE0)==0xC0) { c&=0x1F; count=1; min=0x80; }
+		else if ((c&0xF0)==0xE0) { c&=0x0F; count=2; min=0x800; }
+		else if ((c&0xF8)==0xF0) { c&=0x07; count=3; min=0x10000; }
+		else return L"An invalid character was found in text content.";
+		if (i+count>size)
+			return L"An invalid character was found in text content.";
+		for (;count>0;count--)
+		{
+			if ((buf[i]&0xC0)!=0x80)
+				return L"An invalid character was found in text content.";
+			c=(c<<6)|(buf[i++]&0x3F);
+		}
+		if (c<min || c>0x10FFFF)
+			return L"An invalid character was found in text content.";
+		PushChar(m_Text,c);
+	}
+	return NULL;
+}
+
+CXmlReader::TNode CXmlReader::SetError( const wchar_t *reason, const wchar_t *arg1, const wchar_t *arg2 )
+{
+	if (m_Error.empty() && m_Node!=NODE_ERROR)
+	{
+		int line=1, column=1;
+		for (const wchar_t *str=&m_Text[0];str<m_Pos;str++)
+		{
+			if (*str=='\n')
+				line++, column=1;
+			else
+				column++;
+		}
+		wchar_t text[512];
+		int len=swprintf(text,sizeof(text)/sizeof(text[0]),reason,arg1,arg2);
+		if (len<0) len=0;
+		swprintf(text+len,sizeof(text)/sizeof(text[0])-len,L" Line %d, position %d.",line,column);
+		m_Error.assign(text,text+wcslen(text)+1);
+	}
+	m_Node=NODE_ERROR;
+	return m_Node;
+}
+
+const wchar_t *CXmlReader::GetAttribute( const wchar_t *name ) const
+{
+	for (std::vector<Attribute>::const_iterator it=m_Attributes.begin();it!=m_Attributes.end();++it)
+	{
+		if (wcscmp(&m_Buf[it->name],name)==0)
+			return &m_Buf[it->value];
+	}
+	return NULL;
+}
+
+bool CXmlReader::IsWhiteSpace( void ) const
+{
+	for (int i=0;i<m_TextLength;i++)
+	{
+		if (!IsSpace(m_Buf[i]))
+			return false;
+	}
+	return true;
+}
+
+// Moves past the next occurrence of the end string. Returns false if it is not found
+bool CXmlReader::Skip( const wchar_t *end )
+{
+	size_t len=wcslen(end);
+	for (;m_Pos<m_End;m_Pos++)
+	{
+		if (*m_Pos==end[0] && wcsncmp(m_Pos,end,len)==0)
+		{
+			m_Pos+=len;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Adds a zero-terminated name to m_Buf
+bool CXmlReader::ReadName( void )
+{
+	if (m_Pos>=m_End || !IsNameStart(*m_Pos))
+		return false;
+	while (m_Pos<m_End && IsNameChar(*m_Pos))
+		m_Buf.push_back(*m_Pos++);
+	m_Buf.push_back(0);
+	return true;
+}
+
+// Adds the character of a reference (&amp; or &#123;) to m_Buf
+bool CXmlReader::ReadReference( void )
+{
+	const wchar_t *start=m_Pos+1;
+	const wchar_t *end=start;
+	while (end<m_End && end-start<12 && *end!=';' && !IsSpace(*end) && *end!='<' && *end!='&')
+		end++;
+	if (end>=m_End || *end!=';')
+	{
+		SetError(L"Whitespace is not allowed at this location.");
+		return false;
+	}
+	if (*start=='#')
+	{
+		unsigned int c=0;
+		const wchar_t *str=start+1;
+		bool bHex=(*str=='x');
+		if (bHex) str++;
+		if (str==end)
+		{
+			SetError(L"Invalid character reference.");
+			return false;
+		}
+		for (;str<end;str++)
+		{
+			int digit;
+			if (*str>='0' && *str<='9') digit=*str-'0';
+			else if (bHex && *str>='a' && *str<='f') digit=*str-'a'+10;
+			else if (bHex && *str>='A' && *str<='F') digit=*str-'A'+10;
+			else digit=-1;
+			if (digit<0 || c>0x10FFFF)
+			{
+				SetError(L"Invalid character reference.");
+				return false;
+			}
+			c=c*(bHex?16:10)+digit;
+		}
+		if (c==0 || c>0x10FFFF)
+		{
+			SetError(L"Invalid unicode character.");
+			return false;
+		}
+		PushChar(m_Buf,c);
+	}
+	else
+	{
+		int len=(int)(end-start);
+		if (len==2 && wcsncmp(start,L"lt",2)==0) m_Buf.push_back('<');
+		else if (len==2 && wcsncmp(start,L"gt",2)==0) m_Buf.push_back('>');
+		else if (len==3 && wcsncmp(start,L"amp",3)==0) m_Buf.push_back('&');
+		else if (len==4 && wcsncmp(start,L"quot",4)==0) m_Buf.push_back('"');
+		else if (len==4 && wcsncmp(start,L"apos",4)==0) m_Buf.push_back('\'');
+		else
+		{
+			wchar_t name[16];
+			memcpy(name,start,len*sizeof(wchar_t));
+			name[len]=0;
+			SetError(L"Reference to undefined entity '%.100ls'.",name);
+			return false;
+		}
+	}
+	m_Pos=end+1;
+	return true;
+}
+
+CXmlReader::TNode CXmlReader::Read( void )
+{
+	if (m_Node==NODE_ERROR || m_Node==NODE_EOF)
+		return m_Node;
+	if (m_bPendingEnd)
+	{
+		// the end of an empty element. the name is still in m_Buf
+		m_bPendingEnd=false;
+		m_ElementNames.resize(m_OpenElements.back());
+		m_OpenElements.pop_back();
+		if (m_OpenElements.empty())
+			m_bRootDone=true;
+		m_Node=NODE_END_ELEMENT;
+		return m_Node;
+	}
+
+	while (1)
+	{
+		if (m_Pos>=m_End)
+		{
+			if (!m_OpenElements.empty())
+				return SetError(L"Unexpected end of file has occurred. The following elements are not closed: %.100ls.",&m_ElementNames[m_OpenElements.back()]);
+			if (!m_bRootStarted)
+				return SetError(L"XML document must have a top level element.");
+			m_Node=NODE_EOF;
+			return m_Node;
+		}
+		if (*m_Pos!='<')
+		{
+			if (!m_OpenElements.empty())
+				return ReadText();
+			if (!IsSpace(*m_Pos))
+				return SetError(L"Invalid at the top level of the document.");
+			m_Pos++;
+			continue;
+		}
+		if (wcsncmp(m_Pos,L"<?",2)==0)
+		{
+			m_Pos+=2;
+			if (!Skip(L"?>"))
+				return SetError(L"Unexpected end of file while parsing PI has occurred.");
+			continue;
+		}
+		if (wcsncmp(m_Pos,L"<!--",4)==0)
+		{
+			m_Pos+=4;
+			if (!Skip(L"-->"))
+				return SetError(L"Unexpected end of file while parsing Comment has occurred.");
+			continue;
+		}
+		if (wcsncmp(m_Pos,L"<![CDATA[",9)==0)
+		{
+			if (m_OpenElements.empty())
+				return SetError(L"Invalid at the top level of the document.");
+			return ReadCData();
+		}
+		if (wcsncmp(m_Pos,L"<!DOCTYPE",9)==0)
+		{
+			if (m_bRootStarted)
+				return SetError(L"Cannot have a DTD declaration outside of a DTD.");
+			if (!SkipDocType())
+				return SetError(L"Unexpected end of file while parsing DOCTYPE has occurred.");
+			continue;
+		}
+		if (m_Pos[1]=='/')
+			return ReadEndTag();
+		return ReadStartTag();
+	}
+}
+
+CXmlReader::TNode CXmlReader::ReadText( void )
+{
+	m_Buf.clear();
+	while (m_Pos<m_End && *m_Pos!='<')
+	{
+		wchar_t c=*m_Pos;
+		if (c=='&')
+		{
+			if (!ReadReference())
+				return NODE_ERROR;
+			continue;
+		}
+		m_Pos++;
+		if (c=='\r')
+		{
+			// the line ends are normalized to \n
+			if (m_Pos<m_End && *m_Pos=='\n')
+				m_Pos++;
+			c='\n';
+		}
+		m_Buf.push_back(c);
+	}
+	m_TextLength=(int)m_Buf.size();
+	m_Buf.push_back(0);
+	m_Node=NODE_TEXT;
+	return m_Node;
+}
+
+CXmlReader::TNode CXmlReader::ReadCData( void )
+{
+	m_Pos+=9;
+	m_Buf.clear();
+	while (1)
+	{
+		if (m_Pos>=m_End)
+			return SetError(L"Unexpected end of file while parsing CDATA has occurred.");
+		if (*m_Pos==']' && wcsncmp(m_Pos,L"]]>",3)==0)
+		{
+			m_Pos+=3;
+			break;
+		}
+		wchar_t c=*m_Pos++;
+		if (c=='\r')
+		{
+			if (m_Pos<m_End && *m_Pos=='\n')
+				m_Pos++;
+			c='\n';
+		}
+		m_Buf.push_back(c);
+	}
+	m_TextLength=(int)m_Buf.size();
+	m_Buf.push_back(0);
+	m_Node=NODE_TEXT;
+	return m_Node;
+}
+
+CXmlReader::TNode CXmlReader::ReadStartTag( void )
+{
+	if (m_bRootDone)
+		return SetError(L"Only one top level element is allowed in an XML document.");
+	m_Pos++;
+	m_Buf.clear();
+	m_Attributes.clear();
+	if (!ReadName())
+		return SetError(L"A name was started with an invalid character.");
+
+	bool bEmpty;
+	while (1)
+	{
+		bool bSpace=false;
+		while (m_Pos<m_End && IsSpace(*m_Pos))
+			m_Pos++, bSpace=true;
+		if (m_Pos>=m_End)
+			return SetError(L"Unexpected end of file has occurred.");
+		if (*m_Pos=='>')
+		{
+			m_Pos++;
+			bEmpty=false;
+			break;
+		}
+		if (*m_Pos=='/')
+		{
+			if (m_Pos[1]!='>')
+				return SetError(L"Expecting '>'.");
+			m_Pos+=2;
+			bEmpty=true;
+			break;
+		}
+		if (!bSpace)
+			return SetError(L"Required white space was missing.");
+
+		Attribute attribute;
+		attribute.name=(int)m_Buf.size();
+		if (!ReadName())
+			return SetError(L"A name was started with an invalid character.");
+		while (m_Pos<m_End && IsSpace(*m_Pos))
+			m_Pos++;
+		if (m_Pos>=m_End || *m_Pos!='=')
+			return SetError(L"Missing equals sign between attribute and attribute value.");
+		m_Pos++;
+		while (m_Pos<m_End && IsSpace(*m_Pos))
+			m_Pos++;
+		if (m_Pos>=m_End || (*m_Pos!='"' && *m_Pos!='\''))
+			return SetError(L"A string literal was expected, but no opening quote character was found.");
+		wchar_t quote=*m_Pos++;
+		attribute.value=(int)m_Buf.size();
+		while (1)
+		{
+			if (m_Pos>=m_End)
+				return SetError(L"Unexpected end of file has occurred.");
+			wchar_t c=*m_Pos;
+			if (c==quote)
+			{
+				m_Pos++;
+				break;
+			}
+			if (c=='<')
+				return SetError(L"The character '<' cannot be used in an attribute value.");
+			if (c=='&')
+			{
+				if (!ReadReference())
+					return NODE_ERROR;
+				continue;
+			}
+			m_Pos++;
+			// the white space in attribute values is normalized to spaces. the references like &#10; are kept
+			if (c=='\r' && m_Pos<m_End && *m_Pos=='\n')
+				m_Pos++;
+			if (c=='\r' || c=='\n' || c=='\t')
+				c=' ';
+			m_Buf.push_back(c);
+		}
+		m_Buf.push_back(0);
+		for (std::vector<Attribute>::const_iterator it=m_Attributes.begin();it!=m_Attributes.end();++it)
+		{
+			if (wcscmp(&m_Buf[it->name],&m_Buf[attribute.name])==0)
+				return SetError(L"Duplicate attribute.");
+		}
+		m_Attributes.push_back(attribute);
+	}
+
+	m_OpenElements.push_back((int)m_ElementNames.size());
+	m_ElementNames.insert(m_ElementNames.end(),&m_Buf[0],&m_Buf[0]+wcslen(&m_Buf[0])+1);
+	m_bRootStarted=true;
+	m_bPendingEnd=bEmpty;
+	m_Node=NODE_ELEMENT;
+	return m_Node;
+}
+
+CXmlReader::TNode CXmlReader::ReadEndTag( void )
+{
+	if (m_OpenElements.empty())
+		return SetError(L"Invalid at the top level of the document.");
+	m_Pos+=2;
+	m_Buf.clear();
+	m_Attributes.clear();
+	if (!ReadName())
+		return SetError(L"A name was started with an invalid character.");
+	while (m_Pos<m_End && IsSpace(*m_Pos))
+		m_Pos++;
+	if (m_Pos>=m_End || *m_Pos!='>')
+		return SetError(L"Expecting '>'.");
+	m_Pos++;
+	const wchar_t *open=&m_ElementNames[m_OpenElements.back()];
+	if (wcscmp(open,&m_Buf[0])!=0)
+		return SetError(L"End tag '%.100ls' does not match the start tag '%.100ls'.",&m_Buf[0],open);
+	m_ElementNames.resize(m_OpenElements.back());
+	m_OpenElements.pop_back();
+	if (m_OpenElements.empty())
+		m_bRootDone=true;
+	m_Node=NODE_END_ELEMENT;
+	return m_Node;
+}
+
+bool CXmlReader::SkipDocType( void )
+{
+	m_Pos+=9;
+	int depth=0;
+	while (m_Pos<m_End)
+	{
+		wchar_t c=*m_Pos++;
+		if (c=='"' || c=='\'')
+		{
+			while (m_Pos<m_End && *m_Pos!=c)
+				m_Pos++;
+			if (m_Pos<m_End) m_Pos++;
+		}
+		else if (c=='[')
+			depth++;
+		else if (c==']')
+			depth--;
+		else if (c=='>' && depth<=0)
+			return true;
+	}
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CXmlWriter::WriteDeclaration( void )
+{
+	const char *declaration="<?xml version=\"1.0\"?>\r\n";
+	m_Data.insert(m_Data.end(),declaration,declaration+strlen(declaration));
+}
+
+void CXmlWriter::StartElement( const wchar_t *name )
+{
+	CloseStartTag();
+	m_Data.push_back('<');
+	int len=(int)wcslen(name);
+	WriteUTF8(name,len);
+	m_OpenElements.push_back((int)m_ElementNames.size());
+	m_ElementNames.insert(m_ElementNames.end(),name,name+len+1);
+	m_bOpenTag=true;
+}
+
+void CXmlWriter::WriteAttribute( const wchar_t *name, const wchar_t *value )
+{
+	Assert(m_bOpenTag);
+	m_Data.push_back(' ');
+	WriteUTF8(name,(int)wcslen(name));
+	m_Data.push_back('=');
+	m_Data.push_back('"');
+	WriteEscaped(value,(int)wcslen(value),true);
+	m_Data.push_back('"');
+}
+
+void CXmlWriter::WriteText( const wchar_t *text, int len )
+{
+	CloseStartTag();
+	WriteEscaped(text,len<0?(int)wcslen(text):len,false);
+}
+
+void CXmlWriter::EndElement( void )
+{
+	Assert(!m_OpenElements.empty());
+	if (m_bOpenTag)
+	{
+		m_Data.push_back('/');
+		m_Data.push_back('>');
+		m_bOpenTag=false;
+	}
+	else
+	{
+		const wchar_t *name=&m_ElementNames[m_OpenElements.back()];
+		m_Data.push_back('<');
+		m_Data.push_back('/');
+		WriteUTF8(name,(int)wcslen(name));
+		m_Data.push_back('>');
+	}
+	m_ElementNames.resize(m_OpenElements.back());
+	m_OpenElements.pop_back();
+}
+
+void CXmlWriter::CloseStartTag( void )
+{
+	if (m_bOpenTag)
+	{
+		m_Data.push_back('>');
+		m_bOpenTag=false;
+	}
+}
+
+void CXmlWriter::WriteUTF8( const wchar_t *str, int len )
+{
+	for (int i=0;i<len;i++)
+	{
+		unsigned int c=str[i];
+		if (c<0x80)
+		{
+			m_Data.push_back((char)c);
+			continue;
+		}
+		if (sizeof(wchar_t)==2 && c>=0xD800 && c<0xDC00 && i+1<len && str[i+1]>=0xDC00 && str[i+1]<0xE000)
+		{
+			c=0x10000+((c-0xD800)<<10)+(str[i+1]-0xDC00);
+			i++;
+		}
+		if (c<0x800)
+		{
+			m_Data.push_back((char)(0xC0|(c>>6)));
+		}
+		else if (c<0x10000)
+		{
+			m_Data.push_back((char)(0xE0|(c>>12)));
+			m_Data.push_back((char)(0x80|((c>>6)&0x3F)));
+		}
+		else
+		{
+			m_Data.push_back((char)(0xF0|(c>>18)));
+			m_Data.push_back((char)(0x80|((c>>12)&0x3F)));
+			m_Data.push_back((char)(0x80|((c>>6)&0x3F)));
+		}
+		m_Data.push_back((char)(0x80|(c&0x3F)));
+	}
+}
+
+void CXmlWriter::WriteEscaped( const wchar_t *str, int len, bool bAttribute )
+{
+	int start=0; // the start of the characters that don't need escaping
+	for (int i=0;i<len;i++)
+	{
+		wchar_t c=str[i];
+		const char *escape=NULL;
+		char buf[16];
+		if (c=='&') escape="&amp;";
+		else if (c=='<') escape="&lt;";
+		else if (c=='>') escape="&gt;";
+		else if (c=='"' && bAttribute) escape="&quot;";
+		else if (c<0x20 && (bAttribute || (c!='\t' && c!='\n')))
+		{
+			// keep the white space in attributes, and the \r and the control characters everywhere
+			snprintf(buf,sizeof(buf),"&#%d;",(int)c);
+			escape=buf;
+		}
+		if (!escape) continue;
+		WriteUTF8(str+start,i-start);
+		m_Data.insert(m_Data.end(),escape,escape+strlen(escape));
+		start=i+1;
+	}
+	WriteUTF8(str+start,len-start);
+}
@@ -0,0 +1,109 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include <vector>
+
+// XmlStream.h - streaming reader and writer for simple XML documents, like the exported settings
+// CXmlReader is a pull parser. It doesn't build a tree, so the memory it uses doesn't grow with the number of elements.
+// CXmlWriter produces UTF-8 text and escapes the text and the attribute values, so CXmlReader reads back the same strings.
+// Supported are elements, attributes, text, CDATA sections, character references and the predefined entities. Comments, processing
+// instructions and the DOCTYPE declaration are skipped. The reader and the writer don't depend on the OS
+
+class CXmlReader
+{
+public:
+	enum TNode
+	{
+		NODE_ELEMENT, // a start tag. for an empty element (<a/>) the next node is its NODE_END_ELEMENT
+		NODE_END_ELEMENT,
+		NODE_TEXT, // text or a CDATA section
+		NODE_EOF, // the end of the document
+		NODE_ERROR, // the document is not valid. GetError returns the reason
+	};
+
+	CXmlReader( void );
+
+	// Decodes the document. Supports UTF-8, UTF-16, ISO-8859-1 and Windows-1252. Returns false if the encoding is not supported or the text is not valid
+	bool Load( const unsigned char *buf, int size );
+	// Reads the next node
+	TNode Read( void );
+
+	// the name of the element for NODE_ELEMENT and NODE_END_ELEMENT
+	const wchar_t *GetName( void ) const { return &m_Buf[0]; }
+	// the value of an attribute of the current NODE_ELEMENT. returns NULL if the attribute is missing
+	const wchar_t *GetAttribute( const wchar_t *name ) const;
+	// the text for NODE_TEXT
+	const wchar_t *GetText( void ) const { return &m_Buf[0]; }
+	int GetTextLength( void ) const { return m_TextLength; }
+	bool IsWhiteSpace( void ) const;
+	// the number of open elements after the current node
+	int GetDepth( void ) const { return (int)m_OpenElements.size(); }
+
+	// the reason for the last error, including the line and the position
+	const wchar_t *GetError( void ) const { return m_Error.empty()?L"":&m_Error[0]; }
+
+private:
+	struct Attribute
+	{
+		int name; // offsets in m_Buf
+		int value;
+	};
+
+	std::vector<wchar_t> m_Text; // the decoded document
+	const wchar_t *m_Pos;
+	const wchar_t *m_End;
+	TNode m_Node;
+	std::vector<wchar_t> m_Buf; // the name and the attributes, or the text of the current node
+	std::vector<Attribute> m_Attributes;
+	int m_TextLength;
+	std::vector<wchar_t> m_ElementNames; // the names of the open elements
+	std::vector<int> m_OpenElements; // offsets in m_ElementNames
+	bool m_bPendingEnd; // the current element is empty and the next node is its end
+	bool m_bRootStarted;
+	bool m_bRootDone;
+	std::vector<wchar_t> m_Error;
+
+	const wchar_t *Decode( const unsigned char *buf, int size );
+	TNode SetError( const wchar_t *reason, const wchar_t *arg1=NULL, const wchar_t *arg2=NULL );
+	bool Skip( const wchar_t *end );
+	bool ReadName( void );
+	bool ReadReference( void );
+	TNode ReadText( void );
+	TNode ReadCData( void );
+	TNode ReadStartTag( void );
+	TNode ReadEndTag( void );
+	bool SkipDocType( void );
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class CXmlWriter
+{
+public:
+	CXmlWriter( void ) { m_bOpenTag=false; }
+
+	// writes <?xml version="1.0"?>
+	void WriteDeclaration( void );
+	void StartElement( const wchar_t *name );
+	// must be called after StartElement, before anything else is written in the element
+	void WriteAttribute( const wchar_t *name, const wchar_t *value );
+	void WriteText( const wchar_t *text, int len=-1 );
+	// closes the last open element. an element without content is written as <name/>
+	void EndElement( void );
+
+	// the UTF-8 text of the document
+	const std::vector<char> &GetData( void ) const { return m_Data; }
+
+private:
+	std::vector<char> m_Data;
+	std::vector<wchar_t> m_ElementNames; // the names of the open elements
+	std::vector<int> m_OpenElements; // offsets in m_ElementNames
+	bool m_bOpenTag; // the start tag of the last element is not closed yet
+
+	void CloseStartTag( void );
+	void WriteUTF8( const wchar_t *str, int len );
+	void WriteEscaped( const wchar_t *str, int len, bool bAttribute );
+};
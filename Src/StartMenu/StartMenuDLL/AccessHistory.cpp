@@ -0,0 +1,129 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include "stdafx.h"
+#include "AccessHistory.h"
+#include <algorithm>
+
+// The saved history is an array of unsigned ints:
+//   version, session, count
+//   count entries of 2 ints: hash, score | (age<<16)
+// where age is the number of sessions since the item was used last
+
+unsigned int CAccessHistory::DecayScore( unsigned int score, unsigned int sessions )
+{
+	if (sessions>=32*HALF_LIFE)
+		return 0; // shifting by 32 or more bits is undefined
+	score>>=sessions/HALF_LIFE;
+	for (unsigned int i=0;i<sessions%HALF_LIFE && score>0;i++)
+		score=score*215/256; // 2^(-1/4)
+	return score;
+}
+
+unsigned int CAccessHistory::GetScore( const Entry &entry ) const
+{
+	return DecayScore(entry.score,m_Session-entry.session);
+}
+
+bool CAccessHistory::Load( const void *data, int size )
+{
+	Clear();
+	const unsigned int *pData=(const unsigned int*)data;
+	int count=size/4;
+	if (count<3 || pData[0]!=HISTORY_VERSION || (int)pData[2]>MAX_ENTRIES || count!=3+(int)pData[2]*2)
+		return false;
+	unsigned int session=pData[1];
+	m_Entries.resize(pData[2]);
+	for (size_t i=0;i<m_Entries.size();i++)
+	{
+		Entry &entry=m_Entries[i];
+		unsigned int age=pData[4+i*2]>>16;
+		if (age>MAX_AGE) age=MAX_AGE;
+		entry.hash=pData[3+i*2];
+		entry.score=pData[4+i*2]&0xFFFF;
+		entry.session=session-age;
+		entry.weight=0;
+	}
+	std::sort(m_Entries.begin(),m_Entries.end());
+	for (size_t i=1;i<m_Entries.size();i++)
+	{
+		if (m_Entries[i].hash==m_Entries[i-1].hash)
+		{
+			Clear();
+			return false;
+		}
+	}
+	m_Session=session+1;
+	return true;
+}
+
+void CAccessHistory::Save( std::vector<unsigned int> &data ) const
+{
+	std::vector<const Entry*> entries;
+	GetSorted(entries);
+	if (entries.size()>MAX_ENTRIES)
+		entries.resize(MAX_ENTRIES);
+	data.resize(3+entries.size()*2);
+	data[0]=HISTORY_VERSION;
+	data[1]=m_Session;
+	data[2]=(unsigned int)entries.size();
+	for (size_t i=0;i<entries.size();i++)
+	{
+		unsigned int age=m_Session-entries[i]->session;
+		if (age>MAX_AGE) age=MAX_AGE;
+		data[3+i*2]=entries[i]->hash;
+		data[4+i*2]=entries[i]->score|(age<<16);
+	}
+}
+
+void CAccessHistory::Record( unsigned int hash, int weight )
+{
+	Entry key={hash};
+	std::vector<Entry>::iterator it=std::lower_bound(m_Entries.begin(),m_Entries.end(),key);
+	if (it==m_Entries.end() || it->hash!=hash)
+	{
+		it=m_Entries.insert(it,key);
+		it->score=0;
+		it->session=m_Session;
+		it->weight=0;
+	}
+	if (it->session!=m_Session)
+	{
+		it->score=GetScore(*it);
+		it->session=m_Session;
+		it->weight=0;
+	}
+	if (weight>it->weight)
+	{
+		it->score+=(weight-it->weight)*SCORE_ONE;
+		if (it->score>MAX_SCORE) it->score=MAX_SCORE;
+		it->weight=weight;
+	}
+}
+
+// Returns the entries with non-zero score, the highest score first
+void CAccessHistory::GetSorted( std::vector<const Entry*> &entries ) const
+{
+	std::vector<std::pair<unsigned int,const Entry*>> scores;
+	scores.reserve(m_Entries.size());
+	for (std::vector<Entry>::const_iterator it=m_Entries.begin();it!=m_Entries.end();++it)
+	{
+		unsigned int score=GetScore(*it);
+		if (score>0)
+			scores.push_back(std::pair<unsigned int,const Entry*>(~score,&*it)); // ~score to sort in descending order
+	}
+	std::sort(scores.begin(),scores.end());
+	entries.resize(scores.size());
+	for (size_t i=0;i<scores.size();i++)
+		entries[i]=scores[i].second;
+}
+
+void CAccessHistory::Predict( int maxCount, std::vector<unsigned int> &hashes ) const
+{
+	hashes.clear();
+	std::vector<const Entry*> entries;
+	GetSorted(entries);
+	for (int i=0;i<(int)entries.size() && i<maxCount;i++)
+		hashes.push_back(entries[i]->hash);
+}
@@ -0,0 +1,65 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include <vector>
+
+// CAccessHistory - remembers which items were used in the recent sessions and predicts which ones will be needed first
+// In every session an item gets points for being shown or executed (only the biggest weight counts once per session).
+// The points from older sessions lose half their value every HALF_LIFE sessions.
+// The history doesn't depend on the OS and doesn't do any locking
+class CAccessHistory
+{
+public:
+	enum
+	{
+		WEIGHT_SHOWN=1,
+		WEIGHT_EXECUTED=4,
+		HALF_LIFE=4, // in sessions
+		MAX_ENTRIES=256, // the number of saved items
+	};
+
+	CAccessHistory( void ) { m_Session=0; }
+
+	void Clear( void ) { m_Entries.clear(); m_Session=0; }
+	// Loads the saved history and starts a new session. Returns false if the data is not valid (the history is cleared)
+	bool Load( const void *data, int size );
+	// Saves the MAX_ENTRIES items with the highest scores
+	void Save( std::vector<unsigned int> &data ) const;
+
+	// Records that the item was used in the current session
+	void Record( unsigned int hash, int weight );
+	// Returns up to maxCount items, the most likely first
+	void Predict( int maxCount, std::vector<unsigned int> &hashes ) const;
+	int GetCount( void ) const { return (int)m_Entries.size(); }
+
+	// Decays the score by 2^(-1/HALF_LIFE) per session
+	static unsigned int DecayScore( unsigned int score, unsigned int sessions );
+
+private:
+	enum
+	{
+		HISTORY_VERSION=1,
+		SCORE_ONE=16, // fixed point score
+		MAX_SCORE=0xFFFF,
+		MAX_AGE=16*HALF_LIFE, // in sessions. any score decays to 0 by then
+	};
+
+	struct Entry
+	{
+		unsigned int hash;
+		unsigned int score; // as of the session when the item was used last
+		unsigned int session; // the last session when the item was used
+		int weight; // the weight that was added in that session
+
+		bool operator<( const Entry &x ) const { return hash<x.hash; }
+	};
+
+	std::vector<Entry> m_Entries; // sorted by hash
+	unsigned int m_Session;
+
+	unsigned int GetScore( const Entry &entry ) const;
+	void GetSorted( std::vector<const Entry*> &entries ) const;
+};
@@ -0,0 +1,161 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include "stdafx.h"
+#include "AtlasAllocator.h"
+
+void CAtlasAllocator::Init( int width, int height )
+{
+	m_Width=width;
+	m_Height=height;
+	Clear();
+}
+
+void CAtlasAllocator::Clear( void )
+{
+	m_Shelves.clear();
+	m_Top=0;
+	m_Count=0;
+}
+
+bool CAtlasAllocator::HasRoom( const Shelf &shelf, int width, int shelfWidth )
+{
+	if (shelf.used+width<=shelfWidth)
+		return true;
+	for (std::vector<Span>::const_iterator it=shelf.freeSpans.begin();it!=shelf.freeSpans.end();++it)
+	{
+		if (it->width>=width)
+			return true;
+	}
+	return false;
+}
+
+int CAtlasAllocator::AllocFromShelf( Shelf &shelf, int width )
+{
+	// first fit from the freed spans, then from the tail
+	for (std::vector<Span>::iterator it=shelf.freeSpans.begin();it!=shelf.freeSpans.end();++it)
+	{
+		if (it->width>=width)
+		{
+			int x=it->x;
+			it->x+=width;
+			it->width-=width;
+			if (it->width==0)
+				shelf.freeSpans.erase(it);
+			return x;
+		}
+	}
+	int x=shelf.used;
+	shelf.used+=width;
+	return x;
+}
+
+bool CAtlasAllocator::Alloc( int width, int height, AtlasRect &rc )
+{
+	if (width<=0 || height<=0 || width>m_Width || height>m_Height)
+		return false;
+
+	// find the lowest shelf that has room. don't waste more than 25% of the height
+	Shelf *pShelf=NULL;
+	for (std::vector<Shelf>::iterator it=m_Shelves.begin();it!=m_Shelves.end();++it)
+	{
+		if (it->height<height || it->height-height>height/4)
+			continue;
+		if (pShelf && pShelf->height<=it->height)
+			continue;
+		if (HasRoom(*it,width,m_Width))
+			pShelf=&*it;
+	}
+	if (!pShelf && m_Top+height<=m_Height)
+	{
+		// start a new shelf at the bottom
+		Shelf shelf={m_Top,height,0,0};
+		m_Shelves.push_back(shelf);
+		m_Top+=height;
+		pShelf=&m_Shelves.back();
+	}
+	if (!pShelf)
+	{
+		// reuse an empty shelf even if it is too tall
+		for (std::vector<Shelf>::iterator it=m_Shelves.begin();it!=m_Shelves.end();++it)
+		{
+			if (it->count==0 && it->height>=height)
+			{
+				pShelf=&*it;
+				break;
+			}
+		}
+	}
+	if (!pShelf)
+		return false;
+
+	rc.x=AllocFromShelf(*pShelf,width);
+	rc.y=pShelf->y;
+	rc.width=width;
+	rc.height=height;
+	pShelf->count++;
+	m_Count++;
+	return true;
+}
+
+void CAtlasAllocator::Free( const AtlasRect &rc )
+{
+	std::vector<Shelf>::iterator shelf=m_Shelves.begin();
+	for (;shelf!=m_Shelves.end();++shelf)
+	{
+		if (shelf->y==rc.y)
+			break;
+	}
+	Assert(shelf!=m_Shelves.end() && shelf->count>0);
+	if (shelf==m_Shelves.end()) return;
+
+	shelf->count--;
+	m_Count--;
+	if (shelf->count==0)
+	{
+		shelf->used=0;
+		shelf->freeSpans.clear();
+		// give the empty shelves at the bottom back to the page
+		while (!m_Shelves.empty() && m_Shelves.back().count==0)
+		{
+			m_Top=m_Shelves.back().y;
+			m_Shelves.pop_back();
+		}
+		return;
+	}
+
+	Span span={rc.x,rc.width};
+	std::vector<Span> &spans=shelf->freeSpans;
+	if (span.x+span.width==shelf->used)
+	{
+		// the span is at the end, shrink the tail
+		shelf->used=span.x;
+		if (!spans.empty() && spans.back().x+spans.back().width==shelf->used)
+		{
+			shelf->used=spans.back().x;
+			spans.pop_back();
+		}
+		return;
+	}
+
+	std::vector<Span>::iterator it=spans.begin();
+	while (it!=spans.end() && it->x<span.x)
+		++it;
+	bool bMergeNext=(it!=spans.end() && span.x+span.width==it->x);
+	bool bMergePrev=(it!=spans.begin() && (it-1)->x+(it-1)->width==span.x);
+	if (bMergePrev && bMergeNext)
+	{
+		(it-1)->width+=span.width+it->width;
+		spans.erase(it);
+	}
+	else if (bMergePrev)
+		(it-1)->width+=span.width;
+	else if (bMergeNext)
+	{
+		it->x=span.x;
+		it->width+=span.width;
+	}
+	else
+		spans.insert(it,span);
+}
@@ -0,0 +1,52 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include <vector>
+
+// AtlasAllocator.h - finds room for the icons in an atlas page
+
+struct AtlasRect
+{
+	int x, y;
+	int width, height;
+};
+
+// CAtlasAllocator - packs rectangles into a single page using shelves with free lists
+// The allocator doesn't depend on the OS. It only manages the coordinates, not the pixels
+class CAtlasAllocator
+{
+public:
+	CAtlasAllocator( void ) { m_Width=m_Height=m_Top=0; m_Count=0; }
+
+	void Init( int width, int height );
+	bool Alloc( int width, int height, AtlasRect &rc );
+	void Free( const AtlasRect &rc );
+	void Clear( void );
+	bool IsEmpty( void ) const { return m_Count==0; }
+	int GetCount( void ) const { return m_Count; }
+
+private:
+	struct Span
+	{
+		int x, width;
+	};
+
+	struct Shelf
+	{
+		int y, height;
+		int used; // the x coordinate of the unused tail of the shelf
+		int count; // number of rectangles in the shelf
+		std::vector<Span> freeSpans; // sorted by x, never adjacent to each other or to the tail
+	};
+
+	int m_Width, m_Height;
+	int m_Top; // the y coordinate of the unused bottom of the page
+	int m_Count;
+	std::vector<Shelf> m_Shelves; // sorted by y
+
+	static bool HasRoom( const Shelf &shelf, int width, int shelfWidth );
+	static int AllocFromShelf( Shelf &shelf, int width );
+};
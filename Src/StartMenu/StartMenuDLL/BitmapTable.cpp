@@ -0,0 +1,83 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include "stdafx.h"
+#include "BitmapTable.h"
+#include "FNVHash.h"
+
+unsigned int CalcPixelHash( const unsigned int *bits, int width, int height, int stride, bool bBottomUp )
+{
+	unsigned int hash=CalcFNVHash(&width,4);
+	hash=CalcFNVHash(&height,4,hash);
+	for (int y=0;y<height;y++)
+		hash=CalcFNVHash(bits+(bBottomUp?height-1-y:y)*stride,width*4,hash);
+	return hash;
+}
+
+CBitmapTable::Bitmap *CBitmapTable::Find( unsigned int hash, const unsigned int *bits, int width, int height, bool bBottomUp )
+{
+	// different pixels can have the same hash, so compare the pixels
+	for (std::multimap<unsigned int,Bitmap*>::iterator it=m_Bitmaps.find(hash);it!=m_Bitmaps.end() && it->first==hash;++it)
+	{
+		Bitmap *pBitmap=it->second;
+		if (pBitmap->rc.width!=width || pBitmap->rc.height!=height)
+			continue;
+		bool bSame=true;
+		for (int y=0;y<height && bSame;y++)
+		{
+			const unsigned int *src=bits+(bBottomUp?height-1-y:y)*width;
+			bSame=memcmp(pBitmap->bits+y*pBitmap->stride,src,width*4)==0;
+		}
+		if (bSame)
+		{
+			pBitmap->refCount++;
+			return pBitmap;
+		}
+	}
+	return NULL;
+}
+
+void CBitmapTable::Add( Bitmap *pBitmap, unsigned int hash )
+{
+	pBitmap->hash=hash;
+	pBitmap->refCount=1;
+	m_Bitmaps.emplace(hash,pBitmap);
+}
+
+void CBitmapTable::AddRef( const Bitmap *pBitmap )
+{
+	if (pBitmap)
+		const_cast<Bitmap*>(pBitmap)->refCount++;
+}
+
+bool CBitmapTable::Release( const Bitmap *pBitmap )
+{
+	if (!pBitmap) return false;
+	Bitmap *pBitmap2=const_cast<Bitmap*>(pBitmap);
+	Assert(pBitmap2->refCount>0);
+	if (--pBitmap2->refCount>0)
+		return false;
+	for (std::multimap<unsigned int,Bitmap*>::iterator it=m_Bitmaps.find(pBitmap2->hash);it!=m_Bitmaps.end() && it->first==pBitmap2->hash;++it)
+	{
+		if (it->second==pBitmap2)
+		{
+			m_Bitmaps.erase(it);
+			break;
+		}
+	}
+	return true;
+}
+
+void CBitmapTable::GetStats( Stats &stats ) const
+{
+	memset(&stats,0,sizeof(stats));
+	for (std::multimap<unsigned int,Bitmap*>::const_iterator it=m_Bitmaps.begin();it!=m_Bitmaps.end();++it)
+	{
+		int size=it->second->rc.width*it->second->rc.height*4;
+		stats.bitmaps++;
+		stats.references+=it->second->refCount;
+		stats.bytes+=size;
+		stats.savedBytes+=(it->second->refCount-1)*size;
+	}
+}
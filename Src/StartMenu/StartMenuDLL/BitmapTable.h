@@ -0,0 +1,65 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include <map>
+#include "AtlasAllocator.h"
+
+// BitmapTable.h - finds the icon bitmaps with identical pixels, so the icons can share them
+
+// Calculates a hash of the pixels in top-down order. If bBottomUp is true the first row is the bottom of the image
+unsigned int CalcPixelHash( const unsigned int *bits, int width, int height, int stride, bool bBottomUp );
+
+// CBitmapTable - reference counted bitmaps, indexed by the hash of their pixels
+// The table doesn't allocate or free the bitmaps and their pixels, and doesn't depend on the OS
+class CBitmapTable
+{
+public:
+	struct Bitmap
+	{
+		unsigned int *bits; // the top-left pixel
+		int stride; // in pixels
+		AtlasRect rc;
+
+	private:
+		unsigned int hash; // hash of the pixels
+		int refCount;
+
+		friend class CBitmapTable;
+	};
+
+	struct Stats
+	{
+		int bitmaps; // number of unique bitmaps
+		int references; // number of icons using the bitmaps
+		int bytes; // memory used by the unique bitmaps
+		int savedBytes; // memory saved by sharing identical bitmaps
+	};
+
+	// Returns a bitmap with the same size and pixels and adds a reference to it. Returns NULL if there is none. If bBottomUp is true the first row is the bottom of the image
+	Bitmap *Find( unsigned int hash, const unsigned int *bits, int width, int height, bool bBottomUp );
+	// Adds a new bitmap with one reference. The size and the pixels must be set
+	void Add( Bitmap *pBitmap, unsigned int hash );
+	// Adds a reference to a bitmap that is already in the table
+	static void AddRef( const Bitmap *pBitmap );
+	// Releases a reference. Returns true if it was the last one. Then the bitmap is removed from the table and the caller must free it
+	bool Release( const Bitmap *pBitmap );
+	// Returns the number of references to the bitmap
+	static int GetRefCount( const Bitmap *pBitmap ) { return pBitmap?pBitmap->refCount:0; }
+
+	int GetCount( void ) const { return (int)m_Bitmaps.size(); }
+	void GetStats( Stats &stats ) const;
+
+	// Removes all bitmaps from the table and deletes them as the type T
+	template<class T> void DeleteAll( void )
+	{
+		for (std::multimap<unsigned int,Bitmap*>::iterator it=m_Bitmaps.begin();it!=m_Bitmaps.end();++it)
+			delete static_cast<T*>(it->second);
+		m_Bitmaps.clear();
+	}
+
+private:
+	std::multimap<unsigned int,Bitmap*> m_Bitmaps; // the key is the hash of the pixels
+};
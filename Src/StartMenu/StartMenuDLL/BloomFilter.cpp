@@ -0,0 +1,51 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include "stdafx.h"
+#include "BloomFilter.h"
+
+void CBloomFilter::Init( int count )
+{
+	unsigned int bits=64;
+	while (bits<(unsigned int)count*10 && bits<0x10000000)
+		bits*=2;
+	m_Bits.clear();
+	m_Bits.resize(bits/32,0);
+	m_Mask=bits-1;
+}
+
+// The second hash for the double hashing. Must be odd so the steps visit different bits
+unsigned int CBloomFilter::GetStep( unsigned int hash )
+{
+	hash^=hash>>16;
+	hash*=0x85EBCA6B;
+	hash^=hash>>13;
+	return hash|1;
+}
+
+void CBloomFilter::Add( unsigned int hash )
+{
+	if (m_Bits.empty())
+		Init(64);
+	unsigned int step=GetStep(hash);
+	for (int i=0;i<HASH_COUNT;i++,hash+=step)
+	{
+		unsigned int bit=hash&m_Mask;
+		m_Bits[bit>>5]|=1u<<(bit&31);
+	}
+}
+
+bool CBloomFilter::MayContain( unsigned int hash ) const
+{
+	if (m_Bits.empty())
+		return false;
+	unsigned int step=GetStep(hash);
+	for (int i=0;i<HASH_COUNT;i++,hash+=step)
+	{
+		unsigned int bit=hash&m_Mask;
+		if (!(m_Bits[bit>>5]&(1u<<(bit&31))))
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,30 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include <vector>
+
+// CBloomFilter - a compact set of hashes that can tell quickly when a hash is definitely not in the set
+// MayContain can return true for hashes that were never added (about 1% of the time), but never returns false for a hash that was added.
+// The keys are already hashes (like CalcFNVHash), so the bit positions are derived from them directly. The filter doesn't depend on the OS
+class CBloomFilter
+{
+public:
+	CBloomFilter( void ) { m_Mask=0; }
+
+	// Clears the filter and sizes it for the expected number of hashes
+	void Init( int count );
+	void Clear( void ) { m_Bits.clear(); m_Mask=0; }
+	void Add( unsigned int hash );
+	bool MayContain( unsigned int hash ) const;
+
+private:
+	enum { HASH_COUNT=5 }; // number of bits per hash. with 10 bits per hash gives ~1% false positives
+
+	std::vector<unsigned int> m_Bits;
+	unsigned int m_Mask; // number of bits - 1 (the number of bits is a power of 2)
+
+	static unsigned int GetStep( unsigned int hash );
+};
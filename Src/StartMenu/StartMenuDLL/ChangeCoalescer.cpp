@@ -0,0 +1,73 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include "stdafx.h"
+#include "ChangeCoalescer.h"
+#include "FNVHash.h"
+
+void CChangeCoalescer::Touch( unsigned int time )
+{
+	if (!m_bPending)
+		m_FirstTime=time;
+	m_LastTime=time;
+	m_bPending=true;
+}
+
+void CChangeCoalescer::AddPath( const wchar_t *PATH, int folder, bool bAdded, unsigned int time )
+{
+	Touch(time);
+	if (m_FolderMask&(1<<folder))
+		return;
+	unsigned int hash=CalcFNVHash(PATH);
+	for (std::multimap<unsigned int,Change>::iterator it=m_Changes.find(hash);it!=m_Changes.end() && it->first==hash;++it)
+	{
+		if (it->second.folder==folder && it->second.PATH==PATH)
+		{
+			it->second.bAdded|=bAdded;
+			return;
+		}
+	}
+	if (++m_FolderCounts[folder]>MAX_FOLDER_CHANGES)
+	{
+		// too many changes, probably an installer. reloading the folder is cheaper
+		AddFolder(folder,time);
+		return;
+	}
+	Change &change=m_Changes.emplace(hash,Change())->second;
+	change.PATH=PATH;
+	change.folder=folder;
+	change.bAdded=bAdded;
+}
+
+void CChangeCoalescer::AddFolder( int folder, unsigned int time )
+{
+	Touch(time);
+	m_FolderMask|=1<<folder;
+}
+
+int CChangeCoalescer::GetTimeout( unsigned int time ) const
+{
+	if (!m_bPending)
+		return -1;
+	int quiet=(int)(m_LastTime+QUIET_TIME-time);
+	int delay=(int)(m_FirstTime+MAX_DELAY-time);
+	int timeout=quiet<delay?quiet:delay;
+	return timeout>0?timeout:0;
+}
+
+void CChangeCoalescer::TakeChanges( std::vector<Change> &changes, unsigned int &folderMask )
+{
+	changes.clear();
+	changes.reserve(m_Changes.size());
+	for (std::multimap<unsigned int,Change>::const_iterator it=m_Changes.begin();it!=m_Changes.end();++it)
+	{
+		if (!(m_FolderMask&(1<<it->second.folder)))
+			changes.push_back(it->second);
+	}
+	folderMask=m_FolderMask;
+	m_Changes.clear();
+	m_FolderCounts.clear();
+	m_FolderMask=0;
+	m_bPending=false;
+}
@@ -0,0 +1,50 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include <map>
+#include <vector>
+
+// CChangeCoalescer - collects the file system changes in the watched folders until they calm down
+// The changes are processed after no new changes arrive for QUIET_TIME, or MAX_DELAY after the first change.
+// Multiple changes of the same path are merged. If a folder gets too many changes, the whole folder is reloaded instead.
+// The coalescer doesn't access the file system or the clock. The caller provides the time in milliseconds
+class CChangeCoalescer
+{
+public:
+	enum
+	{
+		QUIET_TIME=1000,
+		MAX_DELAY=10000,
+		MAX_FOLDER_CHANGES=200,
+	};
+
+	struct Change
+	{
+		CString PATH;
+		int folder; // the index of the watched folder
+		bool bAdded; // the path was created or renamed (as opposed to only modified)
+	};
+
+	CChangeCoalescer( void ) { m_FolderMask=0; m_FirstTime=m_LastTime=0; m_bPending=false; }
+
+	void AddPath( const wchar_t *PATH, int folder, bool bAdded, unsigned int time );
+	// the whole folder must be reloaded
+	void AddFolder( int folder, unsigned int time );
+	bool IsPending( void ) const { return m_bPending; }
+	// returns the time to wait before the changes are ready, or -1 if nothing is pending
+	int GetTimeout( unsigned int time ) const;
+	// takes the changed paths and the mask of the folders to reload. the paths in the reloaded folders are skipped
+	void TakeChanges( std::vector<Change> &changes, unsigned int &folderMask );
+
+private:
+	std::multimap<unsigned int,Change> m_Changes; // the key is the hash of the path
+	std::map<int,int> m_FolderCounts; // number of changes per folder
+	unsigned int m_FolderMask;
+	unsigned int m_FirstTime, m_LastTime;
+	bool m_bPending;
+
+	void Touch( unsigned int time );
+};
@@ -0,0 +1,93 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include "stdafx.h"
+#include "ChangeWatcher.h"
+#include "ResourceHelper.h"
+
+const int WATCHER_BUFFER_SIZE=16384; // in DWORDs
+
+CDirectoryWatcher::CDirectoryWatcher( void )
+{
+	m_Dir=INVALID_HANDLE_VALUE;
+	memset(&m_Overlapped,0,sizeof(m_Overlapped));
+	m_bSubtree=false;
+}
+
+bool CDirectoryWatcher::Start( const wchar_t *path, bool bSubtree )
+{
+	Stop();
+	m_Dir=CreateFile(path,FILE_LIST_DIRECTORY,FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,NULL,OPEN_EXISTING,FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OVERLAPPED,NULL);
+	if (m_Dir==INVALID_HANDLE_VALUE)
+		return false;
+	m_Overlapped.hEvent=CreateEvent(NULL,TRUE,FALSE,NULL);
+	m_PATH=path;
+	if (m_PATH.IsEmpty() || m_PATH[m_PATH.GetLength()-1]!='\\')
+		m_PATH+=L"\\";
+	m_bSubtree=bSubtree;
+	m_Buffer.resize(WATCHER_BUFFER_SIZE);
+	if (!m_Overlapped.hEvent || !Listen())
+	{
+		Stop();
+		return false;
+	}
+	return true;
+}
+
+void CDirectoryWatcher::Stop( void )
+{
+	if (m_Dir!=INVALID_HANDLE_VALUE)
+	{
+		CancelIo(m_Dir);
+		if (m_Overlapped.hEvent)
+		{
+			DWORD size;
+			GetOverlappedResult(m_Dir,&m_Overlapped,&size,TRUE);
+		}
+		CloseHandle(m_Dir);
+		m_Dir=INVALID_HANDLE_VALUE;
+	}
+	if (m_Overlapped.hEvent)
+		CloseHandle(m_Overlapped.hEvent);
+	memset(&m_Overlapped,0,sizeof(m_Overlapped));
+}
+
+bool CDirectoryWatcher::Listen( void )
+{
+	ResetEvent(m_Overlapped.hEvent);
+	DWORD filter=FILE_NOTIFY_CHANGE_FILE_NAME|FILE_NOTIFY_CHANGE_DIR_NAME|FILE_NOTIFY_CHANGE_LAST_WRITE;
+	return ReadDirectoryChangesW(m_Dir,&m_Buffer[0],(DWORD)m_Buffer.size()*sizeof(DWORD),m_bSubtree,filter,NULL,&m_Overlapped,NULL)!=0;
+}
+
+bool CDirectoryWatcher::ReadChanges( CChangeCoalescer &changes, int folder )
+{
+	unsigned int time=GetTickCount();
+	DWORD size=0;
+	if (!GetOverlappedResult(m_Dir,&m_Overlapped,&size,FALSE))
+	{
+		if (GetLastError()==ERROR_IO_INCOMPLETE)
+			return true;
+		changes.AddFolder(folder,time);
+		return Listen();
+	}
+	if (size==0)
+	{
+		// the buffer overflowed and the changes are lost
+		changes.AddFolder(folder,time);
+		return Listen();
+	}
+
+	const BYTE *ptr=(const BYTE*)&m_Buffer[0];
+	while (1)
+	{
+		const FILE_NOTIFY_INFORMATION *pInfo=(const FILE_NOTIFY_INFORMATION*)ptr;
+		CString PATH=m_PATH+CString(pInfo->FileName,pInfo->FileNameLength/sizeof(wchar_t));
+		StringUpper(PATH);
+		bool bAdded=(pInfo->Action==FILE_ACTION_ADDED || pInfo->Action==FILE_ACTION_RENAMED_NEW_NAME);
+		changes.AddPath(PATH,folder,bAdded,time);
+		if (!pInfo->NextEntryOffset) break;
+		ptr+=pInfo->NextEntryOffset;
+	}
+	return Listen();
+}
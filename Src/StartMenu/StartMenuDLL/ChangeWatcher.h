@@ -0,0 +1,34 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include "ChangeCoalescer.h"
+#include <vector>
+
+// CDirectoryWatcher - reports the files that change in a folder and its subfolders
+class CDirectoryWatcher
+{
+public:
+	CDirectoryWatcher( void );
+	~CDirectoryWatcher( void ) { Stop(); }
+
+	bool Start( const wchar_t *path, bool bSubtree );
+	void Stop( void );
+	// signaled when there are changes to read
+	HANDLE GetEvent( void ) const { return m_Overlapped.hEvent; }
+	// the watched folder, ends with backslash
+	const wchar_t *GetPath( void ) const { return m_PATH; }
+	// adds the changes to the coalescer and starts listening again. returns false if the watcher can't continue
+	bool ReadChanges( CChangeCoalescer &changes, int folder );
+
+private:
+	HANDLE m_Dir;
+	OVERLAPPED m_Overlapped;
+	CString m_PATH; // ends with backslash
+	bool m_bSubtree;
+	std::vector<DWORD> m_Buffer; // DWORD-aligned for FILE_NOTIFY_INFORMATION
+
+	bool Listen( void );
+};
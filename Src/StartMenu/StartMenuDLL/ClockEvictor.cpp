@@ -0,0 +1,46 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include "stdafx.h"
+#include "ClockEvictor.h"
+
+int CClockEvictor::GetBudget( int kilobytes )
+{
+	if (kilobytes<0) kilobytes=0;
+	if (kilobytes>0x1FFFFF) kilobytes=0x1FFFFF; // the budget in bytes must fit in an int
+	return kilobytes*1024;
+}
+
+int CClockEvictor::Select( std::vector<Entry> &entries, std::vector<int> &refCounts, int totalSize, int budget, std::vector<int> &victims )
+{
+	int count=(int)entries.size();
+	if (totalSize<=budget || count==0)
+		return totalSize;
+
+	// continue after the last visited key
+	int start=0;
+	while (start<count && entries[start].key<=m_Hand)
+		start++;
+	if (start==count)
+		start=0;
+
+	// make up to two turns. the first one may only clear the reference bits
+	for (int i=0;i<count*2 && totalSize>budget;i++)
+	{
+		Entry &entry=entries[(start+i)%count];
+		m_Hand=entry.key;
+		if (entry.bPinned)
+			continue;
+		if (entry.bUsed)
+		{
+			entry.bUsed=false;
+			continue;
+		}
+		victims.push_back((start+i)%count);
+		if (entry.storage<0 || --refCounts[entry.storage]==0)
+			totalSize-=entry.size;
+		entry.bPinned=true; // so the second turn doesn't select it again
+	}
+	return totalSize;
+}
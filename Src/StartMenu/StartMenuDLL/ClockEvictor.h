@@ -0,0 +1,37 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include <vector>
+
+// ClockEvictor.h - chooses the cached icons to remove when the icon cache is over its memory budget
+
+// CClockEvictor - selects cache entries to evict until the cache fits in a memory budget, using the CLOCK algorithm
+// Every entry has a reference bit that is set when the entry is used. The hand clears the bit of used entries and evicts the unused ones
+// The evictor doesn't depend on the OS. The caller provides the entries in a stable order, sorted by key
+class CClockEvictor
+{
+public:
+	struct Entry
+	{
+		unsigned int key; // the entries must be sorted by key
+		int size; // in bytes
+		int storage; // index in the reference counts of the storage shared with other entries. -1 - the entry owns its storage
+		bool bUsed; // reference bit. cleared by Select when the hand passes over the entry
+		bool bPinned; // the entry can't be evicted
+	};
+
+	CClockEvictor( void ) { m_Hand=0; }
+
+	// Converts the cache size in KB to a budget in bytes. Negative sizes are 0, and the budget is clamped so it fits in an int
+	static int GetBudget( int kilobytes );
+
+	// Adds the indices of the entries to evict to victims. Returns the remaining total size
+	// refCounts - the number of references to each shared storage. the size of a shared storage is freed only when its last reference is evicted
+	int Select( std::vector<Entry> &entries, std::vector<int> &refCounts, int totalSize, int budget, std::vector<int> &victims );
+
+private:
+	unsigned int m_Hand; // the key of the last visited entry
+};
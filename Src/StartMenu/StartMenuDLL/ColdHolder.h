@@ -0,0 +1,33 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+// ColdHolder.h - owns the rarely used part of a structure, which is allocated only when one of its fields is set
+// Copying the holder copies the data. T must have a default constructor, a copy constructor and bool IsEmpty() const.
+// The holder doesn't depend on the OS and doesn't do any locking
+
+template<class T> class CColdHolder
+{
+public:
+	CColdHolder( void ) { m_pData=NULL; }
+	CColdHolder( const CColdHolder &holder ) { m_pData=holder.m_pData?new T(*holder.m_pData):NULL; }
+	~CColdHolder( void ) { delete m_pData; }
+	CColdHolder &operator=( const CColdHolder &holder )
+	{
+		if (this==&holder) return *this;
+		T *pData=holder.m_pData?new T(*holder.m_pData):NULL;
+		delete m_pData;
+		m_pData=pData;
+		return *this;
+	}
+
+	const T *Get( void ) const { return m_pData; }
+	T &Alloc( void ) { if (!m_pData) m_pData=new T(); return *m_pData; }
+	// releases the data if all fields are empty
+	void Compact( void ) { if (m_pData && m_pData->IsEmpty()) { delete m_pData; m_pData=NULL; } }
+
+private:
+	T *m_pData;
+};
@@ -213,7 +213,10 @@ CComPtr<IDataObject> CMenuContainer::CreateMetroDataObject( const CItemManager::
 			g_ItemManager.UpdateItemInfo(pInfo,CItemManager::INFO_EXTRA_LARGE_ICON|CItemManager::INFO_REFRESH_NOW,false);
 			int iconSize=CItemManager::EXTRA_LARGE_ICON_SIZE;
 			SHDRAGIMAGE di={{iconSize,iconSize},{iconSize/2,iconSize},NULL,CLR_NONE};
-			di.hbmpDragImage=(HBITMAP)CopyImage(pInfo->extraLargeIcon->bitmap,IMAGE_BITMAP,0,0,0);
+			{
+				CItemManager::RWLock lock(&g_ItemManager,false,CItemManager::RWLOCK_ICONS);
+				di.hbmpDragImage=(HBITMAP)CreateIconBitmapCopy(pInfo->extraLargeIcon->bitmap);
+			}
 			m_pDragSourceHelper->SetFlags(DSH_ALLOWDROPDESCRIPTIONTEXT);
 			if (di.hbmpDragImage)
 				m_pDragSourceHelper->InitializeFromBitmap(&di,pDataObject);
@@ -295,7 +298,10 @@ bool CMenuContainer::DragOut( int index, bool bApp )
 			g_ItemManager.UpdateItemInfo(item.pItemInfo,CItemManager::INFO_EXTRA_LARGE_ICON|CItemManager::INFO_REFRESH_NOW,false);
 			int iconSize=CItemManager::EXTRA_LARGE_ICON_SIZE;
 			SHDRAGIMAGE di={{iconSize,iconSize},{iconSize/2,iconSize},NULL,CLR_NONE};
-			di.hbmpDragImage=(HBITMAP)CopyImage(item.pItemInfo->extraLargeIcon->bitmap,IMAGE_BITMAP,0,0,0);
+			{
+				CItemManager::RWLock lock(&g_ItemManager,false,CItemManager::RWLOCK_ICONS);
+				di.hbmpDragImage=(HBITMAP)CreateIconBitmapCopy(item.pItemInfo->extraLargeIcon->bitmap);
+			}
 			m_pDragSourceHelper->SetFlags(DSH_ALLOWDROPDESCRIPTIONTEXT);
 			if (di.hbmpDragImage)
 				m_pDragSourceHelper->InitializeFromBitmap(&di,pDataObj);
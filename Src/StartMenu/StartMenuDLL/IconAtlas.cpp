@@ -0,0 +1,189 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include "stdafx.h"
+#include "IconAtlas.h"
+
+const int ATLAS_PAGE_SIZE=512; // 1MB per page. fits 1024 16x16 icons or 64 64x64 icons
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CIconAtlas::Init( int iconSize )
+{
+	Clear();
+	m_PageSize=ATLAS_PAGE_SIZE;
+	if (m_PageSize<iconSize)
+		m_PageSize=iconSize;
+}
+
+void CIconAtlas::Clear( void )
+{
+	for (std::list<Page>::iterator it=m_Pages.begin();it!=m_Pages.end();++it)
+	{
+		if (it->bitmap)
+			DeleteObject(it->bitmap);
+	}
+	m_Pages.clear();
+	m_Table.DeleteAll<IconBitmap>();
+}
+
+CIconAtlas::IconBitmap *CIconAtlas::Alloc( int width, int height )
+{
+	AtlasRect rc;
+	Page *pPage=NULL;
+	for (std::list<Page>::iterator it=m_Pages.begin();it!=m_Pages.end();++it)
+	{
+		if (it->allocator.Alloc(width,height,rc))
+		{
+			pPage=&*it;
+			break;
+		}
+	}
+	if (!pPage)
+	{
+		// start a new page
+		Page page;
+		page.width=max(m_PageSize,width);
+		page.height=max(m_PageSize,height);
+		BITMAPINFO bi={0};
+		bi.bmiHeader.biSize=sizeof(BITMAPINFOHEADER);
+		bi.bmiHeader.biWidth=page.width;
+		bi.bmiHeader.biHeight=-page.height;
+		bi.bmiHeader.biPlanes=1;
+		bi.bmiHeader.biBitCount=32;
+		HDC hdc=CreateCompatibleDC(NULL);
+		page.bitmap=CreateDIBSection(hdc,&bi,DIB_RGB_COLORS,(void**)&page.bits,NULL,0);
+		DeleteDC(hdc);
+		if (!page.bitmap)
+			return NULL;
+		page.allocator.Init(page.width,page.height);
+		m_Pages.push_back(page);
+		pPage=&m_Pages.back();
+		if (!pPage->allocator.Alloc(width,height,rc))
+			return NULL;
+	}
+
+	IconBitmap *pBitmap=new IconBitmap;
+	pBitmap->page=pPage->bitmap;
+	pBitmap->bits=pPage->bits+rc.y*pPage->width+rc.x;
+	pBitmap->stride=pPage->width;
+	pBitmap->rc=rc;
+	pBitmap->pAtlas=this;
+	pBitmap->pPage=pPage;
+	return pBitmap;
+}
+
+const CIconAtlas::IconBitmap *CIconAtlas::AddBits( const unsigned int *bits, int width, int height, bool bBottomUp )
+{
+	unsigned int hash=CalcPixelHash(bits,width,height,width,bBottomUp);
+
+	// look for a bitmap with the same pixels
+	GdiFlush();
+	const CBitmapTable::Bitmap *pFound=m_Table.Find(hash,bits,width,height,bBottomUp);
+	if (pFound)
+		return static_cast<const IconBitmap*>(pFound);
+
+	IconBitmap *pBitmap=Alloc(width,height);
+	if (!pBitmap) return NULL;
+	for (int y=0;y<height;y++)
+	{
+		const unsigned int *src=bits+(bBottomUp?height-1-y:y)*width;
+		memcpy(pBitmap->bits+y*pBitmap->stride,src,width*4);
+	}
+	m_Table.Add(pBitmap,hash);
+	return pBitmap;
+}
+
+const CIconAtlas::IconBitmap *CIconAtlas::AddBitmap( HBITMAP bitmap )
+{
+	if (!bitmap) return NULL;
+	DIBSECTION dib;
+	if (GetObject(bitmap,sizeof(dib),&dib)==sizeof(dib) && dib.dsBm.bmBitsPixel==32 && dib.dsBm.bmBits)
+	{
+		// DIB section - copy the pixels directly
+		GdiFlush();
+		return AddBits((const unsigned int*)dib.dsBm.bmBits,dib.dsBm.bmWidth,dib.dsBm.bmHeight,dib.dsBmih.biHeight>0);
+	}
+
+	BITMAP info;
+	if (!GetObject(bitmap,sizeof(info),&info) || info.bmWidth<=0 || info.bmHeight<=0)
+		return NULL;
+	std::vector<unsigned int> bits(info.bmWidth*info.bmHeight);
+	BITMAPINFO bi={0};
+	bi.bmiHeader.biSize=sizeof(BITMAPINFOHEADER);
+	bi.bmiHeader.biWidth=info.bmWidth;
+	bi.bmiHeader.biHeight=-info.bmHeight;
+	bi.bmiHeader.biPlanes=1;
+	bi.bmiHeader.biBitCount=32;
+	HDC hdc=CreateCompatibleDC(NULL);
+	int lines=GetDIBits(hdc,bitmap,0,info.bmHeight,&bits[0],&bi,DIB_RGB_COLORS);
+	DeleteDC(hdc);
+	if (lines!=info.bmHeight)
+		return NULL;
+	return AddBits(&bits[0],info.bmWidth,info.bmHeight,false);
+}
+
+void CIconAtlas::AddRef( const IconBitmap *pBitmap )
+{
+	CBitmapTable::AddRef(pBitmap);
+}
+
+void CIconAtlas::Release( const IconBitmap *pBitmap )
+{
+	if (!pBitmap || !pBitmap->pAtlas->m_Table.Release(pBitmap))
+		return;
+	IconBitmap *pBitmap2=const_cast<IconBitmap*>(pBitmap);
+	pBitmap2->pPage->allocator.Free(pBitmap2->rc);
+	delete pBitmap2;
+}
+
+void CIconAtlas::ReleaseEmptyPages( void )
+{
+	for (std::list<Page>::iterator it=m_Pages.begin();it!=m_Pages.end();)
+	{
+		std::list<Page>::iterator next=it; ++next;
+		if (it->allocator.IsEmpty())
+		{
+			DeleteObject(it->bitmap);
+			m_Pages.erase(it);
+		}
+		it=next;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void DrawIconBitmap( HDC hdc, HDC hdcSrc, int x, int y, int width, int height, const IconBitmap *pBitmap )
+{
+	if (!pBitmap) return;
+	HGDIOBJ bmp0=SelectObject(hdcSrc,pBitmap->page);
+	if (bmp0)
+	{
+		BLENDFUNCTION func={AC_SRC_OVER,0,255,AC_SRC_ALPHA};
+		AlphaBlend(hdc,x,y,width,height,hdcSrc,pBitmap->rc.x,pBitmap->rc.y,pBitmap->rc.width,pBitmap->rc.height,func);
+		SelectObject(hdcSrc,bmp0);
+		// finish the blit while the caller holds the lock. a batched blit could read the page after another thread starts writing to it
+		GdiFlush();
+	}
+}
+
+HBITMAP CreateIconBitmapCopy( const IconBitmap *pBitmap )
+{
+	if (!pBitmap) return NULL;
+	BITMAPINFO bi={0};
+	bi.bmiHeader.biSize=sizeof(BITMAPINFOHEADER);
+	bi.bmiHeader.biWidth=pBitmap->rc.width;
+	bi.bmiHeader.biHeight=-pBitmap->rc.height;
+	bi.bmiHeader.biPlanes=1;
+	bi.bmiHeader.biBitCount=32;
+	HDC hdc=CreateCompatibleDC(NULL);
+	unsigned int *bits;
+	HBITMAP bmp=CreateDIBSection(hdc,&bi,DIB_RGB_COLORS,(void**)&bits,NULL,0);
+	DeleteDC(hdc);
+	if (!bmp) return NULL;
+	GdiFlush();
+	for (int y=0;y<pBitmap->rc.height;y++)
+		memcpy(bits+y*pBitmap->rc.width,pBitmap->bits+y*pBitmap->stride,pBitmap->rc.width*4);
+	return bmp;
+}
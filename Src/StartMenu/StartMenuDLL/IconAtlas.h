@@ -0,0 +1,82 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include <vector>
+#include <list>
+#include "BitmapTable.h"
+
+// IconAtlas.h - packs the cached icons into large shared bitmaps
+// Instead of one DIB section per icon, the icons of the same size type are stored as sub-rectangles of a few atlas pages.
+// This saves GDI handles and lets the menu draw all icons from the same source bitmap.
+// Icons with identical pixels share the same storage. The shared bitmaps are reference counted.
+
+///////////////////////////////////////////////////////////////////////////////
+
+// CIconAtlas - a list of atlas pages for icons of the same size type
+// The atlas must be modified with the RWLOCK_ICONS write lock. The const members and the pixels of the IconBitmap can be read with the read lock
+class CIconAtlas
+{
+public:
+	struct Page;
+
+	// location of an icon in the atlas. never changes after the icon is added
+	struct IconBitmap: public CBitmapTable::Bitmap
+	{
+		HBITMAP page; // the bitmap of the atlas page (32-bit top-down DIB section)
+
+	private:
+		CIconAtlas *pAtlas;
+		Page *pPage;
+
+		friend class CIconAtlas;
+	};
+
+	typedef CBitmapTable::Stats Stats;
+
+	CIconAtlas( void ) { m_PageSize=0; }
+	~CIconAtlas( void ) { Clear(); }
+
+	void Init( int iconSize );
+	void Clear( void );
+
+	// Adds a copy of the bitmap to the atlas, or returns an existing bitmap with the same pixels. The source bitmap is not deleted
+	const IconBitmap *AddBitmap( HBITMAP bitmap );
+	// Adds an icon from 32-bit pixels. If bBottomUp is true the first row is the bottom of the image
+	const IconBitmap *AddBits( const unsigned int *bits, int width, int height, bool bBottomUp );
+	// Adds a reference to a bitmap that is already in the atlas
+	static void AddRef( const IconBitmap *pBitmap );
+	// Releases a reference. The icon is removed from the atlas when the last reference is gone. The main thread must not be using the icon
+	static void Release( const IconBitmap *pBitmap );
+	// Returns the number of references to the bitmap
+	static int GetRefCount( const IconBitmap *pBitmap ) { return CBitmapTable::GetRefCount(pBitmap); }
+	// Deletes the pages that don't contain any icons
+	void ReleaseEmptyPages( void );
+
+	int GetPageCount( void ) const { return (int)m_Pages.size(); }
+	void GetStats( Stats &stats ) const { m_Table.GetStats(stats); }
+
+	struct Page
+	{
+		HBITMAP bitmap;
+		unsigned int *bits;
+		int width, height;
+		CAtlasAllocator allocator;
+	};
+
+private:
+	int m_PageSize;
+	std::list<Page> m_Pages;
+	CBitmapTable m_Table; // the bitmaps by the hash of their pixels
+
+	IconBitmap *Alloc( int width, int height );
+};
+
+typedef CIconAtlas::IconBitmap IconBitmap;
+
+// Draws the icon with per-pixel alpha. Requires the RWLOCK_ICONS read lock, because the background threads write to the same page
+void DrawIconBitmap( HDC hdc, HDC hdcSrc, int x, int y, int width, int height, const IconBitmap *pBitmap );
+// Creates a standalone 32-bit DIB section with a copy of the icon. The caller is responsible for deleting it. Requires the RWLOCK_ICONS read lock
+HBITMAP CreateIconBitmapCopy( const IconBitmap *pBitmap );
@@ -4,12 +4,15 @@
 
 #include "stdafx.h"
 #include "ItemManager.h"
+#include "ModuleValidator.h"
+#include "ChangeWatcher.h"
 #include "MetroLinkManager.h"
 #include "FNVHash.h"
 #include "Settings.h"
 #include "SettingsUI.h"
 #include "Translations.h"
 #include "ResourceHelper.h"
+#include "PixelOps.h"
 #include "MenuContainer.h"
 #include "LogManager.h"
 #include "StartMenuDLL.h"
@@ -35,7 +38,8 @@ static bool g_bInvertMetroIcons;
 
 const int MAX_FOLDER_LEVELS=10; // don't go more than 10 levels deep
 const int REFRESH_DELAY=5000;
-const int CACHE_FILE_VERSION=2;
+const int POWER_CHECK_DELAY=10000; // how often the extra refresh threads check if the computer is back on AC power
+const int CACHE_FILE_VERSION=3;
 
 PROPERTYKEY PKEY_MetroIcon={{0x86D40B4D, 0x9069, 0x443C, {0x81, 0x9A, 0x2A, 0x54, 0x09, 0x0D, 0xCC, 0xEC}}, 2};
 
@@ -134,60 +138,12 @@ static void CreateAppResolver( void )
 	}
 }
 
-static bool DetectGrayscaleImage( const unsigned int *bits, int stride, int width, int height )
+HBITMAP ColorizeMonochromeImage(const IconBitmap *bitmap, DWORD color)
 {
-	if (width==0 || height==0)
-		return false;
-	int transparent=0;
-	for (int y=0;y<height;y++,bits+=stride)
-	{
-		for (int x=0;x<width;x++)
-		{
-			unsigned int pixel=bits[x];
-			int a=(pixel>>24)&255;
-			int r=(pixel>>16)&255;
-			int g=(pixel>>8)&255;
-			int b=(pixel)&255;
-			if (abs(a-r)>2 || abs(r-g)>2 || abs(r-b)>2 || abs(g-b)>2)
-				return false; // found colored pixel
-			if (!(pixel&0xFF000000))
-				transparent++;
-		}
-	}
-	if ((transparent*100)/(width*height)<5)
-		return false; // less than 5% transparent pixels
-	return true;
-}
-
-static void CreateMonochromeImage( unsigned int *bits, int stride, int width, int height, DWORD metroColor )
-{
-	int r0=(metroColor)&255;
-	int g0=(metroColor>>8)&255;
-	int b0=(metroColor>>16)&255;
-	for (int y=0;y<height;y++,bits+=stride)
-	{
-		for (int x=0;x<width;x++)
-		{
-			unsigned int &pixel=bits[x];
-			int a=pixel>>24;
-			int r=(r0*a)/255;
-			int g=(g0*a)/255;
-			int b=(b0*a)/255;
-			pixel=(a<<24)|(r<<16)|(g<<8)|b;
-		}
-	}
-}
-
-HBITMAP ColorizeMonochromeImage(HBITMAP bitmap, DWORD color)
-{
-	{
-		BITMAP info{};
-		GetObject(bitmap, sizeof(info), &info);
-		if (!DetectGrayscaleImage((const unsigned int*)info.bmBits, info.bmWidth, info.bmWidth, info.bmHeight))
-			return nullptr;
-	}
+	if (!bitmap || !DetectGrayscaleImage(bitmap->bits, bitmap->stride, bitmap->rc.width, bitmap->rc.height))
+		return nullptr;
 
-	HBITMAP bmp = (HBITMAP)CopyImage(bitmap, IMAGE_BITMAP, 0, 0, LR_CREATEDIBSECTION);
+	HBITMAP bmp = CreateIconBitmapCopy(bitmap);
 	if (bmp)
 	{
 		BITMAP info{};
@@ -252,9 +208,7 @@ static HBITMAP BitmapFromMetroIcon( HICON hIcon, int bitmapSize, int iconSize, D
 		FillRect(hdc,&rc,(HBRUSH)GetStockObject(DC_BRUSH));
 		DrawIconEx(hdc,offset,offset,hIcon,iconSize,iconSize,0,NULL,DI_NORMAL);
 		SelectObject(hdc,bmp0);
-		int n=bitmapSize*bitmapSize;
-		for (int i=0;i<n;i++)
-			bits[i]|=0xFF000000;
+		SetOpaquePixels(bits,bitmapSize*bitmapSize);
 	}
 	DeleteDC(hdc);
 
@@ -300,9 +254,7 @@ static HBITMAP BitmapFromMetroBitmap( HBITMAP hBitmap, int bitmapSize, DWORD met
 			AlphaBlend(hdc,offset,offset,info.bmWidth,info.bmHeight,hsrc,0,0,info.bmWidth,info.bmHeight,func);
 			SelectObject(hdc,bmp0);
 
-			int n=bitmapSize*bitmapSize;
-			for (int i=0;i<n;i++)
-				bits[i]|=0xFF000000;
+			SetOpaquePixels(bits,bitmapSize*bitmapSize);
 		}
 		else
 		{
@@ -511,6 +463,7 @@ int CItemManager::LARGE_ICON_SIZE;
 int CItemManager::EXTRA_LARGE_ICON_SIZE=64;
 int CItemManager::s_DPI;
 int CItemManager::s_DPIOverride;
+const CItemManager::ItemInfoCold CItemManager::s_EmptyColdInfo;
 
 CItemManager g_ItemManager;
 
@@ -520,13 +473,22 @@ CItemManager::CItemManager( void )
 
 	memset(m_CriticalSections,0,sizeof(m_CriticalSections));
 	memset(m_CriticalSectionOwners,0,sizeof(m_CriticalSectionOwners));
-	m_StartEvent=m_WorkEvent=m_ExitEvent=m_DoneEvent=m_PreloadItemsThread=m_RefreshInfoThread=m_SaveCacheThread=NULL;
-	m_MainThreadId=m_PreloadItemsThreadId=m_RefreshInfoThreadId=0;
+	m_StartEvent=m_WorkEvent=m_ExitEvent=m_DoneEvent=m_PreloadItemsThread=m_SaveCacheThread=NULL;
+	m_MainThreadId=m_PreloadItemsThreadId=0;
+	memset(m_RefreshInfoThreads,0,sizeof(m_RefreshInfoThreads));
+	memset(m_RefreshInfoThreadIds,0,sizeof(m_RefreshInfoThreadIds));
+	m_RefreshInfoThreadCount=0;
 	m_DefaultSmallIcon=m_DefaultLargeIcon=m_DefaultExtraLargeIcon=NULL;
 	m_bHasNewPrograms[0]=m_bHasNewPrograms[1]=m_bHasNewApps[0]=m_bHasNewApps[1]=m_bPreloadIcons=m_bPreloadFavorites=false;
 	m_LoadingStage=LOAD_STOPPED;
 	m_LastCacheSave=0;
+	m_bAccessHistoryDirty=false;
 	m_TransientHash=1;
+	m_IconCacheBudget=0;
+	m_EvictedIconCount=m_ReloadedIconCount=0;
+	m_Counters.Clear();
+	m_LoadCacheTime=m_SaveCacheTime=-1;
+	m_RefreshingCount=0;
 }
 
 CItemManager::~CItemManager( void )
@@ -557,6 +519,8 @@ void CItemManager::Init( void )
 	g_bInvertMetroIcons=GetSettingBool(L"InvertMetroIcons");
 	m_bOldInvertIcons=g_bInvertMetroIcons;
 	m_LoadIconData[0].Init();
+	for (int i=0;i<ICON_SIZE_COUNT;i++)
+		m_IconAtlas[i].Init(GetIconSize((TIconSizeType)i));
 
 	bool bRTL=IsLanguageRTL();
 
@@ -605,6 +569,16 @@ void CItemManager::Init( void )
 	m_RootMetro=text;
 	StringUpper(m_RootMetro);
 
+	// the order matters if some roots are inside others
+	m_LocationTrie.Clear();
+	m_LocationTrie.Add(m_RootStartMenu1,LOCATION_START_MENU);
+	m_LocationTrie.Add(m_RootStartMenu2,LOCATION_START_MENU);
+	m_LocationTrie.Add(m_RootStartMenu3,LOCATION_START_MENU);
+	m_LocationTrie.Add(m_RootGames,LOCATION_GAMES);
+	m_LocationTrie.Add(m_RootDesktop,LOCATION_DESKTOP);
+	m_LocationTrie.Add(m_RootTaskbar,LOCATION_TASKBAR);
+	m_LocationTrie.Add(m_RootMetro,LOCATION_METRO);
+
 	for (int i=0;i<=SHIL_LAST;i++)
 	{
 		CComPtr<IImageList> pList;
@@ -618,7 +592,11 @@ void CItemManager::Init( void )
 	std::sort(m_ListSizes.begin(),m_ListSizes.end());
 
 	CreateDefaultIcons();
-	LoadCacheFile();
+	{
+		int time0=GetTickCount();
+		LoadCacheFile();
+		m_LoadCacheTime=GetTickCount()-time0;
+	}
 
 	ItemInfo &item=m_ItemInfos.emplace(0,ItemInfo())->second;
 	item.bIconOnly=true;
@@ -631,7 +609,9 @@ void CItemManager::Init( void )
 	for (int i=0;i<LOCK_COUNT;i++)
 		InitializeCriticalSection(&m_CriticalSections[i]);
 	m_bPreloadIcons=GetSettingBool(L"PreCacheIcons");
+	m_IconCacheBudget=CClockEvictor::GetBudget(GetSettingInt(L"IconCacheSize"));
 	m_bPreloadFavorites=(GetSettingInt(L"Favorites")==2);
+	LoadAccessHistory();
 
 	m_LoadingStage=LOAD_LOADING;
 	m_StartEvent=CreateEvent(NULL,TRUE,FALSE,NULL);
@@ -639,8 +619,26 @@ void CItemManager::Init( void )
 	m_ExitEvent=CreateEvent(NULL,TRUE,FALSE,NULL);
 	m_DoneEvent=CreateEvent(NULL,TRUE,FALSE,NULL);
 
-	m_PreloadItemsThread=CreateThread(NULL,0,StaticPreloadItemsThread,this,0,&m_PreloadItemsThreadId);
-	m_RefreshInfoThread=CreateThread(NULL,0,StaticRefreshInfoThread,this,0,&m_RefreshInfoThreadId);
+	{
+		// use one refresh thread for every two cores. all threads are created suspended and start only after all thread ids are known,
+		// because GetRefreshThreadIndex (used by the counters and by the icon loading) reads them from any of the threads
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		int count=info.dwNumberOfProcessors/2;
+		if (count<1) count=1;
+		if (count>MAX_REFRESH_THREADS) count=MAX_REFRESH_THREADS;
+		m_PreloadItemsThread=CreateThread(NULL,0,StaticPreloadItemsThread,this,CREATE_SUSPENDED,&m_PreloadItemsThreadId);
+		for (int i=0;i<count;i++)
+			m_RefreshInfoThreads[i]=CreateThread(NULL,0,StaticRefreshInfoThread,this,CREATE_SUSPENDED,&m_RefreshInfoThreadIds[i]);
+		m_RefreshInfoThreadCount=count;
+		if (m_PreloadItemsThread)
+			ResumeThread(m_PreloadItemsThread);
+		for (int i=0;i<m_RefreshInfoThreadCount;i++)
+		{
+			if (m_RefreshInfoThreads[i])
+				ResumeThread(m_RefreshInfoThreads[i]);
+		}
+	}
 
 	LoadOldItems();
 
@@ -659,12 +657,17 @@ void CItemManager::Close( void )
 		CloseHandle(m_PreloadItemsThread);
 		m_PreloadItemsThread=NULL;
 	}
-	if (m_RefreshInfoThread)
+	for (int i=0;i<m_RefreshInfoThreadCount;i++)
 	{
-		WaitForSingleObject(m_RefreshInfoThread,INFINITE);
-		CloseHandle(m_RefreshInfoThread);
-		m_RefreshInfoThread=NULL;
+		if (m_RefreshInfoThreads[i])
+		{
+			WaitForSingleObject(m_RefreshInfoThreads[i],INFINITE);
+			CloseHandle(m_RefreshInfoThreads[i]);
+			m_RefreshInfoThreads[i]=NULL;
+		}
+		m_RefreshInfoThreadIds[i]=0;
 	}
+	m_RefreshInfoThreadCount=0;
 	if (m_SaveCacheThread)
 	{
 		WaitForSingleObject(m_SaveCacheThread,INFINITE);
@@ -673,11 +676,7 @@ void CItemManager::Close( void )
 	}
 	m_LoadingStage=LOAD_STOPPED;
 
-	for (std::multimap<unsigned int,IconInfo>::const_iterator it=m_IconInfos.begin();it!=m_IconInfos.end();++it)
-	{
-		if (it->second.bitmap)
-			DeleteObject(it->second.bitmap);
-	}
+	ClearIcons();
 
 	for (int i=0;i<LOCK_COUNT;i++)
 		DeleteCriticalSection(&m_CriticalSections[i]);
@@ -700,41 +699,144 @@ void CItemManager::CreateDefaultIcons( void )
 		index=-1;
 	IconInfo icon;
 	icon.bTemp=false;
+	icon.bUsed=false;
 	icon.bMetro=false;
 	icon.timestamp.dwLowDateTime=icon.timestamp.dwHighDateTime=0;
 	icon.sizeType=ICON_SIZE_TYPE_SMALL;
 	if (index>=0)
-		icon.bitmap=BitmapFromIcon(LoadShellIcon(index,SMALL_ICON_SIZE),SMALL_ICON_SIZE);
+		icon.bitmap=AddToAtlas(ICON_SIZE_TYPE_SMALL,BitmapFromIcon(LoadShellIcon(index,SMALL_ICON_SIZE),SMALL_ICON_SIZE));
 	else
 		icon.bitmap=NULL;
 	m_DefaultSmallIcon=&m_IconInfos.emplace(0,icon)->second;
 
 	icon.sizeType=ICON_SIZE_TYPE_LARGE;
 	if (index>=0)
-		icon.bitmap=BitmapFromIcon(LoadShellIcon(index,LARGE_ICON_SIZE),LARGE_ICON_SIZE);
+		icon.bitmap=AddToAtlas(ICON_SIZE_TYPE_LARGE,BitmapFromIcon(LoadShellIcon(index,LARGE_ICON_SIZE),LARGE_ICON_SIZE));
 	else
 		icon.bitmap=NULL;
 	m_DefaultLargeIcon=&m_IconInfos.emplace(0,icon)->second;
 
 	icon.sizeType=ICON_SIZE_TYPE_EXTRA_LARGE;
 	if (index>=0)
-		icon.bitmap=BitmapFromIcon(LoadShellIcon(index,EXTRA_LARGE_ICON_SIZE),EXTRA_LARGE_ICON_SIZE);
+		icon.bitmap=AddToAtlas(ICON_SIZE_TYPE_EXTRA_LARGE,BitmapFromIcon(LoadShellIcon(index,EXTRA_LARGE_ICON_SIZE),EXTRA_LARGE_ICON_SIZE));
 	else
 		icon.bitmap=NULL;
 	m_DefaultExtraLargeIcon=&m_IconInfos.emplace(0,icon)->second;
 }
 
+// requires the RWLOCK_ICONS write lock, or the refresh threads must be stopped
+const IconBitmap *CItemManager::AddToAtlas( TIconSizeType sizeType, HBITMAP bitmap )
+{
+	if (!bitmap) return NULL;
+	const IconBitmap *pBitmap=m_IconAtlas[sizeType].AddBitmap(bitmap);
+	DeleteObject(bitmap);
+	return pBitmap;
+}
+
+// deletes all icons and their storage. all threads must be stopped or the locks must be held
+void CItemManager::ClearIcons( void )
+{
+	for (std::multimap<unsigned int,IconInfo>::const_iterator it=m_IconInfos.begin();it!=m_IconInfos.end();++it)
+		CIconAtlas::Release(it->second.bitmap);
+	m_IconInfos.clear();
+	for (std::vector<const IconBitmap*>::const_iterator it=m_OldBitmaps.begin();it!=m_OldBitmaps.end();++it)
+		CIconAtlas::Release(*it);
+	m_OldBitmaps.clear();
+	m_EvictedIcons.clear();
+	for (int i=0;i<ICON_SIZE_COUNT;i++)
+		m_IconAtlas[i].ReleaseEmptyPages();
+}
+
+int CItemManager::GetRefreshThreadIndex( DWORD thread ) const
+{
+	for (int i=0;i<m_RefreshInfoThreadCount;i++)
+	{
+		if (m_RefreshInfoThreadIds[i]==thread)
+			return i;
+	}
+	return -1;
+}
+
 CItemManager::LoadIconData &CItemManager::GetLoadIconData( void )
 {
 	DWORD thread=GetCurrentThreadId();
-	if (thread==m_RefreshInfoThreadId)
-		return m_LoadIconData[2];
+	int index=GetRefreshThreadIndex(thread);
+	if (index>=0)
+		return m_LoadIconData[2+index];
 	if (thread==m_PreloadItemsThreadId)
 		return m_LoadIconData[1];
 	Assert(thread==m_MainThreadId);
 	return m_LoadIconData[0];
 }
 
+void CItemManager::AddCounter( TCounter counter, int count )
+{
+	DWORD thread=GetCurrentThreadId();
+	int slot=GetRefreshThreadIndex(thread);
+	if (slot>=0)
+		slot+=2;
+	else if (thread==m_PreloadItemsThreadId)
+		slot=1;
+	else if (thread==m_MainThreadId)
+		slot=0;
+	m_Counters.Add(slot,counter,count);
+}
+
+void CItemManager::GetCacheStats( CacheStats &stats )
+{
+	Assert(GetCurrentThreadId()==m_MainThreadId);
+	memset(&stats,0,sizeof(stats));
+	int counters[COUNTER_COUNT];
+	m_Counters.Sum(counters);
+	stats.itemLookups=counters[COUNTER_ITEM_LOOKUPS];
+	stats.itemHits=counters[COUNTER_ITEM_HITS];
+	stats.itemRefreshes=counters[COUNTER_ITEM_REFRESHES];
+	stats.iconLookups=counters[COUNTER_ICON_LOOKUPS];
+	stats.iconHits=counters[COUNTER_ICON_HITS];
+	stats.loadCacheTime=m_LoadCacheTime;
+	stats.saveCacheTime=m_SaveCacheTime;
+
+	{
+		RWLock lock(this,false,RWLOCK_ITEMS);
+		stats.itemCount=(int)m_ItemInfos.size();
+		for (std::multimap<unsigned int,ItemInfo>::const_iterator it=m_ItemInfos.begin();it!=m_ItemInfos.end();++it)
+		{
+			if (it->second.refreshFlags&INFO_LINK_APPID)
+				stats.pendingAppIds++;
+		}
+		stats.queueVisible=m_ItemQueue.GetCount(PRIORITY_VISIBLE);
+		stats.queueNext=m_ItemQueue.GetCount(PRIORITY_NEXT);
+		stats.queuePreload=m_ItemQueue.GetCount(PRIORITY_PRELOAD);
+	}
+	{
+		RWLock lock(this,false,RWLOCK_ICONS);
+		stats.evictedIcons=m_EvictedIconCount;
+		stats.reloadedIcons=m_ReloadedIconCount;
+		for (std::multimap<unsigned int,IconInfo>::const_iterator it=m_IconInfos.begin();it!=m_IconInfos.end();++it)
+			stats.iconCounts[it->second.sizeType]++;
+		for (int i=0;i<ICON_SIZE_COUNT;i++)
+		{
+			CIconAtlas::Stats atlasStats;
+			m_IconAtlas[i].GetStats(atlasStats);
+			stats.iconBytes[i]=atlasStats.bytes;
+		}
+	}
+}
+
+void CItemManager::LogCacheStats( void )
+{
+	if (!(g_LogCategories&LOG_CACHE))
+		return;
+	CacheStats stats;
+	GetCacheStats(stats);
+	LOG_MENU(LOG_CACHE,L"Cache stats: items %d, lookups %d, hits %d, refreshes %d, pending appids %d",stats.itemCount,stats.itemLookups,stats.itemHits,stats.itemRefreshes,stats.pendingAppIds);
+	LOG_MENU(LOG_CACHE,L"Cache stats: queue %d/%d/%d (visible/next/preload)",stats.queueVisible,stats.queueNext,stats.queuePreload);
+	LOG_MENU(LOG_CACHE,L"Cache stats: icon lookups %d, hits %d, evicted %d, reloaded %d",stats.iconLookups,stats.iconHits,stats.evictedIcons,stats.reloadedIcons);
+	for (int i=0;i<ICON_SIZE_COUNT;i++)
+		LOG_MENU(LOG_CACHE,L"Cache stats: icon size type %d: %d icons, %d bytes",i,stats.iconCounts[i],stats.iconBytes[i]);
+	LOG_MENU(LOG_CACHE,L"Cache stats: load time %d ms, save time %d ms",stats.loadCacheTime,stats.saveCacheTime);
+}
+
 void CItemManager::ResetTempIcons( void )
 {
 	Assert(GetCurrentThreadId()==m_MainThreadId);
@@ -756,7 +858,7 @@ void CItemManager::ResetTempIcons( void )
 		for (std::map<unsigned int,const ItemInfo*>::iterator it=m_MetroItemInfos10.begin();it!=m_MetroItemInfos10.end();)
 		{
 			std::map<unsigned int,const ItemInfo*>::iterator next=it; ++next;
-			if (it->second && !it->second->packagePath.IsEmpty())
+			if (it->second && !it->second->GetCold().packagePath.IsEmpty())
 			{
 				const_cast<ItemInfo*>(it->second)->validFlags&=~(INFO_ICON|INFO_METRO);
 				m_MetroItemInfos10.erase(it);
@@ -766,17 +868,17 @@ void CItemManager::ResetTempIcons( void )
 	}
 	{
 		// remove temp items from the queue
-		std::list<ItemInfo*>::iterator it=m_ItemQueue.begin();
-		while (it!=m_ItemQueue.end())
 		{
-			std::list<ItemInfo*>::iterator next=it; ++next;
-			if ((*it)->bTemp)
-			{
-				Assert(!(*it)->largeIcon && !(*it)->extraLargeIcon && ((*it)->smallIcon==m_DefaultSmallIcon || (*it)->smallIcon->bTemp));
-				m_ItemQueue.erase(it);
-			}
-			it=next;
+			Lock boostLock(this,LOCK_BOOST);
+			m_BoostedItems.clear();
 		}
+		const IconInfo *defaultSmallIcon=m_DefaultSmallIcon;
+		m_ItemQueue.RemoveIf([defaultSmallIcon]( const ItemInfo *pInfo )
+		{
+			if (!pInfo->bTemp) return false;
+			Assert(!pInfo->largeIcon && !pInfo->extraLargeIcon && (pInfo->smallIcon==defaultSmallIcon || pInfo->smallIcon->bTemp));
+			return true;
+		});
 	}
 
 	int metroFlags=bResetMetro?INFO_METRO:0;
@@ -821,8 +923,7 @@ void CItemManager::ResetTempIcons( void )
 			std::multimap<unsigned int,IconInfo>::iterator next=it; ++next;
 			if (it->second.bTemp || (it->second.bMetro && bResetMetro))
 			{
-				if (it->second.bitmap)
-					DeleteObject(it->second.bitmap);
+				CIconAtlas::Release(it->second.bitmap);
 				m_IconInfos.erase(it);
 			}
 			it=next;
@@ -831,11 +932,118 @@ void CItemManager::ResetTempIcons( void )
 
 	{
 		// delete old bitmaps
-		for (std::vector<HBITMAP>::iterator it=m_OldBitmaps.begin();it!=m_OldBitmaps.end();++it)
-			DeleteObject(*it);
+		for (std::vector<const IconBitmap*>::iterator it=m_OldBitmaps.begin();it!=m_OldBitmaps.end();++it)
+			CIconAtlas::Release(*it);
 		m_OldBitmaps.clear();
+		for (int i=0;i<ICON_SIZE_COUNT;i++)
+			m_IconAtlas[i].ReleaseEmptyPages();
+	}
+	if (m_StringPool.IsPurgeNeeded())
+	{
+		// the removed and refreshed items may have left strings that are not used any more. mark the ones that are still used and purge the rest
+		for (std::multimap<unsigned int,ItemInfo>::const_iterator it=m_ItemInfos.begin();it!=m_ItemInfos.end();++it)
+		{
+			const ItemInfo &info=it->second;
+			m_StringPool.Mark(info.PATH);
+			m_StringPool.Mark(info.path);
+			m_StringPool.Mark(info.appid);
+			m_StringPool.Mark(info.iconPath);
+			const ItemInfoCold *pCold=info.cold.Get();
+			if (pCold)
+			{
+				m_StringPool.Mark(pCold->targetPATH);
+				m_StringPool.Mark(pCold->metroName);
+				m_StringPool.Mark(pCold->packagePath);
+			}
+		}
+		for (std::multimap<unsigned int,IconInfo>::const_iterator it=m_IconInfos.begin();it!=m_IconInfos.end();++it)
+			m_StringPool.Mark(it->second.PATH);
+		m_StringPool.Purge();
 	}
 	m_TransientHash=1;
+
+	if (m_IconCacheBudget>0)
+		EvictIcons();
+}
+
+void CItemManager::EvictIcons( void )
+{
+	Assert(GetCurrentThreadId()==m_MainThreadId && ThreadHasLock(LOCK_CLEANUP) && RWLock::ThreadHasWriteLock(RWLOCK_ITEMS) && RWLock::ThreadHasWriteLock(RWLOCK_ICONS));
+	// the background threads may hold icons that are not stored in an item yet, and the save thread holds pointers to all icons
+	if (m_RefreshingCount>0)
+		return;
+	if (m_SaveCacheThread && WaitForSingleObject(m_SaveCacheThread,0)==WAIT_TIMEOUT)
+		return;
+
+	int totalSize=0;
+	for (int i=0;i<ICON_SIZE_COUNT;i++)
+	{
+		CIconAtlas::Stats stats;
+		m_IconAtlas[i].GetStats(stats);
+		totalSize+=stats.bytes;
+	}
+	if (totalSize<=m_IconCacheBudget)
+		return;
+
+	// icons used by items can't be evicted
+	std::set<const IconInfo*> usedIcons;
+	usedIcons.insert(m_DefaultSmallIcon);
+	usedIcons.insert(m_DefaultLargeIcon);
+	usedIcons.insert(m_DefaultExtraLargeIcon);
+	for (std::multimap<unsigned int,ItemInfo>::const_iterator it=m_ItemInfos.begin();it!=m_ItemInfos.end();++it)
+	{
+		usedIcons.insert(it->second.smallIcon);
+		usedIcons.insert(it->second.largeIcon);
+		usedIcons.insert(it->second.extraLargeIcon);
+	}
+
+	std::vector<CClockEvictor::Entry> entries;
+	std::vector<std::multimap<unsigned int,IconInfo>::iterator> iterators;
+	// the identical bitmaps are shared. a bitmap is freed only when all its references are gone
+	std::map<const IconBitmap*,int> storages;
+	std::vector<int> refCounts;
+	entries.reserve(m_IconInfos.size());
+	iterators.reserve(m_IconInfos.size());
+	for (std::multimap<unsigned int,IconInfo>::iterator it=m_IconInfos.begin();it!=m_IconInfos.end();++it)
+	{
+		CClockEvictor::Entry entry;
+		entry.key=it->first;
+		entry.size=0;
+		entry.storage=-1;
+		const IconBitmap *pBitmap=it->second.bitmap;
+		if (pBitmap)
+		{
+			entry.size=pBitmap->rc.width*pBitmap->rc.height*4;
+			std::map<const IconBitmap*,int>::iterator storage=storages.find(pBitmap);
+			if (storage==storages.end())
+			{
+				storage=storages.insert(std::pair<const IconBitmap*,int>(pBitmap,(int)refCounts.size())).first;
+				refCounts.push_back(CIconAtlas::GetRefCount(pBitmap));
+			}
+			entry.storage=storage->second;
+		}
+		entry.bUsed=it->second.bUsed;
+		entry.bPinned=(it->first==0 || usedIcons.find(&it->second)!=usedIcons.end());
+		entries.push_back(entry);
+		iterators.push_back(it);
+	}
+
+	std::vector<int> victims;
+	m_IconEvictor.Select(entries,refCounts,totalSize,m_IconCacheBudget,victims);
+	for (size_t i=0;i<entries.size();i++)
+		iterators[i]->second.bUsed=entries[i].bUsed;
+
+	// the bitmaps are released on the next reset, in case the main thread still has them
+	for (std::vector<int>::const_iterator it=victims.begin();it!=victims.end();++it)
+	{
+		std::multimap<unsigned int,IconInfo>::iterator victim=iterators[*it];
+		if (victim->second.bitmap)
+			m_OldBitmaps.push_back(victim->second.bitmap);
+		m_EvictedIcons.insert(victim->first);
+		m_IconInfos.erase(victim);
+	}
+	m_EvictedIconCount+=(int)victims.size();
+	LOG_MENU(LOG_CACHE,L"Icon cache: %d bytes, budget %d, evicted %d (total evicted %d, reloaded %d)",totalSize,m_IconCacheBudget,(int)victims.size(),m_EvictedIconCount,m_ReloadedIconCount);
 }
 
 static bool ComparePidls( PIDLIST_ABSOLUTE pidl1, PIDLIST_ABSOLUTE pidl2 )
@@ -897,12 +1105,15 @@ const CItemManager::ItemInfo *CItemManager::GetItemInfo( IShellItem *pItem, PIDL
 				break;
 			}
 		}
+		AddCounter(COUNTER_ITEM_LOOKUPS);
+		if (pInfo)
+			AddCounter(COUNTER_ITEM_HITS);
 		if (!pInfo)
 		{
 			pInfo=&m_ItemInfos.emplace(hash,ItemInfo())->second;
 			pInfo->pidl.Clone(pidl);
-			pInfo->path=path;
-			pInfo->PATH=PATH;
+			pInfo->path=m_StringPool.Intern(path);
+			pInfo->PATH=m_StringPool.Intern(PATH);
 			pInfo->createstamp=createTime;
 			pInfo->writestamp=writeTime;
 			pInfo->smallIcon=m_DefaultSmallIcon;
@@ -912,12 +1123,12 @@ const CItemManager::ItemInfo *CItemManager::GetItemInfo( IShellItem *pItem, PIDL
 		}
 		else
 		{
-			if (!pInfo->packagePath.IsEmpty())
-				MenuGetFileTimestamp(pInfo->packagePath,&writeTime,&createTime);
+			if (!pInfo->GetCold().packagePath.IsEmpty())
+				MenuGetFileTimestamp(pInfo->GetCold().packagePath,&writeTime,&createTime);
 			if (CompareFileTime(&pInfo->writestamp,&writeTime)!=0)
 			{
-				if (!PATH.IsEmpty() && !ComparePidls(pInfo->pidl,pidl) && !ComparePidls(pInfo->newPidl,pidl))
-					pInfo->newPidl.Clone(pidl);
+				if (!PATH.IsEmpty() && !ComparePidls(pInfo->pidl,pidl) && !ComparePidls(pInfo->GetCold().newPidl,pidl))
+					pInfo->SetCold().newPidl.Clone(pidl);
 				pInfo->writestamp=writeTime;
 				pInfo->validFlags=0;
 			}
@@ -979,14 +1190,17 @@ const CItemManager::ItemInfo *CItemManager::GetItemInfo( CString path, int refre
 				break;
 			}
 		}
+		AddCounter(COUNTER_ITEM_LOOKUPS);
+		if (pInfo)
+			AddCounter(COUNTER_ITEM_HITS);
 		if (!pInfo)
 		{
 			pInfo=&m_ItemInfos.emplace(hash,ItemInfo())->second;
 			if (!PATH.IsEmpty())
 				MenuParseDisplayName(path,&pInfo->pidl,NULL,NULL);
 			if (pInfo->pidl)
-				pInfo->path=path;
-			pInfo->PATH=PATH;
+				pInfo->path=m_StringPool.Intern(path);
+			pInfo->PATH=m_StringPool.Intern(PATH);
 			pInfo->createstamp=createTime;
 			pInfo->writestamp=writeTime;
 			pInfo->smallIcon=m_DefaultSmallIcon;
@@ -996,15 +1210,15 @@ const CItemManager::ItemInfo *CItemManager::GetItemInfo( CString path, int refre
 		}
 		else
 		{
-			if (!pInfo->packagePath.IsEmpty())
-				MenuGetFileTimestamp(pInfo->packagePath,&writeTime,&createTime);
+			if (!pInfo->GetCold().packagePath.IsEmpty())
+				MenuGetFileTimestamp(pInfo->GetCold().packagePath,&writeTime,&createTime);
 			if (CompareFileTime(&pInfo->writestamp,&writeTime)!=0)
 			{
 				CAbsolutePidl pidl;
 				if (!PATH.IsEmpty())
 					MenuParseDisplayName(PATH,&pidl,NULL,NULL);
-				if (!ComparePidls(pInfo->pidl,pidl) && !ComparePidls(pInfo->newPidl,pidl))
-					pInfo->newPidl.Swap(pidl);
+				if (!ComparePidls(pInfo->pidl,pidl) && !ComparePidls(pInfo->GetCold().newPidl,pidl))
+					pInfo->SetCold().newPidl.Swap(pidl);
 				pInfo->writestamp=writeTime;
 				pInfo->validFlags=0;
 			}
@@ -1082,7 +1296,7 @@ const CItemManager::ItemInfo *CItemManager::GetCustomIcon( const wchar_t *locati
 			pInfo=&m_ItemInfos.emplace(hash,ItemInfo())->second;
 			pInfo->bIconOnly=true;
 			pInfo->bTemp=bTemp;
-			pInfo->iconPath=location;
+			pInfo->iconPath=bTemp?CString(location):m_StringPool.Intern(location);
 			pInfo->iconIndex=index;
 			pInfo->smallIcon=m_DefaultSmallIcon;
 			pInfo->largeIcon=m_DefaultLargeIcon;
@@ -1237,23 +1451,44 @@ void CItemManager::QueueItemInfo( ItemInfo *pInfo, int refreshFlags )
 {
 	Assert(RWLock::ThreadHasWriteLock(RWLOCK_ITEMS));
 	DWORD thread=GetCurrentThreadId();
-	Assert(thread!=m_RefreshInfoThreadId);
+	Assert(GetRefreshThreadIndex(thread)<0);
 	pInfo->refreshFlags|=refreshFlags&~pInfo->validFlags&(INFO_DATA|INFO_ICON);
 	if (pInfo->refreshFlags)
 	{
-		std::list<ItemInfo*> &queue=(thread==m_PreloadItemsThreadId)?m_ItemQueueLow:m_ItemQueue;
-		for (std::list<ItemInfo*>::const_iterator it=queue.begin();it!=queue.end();++it)
-		{
-			if (*it==pInfo)
-				return;
-		}
-		queue.push_back(pInfo);
+		m_ItemQueue.Push(pInfo,(thread==m_PreloadItemsThreadId)?PRIORITY_PRELOAD:PRIORITY_NEXT);
 		SetEvent(m_WorkEvent);
 		if (thread!=m_PreloadItemsThreadId)
 			SetEvent(m_StartEvent);
 	}
 }
 
+void CItemManager::BoostItemInfo( const ItemInfo *pInfo, int refreshFlags )
+{
+	Assert(GetCurrentThreadId()==m_MainThreadId);
+	RecordItemAccess(pInfo,false);
+	if (!(pInfo->refreshFlags&refreshFlags)) // potentially out of lock, assuming refreshFlags is atomic
+		return;
+	// this is called while painting, so don't wait for the items lock. the refresh threads will do the boosting
+	{
+		Lock lock(this,LOCK_BOOST);
+		if (std::find(m_BoostedItems.begin(),m_BoostedItems.end(),pInfo)!=m_BoostedItems.end())
+			return;
+		m_BoostedItems.push_back(const_cast<ItemInfo*>(pInfo));
+	}
+	SetEvent(m_StartEvent);
+}
+
+void CItemManager::RecordItemAccess( const ItemInfo *pInfo, bool bExecuted )
+{
+	Assert(GetCurrentThreadId()==m_MainThreadId);
+	int weight=bExecuted?CAccessHistory::WEIGHT_EXECUTED:CAccessHistory::WEIGHT_SHOWN;
+	if (pInfo->accessWeight>=weight || pInfo->PATH.IsEmpty())
+		return;
+	const_cast<ItemInfo*>(pInfo)->accessWeight=weight;
+	m_AccessHistory.Record(CalcFNVHash(pInfo->PATH),weight);
+	m_bAccessHistoryDirty=true;
+}
+
 void CItemManager::WaitForShortcuts( const POINT &balloonPos )
 {
 	if (m_PreloadItemsThreadId)
@@ -1296,17 +1531,6 @@ bool CItemManager::IsTaskbarPinned( const wchar_t *appid )
 	return false;
 }
 
-void EncodeRot13( wchar_t *text )
-{
-	for (;*text;text++)
-	{
-		if (*text>='a' && *text<='z')
-			*text=(*text-'a'+13)%26+'a';
-		else if (*text>='A' && *text<='Z')
-			*text=(*text-'A'+13)%26+'A';
-	}
-}
-
 static KNOWNFOLDERID g_KnownPrefixes[]=
 {
 	FOLDERID_SystemX86,
@@ -1327,63 +1551,65 @@ void EncodeUserAssistPath( wchar_t *path )
 		CComString knownPath;
 		if (FAILED(SHGetKnownFolderPath(g_KnownPrefixes[i],0,NULL,&knownPath)))
 			continue;
-		int len=Strlen(knownPath);
-		if (_wcsnicmp(path,knownPath,len)==0)
-		{
-			CComString guid;
-			StringFromCLSID(g_KnownPrefixes[i],&guid);
-			wchar_t name[_MAX_PATH];
-			Sprintf(name,_countof(name),L"%s%s",(const wchar_t*)guid,path+len);
-			Strcpy(path,_MAX_PATH,name);
+		CComString guid;
+		StringFromCLSID(g_KnownPrefixes[i],&guid);
+		if (ReplaceKnownFolder(path,_MAX_PATH,knownPath,guid))
 			return;
-		}
 	}
 }
 
-bool CItemManager::IsPathUsed( CRegKey &regKey, const wchar_t *path, const FILETIME &createstamp, const KnownPathGuid *knownPaths, int knownPathsCount, bool bMetroApp )
+// Reads all values from the key. Returns false if the key can't be opened
+static bool LoadUserAssist( CUserAssistTable &table, HKEY root, const wchar_t *keyName )
 {
-	{
-		unsigned int hash=CalcFNVHash(path);
-		OldItemInfo key={hash};
-		std::vector<OldItemInfo>::const_iterator it=std::lower_bound(m_OldItemInfos.begin(),m_OldItemInfos.end(),key);
-		if (it!=m_OldItemInfos.end() && it->hash==hash)
-		{
-			if (CompareFileTime(&createstamp,&it->timestamp)<0)
-				return true;
-		}
+	CRegKey regKey;
+	if (regKey.Open(root,keyName,KEY_READ)!=ERROR_SUCCESS)
+		return false;
+	for (int idx=0;;idx++)
+	{
+		wchar_t name[_MAX_PATH];
+		DWORD len=_countof(name);
+		UserAssistData data;
+		memset(&data,0,sizeof(data));
+		DWORD size=sizeof(data);
+		DWORD type;
+		LONG res=RegEnumValue(regKey,idx,name,&len,NULL,&type,(BYTE*)&data,&size);
+		if (res==ERROR_NO_MORE_ITEMS)
+			break;
+		// skip the values that a query with a _MAX_PATH name and UserAssistData would not find
+		if (res!=ERROR_SUCCESS || type!=REG_BINARY || !*name)
+			continue;
+		table.Add(name,data);
 	}
+	return true;
+}
 
-	wchar_t name[_MAX_PATH];
-	if (knownPaths)
+bool CItemManager::IsPathUsed( const CUserAssistTable &userAssist, const wchar_t *path, const FILETIME &createstamp, bool bMetroApp )
+{
 	{
-		for (int i=0;i<knownPathsCount;i++)
+		unsigned int hash=CalcFNVHash(path);
+		if (m_OldItemFilter.MayContain(hash))
 		{
-			if (i==knownPathsCount-1)
-				Strcpy(name,_countof(name),path);
-			else if (wcsncmp(path,knownPaths[i].path,knownPaths[i].pathLen)==0)
+			OldItemInfo key={hash};
+			std::vector<OldItemInfo>::const_iterator it=std::lower_bound(m_OldItemInfos.begin(),m_OldItemInfos.end(),key);
+			if (it!=m_OldItemInfos.end() && it->hash==hash)
 			{
-				Sprintf(name,_countof(name),L"%s%s", (const wchar_t*)knownPaths[i].guid,path+knownPaths[i].pathLen);
-				break;
+				if (CompareFileTime(&createstamp,&it->timestamp)<0)
+					return true;
 			}
 		}
 	}
-	else
-	{
-		Strcpy(name,_countof(name),path);
-	}
-	EncodeRot13(name);
-	UserAssistData data;
-	DWORD size=sizeof(data);
-	if (regKey.QueryBinaryValue(name,&data,&size)==ERROR_SUCCESS)
+
+	const UserAssistData *pData=userAssist.FindPath(path);
+	if (pData)
 	{
 		if (bMetroApp)
 		{
 			// count is unreliable, the timestamp can be 0
-			return ((data.timestamp.dwLowDateTime|data.timestamp.dwHighDateTime)==0 || CompareFileTime(&createstamp,&data.timestamp)<0);
+			return ((pData->timestamp.dwLowDateTime|pData->timestamp.dwHighDateTime)==0 || CompareFileTime(&createstamp,&pData->timestamp)<0);
 		}
 		else
 		{
-			return (data.count>0 && CompareFileTime(&createstamp,&data.timestamp)<0);
+			return (pData->count>0 && CompareFileTime(&createstamp,&pData->timestamp)<0);
 		}
 	}
 	return false;
@@ -1430,29 +1656,27 @@ void CItemManager::UpdateNewPrograms( const POINT &balloonPos )
 		LOG_MENU(LOG_NEW,L"Install time: %02d.%02d.%04d:%02d:%02d",st.wDay,st.wMonth,st.wYear,st.wHour,st.wMinute);
 	}
 
-	CRegKey regKeyExe;
-	regKeyExe.Open(HKEY_CURRENT_USER,USERASSIST_APPIDS_KEY,KEY_READ);
-	CRegKey regKeyLink;
-	regKeyLink.Open(HKEY_CURRENT_USER,USERASSIST_LINKS_KEY,KEY_READ);
-
-	KnownPathGuid knownPaths[_countof(g_KnownPrefixes)+1];
+	// read the UserAssist data once instead of querying the registry for every item
+	CUserAssistTable userAssistExe;
+	bool bUserAssistExe=LoadUserAssist(userAssistExe,HKEY_CURRENT_USER,USERASSIST_APPIDS_KEY);
+	CUserAssistTable userAssistLink;
+	bool bUserAssistLink=LoadUserAssist(userAssistLink,HKEY_CURRENT_USER,USERASSIST_LINKS_KEY);
 
 	int OLD_PROGRAMS_AGE=GetSettingInt(L"OldProgramsAge");
 	if (OLD_PROGRAMS_AGE<0) OLD_PROGRAMS_AGE=0;
 	if (OLD_PROGRAMS_AGE>48) OLD_PROGRAMS_AGE=48;
 	const int INSTALL_GRACE_PERIOD=12; // ignore programs installed within 12 hours of system install
-	int knownPathsCount=0;
 	for (int i=0;i<_countof(g_KnownPrefixes);i++)
 	{
-		if (SUCCEEDED(SHGetKnownFolderPath(g_KnownPrefixes[i],0,NULL,&knownPaths[knownPathsCount].path)))
+		CComString path;
+		if (SUCCEEDED(SHGetKnownFolderPath(g_KnownPrefixes[i],0,NULL,&path)))
 		{
-			StringFromCLSID(g_KnownPrefixes[i],&knownPaths[knownPathsCount].guid);
-			knownPaths[knownPathsCount].path.MakeUpper();
-			knownPaths[knownPathsCount].pathLen=Strlen(knownPaths[knownPathsCount].path);
-			knownPathsCount++;
+			CComString guid;
+			StringFromCLSID(g_KnownPrefixes[i],&guid);
+			path.MakeUpper();
+			userAssistLink.AddKnownFolder(path,guid);
 		}
 	}
-	knownPaths[knownPathsCount++].pathLen=0;
 
 	LONGLONG curTime;
 	GetSystemTimeAsFileTime((FILETIME*)&curTime);
@@ -1499,7 +1723,7 @@ void CItemManager::UpdateNewPrograms( const POINT &balloonPos )
 			}
 			if (it->second.location==LOCATION_START_MENU)
 			{
-				if (wcscmp(PathFindExtension(it->second.targetPATH),L".EXE")!=0)
+				if (wcscmp(PathFindExtension(it->second.GetCold().targetPATH),L".EXE")!=0)
 				{
 					LOG_MENU(LOG_NEW,L"Ignoring new: %s target not exe",it->second.path);
 					continue;
@@ -1515,7 +1739,7 @@ void CItemManager::UpdateNewPrograms( const POINT &balloonPos )
 			int hours2=0, hours3=0;
 			if (it->second.location==LOCATION_START_MENU)
 			{
-				HANDLE h=CreateFile(it->second.targetPATH,FILE_READ_ATTRIBUTES,FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,NULL,OPEN_EXISTING,0,NULL);
+				HANDLE h=CreateFile(it->second.GetCold().targetPATH,FILE_READ_ATTRIBUTES,FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,NULL,OPEN_EXISTING,0,NULL);
 				if (h==INVALID_HANDLE_VALUE)
 				{
 					LOG_MENU(LOG_NEW,L"Ignoring new: %s failed to read attributes",it->second.path);
@@ -1544,17 +1768,17 @@ void CItemManager::UpdateNewPrograms( const POINT &balloonPos )
 					continue; // too soon after install
 				}
 
-				if (regKeyLink.m_hKey && IsPathUsed(regKeyLink,it->second.PATH,it->second.createstamp,knownPaths,knownPathsCount,it->second.bMetroApp))
+				if (bUserAssistLink && IsPathUsed(userAssistLink,it->second.PATH,it->second.createstamp,it->second.bMetroApp))
 				{
 					LOG_MENU(LOG_NEW,L"Ignoring new: %s shortcut used after it was created",it->second.path);
 					continue;  // the shortcut was used after it was created
 				}
-				if (regKeyExe.m_hKey)
+				if (bUserAssistExe)
 				{
 					UpdateItemInfo(&it->second,INFO_LINK_APPID,true);
 					CString appid=it->second.appid;
 					appid.MakeUpper();
-					if (IsPathUsed(regKeyExe,appid,it->second.createstamp,NULL,0,it->second.bMetroApp))
+					if (IsPathUsed(userAssistExe,appid,it->second.createstamp,it->second.bMetroApp))
 					{
 						LOG_MENU(LOG_NEW,L"Ignoring new: %s exe used after the shortcut was created",it->second.path);
 						continue; // the exe was used after the shortcut was created
@@ -1574,12 +1798,12 @@ void CItemManager::UpdateNewPrograms( const POINT &balloonPos )
 				}
 				CString appid=it->second.appid;
 				appid.MakeUpper();
-				if (regKeyExe.m_hKey && IsPathUsed(regKeyExe,appid,it->second.createstamp,NULL,0,it->second.bMetroApp))
+				if (bUserAssistExe && IsPathUsed(userAssistExe,appid,it->second.createstamp,it->second.bMetroApp))
 				{
 					LOG_MENU(LOG_NEW,L"Ignoring new: %s app id used after app was created",it->second.path);
 					continue; // the exe was used after the shortcut was created
 				}
-				if (it->second.bLink && regKeyLink.m_hKey && IsPathUsed(regKeyLink,it->second.PATH,it->second.createstamp,knownPaths,knownPathsCount,it->second.bMetroApp))
+				if (it->second.bLink && bUserAssistLink && IsPathUsed(userAssistLink,it->second.PATH,it->second.createstamp,it->second.bMetroApp))
 				{
 					LOG_MENU(LOG_NEW,L"Ignoring new: %s shortcut used after it was created",it->second.path);
 					continue;  // the shortcut was used after it was created
@@ -1690,6 +1914,88 @@ void CItemManager::LoadOldItems( void )
 	}
 
 	std::sort(m_OldItemInfos.begin(),m_OldItemInfos.end());
+	UpdateOldItemFilter();
+}
+
+void CItemManager::LoadAccessHistory( void )
+{
+	m_AccessHistory.Clear();
+	CRegKey regItems;
+	if (regItems.Open(HKEY_CURRENT_USER,L"Software\\OpenShell\\StartMenu",KEY_READ)==ERROR_SUCCESS)
+	{
+		ULONG size=0;
+		regItems.QueryBinaryValue(L"AccessHistory",NULL,&size);
+		if (size>0)
+		{
+			std::vector<unsigned int> data((size+3)/4);
+			if (regItems.QueryBinaryValue(L"AccessHistory",&data[0],&size)==ERROR_SUCCESS)
+				m_AccessHistory.Load(&data[0],size);
+		}
+	}
+	m_AccessHistory.Predict(GetSettingInt(L"WarmItemsCount"),m_PredictedItems);
+	m_bAccessHistoryDirty=true; // save the new session number even if no items are used
+}
+
+void CItemManager::SaveAccessHistory( void )
+{
+	Assert(GetCurrentThreadId()==m_MainThreadId);
+	if (!m_bAccessHistoryDirty)
+		return;
+	m_bAccessHistoryDirty=false;
+	std::vector<unsigned int> data;
+	m_AccessHistory.Save(data);
+
+	CRegKey regItems;
+	if (regItems.Open(HKEY_CURRENT_USER,L"Software\\OpenShell\\StartMenu")!=ERROR_SUCCESS)
+		regItems.Create(HKEY_CURRENT_USER,L"Software\\OpenShell\\StartMenu");
+	regItems.SetBinaryValue(L"AccessHistory",&data[0],ULONG(data.size()*sizeof(unsigned int)));
+}
+
+// Loads the items that were used the most in the previous sessions before the rest of the folders are enumerated
+void CItemManager::WarmPredictedItems( void )
+{
+	if (m_PredictedItems.empty())
+		return;
+	int time0=GetTickCount();
+	int timeLimit=GetSettingInt(L"WarmItemsTime");
+	int refreshFlags=INFO_LINK|INFO_METRO|(m_bPreloadIcons?INFO_SMALL_ICON:0);
+	int count=0;
+	for (std::vector<unsigned int>::const_iterator it=m_PredictedItems.begin();it!=m_PredictedItems.end();++it)
+	{
+		if (m_LoadingStage!=LOAD_LOADING || (int)(GetTickCount()-time0)>timeLimit)
+			break;
+		CAbsolutePidl pidl;
+		TLocation location=LOCATION_UNKNOWN;
+		{
+			// only the items from the cache file can be found by hash. the new ones are loaded with their folder
+			RWLock lock(this,false,RWLOCK_ITEMS);
+			std::multimap<unsigned int,ItemInfo>::const_iterator it2=m_ItemInfos.find(*it);
+			if (it2!=m_ItemInfos.end() && !it2->second.bIconOnly && it2->second.pidl)
+			{
+				pidl.Clone(it2->second.pidl);
+				location=it2->second.location;
+			}
+		}
+		if (!pidl) continue;
+		CComPtr<IShellItem> pItem;
+		if (FAILED(SHCreateItemFromIDList(pidl,IID_IShellItem,(void**)&pItem)) || !pItem) continue;
+		const ItemInfo *pInfo=GetItemInfo(pItem,pidl,refreshFlags|INFO_VALIDATE_FILE,location);
+		if (!pInfo) continue;
+		{
+			// the icons are queued with the preload priority. move them ahead of the rest of the preloaded items
+			RWLock lock(this,true,RWLOCK_ITEMS);
+			m_ItemQueue.Boost(const_cast<ItemInfo*>(pInfo),PRIORITY_NEXT);
+		}
+		count++;
+	}
+	LOG_MENU(LOG_CACHE,L"Warmed %d of %d predicted items in %d ms",count,(int)m_PredictedItems.size(),GetTickCount()-time0);
+}
+
+void CItemManager::UpdateOldItemFilter( void )
+{
+	m_OldItemFilter.Init((int)m_OldItemInfos.size());
+	for (std::vector<OldItemInfo>::const_iterator it=m_OldItemInfos.begin();it!=m_OldItemInfos.end();++it)
+		m_OldItemFilter.Add(it->hash);
 }
 
 void CItemManager::RemoveNewItem( PIDLIST_ABSOLUTE pItem1, PIDLIST_ABSOLUTE pItem2, bool bFolder )
@@ -1770,14 +2076,13 @@ void CItemManager::AddOldItems( const std::vector<unsigned> &hashes )
 	LONGLONG timestamp;
 	GetSystemTimeAsFileTime((FILETIME*)&timestamp);
 	timestamp-=36000000000ll*48;
+	size_t count=0;
 	for (size_t i=0;i<m_OldItemInfos.size();i++)
 	{
-		if (CompareFileTime((FILETIME*)&timestamp,&m_OldItemInfos[i].timestamp)>0)
-		{
-			m_OldItemInfos.erase(m_OldItemInfos.begin()+i);
-			i--;
-		}
+		if (CompareFileTime((FILETIME*)&timestamp,&m_OldItemInfos[i].timestamp)<=0)
+			m_OldItemInfos[count++]=m_OldItemInfos[i];
 	}
+	m_OldItemInfos.resize(count);
 
 	for (std::vector<unsigned>::const_iterator it=hashes.begin();it!=hashes.end();++it)
 	{
@@ -1789,6 +2094,7 @@ void CItemManager::AddOldItems( const std::vector<unsigned> &hashes )
 		else
 			m_OldItemInfos.insert(it2,key);
 	}
+	UpdateOldItemFilter();
 
 	CRegKey regItems;
 	if (regItems.Open(HKEY_CURRENT_USER,L"Software\\OpenShell\\StartMenu")!=ERROR_SUCCESS)
@@ -1820,12 +2126,17 @@ CString GetPropertyStoreString( IPropertyStore *pStore, REFPROPERTYKEY key )
 void CItemManager::RefreshItemInfo( ItemInfo *pInfo, int refreshFlags, IShellItem *pItem0, bool bHasWriteLock )
 {
 	ItemInfo newInfo;
+	InterlockedIncrement(&m_RefreshingCount);
+	AddCounter(COUNTER_ITEM_REFRESHES);
 
 	{
 		// get info from pInfo
 		RWLock lock(this,false,bHasWriteLock?RWLOCK_COUNT:RWLOCK_ITEMS);
 		newInfo=*pInfo;
 	}
+	// items without cold data use a temporary. it is stored in the item only if the refresh finds some cold data
+	ItemInfoCold tempCold;
+	ItemInfoCold &newCold=newInfo.cold.Get()?newInfo.SetCold():tempCold;
 
 	CComPtr<IShellItem> pItem;
 	CComPtr<IShellItem> pAppItem;
@@ -1845,11 +2156,14 @@ void CItemManager::RefreshItemInfo( ItemInfo *pInfo, int refreshFlags, IShellIte
 				pItem=pItem0;
 			else
 			{
-				const CAbsolutePidl &pidl=newInfo.newPidl?newInfo.newPidl:newInfo.pidl;
+				const CAbsolutePidl &pidl=newCold.newPidl?newCold.newPidl:newInfo.pidl;
 				if (pidl)
 				{
 					if (FAILED(SHCreateItemFromIDList(pidl,IID_IShellItem,(void**)&pItem)))
+					{
+						InterlockedDecrement(&m_RefreshingCount);
 						return;
+					}
 				}
 			}
 		}
@@ -1863,8 +2177,8 @@ void CItemManager::RefreshItemInfo( ItemInfo *pInfo, int refreshFlags, IShellIte
 			newInfo.bNoPin=false;
 			newInfo.bNoNew=false;
 			newInfo.bExplicitAppId=false;
-			newInfo.targetPATH.Empty();
-			newInfo.targetPidl.Clear();
+			newCold.targetPATH.Empty();
+			newCold.targetPidl.Clear();
 			if (refreshFlags&INFO_LINK_APPID)
 			{
 				newInfo.appid.Empty();
@@ -1875,9 +2189,9 @@ void CItemManager::RefreshItemInfo( ItemInfo *pInfo, int refreshFlags, IShellIte
 				newInfo.bMetroLink=false;
 				newInfo.bMetroApp=false;
 				newInfo.bProtectedLink=false;
-				newInfo.metroName.Empty();
+				newCold.metroName.Empty();
 				newInfo.iconPath.Empty();
-				newInfo.iconColor=0;
+				newCold.iconColor=0;
 			}
 
 			// refresh link and metro
@@ -1898,17 +2212,17 @@ void CItemManager::RefreshItemInfo( ItemInfo *pInfo, int refreshFlags, IShellIte
 						LOG_MENU(LOG_OPEN, L"Link property store:");
 						LogPropertyStore(LOG_OPEN, pStore);
 #endif
-						if (SUCCEEDED(pLink->GetIDList(&newInfo.targetPidl)))
+						if (SUCCEEDED(pLink->GetIDList(&newCold.targetPidl)))
 						{
 							wchar_t path[_MAX_PATH];
-							if (SUCCEEDED(SHGetPathFromIDList(newInfo.targetPidl,path)))
+							if (SUCCEEDED(SHGetPathFromIDList(newCold.targetPidl,path)))
 							{
 								CharUpper(path);
-								newInfo.targetPATH=path;
+								newCold.targetPATH=path;
 							}
 
 							CComPtr<IShellItem> target;
-							if (SUCCEEDED(SHCreateItemFromIDList(newInfo.targetPidl, IID_PPV_ARGS(&target))))
+							if (SUCCEEDED(SHCreateItemFromIDList(newCold.targetPidl, IID_PPV_ARGS(&target))))
 							{
 								CComPtr<IPropertyStore> store;
 								if (SUCCEEDED(target->BindToHandler(nullptr, BHID_PropertyStore, IID_PPV_ARGS(&store))))
@@ -1957,11 +2271,11 @@ void CItemManager::RefreshItemInfo( ItemInfo *pInfo, int refreshFlags, IShellIte
 							if (newInfo.bMetroApp)
 							{
 								pAppItem=pItem;
-								newInfo.packagePath=GetPropertyStoreString(pStore,PKEY_MetroPackagePath);
-								if (!newInfo.packagePath.IsEmpty())
+								newCold.packagePath=GetPropertyStoreString(pStore,PKEY_MetroPackagePath);
+								if (!newCold.packagePath.IsEmpty())
 								{
 									FILETIME writeTime={0}, createTime={0};
-									if (MenuGetFileTimestamp(newInfo.packagePath,&writeTime,&createTime))
+									if (MenuGetFileTimestamp(newCold.packagePath,&writeTime,&createTime))
 									{
 										newInfo.writestamp=writeTime;
 										newInfo.createstamp=createTime;
@@ -1974,13 +2288,13 @@ void CItemManager::RefreshItemInfo( ItemInfo *pInfo, int refreshFlags, IShellIte
 								newInfo.bProtectedLink=m_RootCommonPrograms.GetLength()==(PathFindFileName(str)-str);
 							}
 							if (SUCCEEDED(pStore->GetValue(PKEY_MetroIconColor,&val)) && (val.vt==VT_I4 || val.vt==VT_UI4))
-								newInfo.iconColor=val.intVal;
+								newCold.iconColor=val.intVal;
 							if (pAppItem || SUCCEEDED(SHCreateItemInKnownFolder(FOLDERID_AppsFolder2,0,newInfo.appid,IID_IShellItem,(void**)&pAppItem)))
 							{
 								CComString pName;
 								if (SUCCEEDED(pAppItem->GetDisplayName(SIGDN_NORMALDISPLAY,&pName)))
 								{
-									newInfo.metroName=pName;
+									newCold.metroName=pName;
 								}
 							}
 						}
@@ -2017,21 +2331,21 @@ void CItemManager::RefreshItemInfo( ItemInfo *pInfo, int refreshFlags, IShellIte
 		{
 			if (!newInfo.bLink)
 			{
-				newInfo.targetPidl.Clear();
-				newInfo.targetPATH.Empty();
+				newCold.targetPidl.Clear();
+				newCold.targetPATH.Empty();
 				newInfo.iconPath.Empty();
 				newInfo.bNoPin=newInfo.bNoNew=false;
 				if (!newInfo.bMetroApp)
 				{
 					newInfo.bExplicitAppId=false;
 					newInfo.appid.Empty();
-					newInfo.packagePath.Empty();
+					newCold.packagePath.Empty();
 				}
 			}
 			else if (newInfo.bMetroLink)
 			{
-				newInfo.targetPidl.Clear();
-				newInfo.targetPATH.Empty();
+				newCold.targetPidl.Clear();
+				newCold.targetPATH.Empty();
 			}
 		}
 
@@ -2047,9 +2361,9 @@ void CItemManager::RefreshItemInfo( ItemInfo *pInfo, int refreshFlags, IShellIte
 				if (pAppItem || SUCCEEDED(SHCreateItemInKnownFolder(FOLDERID_AppsFolder2,0,newInfo.appid,IID_IShellItem,(void**)&pAppItem)))
 				{
 					int iconFlags=refreshFlags&INFO_ICON;
-					LoadMetroIcon(pAppItem,iconFlags,newInfo.smallIcon,newInfo.largeIcon,newInfo.extraLargeIcon,&newInfo.iconColor);
+					LoadMetroIcon(pAppItem,iconFlags,newInfo.smallIcon,newInfo.largeIcon,newInfo.extraLargeIcon,&newCold.iconColor);
 					if (iconFlags)
-						LoadShellIcon(pItem?pItem:pAppItem,iconFlags,newInfo.smallIcon,newInfo.largeIcon,newInfo.extraLargeIcon,&newInfo.iconColor);
+						LoadShellIcon(pItem?pItem:pAppItem,iconFlags,newInfo.smallIcon,newInfo.largeIcon,newInfo.extraLargeIcon,&newCold.iconColor);
 				}
 			}
 			else if (_wcsicmp(PathFindExtension(newInfo.path),L".settingcontent-ms")==0)
@@ -2067,6 +2381,15 @@ void CItemManager::RefreshItemInfo( ItemInfo *pInfo, int refreshFlags, IShellIte
 		}
 	}
 
+	if ((refreshFlags&INFO_DATA) && !newInfo.bTemp)
+	{
+		newCold.targetPATH=m_StringPool.Intern(newCold.targetPATH);
+		newCold.packagePath=m_StringPool.Intern(newCold.packagePath);
+		newInfo.appid=m_StringPool.Intern(newInfo.appid);
+		newCold.metroName=m_StringPool.Intern(newCold.metroName);
+		newInfo.iconPath=m_StringPool.Intern(newInfo.iconPath);
+	}
+
 	{
 		// store info in pInfo
 		RWLock lock(this,true,bHasWriteLock?RWLOCK_COUNT:RWLOCK_ITEMS);
@@ -2080,16 +2403,23 @@ void CItemManager::RefreshItemInfo( ItemInfo *pInfo, int refreshFlags, IShellIte
 			pInfo->bNoPin=newInfo.bNoPin;
 			pInfo->bNoNew=newInfo.bNoNew;
 			pInfo->bExplicitAppId=newInfo.bExplicitAppId;
-			pInfo->targetPidl.Swap(newInfo.targetPidl);
-			pInfo->targetPATH=newInfo.targetPATH;
-			pInfo->packagePath=newInfo.packagePath;
 			if ((refreshFlags&INFO_LINK_APPID) || !newInfo.appid.IsEmpty())
 				pInfo->appid=newInfo.appid;
 			if (!pInfo->appid.IsEmpty())
 				refreshFlags|=INFO_LINK_APPID; // appid is valid, no need to resolve
-			pInfo->metroName=newInfo.metroName;
 			pInfo->iconPath=newInfo.iconPath;
-			pInfo->iconColor=newInfo.iconColor;
+			// newPidl is not copied back. it may have changed while the lock was released
+			newCold.newPidl.Clear();
+			if (pInfo->cold.Get() || !newCold.IsEmpty())
+			{
+				ItemInfoCold &cold=pInfo->SetCold();
+				cold.targetPidl.Swap(newCold.targetPidl);
+				cold.targetPATH=newCold.targetPATH;
+				cold.packagePath=newCold.packagePath;
+				cold.metroName=newCold.metroName;
+				cold.iconColor=newCold.iconColor;
+				pInfo->cold.Compact();
+			}
 			if (pInfo->bMetroApp)
 			{
 				pInfo->writestamp=newInfo.writestamp;
@@ -2109,6 +2439,7 @@ void CItemManager::RefreshItemInfo( ItemInfo *pInfo, int refreshFlags, IShellIte
 			pInfo->validFlags|=refreshFlags&INFO_DATA;
 		pInfo->refreshFlags&=~refreshFlags;
 	}
+	InterlockedDecrement(&m_RefreshingCount);
 }
 
 void CItemManager::RefreshInfos( void )
@@ -2117,10 +2448,12 @@ void CItemManager::RefreshInfos( void )
 	RWLock lock(this,true,RWLOCK_ITEMS);
 	for (std::multimap<unsigned int,ItemInfo>::iterator it=m_ItemInfos.begin();it!=m_ItemInfos.end();++it)
 	{
-		if (it->second.newPidl)
+		if (it->second.GetCold().newPidl)
 		{
-			it->second.pidl.Swap(it->second.newPidl);
-			it->second.newPidl.Clear();
+			CAbsolutePidl &newPidl=it->second.SetCold().newPidl;
+			it->second.pidl.Swap(newPidl);
+			newPidl.Clear();
+			it->second.cold.Compact();
 			it->second.validFlags=0;
 		}
 	}
@@ -2544,100 +2877,138 @@ void CItemManager::LoadMetroIcon( IShellItem *pItem, int &refreshFlags, const Ic
 void CItemManager::FindInCache( unsigned int hash, int &refreshFlags, const IconInfo *&smallIcon, const IconInfo *&largeIcon, const IconInfo *&extraLargeIcon )
 {
 	// look in the cache
+	int requested=refreshFlags&INFO_ICON;
 	RWLock lock(this,false,RWLOCK_ICONS);
 	std::multimap<unsigned int,IconInfo>::iterator it=m_IconInfos.find(hash);
 	for (;it!=m_IconInfos.end() && it->first==hash;++it)
 	{
+		// only set to true under the read lock, so it is safe to write from multiple threads
 		if ((refreshFlags&INFO_SMALL_ICON) && it->second.sizeType==ICON_SIZE_TYPE_SMALL)
 		{
 			smallIcon=&it->second;
+			it->second.bUsed=true;
 			refreshFlags&=~INFO_SMALL_ICON;
 		}
 		if ((refreshFlags&INFO_LARGE_ICON) && it->second.sizeType==ICON_SIZE_TYPE_LARGE)
 		{
 			largeIcon=&it->second;
+			it->second.bUsed=true;
 			refreshFlags&=~INFO_LARGE_ICON;
 		}
 		if ((refreshFlags&INFO_EXTRA_LARGE_ICON) && it->second.sizeType==ICON_SIZE_TYPE_EXTRA_LARGE)
 		{
 			extraLargeIcon=&it->second;
+			it->second.bUsed=true;
 			refreshFlags&=~INFO_EXTRA_LARGE_ICON;
 		}
 	}
+	if (requested)
+	{
+		int found=requested&~refreshFlags;
+		AddCounter(COUNTER_ICON_LOOKUPS,((requested&INFO_SMALL_ICON)?1:0)+((requested&INFO_LARGE_ICON)?1:0)+((requested&INFO_EXTRA_LARGE_ICON)?1:0));
+		AddCounter(COUNTER_ICON_HITS,((found&INFO_SMALL_ICON)?1:0)+((found&INFO_LARGE_ICON)?1:0)+((found&INFO_EXTRA_LARGE_ICON)?1:0));
+	}
 }
 
 void CItemManager::StoreInCache( unsigned int hash, const wchar_t *path, HBITMAP hSmallBitmap, HBITMAP hLargeBitmap, HBITMAP hExtraLargeBitmap, int refreshFlags, const IconInfo *&smallIcon, const IconInfo *&largeIcon, const IconInfo *&extraLargeIcon, bool bTemp, bool bMetro )
 {
 	RWLock lock(this,true,RWLOCK_ICONS);
+	// move the new bitmaps into the atlas
+	const IconBitmap *pSmallBitmap=(refreshFlags&INFO_SMALL_ICON)?AddToAtlas(ICON_SIZE_TYPE_SMALL,hSmallBitmap):NULL;
+	const IconBitmap *pLargeBitmap=(refreshFlags&INFO_LARGE_ICON)?AddToAtlas(ICON_SIZE_TYPE_LARGE,hLargeBitmap):NULL;
+	const IconBitmap *pExtraLargeBitmap=(refreshFlags&INFO_EXTRA_LARGE_ICON)?AddToAtlas(ICON_SIZE_TYPE_EXTRA_LARGE,hExtraLargeBitmap):NULL;
+
 	std::multimap<unsigned int,IconInfo>::iterator it=m_IconInfos.find(hash);
 	for (;it!=m_IconInfos.end() && it->first==hash;++it)
 	{
 		if ((refreshFlags&INFO_SMALL_ICON) && it->second.sizeType==ICON_SIZE_TYPE_SMALL)
 		{
-			if (hSmallBitmap)
+			if (pSmallBitmap)
 			{
-				HBITMAP old=it->second.bitmap;
-				it->second.bitmap=hSmallBitmap;
+				const IconBitmap *old=it->second.bitmap;
+				it->second.bitmap=pSmallBitmap;
 				if (old) m_OldBitmaps.push_back(old);
-				hSmallBitmap=NULL;
+				pSmallBitmap=NULL;
 			}
 			smallIcon=&it->second;
+			it->second.bUsed=true;
 			refreshFlags&=~INFO_SMALL_ICON;
 		}
 		if ((refreshFlags&INFO_LARGE_ICON) && it->second.sizeType==ICON_SIZE_TYPE_LARGE)
 		{
-			if (hLargeBitmap)
+			if (pLargeBitmap)
 			{
-				HBITMAP old=it->second.bitmap;
-				it->second.bitmap=hLargeBitmap;
+				const IconBitmap *old=it->second.bitmap;
+				it->second.bitmap=pLargeBitmap;
 				if (old) m_OldBitmaps.push_back(old);
-				hLargeBitmap=NULL;
+				pLargeBitmap=NULL;
 			}
 			largeIcon=&it->second;
+			it->second.bUsed=true;
 			refreshFlags&=~INFO_LARGE_ICON;
 		}
 		if ((refreshFlags&INFO_EXTRA_LARGE_ICON) && it->second.sizeType==ICON_SIZE_TYPE_EXTRA_LARGE)
 		{
-			if (hExtraLargeBitmap)
+			if (pExtraLargeBitmap)
 			{
-				HBITMAP old=it->second.bitmap;
-				it->second.bitmap=hExtraLargeBitmap;
+				const IconBitmap *old=it->second.bitmap;
+				it->second.bitmap=pExtraLargeBitmap;
 				if (old) m_OldBitmaps.push_back(old);
-				hExtraLargeBitmap=NULL;
+				pExtraLargeBitmap=NULL;
 			}
 			extraLargeIcon=&it->second;
+			it->second.bUsed=true;
 			refreshFlags&=~INFO_EXTRA_LARGE_ICON;
 		}
 	}
 
-	if ((refreshFlags&INFO_SMALL_ICON) && hSmallBitmap)
+	if ((pSmallBitmap || pLargeBitmap || pExtraLargeBitmap) && !m_EvictedIcons.empty())
+	{
+		std::set<unsigned int>::iterator evicted=m_EvictedIcons.find(hash);
+		if (evicted!=m_EvictedIcons.end())
+		{
+			m_ReloadedIconCount++;
+			m_EvictedIcons.erase(evicted);
+		}
+	}
+
+	if ((refreshFlags&INFO_SMALL_ICON) && pSmallBitmap)
 	{
 		IconInfo *pInfo=&m_IconInfos.emplace(hash,IconInfo())->second;
 		pInfo->sizeType=ICON_SIZE_TYPE_SMALL;
 		pInfo->bTemp=bTemp;
 		pInfo->bMetro=bMetro;
+		pInfo->bUsed=true;
 		pInfo->SetPath(path);
-		pInfo->bitmap=hSmallBitmap;
+		if (!bTemp)
+			pInfo->PATH=m_StringPool.Intern(pInfo->PATH);
+		pInfo->bitmap=pSmallBitmap;
 		smallIcon=pInfo;
 	}
-	if ((refreshFlags&INFO_LARGE_ICON) && hLargeBitmap)
+	if ((refreshFlags&INFO_LARGE_ICON) && pLargeBitmap)
 	{
 		IconInfo *pInfo=&m_IconInfos.emplace(hash,IconInfo())->second;
 		pInfo->sizeType=ICON_SIZE_TYPE_LARGE;
 		pInfo->bTemp=bTemp;
 		pInfo->bMetro=bMetro;
+		pInfo->bUsed=true;
 		pInfo->SetPath(path);
-		pInfo->bitmap=hLargeBitmap;
+		if (!bTemp)
+			pInfo->PATH=m_StringPool.Intern(pInfo->PATH);
+		pInfo->bitmap=pLargeBitmap;
 		largeIcon=pInfo;
 	}
-	if ((refreshFlags&INFO_EXTRA_LARGE_ICON) && hExtraLargeBitmap)
+	if ((refreshFlags&INFO_EXTRA_LARGE_ICON) && pExtraLargeBitmap)
 	{
 		IconInfo *pInfo=&m_IconInfos.emplace(hash,IconInfo())->second;
 		pInfo->sizeType=ICON_SIZE_TYPE_EXTRA_LARGE;
 		pInfo->bTemp=bTemp;
 		pInfo->bMetro=bMetro;
+		pInfo->bUsed=true;
 		pInfo->SetPath(path);
-		pInfo->bitmap=hExtraLargeBitmap;
+		if (!bTemp)
+			pInfo->PATH=m_StringPool.Intern(pInfo->PATH);
+		pInfo->bitmap=pExtraLargeBitmap;
 		extraLargeIcon=pInfo;
 	}
 }
@@ -2757,21 +3128,8 @@ void CItemManager::LoadFolderItems( IShellItem *pFolder, int refreshFlags, int l
 
 CItemManager::TLocation CItemManager::DetermineLocation( const wchar_t *PATH )
 {
-	if (wcsncmp(PATH,m_RootStartMenu1,m_RootStartMenu1.GetLength())==0)
-		return LOCATION_START_MENU;
-	if (wcsncmp(PATH,m_RootStartMenu2,m_RootStartMenu2.GetLength())==0)
-		return LOCATION_START_MENU;
-	if (wcsncmp(PATH,m_RootStartMenu3,m_RootStartMenu3.GetLength())==0)
-		return LOCATION_START_MENU;
-	if (wcsncmp(PATH,m_RootGames,m_RootGames.GetLength())==0)
-		return LOCATION_GAMES;
-	if (wcsncmp(PATH,m_RootDesktop,m_RootDesktop.GetLength())==0)
-		return LOCATION_DESKTOP;
-	if (wcsncmp(PATH,m_RootTaskbar,m_RootTaskbar.GetLength())==0)
-		return LOCATION_TASKBAR;
-	if (wcsncmp(PATH,m_RootMetro,m_RootMetro.GetLength())==0)
-		return LOCATION_METRO;
-	return LOCATION_UNKNOWN;
+	int location=m_LocationTrie.Find(PATH);
+	return location<0?LOCATION_UNKNOWN:(TLocation)location;
 }
 
 // Recursive function to preload the metro apps
@@ -2855,12 +3213,69 @@ static struct
 
 const int NUM_WATCHED_DIRS=7;
 
+// Loads an item that was changed in one of the watched folders. root is the watched folder, ending with backslash
+void CItemManager::LoadChangedItem( const wchar_t *PATH, const wchar_t *root, bool bAdded, int refreshFlags, int levels, TLocation location )
+{
+	DWORD attrib=GetFileAttributes(PATH);
+	if (attrib==INVALID_FILE_ATTRIBUTES)
+		return; // the item was deleted or renamed. the old item stays in the cache like before
+	if (attrib&(FILE_ATTRIBUTE_HIDDEN|FILE_ATTRIBUTE_SYSTEM))
+		return; // the folder enumeration skips these too
+	bool bFolder=(attrib&FILE_ATTRIBUTE_DIRECTORY)!=0;
+	if (bFolder && !bAdded)
+		return; // a modified folder means that its children changed, and they are reported separately
+
+	// find how deep the item is in the watched folder. the direct children are at depth 1
+	int rootLen=Strlen(root);
+	if (_wcsnicmp(PATH,root,rootLen)!=0)
+		return;
+	int depth=1;
+	for (const wchar_t *c=PATH+rootLen;*c;c++)
+	{
+		if (*c=='\\')
+			depth++;
+	}
+	if (depth>levels)
+		return; // the item is deeper than the preloaded levels
+
+	CAbsolutePidl pidl;
+	if (FAILED(SHParseDisplayName(PATH,NULL,&pidl,0,NULL)) || !pidl) return;
+	CComPtr<IShellItem> pItem;
+	if (FAILED(SHCreateItemFromIDList(pidl,IID_IShellItem,(void**)&pItem)) || !pItem) return;
+	if (location==CItemManager::LOCATION_DESKTOP)
+	{
+		SFGAOF attr=0;
+		if (FAILED(pItem->GetAttributes(SFGAO_LINK,&attr)) || !(attr&SFGAO_LINK))
+			return;
+	}
+
+	int queueFlags=refreshFlags&INFO_ICON;
+	ItemInfo *pItemInfo=const_cast<ItemInfo*>(GetItemInfo(pItem,pidl,refreshFlags&~INFO_ICON,location));
+	if (queueFlags)
+	{
+		RWLock lock(this,true,RWLOCK_ITEMS);
+		QueueItemInfo(pItemInfo,queueFlags);
+	}
+
+	if (bFolder && depth<levels)
+	{
+		// load the contents of the new folder the same way LoadFolderItems does for its subfolders
+		SFGAOF flags=0;
+		if (SUCCEEDED(pItem->GetAttributes(SFGAO_FOLDER|SFGAO_STREAM|SFGAO_LINK,&flags)) && (flags&(SFGAO_FOLDER|SFGAO_STREAM|SFGAO_LINK))==SFGAO_FOLDER)
+			LoadFolderItems(pItem,refreshFlags,levels-depth,location);
+	}
+}
+
 void CItemManager::PreloadItemsThread( void )
 {
 	int dirCount=0;
 	HANDLE handles[NUM_WATCHED_DIRS+1];
-	DWORD dirMasks[NUM_WATCHED_DIRS]={0};
+	int dirIndices[NUM_WATCHED_DIRS]={0};
+	CDirectoryWatcher watchers[NUM_WATCHED_DIRS];
+	CChangeCoalescer changes;
+	std::vector<CChangeCoalescer::Change> changedItems;
 	DWORD dirMask=0xFFFFFFFF;
+	WarmPredictedItems();
 	while (1)
 	{
 		for (int i=0;i<_countof(g_CacheFolders);i++)
@@ -2904,10 +3319,10 @@ void CItemManager::PreloadItemsThread( void )
 			wchar_t path[_MAX_PATH];
 			if (i<NUM_WATCHED_DIRS && dirMask==0xFFFFFFFF && SUCCEEDED(SHGetPathFromIDList(pidl,path)))
 			{
-				handles[dirCount]=FindFirstChangeNotification(path,TRUE,FILE_NOTIFY_CHANGE_FILE_NAME|FILE_NOTIFY_CHANGE_DIR_NAME|FILE_NOTIFY_CHANGE_LAST_WRITE);
-				if (handles[dirCount]!=INVALID_HANDLE_VALUE)
+				if (watchers[dirCount].Start(path,g_CacheFolders[i].levels>1))
 				{
-					dirMasks[dirCount]=1<<i;
+					handles[dirCount]=watchers[dirCount].GetEvent();
+					dirIndices[dirCount]=i;
 					dirCount++;
 				}
 			}
@@ -2934,20 +3349,63 @@ void CItemManager::PreloadItemsThread( void )
 			SetEvent(m_DoneEvent);
 		if (dirCount==0)
 			break;
+
+		// collect the changes until they calm down (for example when a program is being installed)
 		handles[dirCount]=m_ExitEvent;
-		DWORD wait=WaitForMultipleObjects(dirCount+1,handles,FALSE,INFINITE);
-		if (wait<WAIT_OBJECT_0 || wait>WAIT_OBJECT_0+dirCount-1)
+		bool bExit=false;
+		while (1)
+		{
+			int timeout=changes.GetTimeout(GetTickCount());
+			DWORD wait=WaitForMultipleObjects(dirCount+1,handles,FALSE,timeout<0?INFINITE:timeout);
+			if (wait==WAIT_TIMEOUT)
+				break;
+			if (wait<WAIT_OBJECT_0 || wait>WAIT_OBJECT_0+dirCount-1)
+			{
+				bExit=true;
+				break;
+			}
+			int dir=wait-WAIT_OBJECT_0;
+			if (!watchers[dir].ReadChanges(changes,dirIndices[dir]))
+			{
+				ResetEvent(handles[dir]); // so we don't wake on this event again
+				changes.AddFolder(dirIndices[dir],GetTickCount());
+			}
+		}
+		if (bExit || m_LoadingStage!=LOAD_LOADING)
 			break;
 
-		int dir=wait-WAIT_OBJECT_0;
-		dirMask=dirMasks[dir];
-
-		if (!FindNextChangeNotification(handles[dir]))
-			ResetEvent(handles[dir]); // so we don't wake on this event again
-		Sleep(1000); // hopefully whatever file operation is in progress will finish in a second
+		// reload only the changed items. the folders that had too many changes are reloaded completely
+		unsigned int folderMask;
+		changes.TakeChanges(changedItems,folderMask);
+		dirMask=folderMask;
+		for (std::vector<CChangeCoalescer::Change>::const_iterator it=changedItems.begin();it!=changedItems.end();++it)
+		{
+			if (m_LoadingStage!=LOAD_LOADING) break;
+			int i=it->folder;
+			if (g_CacheFolders[i].folder==FOLDERID_MetroApps)
+			{
+				dirMask|=1<<i;
+				continue;
+			}
+			if (g_CacheFolders[i].location==CItemManager::LOCATION_DESKTOP && (GetSettingInt(L"CompatibilityFixes")&COMPATIBILITY_SKIP_DESKTOP))
+				continue;
+			int refreshFlags=g_CacheFolders[i].refreshFlags;
+			if (!m_bPreloadIcons)
+				refreshFlags&=CItemManager::INFO_DATA;
+			const wchar_t *root=NULL;
+			for (int d=0;d<dirCount;d++)
+			{
+				if (dirIndices[d]==i)
+				{
+					root=watchers[d].GetPath();
+					break;
+				}
+			}
+			if (refreshFlags && root)
+				LoadChangedItem(it->PATH,root,it->bAdded,refreshFlags,g_CacheFolders[i].levels,g_CacheFolders[i].location);
+		}
+		LOG_MENU(LOG_CACHE,L"Reloaded %d changed items, folder mask 0x%X",(int)changedItems.size(),folderMask);
 	}
-	for (int i=0;i<dirCount;i++)
-		FindCloseChangeNotification(handles[i]);
 }
 
 DWORD CALLBACK CItemManager::StaticPreloadItemsThread( void *param )
@@ -2966,12 +3424,25 @@ DWORD CALLBACK CItemManager::StaticPreloadItemsThread( void *param )
 	return 0;
 }
 
-void CItemManager::RefreshInfoThread( void )
+static bool IsOnBatteryPower( void )
+{
+	SYSTEM_POWER_STATUS status;
+	return GetSystemPowerStatus(&status) && status.ACLineStatus==0;
+}
+
+void CItemManager::RefreshInfoThread( int index )
 {
 	WaitForSingleObject(m_StartEvent,REFRESH_DELAY);
 	bool bRefresh=false;
 	while (1)
 	{
+		if (index>0 && IsOnBatteryPower())
+		{
+			// only the first thread works when running on battery
+			if (WaitForSingleObject(m_ExitEvent,POWER_CHECK_DELAY)!=WAIT_TIMEOUT)
+				return;
+			continue;
+		}
 		HANDLE handles[2]={m_WorkEvent,m_ExitEvent};
 		WaitForMultipleObjects(2,handles,FALSE,INFINITE);
 		bRefresh=false;
@@ -2987,24 +3458,22 @@ void CItemManager::RefreshInfoThread( void )
 				Lock cleanupLock(this,LOCK_CLEANUP);
 				{
 					RWLock lock(this,true,RWLOCK_ITEMS);
-					if (!m_ItemQueue.empty())
-					{
-						pItemInfo=*m_ItemQueue.begin();
-						m_ItemQueue.pop_front();
-					}
-					else if (!m_ItemQueueLow.empty())
 					{
-						pItemInfo=*m_ItemQueueLow.begin();
-						m_ItemQueueLow.pop_front();
+						Lock boostLock(this,LOCK_BOOST);
+						for (std::vector<ItemInfo*>::const_iterator it=m_BoostedItems.begin();it!=m_BoostedItems.end();++it)
+							m_ItemQueue.Boost(*it,PRIORITY_VISIBLE);
+						m_BoostedItems.clear();
 					}
-					else
+					if (!m_ItemQueue.BeginRefresh(pItemInfo,refreshFlags))
 						break;
-					refreshFlags=pItemInfo->refreshFlags;
+					if (!m_ItemQueue.IsEmpty())
+						SetEvent(m_WorkEvent); // wake up another thread to help
 				}
 				if (refreshFlags && pItemInfo->bTemp)
 				{
 					// temp items must be refreshed inside LOCK_CLEANUP because the cleanup process will delete all such items
 					RefreshItemInfo(pItemInfo,refreshFlags,NULL,false);
+					EndRefreshItem(pItemInfo);
 					refreshFlags=0;
 				}
 			}
@@ -3012,6 +3481,7 @@ void CItemManager::RefreshInfoThread( void )
 			{
 				// non-temp items should be refreshed outside LOCK_CLEANUP
 				RefreshItemInfo(pItemInfo,refreshFlags,NULL,false);
+				EndRefreshItem(pItemInfo);
 			}
 
 			bRefresh=true;
@@ -3028,15 +3498,24 @@ void CItemManager::RefreshInfoThread( void )
 	}
 }
 
+void CItemManager::EndRefreshItem( ItemInfo *pInfo )
+{
+	RWLock lock(this,true,RWLOCK_ITEMS);
+	if (m_ItemQueue.EndRefresh(pInfo,PRIORITY_NEXT))
+		SetEvent(m_WorkEvent);
+}
+
 DWORD CALLBACK CItemManager::StaticRefreshInfoThread( void *param )
 {
 	CItemManager *pThis=(CItemManager*)param;
 	volatile DWORD MAIN_THREAD=pThis->m_MainThreadId;
 	SetThreadPriority(GetCurrentThread(),THREAD_PRIORITY_IDLE);
 	CoInitialize(NULL);
-	pThis->m_LoadIconData[2].Init();
-	pThis->RefreshInfoThread();
-	pThis->m_LoadIconData[2].Close();
+	int index=pThis->GetRefreshThreadIndex(GetCurrentThreadId());
+	Assert(index>=0);
+	pThis->m_LoadIconData[2+index].Init();
+	pThis->RefreshInfoThread(index);
+	pThis->m_LoadIconData[2+index].Close();
 	CoUninitialize();
 	return MAIN_THREAD-MAIN_THREAD;
 }
@@ -3050,6 +3529,7 @@ namespace
 		int PATHLen;
 		FILETIME timestamp;
 		int bitmapW, bitmapH;
+		int sharedIndex; // 0 - the pixels follow, otherwise the index of an earlier icon with the same bitmap
 	};
 
 	struct ItemData
@@ -3134,26 +3614,17 @@ static bool ReadCacheFile( HANDLE file, CString &data, int len )
 	return true;
 }
 
-static bool ReadCacheFile( HANDLE file, HDC hdc, HBITMAP &data, int width, int height )
+static bool ReadCacheFile( HANDLE file, CIconAtlas &atlas, const IconBitmap *&data, int width, int height )
 {
 	std::vector<DWORD> bits(width*height);
 	if (bits.empty()) return false;
-	BITMAPINFO bi={0};
-	bi.bmiHeader.biSize=sizeof(BITMAPINFOHEADER);
-	bi.bmiHeader.biWidth=width;
-	bi.bmiHeader.biHeight=height;
-	bi.bmiHeader.biPlanes=1;
-	bi.bmiHeader.biBitCount=32;
 	DWORD q;
 	int size=width*height*4;
 	if (!ReadFile(file,&bits[0],size,&q,NULL) || q!=size)
 		return false;
-	unsigned int *pBits;
-	data=CreateDIBSection(hdc,&bi,DIB_RGB_COLORS,(void**)&pBits,NULL,0);
-	if (!data)
-		return false;
-	memcpy(pBits,&bits[0],size);
-	return true;
+	// the cache file stores the bitmaps bottom-up
+	data=atlas.AddBits((const unsigned int*)&bits[0],width,height,true);
+	return data!=NULL;
 }
 
 static void WriteCacheFile( HANDLE file, DWORD data )
@@ -3192,41 +3663,49 @@ static void WriteCacheFile( HANDLE file, const CString &data )
 	}
 }
 
-static void WriteCacheFile( HANDLE file, HDC hdc, HBITMAP data, int width, int height )
+static void WriteCacheFile( HANDLE file, const IconBitmap *data )
 {
+	int width=data->rc.width, height=data->rc.height;
 	std::vector<DWORD> bits(width*height);
 	if (bits.empty()) return;
-	BITMAPINFO bi={0};
-	bi.bmiHeader.biSize=sizeof(BITMAPINFOHEADER);
-	bi.bmiHeader.biWidth=width;
-	bi.bmiHeader.biHeight=height;
-	bi.bmiHeader.biPlanes=1;
-	bi.bmiHeader.biBitCount=32;
-	GetDIBits(hdc,data,0,height,&bits[0],&bi,DIB_RGB_COLORS);
+	for (int y=0;y<height;y++)
+		memcpy(&bits[(height-1-y)*width],data->bits+y*data->stride,width*4);
 	DWORD q;
 	WriteFile(file,&bits[0],width*height*4,&q,NULL);
 }
 
-bool CItemManager::CompareModuleTimeStamp( const CString &PATH, const FILETIME &timestamp, std::vector<ModuleInfo> &modules )
+static unsigned __int64 FileTimeToInt( const FILETIME &time )
 {
-	for (std::vector<ModuleInfo>::const_iterator it=modules.begin();it!=modules.end();++it)
-	{
-		if (it->PATH==PATH)
-			return (CompareFileTime(&timestamp,&it->timestamp)==0);
-	}
-	WIN32_FILE_ATTRIBUTE_DATA attributes={0};
-	if (GetFileAttributesEx(PATH,GetFileExInfoStandard,&attributes))
-	{
-		ModuleInfo info={PATH,attributes.ftLastWriteTime};
-		modules.push_back(info);
-		return (CompareFileTime(&timestamp,&info.timestamp)==0);
-	}
-	else
-	{
-		ModuleInfo info={PATH};
-		modules.push_back(info);
+	return (((unsigned __int64)time.dwHighDateTime)<<32)|time.dwLowDateTime;
+}
+
+static bool StatModule( const wchar_t *PATH, unsigned __int64 &timestamp )
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!GetFileAttributesEx(PATH,GetFileExInfoStandard,&attributes))
 		return false;
+	timestamp=FileTimeToInt(attributes.ftLastWriteTime);
+	return true;
+}
+
+// reads the icon records and collects their modules, then rewinds the file
+static void CollectCacheModules( HANDLE file, CModuleValidator &validator )
+{
+	LARGE_INTEGER start={0}, zero={0};
+	if (!SetFilePointerEx(file,zero,&start,FILE_CURRENT))
+		return;
+	while (ReadCacheFile(file)=='ICON')
+	{
+		IconData data;
+		CString PATH;
+		if (!ReadCacheFile(file,data) || !ReadCacheFile(file,PATH,data.PATHLen))
+			break;
+		validator.AddModule(PATH);
+		if (data.sharedIndex==0)
+			SetFilePointer(file,data.bitmapW*data.bitmapH*4,NULL,FILE_CURRENT);
 	}
+	SetFilePointerEx(file,start,NULL,FILE_BEGIN);
+	validator.StatModules();
 }
 
 void CItemManager::LoadCacheFile( void )
@@ -3243,11 +3722,9 @@ void CItemManager::LoadCacheFile( void )
 
 	bool bError=true;
 	DWORD tag=ReadCacheFile(file);
-	std::vector<ModuleInfo> modules;
-	ModuleInfo stdInfo={L"SHELL32.DLL"};
-	modules.push_back(stdInfo);
-	stdInfo.PATH=L"IMAGERES.DLL";
-	modules.push_back(stdInfo);
+	CModuleValidator modules(StatModule);
+	modules.SetTimeStamp(L"SHELL32.DLL",0);
+	modules.SetTimeStamp(L"IMAGERES.DLL",0);
 	m_BlackListInfos10.clear();
 	if (tag=='CLSH')
 	{
@@ -3261,13 +3738,15 @@ void CItemManager::LoadCacheFile( void )
 			int size2=ReadCacheFile(file);
 			int size3=ReadCacheFile(file);
 			int langHash=ReadCacheFile(file);
+			bool bSizesMatch=(size1==SMALL_ICON_SIZE && size2==LARGE_ICON_SIZE && size3==EXTRA_LARGE_ICON_SIZE);
+			if (bSizesMatch)
+				CollectCacheModules(file,modules);
 			bError=false;
 			tag=ReadCacheFile(file);
-			HDC hdc=CreateCompatibleDC(NULL);
 			while (tag=='ICON')
 			{
 				IconData data;
-				if (!ReadCacheFile(file,data))
+				if (!ReadCacheFile(file,data) || data.sizeType<0 || data.sizeType>=ICON_SIZE_COUNT)
 				{
 					bError=true;
 					break;
@@ -3277,14 +3756,35 @@ void CItemManager::LoadCacheFile( void )
 				info.timestamp=data.timestamp;
 				info.bTemp=false;
 				info.bMetro=false;
+				info.bUsed=false;
 				if (!ReadCacheFile(file,info.PATH,data.PATHLen))
 				{
 					bError=true;
 					break;
 				}
-				if (size1==SMALL_ICON_SIZE && size2==LARGE_ICON_SIZE && size3==EXTRA_LARGE_ICON_SIZE && CompareModuleTimeStamp(info.PATH,info.timestamp,modules))
+				info.PATH=m_StringPool.Intern(info.PATH);
+				if (data.sharedIndex<0 || data.sharedIndex>=(int)remapIcons.size())
+				{
+					bError=true;
+					break;
+				}
+				bool bValid=(bSizesMatch && modules.Validate(info.PATH,FileTimeToInt(info.timestamp)));
+				if (data.sharedIndex>0)
+				{
+					// the bitmap is shared with an earlier icon. if that icon was not loaded, this one will be reloaded too
+					const IconInfo *pShared=remapIcons[data.sharedIndex];
+					if (bValid && pShared && pShared->sizeType==data.sizeType)
+					{
+						info.bitmap=pShared->bitmap;
+						CIconAtlas::AddRef(info.bitmap);
+						remapIcons.push_back(&m_IconInfos.emplace(data.key,info)->second);
+					}
+					else
+						remapIcons.push_back(NULL);
+				}
+				else if (bValid)
 				{
-					if (!ReadCacheFile(file,hdc,info.bitmap,data.bitmapW,data.bitmapH))
+					if (!ReadCacheFile(file,m_IconAtlas[data.sizeType],info.bitmap,data.bitmapW,data.bitmapH))
 					{
 						bError=true;
 						break;
@@ -3299,7 +3799,6 @@ void CItemManager::LoadCacheFile( void )
 				}
 				tag=ReadCacheFile(file);
 			}
-			DeleteDC(hdc);
 			if (tag!='ITEM')
 			{
 				bError=true;
@@ -3334,8 +3833,10 @@ void CItemManager::LoadCacheFile( void )
 				info.bExplicitAppId=data.bExplicitAppId;
 				info.validFlags=data.validFlags;
 				info.refreshFlags=0;
-				info.iconColor=data.iconColor;
 				info.iconIndex=data.iconIndex;
+				ItemInfoCold tempCold;
+				ItemInfoCold &cold=(data.targetPidlSize>0 || data.targetPATHLen>0 || data.metroNameLen>0 || data.iconColor!=0)?info.SetCold():tempCold;
+				cold.iconColor=data.iconColor;
 
 				info.smallIcon=data.smallIcon<(int)remapIcons.size()?remapIcons[data.smallIcon]:NULL;
 				if (!info.smallIcon)
@@ -3359,11 +3860,17 @@ void CItemManager::LoadCacheFile( void )
 				bError=bError || !ReadCacheFile(file,info.pidl,data.pidlSize);
 				bError=bError || !ReadCacheFile(file,info.path,data.pathLen);
 				bError=bError || !ReadCacheFile(file,info.PATH,data.PATHLen);
-				bError=bError || !ReadCacheFile(file,info.targetPidl,data.targetPidlSize);
-				bError=bError || !ReadCacheFile(file,info.targetPATH,data.targetPATHLen);
+				bError=bError || !ReadCacheFile(file,cold.targetPidl,data.targetPidlSize);
+				bError=bError || !ReadCacheFile(file,cold.targetPATH,data.targetPATHLen);
 				bError=bError || !ReadCacheFile(file,info.appid,data.appidLen);
-				bError=bError || !ReadCacheFile(file,info.metroName,data.metroNameLen);
+				bError=bError || !ReadCacheFile(file,cold.metroName,data.metroNameLen);
 				bError=bError || !ReadCacheFile(file,info.iconPath,data.iconPathLen);
+				info.path=m_StringPool.Intern(info.path);
+				info.PATH=m_StringPool.Intern(info.PATH);
+				cold.targetPATH=m_StringPool.Intern(cold.targetPATH);
+				info.appid=m_StringPool.Intern(info.appid);
+				cold.metroName=m_StringPool.Intern(cold.metroName);
+				info.iconPath=m_StringPool.Intern(info.iconPath);
 
 				tag=ReadCacheFile(file);
 			}
@@ -3383,12 +3890,7 @@ void CItemManager::LoadCacheFile( void )
 	if (bError)
 	{
 		m_ItemInfos.clear();
-		for (std::multimap<unsigned int,IconInfo>::const_iterator it=m_IconInfos.begin();it!=m_IconInfos.end();++it)
-		{
-			if (it->second.bitmap)
-				DeleteObject(it->second.bitmap);
-		}
-		m_IconInfos.clear();
+		ClearIcons();
 		CreateDefaultIcons();
 	}
 }
@@ -3396,6 +3898,7 @@ void CItemManager::LoadCacheFile( void )
 DWORD CALLBACK CItemManager::SaveCacheFileThread( void *param )
 {
 	CItemManager *pThis=(CItemManager*)param;
+	int time0=GetTickCount();
 	wchar_t path[_MAX_PATH]=L"%LOCALAPPDATA%\\OpenShell";
 	DoEnvironmentSubst(path,_MAX_PATH);
 	SHCreateDirectory(NULL,path);
@@ -3440,31 +3943,42 @@ DWORD CALLBACK CItemManager::SaveCacheFileThread( void *param )
 			blackList.push_back(*it);
 	}
 
-	HDC hdc=CreateCompatibleDC(NULL);
 	std::map<const IconInfo*,int> remapIcons;
+	std::map<const IconBitmap*,int> savedBitmaps; // bitmap -> index of the first icon that uses it
 	int iconIndex=1;
+	int sharedCount=0, sharedBytes=0;
 	// save cached icons and info
 	for (std::vector<const std::pair<const unsigned int,IconInfo>*>::const_iterator it=iconInfos.begin();it!=iconInfos.end();++it)
 	{
 		RWLock lock(pThis,false,RWLOCK_ICONS);
-		if ((*it)->second.bTemp || (*it)->second.bMetro) continue;
+		if ((*it)->second.bTemp || (*it)->second.bMetro || !(*it)->second.bitmap) continue;
 		remapIcons[&(*it)->second]=iconIndex++;
 		IconData data;
 		data.key=(*it)->first;
 		data.sizeType=(*it)->second.sizeType;
 		data.timestamp=(*it)->second.timestamp;
 		data.PATHLen=(*it)->second.PATH.GetLength();
-		BITMAP bmp;
-		GetObject((*it)->second.bitmap,sizeof(bmp),&bmp);
-		data.bitmapW=bmp.bmWidth;
-		data.bitmapH=bmp.bmHeight;
+		data.bitmapW=(*it)->second.bitmap->rc.width;
+		data.bitmapH=(*it)->second.bitmap->rc.height;
+		std::map<const IconBitmap*,int>::const_iterator sharedIt=savedBitmaps.find((*it)->second.bitmap);
+		if (sharedIt==savedBitmaps.end())
+		{
+			data.sharedIndex=0;
+			savedBitmaps[(*it)->second.bitmap]=iconIndex-1;
+		}
+		else
+		{
+			data.sharedIndex=sharedIt->second;
+			sharedCount++;
+			sharedBytes+=data.bitmapW*data.bitmapH*4;
+		}
 
 		WriteCacheFile(file,'ICON');
 		WriteCacheFile(file,data);
 		WriteCacheFile(file,(*it)->second.PATH);
-		WriteCacheFile(file,hdc,(*it)->second.bitmap,data.bitmapW,data.bitmapH);
+		if (data.sharedIndex==0)
+			WriteCacheFile(file,(*it)->second.bitmap);
 	}
-	DeleteDC(hdc);
 
 	FILE *log=NULL;
 	if (g_LogCategories&LOG_CACHE)
@@ -3475,6 +3989,17 @@ DWORD CALLBACK CItemManager::SaveCacheFileThread( void *param )
 		{
 			wchar_t bom=0xFEFF;
 			fwrite(&bom,2,1,log);
+			fwprintf(log,L"Icons: %d, unique bitmaps: %d, shared: %d, disk bytes saved: %d\r\n",iconIndex-1,(int)savedBitmaps.size(),sharedCount,sharedBytes);
+			CStringPool::Stats poolStats;
+			pThis->m_StringPool.GetStats(poolStats);
+			fwprintf(log,L"Strings: %d, bytes: %d, shared: %d, memory bytes saved: %d\r\n",poolStats.count,poolStats.bytes,poolStats.hits,poolStats.savedBytes);
+			RWLock lock(pThis,false,RWLOCK_ICONS);
+			for (int i=0;i<ICON_SIZE_COUNT;i++)
+			{
+				CIconAtlas::Stats stats;
+				pThis->m_IconAtlas[i].GetStats(stats);
+				fwprintf(log,L"Atlas %d: pages: %d, bitmaps: %d, references: %d, bytes: %d, memory bytes saved: %d\r\n",i,pThis->m_IconAtlas[i].GetPageCount(),stats.bitmaps,stats.references,stats.bytes,stats.savedBytes);
+			}
 		}
 	}
 	for (std::vector<const std::pair<const unsigned int,ItemInfo>*>::const_iterator it=itemInfos.begin();it!=itemInfos.end();++it)
@@ -3505,12 +4030,13 @@ DWORD CALLBACK CItemManager::SaveCacheFileThread( void *param )
 		data.extraLargeIcon=(remapIt==remapIcons.end()?0:remapIt->second);
 
 		data.validFlags=(*it)->second.validFlags;
-		data.targetPidlSize=(*it)->second.targetPidl?ILGetSize((*it)->second.targetPidl):0;
-		data.targetPATHLen=(*it)->second.targetPATH.GetLength();
+		const ItemInfoCold &cold=(*it)->second.GetCold();
+		data.targetPidlSize=cold.targetPidl?ILGetSize(cold.targetPidl):0;
+		data.targetPATHLen=cold.targetPATH.GetLength();
 		data.appidLen=(*it)->second.appid.GetLength();
-		data.metroNameLen=(*it)->second.metroName.GetLength();
+		data.metroNameLen=cold.metroName.GetLength();
 		data.iconPathLen=(*it)->second.iconPath.GetLength();
-		data.iconColor=(*it)->second.iconColor;
+		data.iconColor=cold.iconColor;
 		data.iconIndex=(*it)->second.iconIndex;
 
 		WriteCacheFile(file,'ITEM');
@@ -3518,10 +4044,10 @@ DWORD CALLBACK CItemManager::SaveCacheFileThread( void *param )
 		WriteCacheFile(file,(*it)->second.GetLatestPidl(),data.pidlSize);
 		WriteCacheFile(file,(*it)->second.path);
 		WriteCacheFile(file,(*it)->second.PATH);
-		WriteCacheFile(file,(*it)->second.targetPidl,data.targetPidlSize);
-		WriteCacheFile(file,(*it)->second.targetPATH);
+		WriteCacheFile(file,cold.targetPidl,data.targetPidlSize);
+		WriteCacheFile(file,cold.targetPATH);
 		WriteCacheFile(file,(*it)->second.appid);
-		WriteCacheFile(file,(*it)->second.metroName);
+		WriteCacheFile(file,cold.metroName);
 		WriteCacheFile(file,(*it)->second.iconPath);
 		if (log) fwprintf(log,L"0x%08X - %s\r\n",(*it)->first,(const wchar_t*)(*it)->second.PATH);
 	}
@@ -3537,6 +4063,7 @@ DWORD CALLBACK CItemManager::SaveCacheFileThread( void *param )
 	wchar_t path2[_MAX_PATH]=L"%LOCALAPPDATA%\\OpenShell\\DataCache.db";
 	DoEnvironmentSubst(path2,_MAX_PATH);
 	MoveFileEx(path,path2,MOVEFILE_REPLACE_EXISTING);
+	pThis->m_SaveCacheTime=GetTickCount()-time0;
 	return 0;
 }
 
@@ -3545,8 +4072,10 @@ void CItemManager::SaveCacheFile( void )
 #ifdef DISABLE_CACHE
 		return;
 #endif
+	SaveAccessHistory();
 	if (g_LogCategories&LOG_CACHE)
 	{
+		LogCacheStats();
 		SaveCacheFileThread(this);
 		return;
 	}
@@ -3576,12 +4105,8 @@ void CItemManager::ClearCache( void )
 
 	m_BlackListInfos10.clear();
 	m_ItemInfos.clear();
-	for (std::multimap<unsigned int,IconInfo>::const_iterator it=m_IconInfos.begin();it!=m_IconInfos.end();++it)
-	{
-		if (it->second.bitmap)
-			DeleteObject(it->second.bitmap);
-	}
-	m_IconInfos.clear();
+	ClearIcons();
+	m_StringPool.Clear();
 	m_MetroItemInfos10.clear();
 	CreateDefaultIcons();
 	ItemInfo &item=m_ItemInfos.emplace(0,ItemInfo())->second;
@@ -5,6 +5,16 @@
 #pragma once
 
 #include "ComHelper.h"
+#include "IconAtlas.h"
+#include "ClockEvictor.h"
+#include "ColdHolder.h"
+#include "ThreadCounters.h"
+#include "RefreshQueue.h"
+#include "StringPool.h"
+#include "PrefixTrie.h"
+#include "BloomFilter.h"
+#include "AccessHistory.h"
+#include "UserAssistTable.h"
 #include <map>
 #include <set>
 #include <list>
@@ -58,8 +68,9 @@ public:
 		TIconSizeType sizeType;
 		bool bTemp; // the icon will be destroyed when the menu closes
 		bool bMetro; // this is a Metro icon. it may depend on the system color
+		mutable bool bUsed; // the icon was found or stored since the last eviction pass
 		FILETIME timestamp;
-		HBITMAP bitmap; // bitmaps are guaranteed to be valid on the main thread (if the handle is read atomically)
+		const IconBitmap *bitmap; // the icon in the atlas. guaranteed to be valid on the main thread (if the pointer is read atomically)
 
 		void SetPath( const wchar_t *path );
 		const CString &GetPath( void ) const { Assert(RWLock::ThreadHasReadLock(RWLOCK_ICONS)); return PATH; }
@@ -99,6 +110,24 @@ public:
 		LOCATION_METRO,
 	};
 
+	// the part of the item that is only needed when the item is refreshed, saved or executed. allocated only for the items that have such data
+	struct ItemInfoCold
+	{
+		ItemInfoCold( void ) { iconColor=0; }
+		bool IsEmpty( void ) const { return !newPidl && !targetPidl && targetPATH.IsEmpty() && metroName.IsEmpty() && packagePath.IsEmpty() && iconColor==0; }
+
+		CAbsolutePidl newPidl;
+		CAbsolutePidl targetPidl;
+		CString targetPATH;
+		CString metroName;
+		CString packagePath; // only for a metro app
+		DWORD iconColor;
+	};
+
+	// owns the cold part of an item. copying the holder copies the data
+	typedef CColdHolder<ItemInfoCold> ColdInfoHolder;
+
+	// the members are ordered so the ones used for painting and searching are close together
 	struct ItemInfo
 	{
 		ItemInfo( void )
@@ -106,9 +135,11 @@ public:
 			smallIcon=largeIcon=extraLargeIcon=NULL;
 			validFlags=refreshFlags=0;
 			bIconOnly=bTemp=bLink=bExplicitAppId=bNoPin=bNoNew=bMetroLink=bMetroApp=bProtectedLink=false;
+			bRefreshing=bRequeue=false;
 			writestamp.dwHighDateTime=writestamp.dwLowDateTime=0;
 			createstamp.dwHighDateTime=createstamp.dwLowDateTime=0;
 			location=LOCATION_UNKNOWN;
+			accessWeight=0;
 		}
 
 		// PATH never changes after the item is created. it can be accessed without a lock
@@ -129,18 +160,19 @@ public:
 		bool IsExplicitAppId( void ) const { Assert(RWLock::ThreadHasReadLock(RWLOCK_ITEMS)); return bExplicitAppId; }
 		const CString &GetPath( void ) const { Assert(RWLock::ThreadHasReadLock(RWLOCK_ITEMS)); return path; }
 		const CString &GetAppid( void ) const { Assert(RWLock::ThreadHasReadLock(RWLOCK_ITEMS)); return appid; }
-		const CString &GetTargetPATH( void ) const { Assert(RWLock::ThreadHasReadLock(RWLOCK_ITEMS)); return targetPATH; }
-		const CAbsolutePidl &GetTargetPidl( void ) const { Assert(RWLock::ThreadHasReadLock(RWLOCK_ITEMS)); return targetPidl; }
-		const CString &GetMetroName( void ) const { Assert(RWLock::ThreadHasReadLock(RWLOCK_ITEMS)); return metroName; }
+		const CString &GetTargetPATH( void ) const { Assert(RWLock::ThreadHasReadLock(RWLOCK_ITEMS)); return GetCold().targetPATH; }
+		const CAbsolutePidl &GetTargetPidl( void ) const { Assert(RWLock::ThreadHasReadLock(RWLOCK_ITEMS)); return GetCold().targetPidl; }
+		const CString &GetMetroName( void ) const { Assert(RWLock::ThreadHasReadLock(RWLOCK_ITEMS)); return GetCold().metroName; }
 		const CString &GetIconPath( void ) const { Assert(RWLock::ThreadHasReadLock(RWLOCK_ITEMS)); return iconPath; }
-		const CString &GetPackagePath( void ) const { Assert(RWLock::ThreadHasReadLock(RWLOCK_ITEMS)); return packagePath; }
+		const CString &GetPackagePath( void ) const { Assert(RWLock::ThreadHasReadLock(RWLOCK_ITEMS)); return GetCold().packagePath; }
 		TLocation GetLocation( void ) const { Assert(RWLock::ThreadHasReadLock(RWLOCK_ITEMS)); return location; }
 
 	private:
 		CAbsolutePidl pidl;
-		CAbsolutePidl newPidl;
-		FILETIME writestamp; // valid only for items with paths. the rest are assumed to never change
-		FILETIME createstamp; // valid only for items with paths. the rest are assumed to never change
+		int validFlags;
+		int refreshFlags; // 0 if not in the queue, the item can't be deleted if this is !=0
+		bool bRefreshing; // a refresh thread is working on the item
+		bool bRequeue; // the item was queued again while it was refreshing
 		bool bIconOnly;
 		bool bTemp; // the item and its icon will be destroyed when the menu closes (only allowed for small-icon items)
 		bool bLink;
@@ -150,23 +182,22 @@ public:
 		bool bNoPin; // the link shouldn't be pinned
 		bool bNoNew; // the link shouldn't be new
 		bool bExplicitAppId;
-		CString path; // only for a file
-		CString packagePath; // only for a metro app
 		TLocation location;
-
-		int validFlags;
-		int refreshFlags; // 0 if not in the queue, the item can't be deleted if this is !=0
-
-		CAbsolutePidl targetPidl;
-		CString targetPATH;
+		int accessWeight; // the biggest weight recorded in the access history in this session. main thread only
+		CString path; // only for a file
 		CString appid;
-		CString metroName;
-		CString iconPath;
-		DWORD iconColor;
+		FILETIME writestamp; // valid only for items with paths. the rest are assumed to never change
+		FILETIME createstamp; // valid only for items with paths. the rest are assumed to never change
 
+		CString iconPath;
 		int iconIndex; // used only if bIconOnly
 
-		const CAbsolutePidl &GetLatestPidl( void ) const { Assert(RWLock::ThreadHasReadLock(RWLOCK_ITEMS)); return newPidl?newPidl:pidl; }
+		ColdInfoHolder cold;
+
+		const ItemInfoCold &GetCold( void ) const { const ItemInfoCold *pCold=cold.Get(); return pCold?*pCold:s_EmptyColdInfo; }
+		// requires the write lock if the item is in m_ItemInfos
+		ItemInfoCold &SetCold( void ) { return cold.Alloc(); }
+		const CAbsolutePidl &GetLatestPidl( void ) const { Assert(RWLock::ThreadHasReadLock(RWLOCK_ITEMS)); const CAbsolutePidl &newPidl=GetCold().newPidl; return newPidl?newPidl:pidl; }
 
 		friend class CItemManager;
 	};
@@ -178,6 +209,10 @@ public:
 	const ItemInfo* GetLinkIcon(IShellLink* link, TIconSizeType iconSizeType);
 	const ItemInfo *GetMetroAppInfo10( const wchar_t *appid );
 	void UpdateItemInfo( const ItemInfo *pInfo, int refreshFlags, bool bHasWriteLock=false );
+	// moves the item to the front of the background queue if some of the refreshFlags are not loaded yet (call when the item becomes visible)
+	void BoostItemInfo( const ItemInfo *pInfo, int refreshFlags );
+	// records that the item was shown or executed, so it can be loaded first in the next session (main thread only)
+	void RecordItemAccess( const ItemInfo *pInfo, bool bExecuted );
 	void WaitForShortcuts( const POINT &balloonPos );
 	bool IsTaskbarPinned( const wchar_t *appid );
 	void UpdateNewPrograms( const POINT &balloonPos );
@@ -186,6 +221,31 @@ public:
 	bool HasNewApps( bool bReal ) { return m_bHasNewApps[bReal?0:1]; }
 	void RefreshInfos( void );
 
+	// a snapshot of the cache activity and contents, for logging and diagnostics
+	struct CacheStats
+	{
+		// counters since the start
+		int itemLookups; // calls to GetItemInfo
+		int itemHits; // the item was already in the cache
+		int itemRefreshes; // the item data or icons were loaded
+		int iconLookups; // icons requested from the icon cache
+		int iconHits; // icons found in the icon cache
+		int evictedIcons;
+		int reloadedIcons; // evicted icons that were needed again
+
+		// current state
+		int itemCount;
+		int pendingAppIds; // items waiting for INFO_LINK_APPID
+		int queueVisible, queueNext, queuePreload; // items waiting in the background queue
+		int iconCounts[ICON_SIZE_COUNT];
+		int iconBytes[ICON_SIZE_COUNT]; // unique bitmap memory in the atlas
+		int loadCacheTime, saveCacheTime; // in milliseconds. -1 if the cache was not loaded/saved yet
+	};
+
+	// main thread only
+	void GetCacheStats( CacheStats &stats );
+	void LogCacheStats( void );
+
 	void RemoveNewItem( PIDLIST_ABSOLUTE pItem1, PIDLIST_ABSOLUTE pItem2, bool bFolder );
 	void RemoveNewItems( bool bPrograms, bool bMetro );
 	void SaveOldItems( void );
@@ -253,24 +313,29 @@ public:
 private:
 	static int s_DPI;
 	static int s_DPIOverride;
+	static const ItemInfoCold s_EmptyColdInfo; // returned for the items without cold data
 
 	enum TLock
 	{
 		LOCK_CLEANUP,
+		LOCK_BOOST, // protects m_BoostedItems
 		LOCK_COUNT,
 	};
 
 	SRWLOCK m_RWLocks[RWLOCK_COUNT];
 	CRITICAL_SECTION m_CriticalSections[LOCK_COUNT];
 	DWORD m_CriticalSectionOwners[LOCK_COUNT];
-	HANDLE m_StartEvent; // start the refresh thread
-	HANDLE m_WorkEvent; // kicks off the refresh thread
+	enum { MAX_REFRESH_THREADS=4 };
+
+	HANDLE m_StartEvent; // start the refresh threads
+	HANDLE m_WorkEvent; // kicks off one refresh thread. the thread wakes up the next one if there is more work
 	HANDLE m_ExitEvent; // exit all threads
 	HANDLE m_DoneEvent; // done preloading start menu items
 	HANDLE m_PreloadItemsThread;
-	HANDLE m_RefreshInfoThread;
+	HANDLE m_RefreshInfoThreads[MAX_REFRESH_THREADS];
 	HANDLE m_SaveCacheThread;
-	DWORD m_MainThreadId, m_PreloadItemsThreadId, m_RefreshInfoThreadId;
+	DWORD m_MainThreadId, m_PreloadItemsThreadId, m_RefreshInfoThreadIds[MAX_REFRESH_THREADS];
+	int m_RefreshInfoThreadCount;
 
 	// per-thread info used to load icons
 	struct LoadIconData
@@ -284,8 +349,25 @@ private:
 		void Close( void );
 	};
 
-	LoadIconData m_LoadIconData[3]; // one for each thread (main, preload, refresh)
+	LoadIconData m_LoadIconData[2+MAX_REFRESH_THREADS]; // one for each thread (main, preload, refresh threads)
 	LoadIconData &GetLoadIconData( void );
+	int GetRefreshThreadIndex( DWORD thread ) const; // returns -1 if the thread is not a refresh thread
+
+	enum TCounter
+	{
+		COUNTER_ITEM_LOOKUPS,
+		COUNTER_ITEM_HITS,
+		COUNTER_ITEM_REFRESHES,
+		COUNTER_ICON_LOOKUPS,
+		COUNTER_ICON_HITS,
+
+		COUNTER_COUNT
+	};
+
+	// counters for the statistics. slots for the main, preload and refresh threads. the sets are merged by GetCacheStats
+	CThreadCounters<COUNTER_COUNT,2+MAX_REFRESH_THREADS> m_Counters;
+	void AddCounter( TCounter counter, int count=1 );
+	volatile int m_LoadCacheTime, m_SaveCacheTime;
 
 	class Lock
 	{
@@ -318,6 +400,8 @@ private:
 	void QueueItemInfo( ItemInfo *pInfo, int refreshFlags );
 	// doesn't require a lock
 	void RefreshItemInfo( ItemInfo *pInfo, int refreshFlags, IShellItem *pItem, bool bHasWriteLock );
+	// called by the refresh threads after the item is refreshed. queues it again if it was requested during the refresh
+	void EndRefreshItem( ItemInfo *pInfo );
 
 	void FindInCache( unsigned int hash, int &refreshFlags, const IconInfo *&smallIcon, const IconInfo *&largeIcon, const IconInfo *&extraLargeIcon );
 	void StoreInCache( unsigned int hash, const wchar_t *path, HBITMAP hSmallBitmap, HBITMAP hLargeBitmap, HBITMAP hExtraLargeBitmap, int refreshFlags, const IconInfo *&smallIcon, const IconInfo *&largeIcon, const IconInfo *&extraLargeIcon, bool bTemp, bool bMetro );
@@ -327,6 +411,11 @@ private:
 	HICON LoadShellIcon( int index, int iconSize );
 	HICON LoadShellIcon( int iconSize, IExtractIcon *pExtractW, const wchar_t *location, IExtractIconA *pExtractA, const char *locationA, int index );
 	HBITMAP BitmapFromIcon( HICON hIcon, int iconSize, bool bDestroyIcon=true );
+	// moves the bitmap into the atlas for the given size type. the bitmap is deleted
+	const IconBitmap *AddToAtlas( TIconSizeType sizeType, HBITMAP bitmap );
+	void ClearIcons( void );
+	// removes unused icons until the icon memory fits in m_IconCacheBudget. requires all locks
+	void EvictIcons( void );
 
 	bool m_bInitialized;
 
@@ -344,16 +433,38 @@ private:
 	// the key is a hash of the location and index
 	std::multimap<unsigned int,IconInfo> m_IconInfos;
 
+	// shared storage for the paths and names of the items and icons (except temp items)
+	CStringPool m_StringPool;
+
+	// storage for the icon bitmaps, one for each size type
+	CIconAtlas m_IconAtlas[ICON_SIZE_COUNT];
+
 	// bitmaps that were replaced but may still be used by the main thread
-	std::vector<HBITMAP> m_OldBitmaps;
+	std::vector<const IconBitmap*> m_OldBitmaps;
+
+	// memory budget for the icon bitmaps (0 - unlimited)
+	int m_IconCacheBudget;
+	CClockEvictor m_IconEvictor;
+	std::set<unsigned int> m_EvictedIcons; // keys of evicted icons, to detect when they are loaded again
+	int m_EvictedIconCount;
+	int m_ReloadedIconCount;
+	volatile LONG m_RefreshingCount; // number of threads in RefreshItemInfo. they may hold icons that are not stored in any item yet
 
 	const IconInfo *m_DefaultSmallIcon;
 	const IconInfo *m_DefaultLargeIcon;
 	const IconInfo *m_DefaultExtraLargeIcon;
 
-	// list of items to process in background
-	std::list<ItemInfo*> m_ItemQueue;
-	std::list<ItemInfo*> m_ItemQueueLow; // lower priority
+	// items to process in background
+	enum TQueuePriority
+	{
+		PRIORITY_VISIBLE, // the item is visible in a menu
+		PRIORITY_NEXT, // requested by the main thread, likely to be shown soon
+		PRIORITY_PRELOAD, // requested by the preload thread
+
+		PRIORITY_COUNT
+	};
+	CRefreshQueue<ItemInfo,PRIORITY_COUNT> m_ItemQueue;
+	std::vector<ItemInfo*> m_BoostedItems; // items that became visible. the refresh threads move them to PRIORITY_VISIBLE before taking the next item
 
 	std::vector<const ItemInfo*> m_NewPrograms;
 	std::vector<const ItemInfo*> m_NewProgramRoots;
@@ -376,10 +487,11 @@ private:
 
 	void LoadFolderItems( IShellItem *pFolder, int refreshFlags, int levels, TLocation location );
 	void LoadMetroItems( int refreshFlags );
+	void LoadChangedItem( const wchar_t *PATH, const wchar_t *root, bool bAdded, int refreshFlags, int levels, TLocation location );
 	void PreloadItemsThread( void );
 	void CreateDefaultIcons( void );
 	static DWORD CALLBACK StaticPreloadItemsThread( void *param );
-	void RefreshInfoThread( void );
+	void RefreshInfoThread( int index );
 	static DWORD CALLBACK StaticRefreshInfoThread( void *param );
 	static DWORD CALLBACK SaveCacheFileThread( void *param );
 
@@ -392,23 +504,10 @@ private:
 	CString m_RootDesktop;
 	CString m_RootTaskbar;
 	CString m_RootMetro;
+	CPrefixTrie m_LocationTrie; // all roots in the order they are checked. the value is TLocation
 	// can be called from any thread
 	TLocation DetermineLocation( const wchar_t *PATH );
 
-	struct ModuleInfo
-	{
-		CString PATH;
-		FILETIME timestamp;
-	};
-	static bool CompareModuleTimeStamp( const CString &PATH, const FILETIME &timestamp, std::vector<ModuleInfo> &modules );
-
-	struct KnownPathGuid
-	{
-		CComString path;
-		CComString guid;
-		int pathLen;
-	};
-
 	struct OldItemInfo
 	{
 		unsigned int hash;
@@ -418,10 +517,21 @@ private:
 	};
 
 	std::vector<OldItemInfo> m_OldItemInfos;
+	CBloomFilter m_OldItemFilter; // quickly rejects the hashes that are not in m_OldItemInfos
 
 	void LoadOldItems( void );
-	bool IsPathUsed( CRegKey &regKey, const wchar_t *path, const FILETIME &createstamp, const KnownPathGuid *knownPaths, int knownPathsCount, bool bMetroApp );
+	void UpdateOldItemFilter( void );
+	// knownPrefixes maps the paths in knownPaths to their index
+	bool IsPathUsed( const CUserAssistTable &userAssist, const wchar_t *path, const FILETIME &createstamp, bool bMetroApp );
 	void AddOldItems( const std::vector<unsigned> &hashes );
+
+	CAccessHistory m_AccessHistory; // main thread only
+	bool m_bAccessHistoryDirty;
+	std::vector<unsigned int> m_PredictedItems; // the items to load first. doesn't change after Init
+
+	void LoadAccessHistory( void );
+	void SaveAccessHistory( void );
+	void WarmPredictedItems( void );
 };
 
 CString GetPropertyStoreString( IPropertyStore *pStore, REFPROPERTYKEY key );
@@ -439,19 +549,7 @@ private:
 	CAbsolutePidl m_Root;
 };
 
-struct UserAssistData
-{
-	int pad1;
-	int count;
-	int pad2[2];
-	float history[10];
-	int last;
-	FILETIME timestamp;
-	int pad3;
-};
-
 void EncodeUserAssistPath( wchar_t *path );
-void EncodeRot13( wchar_t *text );
 
 enum TNetworkType
 {
@@ -469,7 +567,7 @@ bool MenuGetFileTimestamp( const wchar_t *path, FILETIME *pWriteTime, FILETIME *
 STDAPI ShGetKnownFolderPath( REFKNOWNFOLDERID rfid, PWSTR *pPath );
 STDAPI ShGetKnownFolderIDList(REFKNOWNFOLDERID rfid, PIDLIST_ABSOLUTE *pPidl );
 STDAPI ShGetKnownFolderItem(REFKNOWNFOLDERID rfid, IShellItem **ppItem );
-HBITMAP ColorizeMonochromeImage(HBITMAP bitmap, DWORD color);
+HBITMAP ColorizeMonochromeImage(const IconBitmap *bitmap, DWORD color);
 
 #define TASKBAR_PINNED_ROOT L"%APPDATA%\\Microsoft\\Internet Explorer\\Quick Launch\\User Pinned\\TaskBar"
 #define STARTSCREEN_COMMAND L"startscreen.lnk"
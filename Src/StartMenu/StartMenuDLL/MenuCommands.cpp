@@ -1584,6 +1584,8 @@ void CMenuContainer::ActivateItem( int index, TActivateType type, const POINT *p
 		if (item.id==MENU_EMPTY || item.id==MENU_EMPTY_TOP) return;
 		if (item.bFolder && pItemPidl1 && !item.bSplit && !GetSettingBool(L"EnableExplorer"))
 				return;
+		if (item.pItemInfo)
+			g_ItemManager.RecordItemAccess(item.pItemInfo,true);
 		if (item.id==MENU_SEARCH_BOX)
 		{
 			// the search button was pressed
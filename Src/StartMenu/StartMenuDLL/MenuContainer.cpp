@@ -50,6 +50,16 @@ enum
 	MENU_EXPANDED = 2, // the item is expanded
 };
 
+// the settings that are read while the menu is handling input or drawing
+static CSettingRef<int> g_SettingProgramsStyle(L"ProgramsStyle");
+static CSettingRef<int> g_SettingSearchBox(L"SearchBox");
+static CSettingRef<bool> g_SettingSearchSelect(L"SearchSelect");
+static CSettingRef<bool> g_SettingSearchInternet(L"SearchInternet");
+static CSettingRef<int> g_SettingRecentProgKeys(L"RecentProgKeys");
+static CSettingRef<bool> g_SettingEnableAccelerators(L"EnableAccelerators");
+static CSettingRef<bool> g_SettingAltAccelerators(L"AltAccelerators");
+static CSettingRef<int> g_SettingJumplistKeys(L"JumplistKeys");
+
 static StdMenuOption g_StdOptions[]=
 {
 	{MENU_COMPUTER,MENU_NONE}, // MENU_ENABLED|MENU_EXPANDED from settings
@@ -112,11 +122,11 @@ void CUserWindow::Init( CMenuContainer *pOwner )
 		m_UserBitmap=CMenuContainer::LoadUserImage(skin.User_image_size,skin.User_mask.GetBitmap());
 	else
 		m_UserBitmap=CMenuContainer::LoadUserImage(skin.User_image_size,NULL);
-	m_TimerBitmap=(HBITMAP)1;
+	m_TimerBitmap=(const IconBitmap*)1;
 	SetImage(NULL,false);
 }
 
-void CUserWindow::StartImageTimer( HBITMAP bmp )
+void CUserWindow::StartImageTimer( const IconBitmap *bmp )
 {
 	if (m_TimerBitmap==bmp) return;
 	m_TimerBitmap=bmp;
@@ -125,7 +135,7 @@ void CUserWindow::StartImageTimer( HBITMAP bmp )
 	SetTimer(TIMER_SET,time);
 }
 
-void CUserWindow::SetImage( HBITMAP bmp, bool bAnimate )
+void CUserWindow::SetImage( const IconBitmap *bmp, bool bAnimate )
 {
 	m_bDefaultImage=!bmp;
 	EnableWindow(m_bDefaultImage);
@@ -141,8 +151,8 @@ void CUserWindow::SetImage( HBITMAP bmp, bool bAnimate )
 	int iconSize=bmp?CItemManager::EXTRA_LARGE_ICON_SIZE:CMenuContainer::s_Skin.User_image_size;
 	if (bmp)
 	{
-		SelectObject(hsrc,bmp);
-		BitBlt(hdst,(m_Size.cx-iconSize)/2,(m_Size.cy-iconSize)/2,iconSize,iconSize,hsrc,0,0,SRCCOPY);
+		SelectObject(hsrc,bmp->page);
+		BitBlt(hdst,(m_Size.cx-iconSize)/2,(m_Size.cy-iconSize)/2,iconSize,iconSize,hsrc,bmp->rc.x,bmp->rc.y,SRCCOPY);
 	}
 	else
 	{
@@ -295,7 +305,7 @@ LRESULT CUserWindow::OnTimer( UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHa
 	if (wParam==TIMER_SET)
 	{
 		SetImage(m_TimerBitmap,true);
-		m_TimerBitmap=(HBITMAP)1;
+		m_TimerBitmap=(const IconBitmap*)1;
 		KillTimer(TIMER_SET);
 	}
 	return 0;
@@ -433,7 +443,7 @@ LRESULT CALLBACK CMenuContainer::SubclassSearchBox( HWND hWnd, UINT uMsg, WPARAM
 	{
 		LRESULT res=DefSubclassProc(hWnd,uMsg,wParam,lParam);
 		HDC hdc=(HDC)wParam;
-		if ((lParam&PRF_CLIENT) && ::GetWindowTextLength(hWnd)==0 && ((GetSettingInt(L"SearchBox")==SEARCHBOX_NORMAL && GetSettingBool(L"SearchSelect")) || GetFocus()!=hWnd) && pParent->m_SearchIndex>=0)
+		if ((lParam&PRF_CLIENT) && ::GetWindowTextLength(hWnd)==0 && ((g_SettingSearchBox==SEARCHBOX_NORMAL && g_SettingSearchSelect) || GetFocus()!=hWnd) && pParent->m_SearchIndex>=0)
 		{
 			RECT rc;
 			::SendMessage(hWnd,EM_GETRECT,0,(LPARAM)&rc);
@@ -1056,7 +1066,7 @@ void CMenuContainer::AddStandardItems( void )
 	if (m_pStdItem && m_pStdItem->id!=MENU_NO)
 	{
 		bool bItemsFirst=(m_Options&(CONTAINER_ITEMS_FIRST|CONTAINER_SEARCH))==CONTAINER_ITEMS_FIRST;
-		if (!m_Items.empty() && !(s_bWin7Style && !m_bSubMenu && GetSettingInt(L"ProgramsStyle")==PROGRAMS_HIDDEN))
+		if (!m_Items.empty() && !(s_bWin7Style && !m_bSubMenu && g_SettingProgramsStyle==PROGRAMS_HIDDEN))
 		{
 			MenuItem item(MENU_SEPARATOR);
 			if (m_pStdItem->id==MENU_COLUMN_PADDING)
@@ -1151,7 +1161,7 @@ void CMenuContainer::AddStandardItems( void )
 				m_Items.insert(m_Items.begin()+menuIdx,1,item);
 				menuIdx++;
 				searchProviderIndex=(int)menuIdx;
-				if (GetSettingBool(L"SearchInternet"))
+				if (g_SettingSearchInternet)
 				{
 					AddInternetSearch(menuIdx);
 					menuIdx++;
@@ -1501,7 +1511,7 @@ void CMenuContainer::AddStandardItems( void )
 
 void CMenuContainer::UpdateAccelerators( int first, int last )
 {
-	TRecentKeys recentKeys=(TRecentKeys)GetSettingInt(L"RecentProgKeys");
+	TRecentKeys recentKeys=(TRecentKeys)(int)g_SettingRecentProgKeys;
 
 	for (int i=first;i<last;i++)
 	{
@@ -2150,7 +2160,7 @@ void CMenuContainer::GetRecentPrograms( std::vector<MenuItem> &items, int maxCou
 		}
 	}
 
-	TRecentKeys recentKeys=(TRecentKeys)GetSettingInt(L"RecentProgKeys");
+	TRecentKeys recentKeys=(TRecentKeys)(int)g_SettingRecentProgKeys;
 	for (int idx=0;idx<(int)items.size();idx++)
 	{
 		MenuItem &item=items[idx];
@@ -2602,7 +2612,7 @@ void CMenuContainer::InitItems( void )
 	if (m_ScrollCount>0 && m_Items[m_ScrollCount-1].id==MENU_PROGRAMS_TREE)
 		m_ScrollCount--;
 
-	if (s_bWin7Style && !m_bSubMenu && GetSettingInt(L"ProgramsStyle")!=PROGRAMS_HIDDEN)
+	if (s_bWin7Style && !m_bSubMenu && g_SettingProgramsStyle!=PROGRAMS_HIDDEN)
 	{
 		MenuItem item(MENU_PROGRAMS_TREE);
 		m_Items.push_back(item);
@@ -2979,7 +2989,7 @@ bool CMenuContainer::InitSearchItems( void )
 	else
 	{
 		m_ScrollCount=(int)m_Items.size();
-		bool bInternet=GetSettingBool(L"SearchInternet");
+		bool bInternet=g_SettingSearchInternet;
 		if (s_SearchResults.bSearching)
 		{
 			MenuItem item(MENU_SEARCH_EMPTY);
@@ -3314,7 +3324,7 @@ void CMenuContainer::InitWindowInternal( bool bDontShrink, const POINT &corner,
 			}
 			else if (s_bWin7Style && item.id==MENU_PROGRAMS)
 			{
-				if (GetSettingInt(L"ProgramsStyle")==PROGRAMS_INLINE)
+				if (g_SettingProgramsStyle==PROGRAMS_INLINE)
 					item.drawType=item.bNew?MenuSkin::PROGRAMS_BUTTON_NEW:MenuSkin::PROGRAMS_BUTTON;
 				else
 					item.drawType=item.bNew?MenuSkin::PROGRAMS_CASCADING_NEW:MenuSkin::PROGRAMS_CASCADING;
@@ -3426,7 +3436,7 @@ void CMenuContainer::InitWindowInternal( bool bDontShrink, const POINT &corner,
 			}
 			else if (s_bWin7Style && item.id==MENU_PROGRAMS)
 			{
-				if (GetSettingInt(L"ProgramsStyle")!=PROGRAMS_HIDDEN)
+				if (g_SettingProgramsStyle!=PROGRAMS_HIDDEN)
 					h=settings.itemHeight;
 				else
 					h=0;
@@ -3962,7 +3972,7 @@ void CMenuContainer::InitWindowInternal( bool bDontShrink, const POINT &corner,
 			if (bRecentByName)
 				std::sort(m_Items.begin()+firstRecent,m_Items.begin()+lastRecent,MenuItem::MruNameComparator());
 
-			TRecentKeys recentKeys=(TRecentKeys)GetSettingInt(L"RecentProgKeys");
+			TRecentKeys recentKeys=(TRecentKeys)(int)g_SettingRecentProgKeys;
 			if (recentKeys>=RECENT_KEYS_DIGITS)
 			{
 				// reassign accelerators
@@ -4690,7 +4700,7 @@ void CMenuContainer::UpdateUserPicture( void )
 {
 	if (m_bTwoColumns && s_UserPicture.m_hWnd && s_UserPicture.IsWindowVisible())
 	{
-		HBITMAP bmp=NULL;
+		const IconBitmap *bmp=NULL;
 		int bmpIndex=m_HotItem>=0?m_HotItem:(m_ContextItem>=0?m_ContextItem:m_Submenu);
 		if (bmpIndex>=0 && bmpIndex<m_OriginalCount && bmpIndex<(int)m_Items.size() && m_Items[bmpIndex].column==1 && m_Items[bmpIndex].pItemInfo && m_Items[bmpIndex].pItemInfo->extraLargeIcon)
 			bmp=m_Items[bmpIndex].pItemInfo->extraLargeIcon->bitmap;
@@ -5111,10 +5121,10 @@ void CMenuContainer::UpdateSearchResults( bool bForceShowAll )
 // Turn on the keyboard cues from now on. This is done when a keyboard action is detected
 void CMenuContainer::ShowKeyboardCues( bool alt )
 {
-	if (!GetSettingBool(L"EnableAccelerators"))
+	if (!g_SettingEnableAccelerators)
 		return;
 
-	if (GetSettingBool(L"AltAccelerators") && !alt)
+	if (g_SettingAltAccelerators && !alt)
 		return;
 
 	if (!s_bKeyboardCues)
@@ -5484,7 +5494,7 @@ bool CMenuContainer::CanSelectItem( int index, bool bKeyboard )
 		return false;
 	if (item.itemRect.bottom==item.itemRect.top)
 		return false;
-	if (bKeyboard && item.id==MENU_SEARCH_BOX && GetSettingInt(L"SearchBox")!=SEARCHBOX_NORMAL)
+	if (bKeyboard && item.id==MENU_SEARCH_BOX && g_SettingSearchBox!=SEARCHBOX_NORMAL)
 		return false;
 	return true;
 }
@@ -6111,10 +6121,10 @@ LRESULT CMenuContainer::OnSysKeyDown( UINT uMsg, WPARAM wParam, LPARAM lParam, B
 
 LRESULT CMenuContainer::OnChar( UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled )
 {
-	if (!GetSettingBool(L"EnableAccelerators"))
+	if (!g_SettingEnableAccelerators)
 		return TRUE;
 
-	if (GetSettingBool(L"AltAccelerators") && !(HIWORD(lParam) & KF_ALTDOWN))
+	if (g_SettingAltAccelerators && !(HIWORD(lParam) & KF_ALTDOWN))
 		return TRUE;
 
 	if (wParam>=0xD800 && wParam<=0xDBFF)
@@ -6162,14 +6172,14 @@ LRESULT CMenuContainer::OnChar( UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& b
 		first=firstCustom;
 
 	// exactly 1 item has that accelerator
-	if (m_Items[first].bHasJumpList && GetSettingInt(L"JumplistKeys")==0)
+	if (m_Items[first].bHasJumpList && g_SettingJumplistKeys==0)
 	{
 		ActivateItem(first,ACTIVATE_SELECT,NULL);
 		return 0;
 	}
 	ActivateData data;
 	data.bNoModifiers=true;
-	if (!m_Items[first].bFolder || (!m_Items[first].bHasJumpList && m_Items[first].bSplit) || (m_Items[first].bHasJumpList && GetSettingInt(L"JumplistKeys")==1))
+	if (!m_Items[first].bFolder || (!m_Items[first].bHasJumpList && m_Items[first].bSplit) || (m_Items[first].bHasJumpList && g_SettingJumplistKeys==1))
 	{
 		ActivateItem(first,ACTIVATE_EXECUTE,NULL,&data);
 		return 0;
@@ -6509,7 +6519,7 @@ LRESULT CMenuContainer::OnMouseMove( UINT uMsg, WPARAM wParam, LPARAM lParam, BO
 						int time=s_HoverTime;
 						if (!bArrow && m_Items[m_HotItem].bSplit)
 							time=s_SplitHoverTime;
-						else if (s_bWin7Style && index==m_ProgramButtonIndex && GetSettingInt(L"ProgramsStyle")==PROGRAMS_INLINE)
+						else if (s_bWin7Style && index==m_ProgramButtonIndex && g_SettingProgramsStyle==PROGRAMS_INLINE)
 							time=m_bDisableProgHover?-1:s_ProgramsHoverTime;
 						if (time>=0)
 							SetTimer(TIMER_HOVER,time);
@@ -6814,7 +6824,7 @@ LRESULT CMenuContainer::OnLButtonDown( UINT uMsg, WPARAM wParam, LPARAM lParam,
 		}
 		const MenuItem &item=m_Items[index];
 		if (item.id==MENU_SEPARATOR) return 0;
-		if (index==m_ProgramButtonIndex && GetSettingInt(L"ProgramsStyle")==PROGRAMS_INLINE)
+		if (index==m_ProgramButtonIndex && g_SettingProgramsStyle==PROGRAMS_INLINE)
 		{
 			m_bDisableProgHover=true;
 			KillTimer(TIMER_HOVER);
@@ -6902,7 +6912,7 @@ LRESULT CMenuContainer::OnLButtonUp( UINT uMsg, WPARAM wParam, LPARAM lParam, BO
 				return 0;
 			}
 		}
-		else if (s_bWin7Style && item.id==MENU_PROGRAMS && GetSettingInt(L"ProgramsStyle")==PROGRAMS_INLINE && m_SubShowTime && (int)(GetTickCount()-m_SubShowTime)<500)
+		else if (s_bWin7Style && item.id==MENU_PROGRAMS && g_SettingProgramsStyle==PROGRAMS_INLINE && m_SubShowTime && (int)(GetTickCount()-m_SubShowTime)<500)
 			return 0; // ignore clicks soon after the programs open
 		if (index!=m_Submenu)
 		{
@@ -7984,7 +7994,7 @@ HWND CMenuContainer::ToggleStartMenu( int taskbarId, bool bKeyboard, bool bAllPr
 				g_StdOptions[i].options=GetSettingBool(L"Search")?MENU_ENABLED|MENU_EXPANDED:0;
 				break;
 			case MENU_SEARCH_BOX:
-				g_StdOptions[i].options=GetSettingInt(L"SearchBox")!=SEARCHBOX_HIDDEN?MENU_ENABLED|MENU_EXPANDED:0;
+				g_StdOptions[i].options=g_SettingSearchBox!=SEARCHBOX_HIDDEN?MENU_ENABLED|MENU_EXPANDED:0;
 				break;
 			case MENU_USERFILES:
 				if (s_bWin7Style)
@@ -8058,7 +8068,7 @@ HWND CMenuContainer::ToggleStartMenu( int taskbarId, bool bKeyboard, bool bAllPr
 
 	s_bNoDragDrop=!GetSettingBool(L"EnableDragDrop");
 	s_bNoContextMenu=!GetSettingBool(L"EnableContextMenu");
-	s_bKeyboardCues=bKeyboard&&GetSettingBool(L"EnableAccelerators")&&!GetSettingBool(L"AltAccelerators");
+	s_bKeyboardCues=bKeyboard&&g_SettingEnableAccelerators&&!g_SettingAltAccelerators;
 	s_RecentPrograms=(TRecentPrograms)GetSettingInt(L"RecentPrograms");
 	if (s_RecentPrograms!=RECENT_PROGRAMS_NONE)
 		LoadMRUShortcuts();
@@ -8563,10 +8573,10 @@ HWND CMenuContainer::ToggleStartMenu( int taskbarId, bool bKeyboard, bool bAllPr
 	pStartMenu->InitWindow();
 	pStartMenu->SetHotItem((bKeyboard && bAllPrograms)?0:-1);
 	bool bTreeSelected=false;
-	if (s_bWin7Style && GetSettingInt(L"ProgramsStyle")==PROGRAMS_INLINE && GetSettingBool(L"OpenPrograms"))
+	if (s_bWin7Style && g_SettingProgramsStyle==PROGRAMS_INLINE && GetSettingBool(L"OpenPrograms"))
 	{
 		pStartMenu->SetMenuMode(MODE_PROGRAMS);
-		if (pStartMenu->m_SearchIndex<0 || GetSettingInt(L"SearchBox")!=SEARCHBOX_NORMAL || !GetSettingBool(L"SearchSelect"))
+		if (pStartMenu->m_SearchIndex<0 || g_SettingSearchBox!=SEARCHBOX_NORMAL || !g_SettingSearchSelect)
 		{
 			bTreeSelected=true;
 			pStartMenu->SetHotItem(pStartMenu->m_ProgramTreeIndex,false,false);
@@ -8602,7 +8612,7 @@ HWND CMenuContainer::ToggleStartMenu( int taskbarId, bool bKeyboard, bool bAllPr
 	}
 
 	s_bOverrideFirstDown=false;
-	if (pStartMenu->m_SearchIndex>=0 && GetSettingInt(L"SearchBox")==SEARCHBOX_NORMAL && GetSettingBool(L"SearchSelect"))
+	if (pStartMenu->m_SearchIndex>=0 && g_SettingSearchBox==SEARCHBOX_NORMAL && g_SettingSearchSelect)
 	{
 		pStartMenu->ActivateItem(pStartMenu->m_SearchIndex,ACTIVATE_SELECT,NULL);
 		if (pStartMenu->m_bTwoColumns && pStartMenu->m_Items[pStartMenu->m_SearchIndex].column==0 && pStartMenu->m_SearchIndex+1<(int)pStartMenu->m_Items.size() && pStartMenu->m_Items[pStartMenu->m_SearchIndex+1].column==1)
@@ -191,7 +191,7 @@ public:
 class CUserWindow: public CWindowImpl<CUserWindow>
 {
 public:
-	CUserWindow( void ) { m_pOwner=NULL; m_Bits=NULL; m_bDefaultImage=true; m_Bitmap=m_UserBitmap=m_TimerBitmap=NULL; m_Timer=0; m_Size.cx=m_Size.cy=0; }
+	CUserWindow( void ) { m_pOwner=NULL; m_Bits=NULL; m_bDefaultImage=true; m_Bitmap=m_UserBitmap=NULL; m_TimerBitmap=NULL; m_Timer=0; m_Size.cx=m_Size.cy=0; }
 	DECLARE_WND_CLASS_EX(L"OpenShell.CUserWindow",0,COLOR_MENU)
 
 	// message handlers
@@ -207,8 +207,8 @@ public:
 	void Init( CMenuContainer *pOwner );
 	void Update( int alpha=255 );
 	void UpdatePartial( POINT pos, const RECT *pClipRect );
-	void SetImage( HBITMAP bmp, bool bAnimate );
-	void StartImageTimer( HBITMAP bmp );
+	void SetImage( const IconBitmap *bmp, bool bAnimate );
+	void StartImageTimer( const IconBitmap *bmp );
 
 protected:
 	LRESULT OnDestroy( UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled );
@@ -228,7 +228,7 @@ private:
 	HBITMAP m_Bitmap;
 	SIZE m_Size;
 	int m_Timer;
-	HBITMAP m_TimerBitmap;
+	const IconBitmap *m_TimerBitmap;
 	bool m_bUserBitmapMask;
 
 	enum
@@ -22,6 +22,7 @@
 #include <chrono>
 
 static BLENDFUNCTION g_AlphaFunc={AC_SRC_OVER,0,255,AC_SRC_ALPHA};
+static CSettingRef<int> g_SettingRecentProgKeys(L"RecentProgKeys");
 
 MIDL_INTERFACE("4BEDE6E0-A125-46A7-A3BF-4187165E09A5")
 IUserTileStore8 : public IUnknown
@@ -1598,7 +1599,7 @@ void CMenuContainer::DrawBackground( HDC hdc, const RECT &drawRect )
 	MenuSkin::TOpacity opacity=m_bSubMenu?s_Skin.Submenu_opacity:s_Skin.Main_opacity;
 	int glow=s_Skin.ItemSettings[m_bSubMenu?MenuSkin::SUBMENU_ITEM:MenuSkin::COLUMN1_ITEM].glowSize;
 	if (!s_Theme) glow=0;
-	TRecentKeys recentType=(TRecentKeys)GetSettingInt(L"RecentProgKeys");
+	TRecentKeys recentType=(TRecentKeys)(int)g_SettingRecentProgKeys;
 
 	if (m_bSubMenu)
 	{
@@ -2269,24 +2270,27 @@ void CMenuContainer::DrawBackground( HDC hdc, const RECT &drawRect )
 				MarginsBlit(hdc2,hdc,rSrc,rDst,rMargins,settings.bmpIconFrame.bIs32);
 				SelectObject(hdc2,bmp0);
 			}
+			g_ItemManager.BoostItemInfo(item.pItemInfo,(settings.iconSize==MenuSkin::ICON_SIZE_LARGE)?CItemManager::INFO_LARGE_ICON:CItemManager::INFO_SMALL_ICON);
 			const CItemManager::IconInfo *pIcon=(settings.iconSize==MenuSkin::ICON_SIZE_LARGE)?item.pItemInfo->largeIcon:item.pItemInfo->smallIcon;
 			if (pIcon && pIcon->bitmap)
 			{
+				CItemManager::RWLock iconLock(&g_ItemManager,false,CItemManager::RWLOCK_ICONS);
 				HBITMAP temp = ColorizeMonochromeImage(pIcon->bitmap, color);
-				HBITMAP bitmap = temp ? temp : pIcon->bitmap;
-
-				BITMAP info;
-				GetObject(bitmap,sizeof(info),&info);
-				HGDIOBJ bmp0=SelectObject(hdc2,bitmap);
-				if (bmp0)
-				{
-					BLENDFUNCTION func={AC_SRC_OVER,0,255,AC_SRC_ALPHA};
-					AlphaBlend(hdc,iconX,iconY,iconSize.cx,iconSize.cy,hdc2,0,0,info.bmWidth,info.bmHeight,func);
-					SelectObject(hdc2,bmp0);
-				}
-
 				if (temp)
+				{
+					BITMAP info;
+					GetObject(temp,sizeof(info),&info);
+					HGDIOBJ bmp0=SelectObject(hdc2,temp);
+					if (bmp0)
+					{
+						BLENDFUNCTION func={AC_SRC_OVER,0,255,AC_SRC_ALPHA};
+						AlphaBlend(hdc,iconX,iconY,iconSize.cx,iconSize.cy,hdc2,0,0,info.bmWidth,info.bmHeight,func);
+						SelectObject(hdc2,bmp0);
+					}
 					DeleteObject(temp);
+				}
+				else
+					DrawIconBitmap(hdc,hdc2,iconX,iconY,iconSize.cx,iconSize.cy,pIcon->bitmap);
 			}
 		}
 		else if (item.id==MENU_SHUTDOWN_BUTTON && s_bHasUpdates && s_Skin.Shutdown_bitmap.GetBitmap())
@@ -2852,12 +2856,12 @@ void CProgramsTree::DrawTreeItem( HDC hdc, HDC hsrc, HTREEITEM hItem, const RECT
 	int x=rc.left-iconSize-3-iconPadding.right;
 	int y=rc.top+iconTopOffset;
 
+	if (pItem->pItemInfo1)
+		g_ItemManager.BoostItemInfo(pItem->pItemInfo1,CItemManager::INFO_SMALL_ICON);
 	if (pItem->pItemInfo1 && pItem->pItemInfo1->smallIcon)
 	{
-		HGDIOBJ bmp0=SelectObject(hsrc,pItem->pItemInfo1->smallIcon->bitmap);
-		BLENDFUNCTION func={AC_SRC_OVER,0,255,AC_SRC_ALPHA};
-		AlphaBlend(hdc,x,y,iconSize,iconSize,hsrc,0,0,iconSize,iconSize,func);
-		SelectObject(hsrc,bmp0);
+		CItemManager::RWLock iconLock(&g_ItemManager,false,CItemManager::RWLOCK_ICONS);
+		DrawIconBitmap(hdc,hsrc,x,y,iconSize,iconSize,pItem->pItemInfo1->smallIcon->bitmap);
 	}
 
 	// draw text
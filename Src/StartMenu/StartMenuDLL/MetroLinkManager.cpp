@@ -381,9 +381,15 @@ void UninstallMetroApp( HWND parent, const wchar_t *name, const wchar_t *appid )
 		const CItemManager::ItemInfo *pItemInfo=g_ItemManager.GetItemInfo(pAppItem,pidl,CItemManager::INFO_LINK|CItemManager::INFO_METRO);
 		g_ItemManager.UpdateItemInfo(pItemInfo,CItemManager::INFO_LARGE_ICON|CItemManager::INFO_REFRESH_NOW);
 		HBITMAP hMonoBitmap=CreateBitmap(CItemManager::LARGE_ICON_SIZE,CItemManager::LARGE_ICON_SIZE,1,1,NULL);
-		ICONINFO info={TRUE,0,0,hMonoBitmap,pItemInfo->largeIcon->bitmap};
+		HBITMAP hColorBitmap;
+		{
+			CItemManager::RWLock lock(&g_ItemManager,false,CItemManager::RWLOCK_ICONS);
+			hColorBitmap=CreateIconBitmapCopy(pItemInfo->largeIcon->bitmap);
+		}
+		ICONINFO info={TRUE,0,0,hMonoBitmap,hColorBitmap};
 		hIcon=CreateIconIndirect(&info);
 		DeleteObject(hMonoBitmap);
+		if (hColorBitmap) DeleteObject(hColorBitmap);
 	}
 
 	TASKDIALOGCONFIG task={sizeof(task),parent,NULL,TDF_ALLOW_DIALOG_CANCELLATION|TDF_USE_HICON_MAIN,TDCBF_YES_BUTTON|TDCBF_NO_BUTTON};
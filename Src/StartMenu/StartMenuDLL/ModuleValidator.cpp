@@ -0,0 +1,58 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include "stdafx.h"
+#include "ModuleValidator.h"
+#include "FNVHash.h"
+
+CModuleValidator::Module &CModuleValidator::GetModule( const wchar_t *PATH )
+{
+	unsigned int hash=CalcFNVHash(PATH);
+	for (std::multimap<unsigned int,Module>::iterator it=m_Modules.find(hash);it!=m_Modules.end() && it->first==hash;++it)
+	{
+		if (it->second.PATH==PATH)
+			return it->second;
+	}
+	Module &module=m_Modules.emplace(hash,Module())->second;
+	module.PATH=PATH;
+	module.timestamp=0;
+	module.bStat=module.bExists=false;
+	return module;
+}
+
+void CModuleValidator::Stat( Module &module )
+{
+	module.bExists=m_StatFunc(module.PATH,module.timestamp);
+	module.bStat=true;
+	m_StatCount++;
+}
+
+void CModuleValidator::SetTimeStamp( const wchar_t *PATH, unsigned __int64 timestamp )
+{
+	Module &module=GetModule(PATH);
+	module.timestamp=timestamp;
+	module.bStat=module.bExists=true;
+}
+
+void CModuleValidator::AddModule( const wchar_t *PATH )
+{
+	GetModule(PATH);
+}
+
+void CModuleValidator::StatModules( void )
+{
+	for (std::multimap<unsigned int,Module>::iterator it=m_Modules.begin();it!=m_Modules.end();++it)
+	{
+		if (!it->second.bStat)
+			Stat(it->second);
+	}
+}
+
+bool CModuleValidator::Validate( const wchar_t *PATH, unsigned __int64 timestamp )
+{
+	Module &module=GetModule(PATH);
+	if (!module.bStat)
+		Stat(module);
+	return module.bExists && module.timestamp==timestamp;
+}
@@ -0,0 +1,49 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include <map>
+#include <vector>
+
+// CModuleValidator - checks if the modules used by the cached icons have changed since the cache was saved
+// First all modules are collected with AddModule, then StatModules gets their timestamps in one batch, and then Validate checks each icon.
+// Modules that were not collected are checked the first time they are validated.
+// The validator doesn't access the file system directly. It uses the provided stat function
+class CModuleValidator
+{
+public:
+	// returns false if the module doesn't exist
+	typedef bool (*TStatFunc)( const wchar_t *PATH, unsigned __int64 &timestamp );
+
+	CModuleValidator( TStatFunc statFunc ) { m_StatFunc=statFunc; m_StatCount=0; }
+
+	// adds a module with a known timestamp, which is never checked
+	void SetTimeStamp( const wchar_t *PATH, unsigned __int64 timestamp );
+	// collects a module to be checked by StatModules
+	void AddModule( const wchar_t *PATH );
+	// gets the timestamps of all collected modules
+	void StatModules( void );
+	// returns true if the module exists and has the given timestamp
+	bool Validate( const wchar_t *PATH, unsigned __int64 timestamp );
+
+	int GetModuleCount( void ) const { return (int)m_Modules.size(); }
+	int GetStatCount( void ) const { return m_StatCount; }
+
+private:
+	struct Module
+	{
+		CString PATH;
+		unsigned __int64 timestamp;
+		bool bStat; // the timestamp is known
+		bool bExists;
+	};
+
+	TStatFunc m_StatFunc;
+	std::multimap<unsigned int,Module> m_Modules; // the key is the hash of the path
+	int m_StatCount;
+
+	Module &GetModule( const wchar_t *PATH );
+	void Stat( Module &module );
+};
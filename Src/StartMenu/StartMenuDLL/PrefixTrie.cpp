@@ -0,0 +1,73 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include "stdafx.h"
+#include "PrefixTrie.h"
+
+void CPrefixTrie::Clear( void )
+{
+	m_Nodes.resize(1);
+	Node &root=m_Nodes[0];
+	root.ch=0;
+	root.firstChild=root.nextSibling=-1;
+	root.value=-1;
+	root.order=0;
+	m_Count=0;
+}
+
+void CPrefixTrie::Add( const wchar_t *prefix, int value )
+{
+	Assert(value>=0);
+	if (!prefix || !prefix[0]) return;
+	int node=0;
+	for (const wchar_t *c=prefix;*c;c++)
+	{
+		int child=m_Nodes[node].firstChild;
+		while (child>=0 && m_Nodes[child].ch!=*c)
+			child=m_Nodes[child].nextSibling;
+		if (child<0)
+		{
+			Node newNode;
+			newNode.ch=*c;
+			newNode.firstChild=-1;
+			newNode.nextSibling=m_Nodes[node].firstChild;
+			newNode.value=-1;
+			newNode.order=0;
+			child=(int)m_Nodes.size();
+			m_Nodes.push_back(newNode);
+			m_Nodes[node].firstChild=child;
+		}
+		node=child;
+	}
+	if (m_Nodes[node].value<0)
+	{
+		// if the same prefix is added twice, the first one wins
+		m_Nodes[node].value=value;
+		m_Nodes[node].order=m_Count;
+	}
+	m_Count++;
+}
+
+int CPrefixTrie::Find( const wchar_t *str, int *pLen ) const
+{
+	int value=-1, order=m_Count, len=0;
+	int node=0;
+	for (int i=0;;i++)
+	{
+		if (m_Nodes[node].value>=0 && m_Nodes[node].order<order)
+		{
+			value=m_Nodes[node].value;
+			order=m_Nodes[node].order;
+			len=i;
+		}
+		if (!str[i]) break;
+		int child=m_Nodes[node].firstChild;
+		while (child>=0 && m_Nodes[child].ch!=str[i])
+			child=m_Nodes[child].nextSibling;
+		if (child<0) break;
+		node=child;
+	}
+	if (pLen) *pLen=len;
+	return value;
+}
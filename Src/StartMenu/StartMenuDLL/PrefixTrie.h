@@ -0,0 +1,35 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include <vector>
+
+// CPrefixTrie - finds which of a set of prefixes matches the start of a string in a single pass over the string
+// When more than one prefix matches, the one that was added first wins, so the prefixes should be added in order of priority.
+// The comparison is case-sensitive. The trie doesn't depend on the OS
+class CPrefixTrie
+{
+public:
+	CPrefixTrie( void ) { Clear(); }
+
+	void Clear( void );
+	// Adds a prefix with a value (must be >=0). Empty prefixes are ignored
+	void Add( const wchar_t *prefix, int value );
+	// Returns the value of the matching prefix or -1. Optionally returns the length of the prefix
+	int Find( const wchar_t *str, int *pLen=NULL ) const;
+	bool IsEmpty( void ) const { return m_Count==0; }
+
+private:
+	struct Node
+	{
+		wchar_t ch;
+		int firstChild, nextSibling; // indices in m_Nodes, -1 if none
+		int value; // -1 if no prefix ends here
+		int order; // the order in which the prefix was added
+	};
+
+	std::vector<Node> m_Nodes; // the first node is the root
+	int m_Count;
+};
@@ -0,0 +1,149 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include <list>
+#include <map>
+
+// PriorityQueue.h - multi-level queue for the background work
+// Each level is a FIFO list. Adding an item that is already in the queue doesn't create a duplicate, but can move it to a higher priority.
+// To prevent starvation, after a number of items are taken from the higher levels in a row, one item is taken from a lower level.
+// The lower levels take turns, so a middle level is not starved while the lowest one has items.
+// The queue doesn't depend on the OS and doesn't do any locking.
+
+template<class T, int LEVELS> class CPriorityQueue
+{
+public:
+	// level 0 is the highest priority
+	CPriorityQueue( int starvationLimit=16 ) { m_StarvationLimit=starvationLimit; m_StarvationCount=0; m_ReliefLevel=0; }
+
+	bool IsEmpty( void ) const { return m_Index.empty(); }
+	int GetCount( void ) const { return (int)m_Index.size(); }
+	int GetCount( int level ) const { return (int)m_Levels[level].size(); }
+
+	// Adds the item at the given level. If the item is already in a lower level it is moved to the back of the new level. Returns false if the item was already queued
+	bool Push( const T &item, int level )
+	{
+		typename std::map<T,Location>::iterator it=m_Index.find(item);
+		if (it!=m_Index.end())
+		{
+			if (it->second.level>level)
+				Move(it,level);
+			return false;
+		}
+		Location &location=m_Index[item];
+		location.level=level;
+		location.it=m_Levels[level].insert(m_Levels[level].end(),item);
+		return true;
+	}
+
+	// Moves the item to the given level if it is queued with a lower priority. Returns false if the item is not in the queue
+	bool Boost( const T &item, int level )
+	{
+		typename std::map<T,Location>::iterator it=m_Index.find(item);
+		if (it==m_Index.end())
+			return false;
+		if (it->second.level>level)
+			Move(it,level);
+		return true;
+	}
+
+	// Takes the next item. Returns false if the queue is empty
+	bool Pop( T &item )
+	{
+		int level=0;
+		while (level<LEVELS && m_Levels[level].empty())
+			level++;
+		if (level==LEVELS)
+			return false;
+
+		// the next lower level in turn that has items
+		int lower=-1;
+		for (int i=0;i<LEVELS;i++)
+		{
+			int l=(m_ReliefLevel+i)%LEVELS;
+			if (l>level && !m_Levels[l].empty())
+			{
+				lower=l;
+				break;
+			}
+		}
+		if (lower>=0 && m_StarvationCount>=m_StarvationLimit)
+		{
+			// give the lower priority items a chance
+			level=lower;
+			m_ReliefLevel=lower+1;
+			m_StarvationCount=0;
+		}
+		else if (lower>=0)
+			m_StarvationCount++;
+		else
+			m_StarvationCount=0;
+
+		item=m_Levels[level].front();
+		m_Levels[level].pop_front();
+		m_Index.erase(item);
+		return true;
+	}
+
+	// Removes the item from the queue. Returns false if the item is not in the queue
+	bool Remove( const T &item )
+	{
+		typename std::map<T,Location>::iterator it=m_Index.find(item);
+		if (it==m_Index.end())
+			return false;
+		m_Levels[it->second.level].erase(it->second.it);
+		m_Index.erase(it);
+		return true;
+	}
+
+	// Removes all items that match the predicate
+	template<class Pred> void RemoveIf( Pred pred )
+	{
+		for (int level=0;level<LEVELS;level++)
+		{
+			typename std::list<T>::iterator it=m_Levels[level].begin();
+			while (it!=m_Levels[level].end())
+			{
+				typename std::list<T>::iterator next=it; ++next;
+				if (pred(*it))
+				{
+					m_Index.erase(*it);
+					m_Levels[level].erase(it);
+				}
+				it=next;
+			}
+		}
+	}
+
+	void Clear( void )
+	{
+		for (int level=0;level<LEVELS;level++)
+			m_Levels[level].clear();
+		m_Index.clear();
+		m_StarvationCount=0;
+		m_ReliefLevel=0;
+	}
+
+private:
+	struct Location
+	{
+		int level;
+		typename std::list<T>::iterator it;
+	};
+
+	std::list<T> m_Levels[LEVELS];
+	std::map<T,Location> m_Index;
+	int m_StarvationLimit; // number of items taken from the higher levels before one is taken from a lower level
+	int m_StarvationCount;
+	int m_ReliefLevel; // the lower level that gets the next turn
+
+	void Move( typename std::map<T,Location>::iterator it, int level )
+	{
+		m_Levels[it->second.level].erase(it->second.it);
+		it->second.level=level;
+		it->second.it=m_Levels[level].insert(m_Levels[level].end(),it->first);
+	}
+};
@@ -0,0 +1,46 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include "PriorityQueue.h"
+
+// RefreshQueue.h - the queue of the refresh threads
+// Only one thread at a time refreshes an item. If a thread takes an item that another thread is refreshing, the item is marked and is queued again when the refresh is done.
+// T must have the members int refreshFlags, bool bRefreshing and bool bRequeue. The refresh clears the bits of refreshFlags that it handled.
+// The queue doesn't depend on the OS and doesn't do any locking. The caller must hold the items lock for all calls
+
+template<class T, int LEVELS> class CRefreshQueue: public CPriorityQueue<T*,LEVELS>
+{
+public:
+	CRefreshQueue( int starvationLimit=16 ): CPriorityQueue<T*,LEVELS>(starvationLimit) {}
+
+	// Takes the next item. Returns false if the queue is empty. refreshFlags is 0 if the item doesn't need a refresh or another thread is refreshing it.
+	// Otherwise the refresh must be finished with EndRefresh
+	bool BeginRefresh( T *&pItem, int &refreshFlags )
+	{
+		if (!this->Pop(pItem))
+			return false;
+		refreshFlags=pItem->refreshFlags;
+		if (pItem->bRefreshing)
+		{
+			// another thread is refreshing the item. it will queue it again when it is done
+			pItem->bRequeue=true;
+			refreshFlags=0;
+		}
+		else if (refreshFlags)
+			pItem->bRefreshing=true;
+		return true;
+	}
+
+	// Finishes the refresh of the item. If the item was requested again in the meantime, it is queued at the given level. Returns true if the item was queued
+	bool EndRefresh( T *pItem, int level )
+	{
+		pItem->bRefreshing=false;
+		if (!pItem->bRequeue)
+			return false;
+		pItem->bRequeue=false;
+		return pItem->refreshFlags && this->Push(pItem,level);
+	}
+};
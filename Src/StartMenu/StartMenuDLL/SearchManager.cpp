@@ -28,6 +28,20 @@ const CLSID CLSID_CSearchManager2={0x7D096C5F,0xAC08,0x4f1f,{0xBE,0xB7,0x5C,0x22
 const int RANK_LIST_VERSION=1;
 const int RANK_LIST_SIZE=256;
 
+// the settings that are read for every search
+static CSettingRef<bool> g_SettingSearchAutoComplete(L"SearchAutoComplete");
+static CSettingRef<bool> g_SettingSearchPrograms(L"SearchPrograms");
+static CSettingRef<bool> g_SettingSearchPath(L"SearchPath");
+static CSettingRef<bool> g_SettingSearchMetroApps(L"SearchMetroApps");
+static CSettingRef<bool> g_SettingSearchMetroSettings(L"SearchMetroSettings");
+static CSettingRef<bool> g_SettingSearchKeywords(L"SearchKeywords");
+static CSettingRef<bool> g_SettingSearchFiles(L"SearchFiles");
+static CSettingRef<bool> g_SettingSearchContents(L"SearchContents");
+static CSettingRef<bool> g_SettingSearchCategories(L"SearchCategories");
+static CSettingRef<bool> g_SettingSearchSubWord(L"SearchSubWord");
+static CSettingRef<bool> g_SettingSearchTrack(L"SearchTrack");
+static CSettingRef<int> g_SettingPinnedPrograms(L"PinnedPrograms");
+
 CSearchManager::CSearchManager( void )
 {
 	m_bInitialized=false;
@@ -79,7 +93,7 @@ void CSearchManager::Close( void )
 
 static CString ParseAutoCompletePath( const CString &searchText )
 {
-	if (GetSettingBool(L"SearchAutoComplete"))
+	if (g_SettingSearchAutoComplete)
 	{
 		const wchar_t *str=searchText;
 		if (str[0]>='A' && str[0]<='Z' && str[1]==':')
@@ -115,19 +129,19 @@ void CSearchManager::BeginSearch( const CString &searchText )
 
 		// initialize the request with unique ID
 		m_SearchRequest.requestId=++m_LastRequestId;
-		m_SearchRequest.bSearchPrograms=GetSettingBool(L"SearchPrograms");
-		m_SearchRequest.bSearchPath=GetSettingBool(L"SearchPath");
-		m_SearchRequest.bSearchMetroApps=GetSettingBool(L"SearchMetroApps");
-		m_SearchRequest.bSearchMetroSettings=GetSettingBool(L"SearchMetroSettings");
+		m_SearchRequest.bSearchPrograms=g_SettingSearchPrograms;
+		m_SearchRequest.bSearchPath=g_SettingSearchPath;
+		m_SearchRequest.bSearchMetroApps=g_SettingSearchMetroApps;
+		m_SearchRequest.bSearchMetroSettings=g_SettingSearchMetroSettings;
 		m_SearchRequest.bSearchSettings=m_SearchRequest.bSearchPrograms; //GetSettingBool(L"SearchSettings");
-		m_SearchRequest.bSearchKeywords=GetSettingBool(L"SearchKeywords");
-		m_SearchRequest.bSearchFiles=GetSettingBool(L"SearchFiles");
-		m_SearchRequest.bSearchMetadata=GetSettingBool(L"SearchContents");
-		m_SearchRequest.bSearchTypes=GetSettingBool(L"SearchCategories");
-		m_SearchRequest.bSearchSubWord=GetSettingBool(L"SearchSubWord");
-		m_SearchRequest.bUseRanks=GetSettingBool(L"SearchTrack");
+		m_SearchRequest.bSearchKeywords=g_SettingSearchKeywords;
+		m_SearchRequest.bSearchFiles=g_SettingSearchFiles;
+		m_SearchRequest.bSearchMetadata=g_SettingSearchContents;
+		m_SearchRequest.bSearchTypes=g_SettingSearchCategories;
+		m_SearchRequest.bSearchSubWord=g_SettingSearchSubWord;
+		m_SearchRequest.bUseRanks=g_SettingSearchTrack;
 		m_SearchRequest.bNoCommonFolders=(SHRestricted(REST_NOCOMMONGROUPS)!=0);
-		m_SearchRequest.bPinnedFolder=(GetSettingInt(L"PinnedPrograms")==PINNED_PROGRAMS_PINNED);
+		m_SearchRequest.bPinnedFolder=(g_SettingPinnedPrograms==PINNED_PROGRAMS_PINNED);
 		m_SearchRequest.searchText=searchText;
 		m_SearchRequest.autoCompletePath=ParseAutoCompletePath(searchText);
 	}
@@ -210,7 +224,7 @@ void CSearchManager::LoadItemRanks( void )
 	Assert(GetCurrentThreadId()==m_MainThreadId);
 	Lock lock(this,LOCK_RANKS);
 	m_ItemRanks.clear();
-	if (GetSettingBool(L"SearchTrack"))
+	if (g_SettingSearchTrack)
 	{
 		CRegKey regKey;
 		if (regKey.Open(HKEY_CURRENT_USER,GetSettingsRegPath(),KEY_READ)==ERROR_SUCCESS)
@@ -245,7 +259,7 @@ void CSearchManager::AddItemRank( unsigned int hash )
 	Assert(GetCurrentThreadId()==m_MainThreadId);
 	Assert(m_bRanksLoaded);
 	Lock lock(this,LOCK_RANKS);
-	if (GetSettingBool(L"SearchTrack"))
+	if (g_SettingSearchTrack)
 	{
 		FILETIME curTime;
 		GetSystemTimeAsFileTime(&curTime);
@@ -1375,7 +1389,7 @@ void CSearchManager::GetSearchResults( SearchResults &results )
 	results.autoCompletePath.Empty();
 	Lock lock(this,LOCK_DATA);
 	results.autoCompletePath=m_AutoCompletePath;
-	bool bSearchSubWord=GetSettingBool(L"SearchSubWord");
+	bool bSearchSubWord=g_SettingSearchSubWord;
 	if (m_AutoCompletePath.IsEmpty())
 	{
 		{
@@ -1535,7 +1549,7 @@ void CSearchManager::LaunchExternalSearch( PIDLIST_ABSOLUTE root, unsigned int c
 	}
 
 	PROPERTYKEY keyString;
-	if (!GetSettingBool(L"SearchContents"))
+	if (!g_SettingSearchContents)
 		keyString=PKEY_ItemNameDisplay;
 	else if (FAILED(PSGetPropertyKeyFromName(L"System.Generic.String",&keyString)))
 		return;
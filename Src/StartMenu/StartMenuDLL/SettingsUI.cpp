@@ -2654,14 +2654,16 @@ HICON CCustomMenuDlg7::CItemList::LoadIcon( const MenuItem &item, bool bSmall )
 							if (pIconInfo && pIconInfo->bitmap)
 							{
 								int iconSize=GetSystemMetrics(bSmall?SM_CXSMICON:SM_CXICON);
-								BITMAP bmpInfo;
-								GetObject(pIconInfo->bitmap,sizeof(bmpInfo),&bmpInfo);
+								const IconBitmap *pBitmap=pIconInfo->bitmap;
 
 								std::vector<char> buf((iconSize+1)*iconSize,-1);
 								HBITMAP bmpMask=CreateBitmap(iconSize,iconSize,1,8,&buf[0]);
 
-								HBITMAP bmpColor=pIconInfo->bitmap;
-								if (bmpInfo.bmWidth!=iconSize || bmpInfo.bmHeight!=iconSize)
+								HBITMAP bmpColor;
+								CItemManager::RWLock iconLock(&g_ItemManager,false,CItemManager::RWLOCK_ICONS);
+								if (pBitmap->rc.width==iconSize && pBitmap->rc.height==iconSize)
+									bmpColor=CreateIconBitmapCopy(pBitmap);
+								else
 								{
 									HDC hSrc=CreateCompatibleDC(NULL);
 									HDC hDst=CreateCompatibleDC(hSrc);
@@ -2673,9 +2675,9 @@ HICON CCustomMenuDlg7::CItemList::LoadIcon( const MenuItem &item, bool bSmall )
 									bi.bmiHeader.biBitCount=32;
 									bmpColor=CreateDIBSection(hDst,&bi,DIB_RGB_COLORS,NULL,NULL,0);
 
-									HGDIOBJ bmp01=SelectObject(hSrc,pIconInfo->bitmap);
+									HGDIOBJ bmp01=SelectObject(hSrc,pBitmap->page);
 									HGDIOBJ bmp02=SelectObject(hDst,bmpColor);
-									StretchBlt(hDst,0,0,bi.bmiHeader.biWidth,bi.bmiHeader.biHeight,hSrc,0,0,bmpInfo.bmWidth,bmpInfo.bmHeight,SRCCOPY);
+									StretchBlt(hDst,0,0,bi.bmiHeader.biWidth,bi.bmiHeader.biHeight,hSrc,pBitmap->rc.x,pBitmap->rc.y,pBitmap->rc.width,pBitmap->rc.height,SRCCOPY);
 									SelectObject(hSrc,bmp01);
 									SelectObject(hDst,bmp02);
 									DeleteDC(hSrc);
@@ -2684,7 +2686,7 @@ HICON CCustomMenuDlg7::CItemList::LoadIcon( const MenuItem &item, bool bSmall )
 								ICONINFO info={TRUE,0,0,bmpMask,bmpColor};
 								HICON hIcon=CreateIconIndirect(&info);
 								DeleteObject(bmpMask);
-								if (bmpColor!=pIconInfo->bitmap)
+								if (bmpColor)
 									DeleteObject(bmpColor);
 								return hIcon;
 							}
@@ -4143,6 +4145,9 @@ CSetting g_Settings[]={
 	{L"EnableSettings",CSetting::TYPE_BOOL,0,0,1,CSetting::FLAG_HIDDEN|CSetting::FLAG_NOSAVE},
 	{L"CrashDump",CSetting::TYPE_INT,0,0,0,CSetting::FLAG_HIDDEN|CSetting::FLAG_NOSAVE},
 	{L"OldProgramsAge",CSetting::TYPE_INT,0,0,48,CSetting::FLAG_HIDDEN|CSetting::FLAG_NOSAVE},
+	{L"IconCacheSize",CSetting::TYPE_INT,0,0,0,CSetting::FLAG_HIDDEN|CSetting::FLAG_NOSAVE},
+	{L"WarmItemsCount",CSetting::TYPE_INT,0,0,50,CSetting::FLAG_HIDDEN|CSetting::FLAG_NOSAVE},
+	{L"WarmItemsTime",CSetting::TYPE_INT,0,0,2000,CSetting::FLAG_HIDDEN|CSetting::FLAG_NOSAVE},
 	{L"FolderStartMenu",CSetting::TYPE_STRING,0,0,L"",CSetting::FLAG_HIDDEN|CSetting::FLAG_NOSAVE},
 	{L"FolderCommonStartMenu",CSetting::TYPE_STRING,0,0,L"",CSetting::FLAG_HIDDEN|CSetting::FLAG_NOSAVE},
 	{L"FolderPrograms",CSetting::TYPE_STRING,0,0,L"",CSetting::FLAG_HIDDEN|CSetting::FLAG_NOSAVE},
@@ -12,6 +12,7 @@
 #include "SettingsUI.h"
 #include "Translations.h"
 #include "ResourceHelper.h"
+#include "PixelOps.h"
 #include "FNVHash.h"
 #include "dllmain.h"
 #include "IatHookHelper.h"
@@ -1055,18 +1056,7 @@ MenuBitmap MenuSkin::LoadSkinBitmap( HMODULE hMod, int index, int maskIndex, COL
 	if (res.bIs32 && bPremultiply)
 	{
 		// 32-bit bitmap detected. pre-multiply the alpha
-		for (int i=0;i<n;i++)
-		{
-			unsigned int &pixel=((unsigned int*)info.bmBits)[i];
-			int a=(pixel>>24);
-			int r=(pixel>>16)&255;
-			int g=(pixel>>8)&255;
-			int b=(pixel)&255;
-			r=(r*a)/255;
-			g=(g*a)/255;
-			b=(b*a)/255;
-			pixel=(a<<24)|(r<<16)|(g<<8)|b;
-		}
+		PremultiplyPixels((unsigned int*)info.bmBits,n);
 	}
 	return res;
 }
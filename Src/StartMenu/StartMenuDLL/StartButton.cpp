@@ -8,6 +8,7 @@
 #include "Settings.h"
 #include "SettingsUI.h"
 #include "ResourceHelper.h"
+#include "ImageResampler.h"
 #include "ItemManager.h"
 #include "StartMenuDLL.h"
 #include "StartButton.h"
@@ -489,7 +490,7 @@ void CStartButton::ParseAnimation( Animation &animation, const std::vector<unsig
 	index+=ranges+1;
 }
 
-// Splits a 32bpp HBITMAP vertically into n parts, resizes them using bilinear resampling and merges them back into one
+// Splits a 32bpp HBITMAP vertically into n parts, resizes them using ResizePixels and merges them back into one
 HBITMAP SplitResizeMergeHBitmap32( HBITMAP hSrc, float scale, int partCount )
 {
 	if (!hSrc || scale <= 0.0f || partCount <= 0) return nullptr;
@@ -523,10 +524,6 @@ HBITMAP SplitResizeMergeHBitmap32( HBITMAP hSrc, float scale, int partCount )
 	// Allocate resized pixel buffer
 	Pixel* dstPixels = new Pixel[dstW * dstH];
 
-	auto lerp = [](uint8_t a, uint8_t b, float f) -> uint8_t {
-		return static_cast<uint8_t>(a * (1.0f - f) + b * f + 0.5f);
-	};
-
 	// Compute height for each split part
 	int srcYOffset = 0;
 	int dstYOffset = 0;
@@ -538,35 +535,10 @@ HBITMAP SplitResizeMergeHBitmap32( HBITMAP hSrc, float scale, int partCount )
 			: srcH / partCount;
 		int curDstH = static_cast<int>(curSrcH * scale);
 
-		// Bilinear resampling
-		for (int y = 0; y < curDstH; ++y)
-		{
-			float srcY = (y + 0.5f) / scale - 0.5f + srcYOffset;
-			int y0 = max(0, static_cast<int>(floorf(srcY)));
-			int y1 = min(srcH - 1, y0 + 1);
-			float fy = srcY - y0;
-
-			for (int x = 0; x < dstW; ++x)
-			{
-				float srcX = (x + 0.5f) / scale - 0.5f;
-				int x0 = max(0, static_cast<int>(floorf(srcX)));
-				int x1 = min(srcW - 1, x0 + 1);
-				float fx = srcX - x0;
-
-				Pixel p00 = srcPixels[y0 * srcW + x0];
-				Pixel p10 = srcPixels[y0 * srcW + x1];
-				Pixel p01 = srcPixels[y1 * srcW + x0];
-				Pixel p11 = srcPixels[y1 * srcW + x1];
-
-				Pixel out;
-				out.b = lerp(lerp(p00.b, p10.b, fx), lerp(p01.b, p11.b, fx), fy);
-				out.g = lerp(lerp(p00.g, p10.g, fx), lerp(p01.g, p11.g, fx), fy);
-				out.r = lerp(lerp(p00.r, p10.r, fx), lerp(p01.r, p11.r, fx), fy);
-				out.a = lerp(lerp(p00.a, p10.a, fx), lerp(p01.a, p11.a, fx), fy);
-
-				dstPixels[(dstYOffset + y) * dstW + x] = out;
-			}
-		}
+		// Resample the part on its own so the parts don't bleed into each other
+		if (curSrcH > 0 && curDstH > 0)
+			ResizePixels(reinterpret_cast<unsigned int*>(srcPixels + srcYOffset * srcW), srcW, curSrcH, srcW,
+				reinterpret_cast<unsigned int*>(dstPixels + dstYOffset * dstW), dstW, curDstH, dstW);
 
 		srcYOffset += curSrcH;
 		dstYOffset += curDstH;
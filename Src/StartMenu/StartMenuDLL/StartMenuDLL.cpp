@@ -10,6 +10,7 @@
 #include "SettingsParser.h"
 #include "Translations.h"
 #include "Settings.h"
+#include "SettingsSnapshot.h"
 #include "SettingsUI.h"
 #include "ResourceHelper.h"
 #include "LogManager.h"
@@ -3820,9 +3821,16 @@ if (!g_bTrimHooks)
 				}
 				else if (msg->wParam==MSG_RELOADSETTINGS)
 				{
-					LoadSettings();
-					UpdateTaskBars(TASKBAR_RECREATE_BUTTONS);
-					UpdateTaskBars(TASKBAR_UPDATE_TEXTURE);
+					CSettingChanges changes;
+					LoadSettings(&changes);
+					// only rebuild the buttons and the texture if their settings changed.
+					// if no setting changed, the reload is for something outside of the settings (like a new image in the same file), so rebuild everything
+					bool bAll=changes.IsEmpty();
+					bool bTaskbar=bAll || changes.IsGroupChanged(L"Taskbar");
+					if (bTaskbar || changes.IsGroupChanged(L"StartButton"))
+						UpdateTaskBars(TASKBAR_RECREATE_BUTTONS);
+					if (bTaskbar)
+						UpdateTaskBars(TASKBAR_UPDATE_TEXTURE);
 					ResetHotCorners();
 					RedrawTaskbars();
 				}
@@ -0,0 +1,65 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include "stdafx.h"
+#include "StringPool.h"
+
+CStringPool::CStringPool( void )
+{
+	InitializeCriticalSection(&m_Section);
+}
+
+CStringPool::~CStringPool( void )
+{
+	DeleteCriticalSection(&m_Section);
+}
+
+CString CStringPool::Intern( const CString &str )
+{
+	if (str.IsEmpty())
+		return str;
+	EnterCriticalSection(&m_Section);
+	CString res=m_Table.Intern(str);
+	LeaveCriticalSection(&m_Section);
+	return res;
+}
+
+void CStringPool::Mark( const CString &str )
+{
+	if (str.IsEmpty())
+		return;
+	EnterCriticalSection(&m_Section);
+	m_Table.Mark(str);
+	LeaveCriticalSection(&m_Section);
+}
+
+int CStringPool::Purge( void )
+{
+	EnterCriticalSection(&m_Section);
+	int count=m_Table.Purge();
+	LeaveCriticalSection(&m_Section);
+	return count;
+}
+
+bool CStringPool::IsPurgeNeeded( void )
+{
+	EnterCriticalSection(&m_Section);
+	bool res=m_Table.IsPurgeNeeded();
+	LeaveCriticalSection(&m_Section);
+	return res;
+}
+
+void CStringPool::Clear( void )
+{
+	EnterCriticalSection(&m_Section);
+	m_Table.Clear();
+	LeaveCriticalSection(&m_Section);
+}
+
+void CStringPool::GetStats( Stats &stats )
+{
+	EnterCriticalSection(&m_Section);
+	m_Table.GetStats(stats);
+	LeaveCriticalSection(&m_Section);
+}
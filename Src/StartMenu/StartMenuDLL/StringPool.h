@@ -0,0 +1,35 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include "StringTable.h"
+
+// StringPool.h - stores each distinct string once
+// Intern returns a CString that shares its buffer with all other interned copies of the same text (CString buffers are reference counted).
+// The owner marks the strings that are still used, and Purge removes the others. A removed string stays valid in the CStrings that have it, only it is not shared any more.
+// The pool is thread-safe.
+
+class CStringPool
+{
+public:
+	typedef CStringTable::Stats Stats;
+
+	CStringPool( void );
+	~CStringPool( void );
+
+	CString Intern( const CString &str );
+	// marks the string as used until the next Purge
+	void Mark( const CString &str );
+	// removes the strings that were not interned or marked since the last purge. returns the number of removed strings
+	int Purge( void );
+	// returns true if the pool grew enough since the last purge
+	bool IsPurgeNeeded( void );
+	void Clear( void );
+	void GetStats( Stats &stats );
+
+private:
+	CRITICAL_SECTION m_Section;
+	CStringTable m_Table;
+};
@@ -0,0 +1,88 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include "stdafx.h"
+#include "StringTable.h"
+#include "FNVHash.h"
+
+CStringTable::Entry *CStringTable::Find( const CString &str, unsigned int hash )
+{
+	for (std::multimap<unsigned int,Entry>::iterator it=m_Strings.find(hash);it!=m_Strings.end() && it->first==hash;++it)
+	{
+		if (it->second.text==str)
+			return &it->second;
+	}
+	return NULL;
+}
+
+CString CStringTable::Intern( const CString &str )
+{
+	if (str.IsEmpty())
+		return str;
+	unsigned int hash=CalcFNVHash((const wchar_t*)str);
+	Entry *pEntry=Find(str,hash);
+	if (pEntry)
+	{
+		pEntry->mark=m_Mark;
+		if ((const wchar_t*)pEntry->text!=(const wchar_t*)str)
+		{
+			m_Hits++;
+			m_SavedBytes+=(str.GetLength()+1)*2;
+		}
+		return pEntry->text;
+	}
+	// make a copy with an exact size buffer, in case str is part of a bigger buffer
+	Entry entry;
+	entry.text=CString((const wchar_t*)str,str.GetLength());
+	entry.mark=m_Mark;
+	m_Strings.emplace(hash,entry);
+	return entry.text;
+}
+
+bool CStringTable::Mark( const CString &str )
+{
+	if (str.IsEmpty())
+		return false;
+	Entry *pEntry=Find(str,CalcFNVHash((const wchar_t*)str));
+	if (!pEntry)
+		return false;
+	pEntry->mark=m_Mark;
+	return true;
+}
+
+int CStringTable::Purge( void )
+{
+	int count=0;
+	std::multimap<unsigned int,Entry>::iterator it=m_Strings.begin();
+	while (it!=m_Strings.end())
+	{
+		std::multimap<unsigned int,Entry>::iterator next=it; ++next;
+		if (it->second.mark!=m_Mark)
+		{
+			m_Strings.erase(it);
+			count++;
+		}
+		it=next;
+	}
+	m_Mark++;
+	m_PurgeCount=(int)m_Strings.size();
+	return count;
+}
+
+void CStringTable::Clear( void )
+{
+	m_Strings.clear();
+	m_PurgeCount=0;
+	m_Hits=m_SavedBytes=0;
+}
+
+void CStringTable::GetStats( Stats &stats ) const
+{
+	stats.count=(int)m_Strings.size();
+	stats.bytes=0;
+	for (std::multimap<unsigned int,Entry>::const_iterator it=m_Strings.begin();it!=m_Strings.end();++it)
+		stats.bytes+=(it->second.text.GetLength()+1)*2;
+	stats.hits=m_Hits;
+	stats.savedBytes=m_SavedBytes;
+}
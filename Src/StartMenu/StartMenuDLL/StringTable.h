@@ -0,0 +1,53 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include <map>
+
+// StringTable.h - the strings of the string pool. stores each distinct string once, indexed by its hash
+// The owner marks the strings it still uses before each Purge, and Purge removes the rest. The strings added since the previous Purge are kept even if they are not marked yet.
+// The table doesn't depend on the OS and doesn't do any locking
+
+class CStringTable
+{
+public:
+	struct Stats
+	{
+		int count; // number of distinct strings
+		int bytes; // memory used by the distinct strings
+		int hits; // number of times an existing string was returned
+		int savedBytes; // memory saved by sharing the strings
+	};
+
+	CStringTable( void ) { m_Mark=1; m_PurgeCount=0; m_Hits=m_SavedBytes=0; }
+
+	// Returns the stored copy of the string, adding it if needed
+	CString Intern( const CString &str );
+	// Marks the string as used. Returns false if it is not in the table
+	bool Mark( const CString &str );
+	// Removes the strings that were not marked or added since the previous Purge. Returns the number of removed strings
+	int Purge( void );
+	// Returns true if the table grew by a quarter since the last Purge. Marking all strings is expensive, so the owner only does it when this returns true
+	bool IsPurgeNeeded( void ) const { return (int)m_Strings.size()>m_PurgeCount+m_PurgeCount/4+PURGE_SLACK; }
+	void Clear( void );
+	void GetStats( Stats &stats ) const;
+
+private:
+	struct Entry
+	{
+		CString text;
+		unsigned int mark; // the last Purge period that used the string
+	};
+
+	enum { PURGE_SLACK=64 }; // small tables are not purged for every few new strings
+
+	std::multimap<unsigned int,Entry> m_Strings; // the key is the hash of the string
+	unsigned int m_Mark; // the current Purge period
+	int m_PurgeCount; // the number of strings after the last Purge
+	int m_Hits;
+	int m_SavedBytes;
+
+	Entry *Find( const CString &str, unsigned int hash );
+};
@@ -0,0 +1,47 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+// ThreadCounters.h - statistics counters that many threads can increment without locking
+// Each known thread has its own slot and is the only one that writes to it. The other threads share one slot and use interlocked operations.
+// Each slot is in its own cache line, so the threads don't write to the same line. Sum adds up all slots.
+// The counters don't depend on the OS, except for InterlockedExchangeAdd. The caller finds the slot of the current thread
+
+template<int COUNT, int SLOTS> class CThreadCounters
+{
+public:
+	CThreadCounters( void ) { Clear(); }
+
+	// there must be no other threads that add to the counters
+	void Clear( void ) { memset(m_Slots,0,sizeof(m_Slots)); }
+
+	// Adds to a counter. slot is the slot of the current thread (0 to SLOTS-1) or -1 for the threads without a slot
+	void Add( int slot, int counter, int count )
+	{
+		Assert(slot>=-1 && slot<SLOTS && counter>=0 && counter<COUNT);
+		if (slot>=0)
+			m_Slots[slot].counters[counter]+=count;
+		else
+			InterlockedExchangeAdd(&m_Slots[SLOTS].counters[counter],count);
+	}
+
+	// Adds up the counters of all slots. The slots of the threads that are running may be a little behind
+	void Sum( int counters[COUNT] ) const
+	{
+		for (int c=0;c<COUNT;c++)
+			counters[c]=0;
+		for (int i=0;i<=SLOTS;i++)
+			for (int c=0;c<COUNT;c++)
+				counters[c]+=m_Slots[i].counters[c];
+	}
+
+private:
+	struct __declspec(align(64)) Slot
+	{
+		volatile LONG counters[COUNT];
+	};
+
+	Slot m_Slots[SLOTS+1]; // the last one is shared by the threads without a slot
+};
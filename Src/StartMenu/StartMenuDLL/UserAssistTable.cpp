@@ -0,0 +1,79 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include "stdafx.h"
+#include "UserAssistTable.h"
+#include "FNVHash.h"
+
+void EncodeRot13( wchar_t *text )
+{
+	for (;*text;text++)
+	{
+		if (*text>='a' && *text<='z')
+			*text=(*text-'a'+13)%26+'a';
+		else if (*text>='A' && *text<='Z')
+			*text=(*text-'A'+13)%26+'A';
+	}
+}
+
+bool ReplaceKnownFolder( wchar_t *path, int size, const wchar_t *folder, const wchar_t *guid )
+{
+	int len=Strlen(folder);
+	if (len==0 || _wcsnicmp(path,folder,len)!=0)
+		return false;
+	wchar_t name[_MAX_PATH];
+	int guidLen=Strcpy(name,_countof(name),guid);
+	Strcpy(name+guidLen,_countof(name)-guidLen,path+len);
+	Strcpy(path,size,name);
+	return true;
+}
+
+void CUserAssistTable::AddKnownFolder( const wchar_t *PATH, const wchar_t *guid )
+{
+	m_KnownFolders.Add(PATH,(int)m_Guids.size());
+	m_Guids.push_back(CString(guid));
+}
+
+void CUserAssistTable::Add( const wchar_t *encodedName, const UserAssistData &data )
+{
+	wchar_t NAME[_MAX_PATH];
+	Strcpy(NAME,_countof(NAME),encodedName);
+	EncodeRot13(NAME);
+	// the registry names are not case-sensitive
+	CharUpper(NAME);
+	Value value;
+	value.NAME=NAME;
+	value.data=data;
+	m_Values.insert(std::pair<unsigned int,Value>(CalcFNVHash(NAME),value));
+}
+
+void CUserAssistTable::Clear( void )
+{
+	m_Values.clear();
+	m_KnownFolders.Clear();
+	m_Guids.clear();
+}
+
+const UserAssistData *CUserAssistTable::Find( const wchar_t *NAME ) const
+{
+	unsigned int hash=CalcFNVHash(NAME);
+	for (std::multimap<unsigned int,Value>::const_iterator it=m_Values.find(hash);it!=m_Values.end() && it->first==hash;++it)
+	{
+		if (it->second.NAME==NAME)
+			return &it->second.data;
+	}
+	return NULL;
+}
+
+const UserAssistData *CUserAssistTable::FindPath( const wchar_t *PATH ) const
+{
+	int len;
+	int index=m_KnownFolders.Find(PATH,&len);
+	if (index<0)
+		return Find(PATH);
+	wchar_t NAME[_MAX_PATH];
+	int guidLen=Strcpy(NAME,_countof(NAME),m_Guids[index]);
+	Strcpy(NAME+guidLen,_countof(NAME)-guidLen,PATH+len);
+	return Find(NAME);
+}
@@ -0,0 +1,56 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include <map>
+#include <vector>
+#include "PrefixTrie.h"
+
+// UserAssistTable.h - decodes the UserAssist data, which records when the programs were used
+
+struct UserAssistData
+{
+	int pad1;
+	int count;
+	int pad2[2];
+	float history[10];
+	int last;
+	FILETIME timestamp;
+	int pad3;
+};
+
+// The UserAssist value names are encoded with ROT13, which is its own inverse
+void EncodeRot13( wchar_t *text );
+// Replaces the known folder at the start of the path with its GUID, like in the UserAssist value names. The comparison is not case-sensitive
+// Returns false if the path is not in the folder
+bool ReplaceKnownFolder( wchar_t *path, int size, const wchar_t *folder, const wchar_t *guid );
+
+// CUserAssistTable - all values of a UserAssist key, read in one pass and decoded
+// Replaces the individual registry queries when many paths need to be checked. The table doesn't depend on the OS. CItemManager reads the values from the registry
+class CUserAssistTable
+{
+public:
+	// Adds a known folder that is replaced with its GUID by FindPath. The folders are checked in the order they are added. The path must be in upper case
+	void AddKnownFolder( const wchar_t *PATH, const wchar_t *guid );
+	// Adds a value with a ROT13-encoded name, as stored in the registry
+	void Add( const wchar_t *encodedName, const UserAssistData &data );
+	void Clear( void );
+	// Finds the data for a decoded name. The name must be in upper case
+	const UserAssistData *Find( const wchar_t *NAME ) const;
+	// Finds the data for a path in upper case, after replacing the known folder at its start
+	const UserAssistData *FindPath( const wchar_t *PATH ) const;
+	int GetCount( void ) const { return (int)m_Values.size(); }
+
+private:
+	struct Value
+	{
+		CString NAME;
+		UserAssistData data;
+	};
+
+	std::multimap<unsigned int,Value> m_Values; // the key is the hash of the decoded upper case name
+	CPrefixTrie m_KnownFolders; // the value is the index in m_Guids
+	std::vector<CString> m_Guids;
+};
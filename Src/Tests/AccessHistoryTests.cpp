@@ -0,0 +1,281 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "AccessHistory.h"
+#include <algorithm>
+
+// Saves the history and loads it back, which starts the next session like the next start of the menu
+static void NextSession( CAccessHistory &history )
+{
+	std::vector<unsigned int> data;
+	history.Save(data);
+	CHECK(history.Load(&data[0],(int)data.size()*4));
+}
+
+// A saved history with one entry
+static std::vector<unsigned int> MakeData( unsigned int session, unsigned int hash, unsigned int score, unsigned int age )
+{
+	std::vector<unsigned int> data;
+	data.push_back(1); // version
+	data.push_back(session);
+	data.push_back(1);
+	data.push_back(hash);
+	data.push_back(score|(age<<16));
+	return data;
+}
+
+static bool IsSame( const std::vector<unsigned int> &hashes, const unsigned int *expected, int count )
+{
+	return hashes==std::vector<unsigned int>(expected,expected+count);
+}
+
+TEST(AccessHistory,Decay)
+{
+	CHECK(CAccessHistory::DecayScore(64,0)==64);
+	CHECK(CAccessHistory::DecayScore(64,1)==53);
+	CHECK(CAccessHistory::DecayScore(64,CAccessHistory::HALF_LIFE)==32);
+	CHECK(CAccessHistory::DecayScore(64,CAccessHistory::HALF_LIFE*2+1)==13);
+	CHECK(CAccessHistory::DecayScore(0,3)==0);
+	// the score never grows from one half-life to the next. within a half-life the rounding can be off by 1
+	for (unsigned int s=0;s<200;s++)
+	{
+		CHECK(CAccessHistory::DecayScore(1000,s+CAccessHistory::HALF_LIFE)<=CAccessHistory::DecayScore(1000,s));
+		CHECK(CAccessHistory::DecayScore(1000,s+1)<=CAccessHistory::DecayScore(1000,s)+1);
+	}
+
+	// regression: shifting by 32 or more bits used to be undefined. on x86 a shift by 32 left the score unchanged
+	CHECK(CAccessHistory::DecayScore(0xFFFFFFFF,31*CAccessHistory::HALF_LIFE)==1);
+	CHECK(CAccessHistory::DecayScore(0xFFFFFFFF,32*CAccessHistory::HALF_LIFE-1)==0);
+	CHECK(CAccessHistory::DecayScore(0xFFFFFFFF,32*CAccessHistory::HALF_LIFE)==0);
+	CHECK(CAccessHistory::DecayScore(0xFFFFFFFF,33*CAccessHistory::HALF_LIFE)==0);
+	CHECK(CAccessHistory::DecayScore(0xFFFF,0xFFFF)==0);
+	CHECK(CAccessHistory::DecayScore(0xFFFF,0xFFFFFFFF)==0);
+}
+
+TEST(AccessHistory,Record)
+{
+	CAccessHistory history;
+	std::vector<unsigned int> hashes;
+	history.Predict(10,hashes);
+	CHECK(hashes.empty());
+
+	// only the biggest weight counts once per session
+	history.Record(1,CAccessHistory::WEIGHT_SHOWN);
+	history.Record(1,CAccessHistory::WEIGHT_SHOWN);
+	history.Record(1,CAccessHistory::WEIGHT_SHOWN);
+	history.Record(2,CAccessHistory::WEIGHT_EXECUTED);
+	history.Record(3,CAccessHistory::WEIGHT_SHOWN);
+	history.Record(3,CAccessHistory::WEIGHT_EXECUTED);
+	history.Record(3,CAccessHistory::WEIGHT_SHOWN);
+	history.Record(4,2);
+	history.Record(4,2);
+	CHECK(history.GetCount()==4);
+	std::vector<unsigned int> data;
+	history.Save(data);
+	CHECK(data.size()==3+4*2);
+	// the scores are saved with the highest first. 2 and 3 have the same score and are in the order of the hash
+	static const unsigned int expected1[]={1,0,4, 2,64, 3,64, 4,32, 1,16};
+	CHECK(data==std::vector<unsigned int>(expected1,expected1+_countof(expected1)));
+
+	history.Predict(3,hashes);
+	static const unsigned int hashes1[]={2,3,4};
+	CHECK(IsSame(hashes,hashes1,3));
+	history.Predict(0,hashes);
+	CHECK(hashes.empty());
+
+	// in the next session the old score decays first and the new weight is added
+	NextSession(history);
+	history.Record(1,CAccessHistory::WEIGHT_EXECUTED);
+	history.Save(data);
+	static const unsigned int expected2[]={1,1,4, 1,13+64, 2,64|(1<<16), 3,64|(1<<16), 4,32|(1<<16)};
+	CHECK(data==std::vector<unsigned int>(expected2,expected2+_countof(expected2)));
+
+	// the score doesn't overflow. an item executed in every session stays far below the limit, so use a big weight
+	history.Record(5,0x10000);
+	history.Save(data);
+	CHECK(data[3]==5 && data[4]==0xFFFF);
+	history.Record(5,0x20000);
+	history.Save(data);
+	CHECK(data[3]==5 && data[4]==0xFFFF);
+}
+
+TEST(AccessHistory,SaveLoad)
+{
+	CAccessHistory history;
+	for (unsigned int i=1;i<=10;i++)
+		history.Record(i*1000,i%3==0?CAccessHistory::WEIGHT_EXECUTED:CAccessHistory::WEIGHT_SHOWN);
+	std::vector<unsigned int> data1, data2;
+	history.Save(data1);
+
+	// loading starts a new session, so the ages grow by 1
+	CAccessHistory history2;
+	CHECK(history2.Load(&data1[0],(int)data1.size()*4));
+	CHECK(history2.GetCount()==10);
+	history2.Save(data2);
+	CHECK(data2.size()==data1.size() && data2[1]==data1[1]+1);
+	for (size_t i=3;i<data1.size();i+=2)
+		CHECK(data2[i]==data1[i] && data2[i+1]==data1[i+1]+(1<<16));
+	std::vector<unsigned int> hashes1, hashes2;
+	history.Predict(10,hashes1);
+	history2.Predict(10,hashes2);
+	CHECK(hashes1==hashes2);
+
+	// the items that decayed to 0 are not saved
+	for (int i=0;i<80;i++)
+	{
+		history2.Record(1,CAccessHistory::WEIGHT_SHOWN);
+		NextSession(history2);
+	}
+	CHECK(history2.GetCount()==1);
+
+	// only the MAX_ENTRIES items with the highest scores are saved
+	CAccessHistory history3;
+	for (unsigned int i=0;i<CAccessHistory::MAX_ENTRIES+50;i++)
+		history3.Record(i,i<50?CAccessHistory::WEIGHT_SHOWN:CAccessHistory::WEIGHT_EXECUTED);
+	history3.Save(data1);
+	CHECK(data1[2]==CAccessHistory::MAX_ENTRIES);
+	CHECK(history3.Load(&data1[0],(int)data1.size()*4));
+	CHECK(history3.GetCount()==CAccessHistory::MAX_ENTRIES);
+	history3.Predict(CAccessHistory::MAX_ENTRIES+50,hashes1);
+	CHECK(hashes1.size()==CAccessHistory::MAX_ENTRIES);
+	CHECK(*std::min_element(hashes1.begin(),hashes1.end())==50);
+}
+
+TEST(AccessHistory,Invalid)
+{
+	CAccessHistory history;
+	history.Record(1,CAccessHistory::WEIGHT_SHOWN);
+	std::vector<unsigned int> data=MakeData(10,5,100,0);
+	CHECK(history.Load(&data[0],(int)data.size()*4));
+	CHECK(history.GetCount()==1);
+
+	// every failure clears the history
+	std::vector<unsigned int> bad=data;
+	bad[0]=2; // version
+	CHECK(!history.Load(&bad[0],(int)bad.size()*4));
+	CHECK(history.GetCount()==0);
+	CHECK(history.Load(&data[0],(int)data.size()*4));
+	CHECK(!history.Load(&data[0],(int)data.size()*4-4)); // too short
+	CHECK(history.GetCount()==0);
+	CHECK(!history.Load(&data[0],8));
+	CHECK(!history.Load(NULL,0));
+	bad=data;
+	bad[2]=2; // wrong count
+	CHECK(!history.Load(&bad[0],(int)bad.size()*4));
+	bad.push_back(5); // a duplicate hash
+	bad.push_back(50);
+	CHECK(!history.Load(&bad[0],(int)bad.size()*4));
+	CHECK(history.GetCount()==0);
+	bad[5]=6;
+	CHECK(history.Load(&bad[0],(int)bad.size()*4));
+	CHECK(history.GetCount()==2);
+
+	// too many entries
+	bad.clear();
+	bad.push_back(1);
+	bad.push_back(0);
+	bad.push_back(CAccessHistory::MAX_ENTRIES+1);
+	for (unsigned int i=0;i<CAccessHistory::MAX_ENTRIES+1;i++)
+	{
+		bad.push_back(i);
+		bad.push_back(10);
+	}
+	CHECK(!history.Load(&bad[0],(int)bad.size()*4));
+	CHECK(history.GetCount()==0);
+}
+
+TEST(AccessHistory,MaxAge)
+{
+	// regression: the age read from the data is clamped, so a damaged or very old history doesn't produce huge decay steps
+	std::vector<unsigned int> hashes, data;
+	static const unsigned int ages[]={64,65,127,128,129,0x8000,0xFFFF};
+	for (int i=0;i<_countof(ages);i++)
+	{
+		CAccessHistory history;
+		data=MakeData(1000,7,0xFFFF,ages[i]);
+		CHECK(history.Load(&data[0],(int)data.size()*4));
+		history.Predict(10,hashes);
+		CHECK(hashes.empty());
+		history.Save(data);
+		CHECK(data.size()==3);
+		// using the item again starts from 0
+		history.Record(7,CAccessHistory::WEIGHT_SHOWN);
+		history.Save(data);
+		CHECK(data.size()==5 && data[4]==16);
+	}
+
+	// the session number wraps around
+	CAccessHistory history;
+	data=MakeData(3,7,0xFFFF,0xFFFF);
+	CHECK(history.Load(&data[0],(int)data.size()*4));
+	history.Predict(10,hashes);
+	CHECK(hashes.empty());
+	data=MakeData(3,7,0xFFFF,10);
+	CHECK(history.Load(&data[0],(int)data.size()*4));
+	history.Save(data);
+	CHECK(data.size()==5 && data[1]==4 && data[4]==(0xFFFF|(11<<16)));
+
+	// a young entry survives and gets older by one session
+	data=MakeData(1000,7,0xFFFF,40);
+	CHECK(history.Load(&data[0],(int)data.size()*4));
+	history.Predict(10,hashes);
+	CHECK(hashes.size()==1 && hashes[0]==7);
+}
+
+TEST(AccessHistory,Synthetic)
+{
+	// 40 items, each used in a session with its own probability. the even ones are executed, the odd ones only shown.
+	// after a while the items that are used most often must be predicted first
+	CTestRandom random(38);
+	CAccessHistory history;
+	const int ITEMS=40, SESSIONS=300, WARMUP=100;
+	int predicted[ITEMS]={0};
+	for (int session=0;session<SESSIONS;session++)
+	{
+		for (int i=0;i<ITEMS;i++)
+		{
+			// item i is used in (ITEMS-i)*100/ITEMS percent of the sessions
+			if (random.Next(ITEMS)<ITEMS-i)
+				history.Record(1000+i,(i%2)?CAccessHistory::WEIGHT_SHOWN:CAccessHistory::WEIGHT_EXECUTED);
+		}
+		NextSession(history);
+
+		std::vector<unsigned int> data;
+		history.Save(data);
+		CHECK((int)data[2]<=CAccessHistory::MAX_ENTRIES);
+		unsigned int lastScore=0xFFFFFFFF;
+		for (unsigned int j=0;j<data[2];j++)
+		{
+			unsigned int score=data[4+j*2]&0xFFFF, age=data[4+j*2]>>16;
+			CHECK(score>0 && age<=64);
+			// the entries are sorted by the decayed score
+			unsigned int decayed=CAccessHistory::DecayScore(score,age);
+			CHECK(decayed<=lastScore);
+			lastScore=decayed;
+		}
+
+		if (session>=WARMUP)
+		{
+			std::vector<unsigned int> hashes;
+			history.Predict(10,hashes);
+			CHECK(hashes.size()==10);
+			for (std::vector<unsigned int>::const_iterator it=hashes.begin();it!=hashes.end();++it)
+				predicted[*it-1000]++;
+		}
+	}
+
+	// the executed items that are used in more than 90% of the sessions are almost always in the top 10
+	for (int i=0;i<8;i+=2)
+		CHECK(predicted[i]>=(SESSIONS-WARMUP)*9/10);
+	// the rarely used items are rarely predicted
+	int top=0, bottom=0;
+	for (int i=0;i<10;i++)
+	{
+		top+=predicted[i];
+		bottom+=predicted[ITEMS-1-i];
+	}
+	CHECK(top>bottom*10);
+}
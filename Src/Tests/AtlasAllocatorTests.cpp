@@ -0,0 +1,237 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "AtlasAllocator.h"
+#include <stdio.h>
+
+// Tracks which pixels of the page are used, to find overlapping rectangles
+class CPageMap
+{
+public:
+	CPageMap( int width, int height ) : m_Width(width), m_Height(height), m_Pixels(width*height,0) {}
+
+	// Returns false if the rectangle is outside of the page or overlaps another one
+	bool Add( const AtlasRect &rc )
+	{
+		if (rc.x<0 || rc.y<0 || rc.x+rc.width>m_Width || rc.y+rc.height>m_Height)
+			return false;
+		bool bResult=true;
+		for (int y=rc.y;y<rc.y+rc.height;y++)
+			for (int x=rc.x;x<rc.x+rc.width;x++)
+			{
+				if (m_Pixels[y*m_Width+x]) bResult=false;
+				m_Pixels[y*m_Width+x]=1;
+			}
+		return bResult;
+	}
+
+	void Remove( const AtlasRect &rc )
+	{
+		for (int y=rc.y;y<rc.y+rc.height;y++)
+			for (int x=rc.x;x<rc.x+rc.width;x++)
+				m_Pixels[y*m_Width+x]=0;
+	}
+
+private:
+	int m_Width, m_Height;
+	std::vector<char> m_Pixels;
+};
+
+static bool IsSameRect( const AtlasRect &rc1, const AtlasRect &rc2 )
+{
+	return rc1.x==rc2.x && rc1.y==rc2.y && rc1.width==rc2.width && rc1.height==rc2.height;
+}
+
+TEST(AtlasAllocator,Alloc)
+{
+	CAtlasAllocator allocator;
+	allocator.Init(64,64);
+	CHECK(allocator.IsEmpty());
+	CPageMap map(64,64);
+	AtlasRect rc;
+	CHECK(!allocator.Alloc(0,16,rc));
+	CHECK(!allocator.Alloc(16,-1,rc));
+	CHECK(!allocator.Alloc(65,16,rc));
+	CHECK(!allocator.Alloc(16,65,rc));
+
+	// 16 icons fill the page exactly
+	AtlasRect rects[16];
+	for (int i=0;i<16;i++)
+	{
+		CHECK(allocator.Alloc(16,16,rects[i]));
+		CHECK(map.Add(rects[i]));
+		CHECK(rects[i].width==16 && rects[i].height==16);
+	}
+	CHECK(allocator.GetCount()==16);
+	CHECK(!allocator.Alloc(16,16,rc));
+	CHECK(!allocator.Alloc(1,1,rc));
+
+	// a freed rectangle is reused
+	allocator.Free(rects[5]);
+	CHECK(allocator.GetCount()==15);
+	CHECK(allocator.Alloc(16,16,rc));
+	CHECK(IsSameRect(rc,rects[5]));
+	allocator.Free(rects[6]);
+	CHECK(!allocator.Alloc(17,16,rc));
+	CHECK(!allocator.Alloc(16,17,rc)); // too tall for the shelf
+	CHECK(allocator.Alloc(10,14,rc)); // up to 25% shorter fits in the shelf
+	CHECK(rc.x==rects[6].x && rc.y==rects[6].y);
+	allocator.Free(rc);
+
+	allocator.Clear();
+	CHECK(allocator.IsEmpty());
+	CHECK(allocator.Alloc(64,64,rc));
+	CHECK(rc.x==0 && rc.y==0);
+}
+
+TEST(AtlasAllocator,Coalesce)
+{
+	CAtlasAllocator allocator;
+	allocator.Init(64,32);
+	AtlasRect rects[4], rc;
+	for (int i=0;i<4;i++)
+		allocator.Alloc(16,16,rects[i]);
+
+	// two neighbors merge into one span
+	allocator.Free(rects[1]);
+	allocator.Free(rects[2]);
+	CHECK(allocator.Alloc(32,16,rc));
+	CHECK(rc.x==16 && rc.y==0);
+	allocator.Free(rc);
+
+	// freeing the last one shrinks the tail, including the free span before it
+	allocator.Free(rects[3]);
+	CHECK(allocator.Alloc(48,16,rc));
+	CHECK(rc.x==16 && rc.y==0);
+	allocator.Free(rc);
+
+	// a span that merges with both neighbors
+	allocator.Alloc(16,16,rects[1]);
+	allocator.Alloc(16,16,rects[2]);
+	allocator.Alloc(16,16,rects[3]);
+	allocator.Free(rects[1]);
+	allocator.Free(rects[3]);
+	CHECK(allocator.GetCount()==2);
+	allocator.Free(rects[2]);
+	CHECK(allocator.Alloc(48,16,rc));
+	CHECK(rc.x==16);
+	allocator.Free(rc);
+
+	// an empty shelf at the bottom is given back to the page, so a taller rectangle fits
+	allocator.Free(rects[0]);
+	CHECK(allocator.IsEmpty());
+	CHECK(allocator.Alloc(64,32,rc));
+	allocator.Free(rc);
+
+	// an empty shelf that is too tall is reused when there is no other room
+	allocator.Alloc(64,24,rects[0]);
+	allocator.Alloc(32,8,rects[1]);
+	allocator.Free(rects[0]);
+	CHECK(allocator.Alloc(32,8,rc));
+	CHECK(rc.y==24); // the shelf of the same height
+	CHECK(allocator.Alloc(64,8,rc));
+	CHECK(rc.y==0); // the empty shelf
+}
+
+// Random allocations and frees of the given sizes. Checks that the rectangles never overlap and returns how full the page was (in %) when an allocation failed
+static int TestFragmentation( const int *sizes, int count, int seed )
+{
+	const int PAGE=512;
+	CTestRandom random(seed);
+	CAtlasAllocator allocator;
+	allocator.Init(PAGE,PAGE);
+	CPageMap map(PAGE,PAGE);
+	std::vector<AtlasRect> rects;
+	int area=0, minFill=100, failures=0;
+	for (int i=0;i<100000;i++)
+	{
+		int freeCount=0;
+		if (rects.empty() || random.Next(100)<55)
+		{
+			int size=sizes[random.Next(count)];
+			AtlasRect rc;
+			if (allocator.Alloc(size,size,rc))
+			{
+				CHECK(map.Add(rc));
+				rects.push_back(rc);
+				area+=size*size;
+			}
+			else
+			{
+				int fill=(int)((long long)area*100/(PAGE*PAGE));
+				if (fill<minFill) minFill=fill;
+				failures++;
+				freeCount=10; // free a few to continue
+			}
+		}
+		else
+			freeCount=1;
+		for (;freeCount>0 && !rects.empty();freeCount--)
+		{
+			int index=random.Next((int)rects.size());
+			allocator.Free(rects[index]);
+			map.Remove(rects[index]);
+			area-=rects[index].width*rects[index].height;
+			rects[index]=rects.back();
+			rects.pop_back();
+		}
+		CHECK(allocator.GetCount()==(int)rects.size());
+	}
+	CHECK(failures>0);
+
+	// everything is given back after all rectangles are freed
+	for (std::vector<AtlasRect>::const_iterator it=rects.begin();it!=rects.end();++it)
+		allocator.Free(*it);
+	CHECK(allocator.IsEmpty());
+	AtlasRect rc;
+	CHECK(allocator.Alloc(PAGE,PAGE,rc));
+	return minFill;
+}
+
+TEST(AtlasAllocator,Fragmentation)
+{
+	// each atlas holds one size type, so most icons have the same size, with a few odd ones
+	static const int sizes1[]={32,32,32,32,32,32,32,24,20};
+	int fill1=TestFragmentation(sizes1,_countof(sizes1),26);
+	// the worst case - all sizes mixed in one page
+	static const int sizes2[]={16,20,24,32,48,64};
+	int fill2=TestFragmentation(sizes2,_countof(sizes2),126);
+	printf("AtlasAllocator: the page was at least %d%% full with one size, %d%% with mixed sizes\n",fill1,fill2);
+	CHECK(fill1>=75);
+	CHECK(fill2>=45);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+BENCHMARK(AtlasAllocator,Throughput)
+{
+	// the number of Alloc+Free pairs per second with a page that is kept about half full
+	const int PAGE=512, COUNT=2000000;
+	static const int sizes[]={16,20,24,32,48};
+	CTestRandom random(1);
+	CAtlasAllocator allocator;
+	allocator.Init(PAGE,PAGE);
+	std::vector<AtlasRect> rects;
+	AtlasRect rc;
+	while (allocator.Alloc(16,16,rc) && rects.size()<500)
+		rects.push_back(rc);
+	int failed=0;
+	double time=GetBenchmarkTime();
+	for (int i=0;i<COUNT;i++)
+	{
+		int index=random.Next((int)rects.size());
+		allocator.Free(rects[index]);
+		int size=sizes[random.Next(_countof(sizes))];
+		if (!allocator.Alloc(size,size,rects[index]) && !allocator.Alloc(16,16,rects[index]))
+		{
+			failed++;
+			rects[index]=rects.back();
+			rects.pop_back();
+		}
+	}
+	time=GetBenchmarkTime()-time;
+	printf("AtlasAllocator: %.1f million Alloc+Free per second, %d rectangles, %d failed\n",COUNT/time/1000000,(int)rects.size(),failed);
+}
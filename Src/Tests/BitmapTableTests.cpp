@@ -0,0 +1,226 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "BitmapTable.h"
+
+// a bitmap with its own pixels, like one icon in an atlas page. the stride is wider than the icon
+struct TestBitmap: public CBitmapTable::Bitmap
+{
+	std::vector<unsigned int> pixels;
+
+	TestBitmap( const std::vector<unsigned int> &src, int width, int height )
+	{
+		stride=width+3;
+		pixels.resize(stride*height,0xDEADBEEF);
+		for (int y=0;y<height;y++)
+			for (int x=0;x<width;x++)
+				pixels[y*stride+x]=src[y*width+x];
+		bits=&pixels[0];
+		rc.x=rc.y=0;
+		rc.width=width;
+		rc.height=height;
+	}
+
+	static int s_Deleted;
+	~TestBitmap( void ) { s_Deleted++; }
+};
+
+int TestBitmap::s_Deleted;
+
+static std::vector<unsigned int> RandomPixels( CTestRandom &random, int count )
+{
+	std::vector<unsigned int> pixels(count);
+	for (std::vector<unsigned int>::iterator it=pixels.begin();it!=pixels.end();++it)
+		*it=(unsigned int)random.Next();
+	return pixels;
+}
+
+// Returns the pixels with the rows in reverse order
+static std::vector<unsigned int> FlipPixels( const std::vector<unsigned int> &pixels, int width, int height )
+{
+	std::vector<unsigned int> flipped(pixels.size());
+	for (int y=0;y<height;y++)
+		for (int x=0;x<width;x++)
+			flipped[(height-1-y)*width+x]=pixels[y*width+x];
+	return flipped;
+}
+
+static unsigned int CalcHash( const std::vector<unsigned int> &pixels, int width, int height )
+{
+	return CalcPixelHash(&pixels[0],width,height,width,false);
+}
+
+TEST(BitmapTable,Hash)
+{
+	CTestRandom random(27);
+	std::vector<unsigned int> pixels=RandomPixels(random,16*12);
+	unsigned int hash=CalcHash(pixels,16,12);
+
+	// bottom-up input has the same hash as the same image top-down
+	std::vector<unsigned int> flipped=FlipPixels(pixels,16,12);
+	CHECK(CalcPixelHash(&flipped[0],16,12,16,true)==hash);
+	CHECK(CalcPixelHash(&flipped[0],16,12,16,false)!=hash);
+
+	// the padding after each row is not part of the hash
+	TestBitmap bitmap(pixels,16,12);
+	CHECK(CalcPixelHash(bitmap.bits,16,12,bitmap.stride,false)==hash);
+
+	// the same pixels with a different size
+	CHECK(CalcHash(pixels,12,16)!=hash);
+	CHECK(CalcHash(pixels,16,11)!=hash);
+
+	// a single changed bit
+	pixels[100]^=0x01000000;
+	CHECK(CalcHash(pixels,16,12)!=hash);
+}
+
+TEST(BitmapTable,Find)
+{
+	CTestRandom random(127);
+	std::vector<unsigned int> pixels1=RandomPixels(random,16*16), pixels2=RandomPixels(random,16*16);
+	unsigned int hash1=CalcHash(pixels1,16,16), hash2=CalcHash(pixels2,16,16);
+	CBitmapTable table;
+	CHECK(!table.Find(hash1,&pixels1[0],16,16,false));
+
+	TestBitmap *pBitmap1=new TestBitmap(pixels1,16,16);
+	table.Add(pBitmap1,hash1);
+	CHECK(table.GetCount()==1);
+	CHECK(CBitmapTable::GetRefCount(pBitmap1)==1);
+	CHECK(!table.Find(hash2,&pixels2[0],16,16,false));
+
+	// the same pixels in a different buffer, top-down and bottom-up
+	std::vector<unsigned int> copy=pixels1;
+	CHECK(table.Find(hash1,&copy[0],16,16,false)==pBitmap1);
+	std::vector<unsigned int> flipped=FlipPixels(pixels1,16,16);
+	CHECK(table.Find(hash1,&flipped[0],16,16,true)==pBitmap1);
+	CHECK(CBitmapTable::GetRefCount(pBitmap1)==3);
+	CHECK(table.GetCount()==1);
+
+	TestBitmap *pBitmap2=new TestBitmap(pixels2,16,16);
+	table.Add(pBitmap2,hash2);
+	CHECK(table.Find(hash2,&pixels2[0],16,16,false)==pBitmap2);
+	CHECK(table.Find(hash1,&pixels1[0],16,16,false)==pBitmap1);
+	CHECK(table.GetCount()==2);
+
+	TestBitmap::s_Deleted=0;
+	table.DeleteAll<TestBitmap>();
+	CHECK(TestBitmap::s_Deleted==2);
+	CHECK(table.GetCount()==0);
+	CHECK(!table.Find(hash1,&pixels1[0],16,16,false));
+}
+
+TEST(BitmapTable,RefCount)
+{
+	CTestRandom random(227);
+	std::vector<unsigned int> pixels1=RandomPixels(random,16*16), pixels2=RandomPixels(random,32*32);
+	unsigned int hash1=CalcHash(pixels1,16,16), hash2=CalcHash(pixels2,32,32);
+	CBitmapTable table;
+	CBitmapTable::Stats stats;
+	table.GetStats(stats);
+	CHECK(stats.bitmaps==0 && stats.references==0 && stats.bytes==0 && stats.savedBytes==0);
+	CHECK(CBitmapTable::GetRefCount(NULL)==0);
+	CBitmapTable::AddRef(NULL);
+	CHECK(!table.Release(NULL));
+
+	TestBitmap *pBitmap1=new TestBitmap(pixels1,16,16);
+	table.Add(pBitmap1,hash1);
+	TestBitmap *pBitmap2=new TestBitmap(pixels2,32,32);
+	table.Add(pBitmap2,hash2);
+	CBitmapTable::AddRef(pBitmap1);
+	CHECK(table.Find(hash1,&pixels1[0],16,16,false)==pBitmap1);
+	CHECK(CBitmapTable::GetRefCount(pBitmap1)==3);
+	CHECK(CBitmapTable::GetRefCount(pBitmap2)==1);
+
+	// 4 icons use 2 bitmaps. 2 of them share the 16x16 bitmap with the first one
+	table.GetStats(stats);
+	CHECK(stats.bitmaps==2);
+	CHECK(stats.references==4);
+	CHECK(stats.bytes==16*16*4+32*32*4);
+	CHECK(stats.savedBytes==2*16*16*4);
+
+	// the bitmap stays in the table until the last reference is released
+	CHECK(!table.Release(pBitmap1));
+	CHECK(!table.Release(pBitmap1));
+	CHECK(CBitmapTable::GetRefCount(pBitmap1)==1);
+	CHECK(table.GetCount()==2);
+	CHECK(table.Release(pBitmap1));
+	delete pBitmap1;
+	CHECK(table.GetCount()==1);
+	CHECK(!table.Find(hash1,&pixels1[0],16,16,false));
+	table.GetStats(stats);
+	CHECK(stats.bitmaps==1 && stats.references==1 && stats.bytes==32*32*4 && stats.savedBytes==0);
+
+	// the same pixels can be added again after that
+	pBitmap1=new TestBitmap(pixels1,16,16);
+	table.Add(pBitmap1,hash1);
+	CHECK(table.Find(hash1,&pixels1[0],16,16,false)==pBitmap1);
+	CHECK(CBitmapTable::GetRefCount(pBitmap1)==2);
+
+	CHECK(table.Release(pBitmap2));
+	delete pBitmap2;
+	table.DeleteAll<TestBitmap>();
+}
+
+TEST(BitmapTable,Collision)
+{
+	// different pixels and sizes with the same hash. the table must tell them apart by the pixels
+	const unsigned int HASH=0x12345678;
+	CTestRandom random(327);
+	std::vector<unsigned int> pixels1=RandomPixels(random,16*16), pixels2=pixels1, pixels3=RandomPixels(random,16*16);
+	pixels2[255]^=1; // only the last pixel is different
+	CBitmapTable table;
+	TestBitmap *pBitmap1=new TestBitmap(pixels1,16,16);
+	table.Add(pBitmap1,HASH);
+	CHECK(!table.Find(HASH,&pixels2[0],16,16,false));
+	CHECK(!table.Find(HASH,&pixels1[0],8,32,false)); // the same pixels, but a different size
+	CHECK(!table.Find(HASH,&pixels1[0],16,15,false));
+	std::vector<unsigned int> left(8*16); // the left half of the first bitmap
+	for (int y=0;y<16;y++)
+		for (int x=0;x<8;x++)
+			left[y*8+x]=pixels1[y*16+x];
+	CHECK(!table.Find(HASH,&left[0],8,16,false));
+	CHECK(CBitmapTable::GetRefCount(pBitmap1)==1);
+
+	TestBitmap *pBitmap2=new TestBitmap(pixels2,16,16);
+	table.Add(pBitmap2,HASH);
+	TestBitmap *pBitmap3=new TestBitmap(pixels1,8,32);
+	table.Add(pBitmap3,HASH);
+	TestBitmap *pBitmap4=new TestBitmap(pixels3,16,16);
+	table.Add(pBitmap4,HASH);
+	CHECK(table.GetCount()==4);
+	CHECK(table.Find(HASH,&pixels1[0],16,16,false)==pBitmap1);
+	CHECK(table.Find(HASH,&pixels2[0],16,16,false)==pBitmap2);
+	CHECK(table.Find(HASH,&pixels1[0],8,32,false)==pBitmap3);
+	CHECK(table.Find(HASH,&pixels3[0],16,16,false)==pBitmap4);
+	std::vector<unsigned int> flipped=FlipPixels(pixels2,16,16);
+	CHECK(table.Find(HASH,&flipped[0],16,16,true)==pBitmap2);
+
+	// releasing one of them removes only that one
+	CHECK(!table.Release(pBitmap2));
+	CHECK(!table.Release(pBitmap2));
+	CHECK(table.Release(pBitmap2));
+	delete pBitmap2;
+	CHECK(table.GetCount()==3);
+	CHECK(!table.Find(HASH,&pixels2[0],16,16,false));
+	CHECK(table.Find(HASH,&pixels1[0],16,16,false)==pBitmap1);
+	CHECK(table.Find(HASH,&pixels1[0],8,32,false)==pBitmap3);
+	CHECK(table.Find(HASH,&pixels3[0],16,16,false)==pBitmap4);
+
+	// the first one in the multimap
+	CHECK(!table.Release(pBitmap1));
+	CHECK(!table.Release(pBitmap1));
+	CHECK(table.Release(pBitmap1));
+	delete pBitmap1;
+	CHECK(!table.Find(HASH,&pixels1[0],16,16,false));
+	CHECK(table.Find(HASH,&pixels3[0],16,16,false)==pBitmap4);
+
+	// a different hash is not found even with the same pixels
+	CHECK(!table.Find(HASH+1,&pixels3[0],16,16,false));
+	CBitmapTable::Stats stats;
+	table.GetStats(stats);
+	CHECK(stats.bitmaps==2 && stats.references==7);
+	table.DeleteAll<TestBitmap>();
+}
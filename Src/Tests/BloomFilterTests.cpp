@@ -0,0 +1,69 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "BloomFilter.h"
+#include "FNVHash.h"
+#include <stdio.h>
+
+static unsigned int CalcPathHash( const wchar_t *format, int index )
+{
+	wchar_t path[100];
+	swprintf(path,_countof(path),format,index);
+	return CalcFNVHash(path);
+}
+
+TEST(BloomFilter,Empty)
+{
+	CBloomFilter filter;
+	CHECK(!filter.MayContain(0));
+	CHECK(!filter.MayContain(CalcFNVHash(L"C:\\PROGRAM FILES\\APP.EXE")));
+	filter.Init(100);
+	CHECK(!filter.MayContain(CalcFNVHash(L"C:\\PROGRAM FILES\\APP.EXE")));
+}
+
+TEST(BloomFilter,AddClear)
+{
+	CBloomFilter filter;
+	unsigned int hash=CalcFNVHash(L"C:\\PROGRAM FILES\\APP.EXE");
+	filter.Add(hash); // the filter is sized automatically
+	CHECK(filter.MayContain(hash));
+	filter.Clear();
+	CHECK(!filter.MayContain(hash));
+	filter.Init(10);
+	filter.Add(hash);
+	filter.Add(hash);
+	CHECK(filter.MayContain(hash));
+	filter.Init(10);
+	CHECK(!filter.MayContain(hash));
+}
+
+TEST(BloomFilter,FalsePositives)
+{
+	const int COUNT=10000;
+	CHECK(CalcPathHash(L"C:\\PROGRAM FILES\\APP%d\\APP.EXE",1)!=CalcPathHash(L"C:\\PROGRAM FILES\\APP%d\\APP.EXE",2));
+	CBloomFilter filter;
+	filter.Init(COUNT);
+	for (int i=0;i<COUNT;i++)
+		filter.Add(CalcPathHash(L"C:\\PROGRAM FILES\\APP%d\\APP.EXE",i));
+
+	// never a false negative
+	int missing=0;
+	for (int i=0;i<COUNT;i++)
+	{
+		if (!filter.MayContain(CalcPathHash(L"C:\\PROGRAM FILES\\APP%d\\APP.EXE",i)))
+			missing++;
+	}
+	CHECK(missing==0);
+
+	// about 1% false positives. allow some margin
+	int positives=0;
+	for (int i=0;i<COUNT*10;i++)
+	{
+		if (filter.MayContain(CalcPathHash(L"C:\\WINDOWS\\TOOL%d.EXE",i)))
+			positives++;
+	}
+	CHECK(positives<COUNT*10/50);
+}
@@ -0,0 +1,117 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "ChangeCoalescer.h"
+#include <stdio.h>
+
+static const CChangeCoalescer::Change *FindChange( const std::vector<CChangeCoalescer::Change> &changes, const wchar_t *PATH, int folder )
+{
+	for (std::vector<CChangeCoalescer::Change>::const_iterator it=changes.begin();it!=changes.end();++it)
+	{
+		if (it->PATH==PATH && it->folder==folder)
+			return &*it;
+	}
+	return NULL;
+}
+
+TEST(ChangeCoalescer,Empty)
+{
+	CChangeCoalescer coalescer;
+	CHECK(!coalescer.IsPending());
+	CHECK(coalescer.GetTimeout(1000)==-1);
+	std::vector<CChangeCoalescer::Change> changes(1);
+	unsigned int folderMask=1;
+	coalescer.TakeChanges(changes,folderMask);
+	CHECK(changes.empty());
+	CHECK(folderMask==0);
+}
+
+TEST(ChangeCoalescer,Merge)
+{
+	CChangeCoalescer coalescer;
+	coalescer.AddPath(L"C:\\USERS\\IVO\\DESKTOP\\APP.LNK",0,false,100);
+	coalescer.AddPath(L"C:\\USERS\\IVO\\DESKTOP\\APP.LNK",0,true,110);
+	coalescer.AddPath(L"C:\\USERS\\IVO\\DESKTOP\\APP.LNK",0,false,120);
+	coalescer.AddPath(L"C:\\USERS\\IVO\\DESKTOP\\APP.LNK",1,false,130); // the same path in another watched folder
+	coalescer.AddPath(L"C:\\USERS\\IVO\\DESKTOP\\TOOL.LNK",0,false,140);
+	CHECK(coalescer.IsPending());
+
+	std::vector<CChangeCoalescer::Change> changes;
+	unsigned int folderMask;
+	coalescer.TakeChanges(changes,folderMask);
+	CHECK(changes.size()==3);
+	CHECK(folderMask==0);
+	const CChangeCoalescer::Change *change=FindChange(changes,L"C:\\USERS\\IVO\\DESKTOP\\APP.LNK",0);
+	CHECK(change && change->bAdded); // added once is enough
+	change=FindChange(changes,L"C:\\USERS\\IVO\\DESKTOP\\APP.LNK",1);
+	CHECK(change && !change->bAdded);
+	change=FindChange(changes,L"C:\\USERS\\IVO\\DESKTOP\\TOOL.LNK",0);
+	CHECK(change && !change->bAdded);
+
+	CHECK(!coalescer.IsPending());
+	coalescer.TakeChanges(changes,folderMask);
+	CHECK(changes.empty());
+}
+
+TEST(ChangeCoalescer,Timeout)
+{
+	CChangeCoalescer coalescer;
+	coalescer.AddPath(L"C:\\A.LNK",0,false,1000);
+	CHECK(coalescer.GetTimeout(1000)==CChangeCoalescer::QUIET_TIME);
+	CHECK(coalescer.GetTimeout(1400)==CChangeCoalescer::QUIET_TIME-400);
+	coalescer.AddPath(L"C:\\B.LNK",0,false,1500); // a new change restarts the quiet time
+	CHECK(coalescer.GetTimeout(1500)==CChangeCoalescer::QUIET_TIME);
+	CHECK(coalescer.GetTimeout(2500)==0);
+	CHECK(coalescer.GetTimeout(5000)==0);
+
+	// a steady stream of changes is processed MAX_DELAY after the first one
+	std::vector<CChangeCoalescer::Change> changes;
+	unsigned int folderMask;
+	coalescer.TakeChanges(changes,folderMask);
+	for (unsigned int time=10000;time<10000+CChangeCoalescer::MAX_DELAY;time+=CChangeCoalescer::QUIET_TIME/2)
+		coalescer.AddPath(L"C:\\A.LNK",0,false,time);
+	unsigned int last=10000+CChangeCoalescer::MAX_DELAY-CChangeCoalescer::QUIET_TIME/2;
+	CHECK(coalescer.GetTimeout(last)==CChangeCoalescer::QUIET_TIME/2);
+	CHECK(coalescer.GetTimeout(10000+CChangeCoalescer::MAX_DELAY)==0);
+
+	// the tick count wraps around
+	coalescer.TakeChanges(changes,folderMask);
+	coalescer.AddPath(L"C:\\A.LNK",0,false,0xFFFFFF00);
+	CHECK(coalescer.GetTimeout(0x100)==CChangeCoalescer::QUIET_TIME-0x200);
+}
+
+TEST(ChangeCoalescer,FolderOverflow)
+{
+	CChangeCoalescer coalescer;
+	coalescer.AddPath(L"C:\\USERS\\IVO\\DESKTOP\\APP.LNK",0,true,100);
+	for (int i=0;i<=CChangeCoalescer::MAX_FOLDER_CHANGES;i++)
+	{
+		wchar_t path[100];
+		swprintf(path,_countof(path),L"C:\\PROGRAMDATA\\START MENU\\APP%d.LNK",i);
+		coalescer.AddPath(path,2,true,100+i);
+	}
+	coalescer.AddPath(L"C:\\PROGRAMDATA\\START MENU\\LAST.LNK",2,true,400); // the folder is reloaded anyway
+
+	std::vector<CChangeCoalescer::Change> changes;
+	unsigned int folderMask;
+	coalescer.TakeChanges(changes,folderMask);
+	CHECK(folderMask==(1<<2));
+	CHECK(changes.size()==1);
+	CHECK(FindChange(changes,L"C:\\USERS\\IVO\\DESKTOP\\APP.LNK",0)!=NULL);
+
+	// the counts start again after the changes are taken
+	coalescer.AddPath(L"C:\\PROGRAMDATA\\START MENU\\APP.LNK",2,false,1000);
+	coalescer.TakeChanges(changes,folderMask);
+	CHECK(folderMask==0);
+	CHECK(changes.size()==1);
+
+	coalescer.AddPath(L"C:\\USERS\\IVO\\DESKTOP\\APP.LNK",0,true,2000);
+	coalescer.AddFolder(0,2100);
+	CHECK(coalescer.GetTimeout(2100)==CChangeCoalescer::QUIET_TIME);
+	coalescer.TakeChanges(changes,folderMask);
+	CHECK(folderMask==1);
+	CHECK(changes.empty());
+}
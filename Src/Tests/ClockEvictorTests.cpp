@@ -0,0 +1,231 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "ClockEvictor.h"
+#include <limits.h>
+#include <set>
+
+static CClockEvictor::Entry MakeEntry( unsigned int key, int size, bool bUsed, bool bPinned=false, int storage=-1 )
+{
+	CClockEvictor::Entry entry;
+	entry.key=key;
+	entry.size=size;
+	entry.storage=storage;
+	entry.bUsed=bUsed;
+	entry.bPinned=bPinned;
+	return entry;
+}
+
+static bool IsSame( const std::vector<int> &victims, const int *expected, int count )
+{
+	return victims==std::vector<int>(expected,expected+count);
+}
+
+TEST(ClockEvictor,Budget)
+{
+	CHECK(CClockEvictor::GetBudget(-5)==0);
+	CHECK(CClockEvictor::GetBudget(INT_MIN)==0);
+	CHECK(CClockEvictor::GetBudget(0)==0);
+	CHECK(CClockEvictor::GetBudget(1)==1024);
+	CHECK(CClockEvictor::GetBudget(4096)==4096*1024);
+	CHECK(CClockEvictor::GetBudget(0x1FFFFF)==0x7FFFFC00);
+	// larger sizes would overflow
+	CHECK(CClockEvictor::GetBudget(0x200000)==0x7FFFFC00);
+	CHECK(CClockEvictor::GetBudget(INT_MAX)==0x7FFFFC00);
+}
+
+TEST(ClockEvictor,SecondChance)
+{
+	CClockEvictor evictor;
+	std::vector<CClockEvictor::Entry> entries;
+	std::vector<int> refCounts, victims;
+	for (int i=1;i<=5;i++)
+		entries.push_back(MakeEntry(i*10,10,i==1 || i==3));
+
+	// under the budget nothing is evicted
+	CHECK(evictor.Select(entries,refCounts,50,50,victims)==50);
+	CHECK(victims.empty() && entries[0].bUsed);
+
+	// the used entries lose their reference bit and are skipped
+	CHECK(evictor.Select(entries,refCounts,50,30,victims)==30);
+	static const int victims1[]={1,3};
+	CHECK(IsSame(victims,victims1,2));
+	CHECK(!entries[0].bUsed && !entries[2].bUsed);
+	CHECK(!entries[4].bUsed); // the hand stopped before it
+
+	// the next call continues after the last victim (key 40) and wraps around. key 10 was used again since the last call
+	entries.clear();
+	entries.push_back(MakeEntry(10,10,true));
+	entries.push_back(MakeEntry(30,10,false));
+	entries.push_back(MakeEntry(50,10,false));
+	victims.clear();
+	CHECK(evictor.Select(entries,refCounts,30,10,victims)==10);
+	static const int victims2[]={2,1};
+	CHECK(IsSame(victims,victims2,2));
+	CHECK(!entries[0].bUsed);
+
+	// when all entries are used, the first turn clears the bits and the second one evicts
+	CClockEvictor evictor2;
+	entries.clear();
+	for (int i=1;i<=4;i++)
+		entries.push_back(MakeEntry(i,10,true));
+	victims.clear();
+	CHECK(evictor2.Select(entries,refCounts,40,25,victims)==20);
+	static const int victims3[]={0,1};
+	CHECK(IsSame(victims,victims3,2));
+	CHECK(!entries[2].bUsed && !entries[3].bUsed);
+
+	// the hand is past the last key, so the next call starts from the beginning
+	CClockEvictor evictor3;
+	entries.clear();
+	entries.push_back(MakeEntry(5,10,true));
+	entries.push_back(MakeEntry(6,10,false));
+	victims.clear();
+	CHECK(evictor3.Select(entries,refCounts,20,10,victims)==10);
+	CHECK(victims.size()==1 && victims[0]==1);
+	entries.clear();
+	entries.push_back(MakeEntry(1,10,false));
+	entries.push_back(MakeEntry(5,10,false));
+	victims.clear();
+	CHECK(evictor3.Select(entries,refCounts,20,10,victims)==10);
+	CHECK(victims.size()==1 && victims[0]==0);
+
+	// the entry under the hand was already visited, even if the caller kept it. the next call starts after it
+	entries[0]=MakeEntry(1,10,false);
+	entries.push_back(MakeEntry(7,10,false));
+	victims.clear();
+	CHECK(evictor3.Select(entries,refCounts,30,20,victims)==20);
+	CHECK(victims.size()==1 && victims[0]==1);
+}
+
+TEST(ClockEvictor,Pinned)
+{
+	// the pinned entries are never evicted, even if the budget can't be reached
+	CClockEvictor evictor;
+	std::vector<CClockEvictor::Entry> entries;
+	std::vector<int> refCounts, victims;
+	entries.push_back(MakeEntry(1,10,false,true));
+	entries.push_back(MakeEntry(2,10,true));
+	entries.push_back(MakeEntry(3,10,false,true));
+	entries.push_back(MakeEntry(4,10,false));
+	CHECK(evictor.Select(entries,refCounts,40,0,victims)==20);
+	static const int victims1[]={3,1};
+	CHECK(IsSame(victims,victims1,2));
+
+	// a budget of 0 evicts everything that is not pinned. each entry only once
+	entries.clear();
+	for (int i=1;i<=6;i++)
+		entries.push_back(MakeEntry(i,100,(i&1)!=0,i==6));
+	victims.clear();
+	CClockEvictor evictor2;
+	CHECK(evictor2.Select(entries,refCounts,600,0,victims)==100);
+	CHECK(victims.size()==5);
+	CHECK(std::set<int>(victims.begin(),victims.end()).size()==5);
+
+	// no entries
+	entries.clear();
+	victims.clear();
+	CHECK(evictor2.Select(entries,refCounts,100,0,victims)==100);
+	CHECK(victims.empty());
+}
+
+TEST(ClockEvictor,Shared)
+{
+	// keys 1-3 share one bitmap of 100 bytes, key 4 owns 50 bytes. the shared bitmap is counted once in the total
+	CClockEvictor evictor;
+	std::vector<CClockEvictor::Entry> entries;
+	std::vector<int> refCounts(1,3), victims;
+	for (int i=1;i<=3;i++)
+		entries.push_back(MakeEntry(i,100,false,false,0));
+	entries.push_back(MakeEntry(4,50,false));
+
+	// evicting one user of the shared bitmap doesn't free it, so the hand must continue to the other users
+	CHECK(evictor.Select(entries,refCounts,150,60,victims)==50);
+	static const int victims1[]={0,1,2};
+	CHECK(IsSame(victims,victims1,3));
+	CHECK(refCounts[0]==0);
+
+	// the bitmap has one more reference that is not in the cache, so it is never freed
+	CClockEvictor evictor2;
+	entries.clear();
+	for (int i=1;i<=3;i++)
+		entries.push_back(MakeEntry(i,100,false,false,0));
+	entries.push_back(MakeEntry(4,50,false));
+	refCounts[0]=4;
+	victims.clear();
+	CHECK(evictor2.Select(entries,refCounts,150,60,victims)==100);
+	CHECK(victims.size()==4);
+	CHECK(refCounts[0]==1);
+}
+
+TEST(ClockEvictor,Random)
+{
+	// random caches with shared bitmaps. the returned size must match the bitmaps that are still referenced
+	CTestRandom random(28);
+	for (int test=0;test<1000;test++)
+	{
+		int storageCount=1+random.Next(10), entryCount=1+random.Next(40);
+		std::vector<int> storageSizes(storageCount), refCounts(storageCount);
+		for (int i=0;i<storageCount;i++)
+		{
+			storageSizes[i]=(1+random.Next(4))*256;
+			refCounts[i]=random.Next(3); // references from outside of the cache
+		}
+		std::vector<CClockEvictor::Entry> entries;
+		std::vector<bool> pinned;
+		int totalSize=0;
+		for (int i=0;i<entryCount;i++)
+		{
+			int storage=random.Next(storageCount+3)-3;
+			if (storage<0)
+			{
+				entries.push_back(MakeEntry(i*2+1,100,random.Next(2)==0,random.Next(8)==0));
+				totalSize+=100;
+			}
+			else
+			{
+				entries.push_back(MakeEntry(i*2+1,storageSizes[storage],random.Next(2)==0,random.Next(8)==0,storage));
+				refCounts[storage]++;
+			}
+			pinned.push_back(entries.back().bPinned);
+		}
+		// each bitmap that has references is counted once
+		for (int i=0;i<storageCount;i++)
+			if (refCounts[i]>0)
+				totalSize+=storageSizes[i];
+		std::vector<int> refs=refCounts;
+
+		CClockEvictor evictor;
+		int budget=random.Next(totalSize+1);
+		std::vector<int> victims;
+		int result=evictor.Select(entries,refCounts,totalSize,budget,victims);
+
+		int expected=totalSize;
+		std::set<int> evicted;
+		for (std::vector<int>::const_iterator it=victims.begin();it!=victims.end();++it)
+		{
+			CHECK(evicted.insert(*it).second);
+			CHECK(!pinned[*it]);
+			const CClockEvictor::Entry &entry=entries[*it];
+			if (entry.storage<0 || --refs[entry.storage]==0)
+				expected-=entry.size;
+		}
+		CHECK(result==expected);
+		CHECK(refs==refCounts);
+		if (result>budget)
+		{
+			// the budget was not reached, so everything that is not pinned was evicted
+			for (int i=0;i<entryCount;i++)
+				CHECK(pinned[i] || evicted.count(i)==1);
+		}
+		else if (!victims.empty())
+		{
+			// the last victim is the one that reached the budget
+			const CClockEvictor::Entry &entry=entries[victims.back()];
+			CHECK(result+(entry.storage<0 || refs[entry.storage]==0?entry.size:0)>budget);
+		}
+	}
+}
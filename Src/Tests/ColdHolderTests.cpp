@@ -0,0 +1,292 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "ColdHolder.h"
+#include <stdio.h>
+#include <map>
+
+// like ItemInfoCold. counts the live copies to find leaks and double deletes
+struct TestCold
+{
+	TestCold( void ) { color=0; s_Count++; }
+	TestCold( const TestCold &cold ) : target(cold.target), name(cold.name), color(cold.color) { s_Count++; }
+	~TestCold( void ) { s_Count--; }
+	bool IsEmpty( void ) const { return target.IsEmpty() && name.IsEmpty() && color==0; }
+
+	CString target;
+	CString name;
+	unsigned int color;
+
+	static int s_Count;
+};
+
+int TestCold::s_Count;
+
+typedef CColdHolder<TestCold> TTestHolder;
+
+TEST(ColdHolder,Alloc)
+{
+	TestCold::s_Count=0;
+	{
+		TTestHolder holder;
+		CHECK(!holder.Get());
+		holder.Compact();
+		CHECK(!holder.Get());
+
+		TestCold &cold=holder.Alloc();
+		CHECK(holder.Get()==&cold);
+		CHECK(cold.IsEmpty());
+		// a second Alloc returns the same data
+		cold.name=L"name";
+		CHECK(&holder.Alloc()==&cold);
+		CHECK(holder.Get()->name==L"name");
+		CHECK(TestCold::s_Count==1);
+
+		// Compact keeps the data while a field is set
+		holder.Compact();
+		CHECK(holder.Get()==&cold);
+		cold.name=L"";
+		cold.color=5;
+		holder.Compact();
+		CHECK(holder.Get()==&cold);
+		cold.color=0;
+		holder.Compact();
+		CHECK(!holder.Get());
+		CHECK(TestCold::s_Count==0);
+
+		holder.Alloc().target=L"target";
+	}
+	// the destructor frees the data
+	CHECK(TestCold::s_Count==0);
+}
+
+TEST(ColdHolder,Copy)
+{
+	TestCold::s_Count=0;
+	{
+		TTestHolder holder1;
+		holder1.Alloc().target=L"C:\\Target.exe";
+		holder1.Alloc().color=0xFF0000;
+
+		// the copy has its own data
+		TTestHolder holder2(holder1);
+		CHECK(holder2.Get() && holder2.Get()!=holder1.Get());
+		CHECK(holder2.Get()->target==L"C:\\Target.exe" && holder2.Get()->color==0xFF0000);
+		CHECK(TestCold::s_Count==2);
+		holder2.Alloc().target=L"other";
+		CHECK(holder1.Get()->target==L"C:\\Target.exe");
+
+		// copy of a NULL source
+		TTestHolder empty;
+		TTestHolder holder3(empty);
+		CHECK(!holder3.Get());
+		CHECK(TestCold::s_Count==2);
+
+		// the copy survives the source
+		TTestHolder *pHolder=new TTestHolder(holder1);
+		TTestHolder holder4(*pHolder);
+		delete pHolder;
+		CHECK(holder4.Get() && holder4.Get()->target==L"C:\\Target.exe");
+		CHECK(TestCold::s_Count==3);
+	}
+	CHECK(TestCold::s_Count==0);
+}
+
+TEST(ColdHolder,Assign)
+{
+	TestCold::s_Count=0;
+	{
+		TTestHolder holder1, holder2, empty;
+		holder1.Alloc().name=L"one";
+		holder2.Alloc().name=L"two";
+
+		// the old data is freed and the new is copied
+		holder2=holder1;
+		CHECK(holder2.Get() && holder2.Get()!=holder1.Get() && holder2.Get()->name==L"one");
+		CHECK(TestCold::s_Count==2);
+
+		// into an empty holder
+		TTestHolder holder3;
+		holder3=holder1;
+		CHECK(holder3.Get() && holder3.Get()->name==L"one");
+		CHECK(TestCold::s_Count==3);
+
+		// from a NULL source
+		holder3=empty;
+		CHECK(!holder3.Get());
+		CHECK(TestCold::s_Count==2);
+		holder3=empty;
+		CHECK(!holder3.Get());
+
+		// to itself
+		const TestCold *pCold=holder1.Get();
+		TTestHolder &self=holder1;
+		holder1=self;
+		CHECK(holder1.Get()==pCold && holder1.Get()->name==L"one");
+		CHECK(TestCold::s_Count==2);
+
+		// chained
+		holder3=holder2=empty;
+		CHECK(!holder2.Get() && !holder3.Get());
+		CHECK(TestCold::s_Count==1);
+	}
+	CHECK(TestCold::s_Count==0);
+}
+
+TEST(ColdHolder,Map)
+{
+	// the items are copied into a multimap, like m_ItemInfos
+	TestCold::s_Count=0;
+	{
+		std::multimap<unsigned int,TTestHolder> items;
+		for (unsigned int i=0;i<100;i++)
+		{
+			TTestHolder holder;
+			if (i%3==0)
+				holder.Alloc().color=i+1;
+			items.insert(std::pair<unsigned int,TTestHolder>(i%10,holder));
+		}
+		CHECK(TestCold::s_Count==34);
+		std::multimap<unsigned int,TTestHolder> copy=items;
+		CHECK(TestCold::s_Count==68);
+		items.clear();
+		CHECK(TestCold::s_Count==34);
+		int count=0;
+		for (std::multimap<unsigned int,TTestHolder>::const_iterator it=copy.begin();it!=copy.end();++it)
+			if (it->second.Get())
+			{
+				CHECK((it->second.Get()->color-1)%3==0);
+				count++;
+			}
+		CHECK(count==34);
+	}
+	CHECK(TestCold::s_Count==0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// The layout of ItemInfo before and after the cold fields were moved out. CString, CAbsolutePidl and the icon pointers are one pointer each
+typedef const void *TPtr;
+
+struct ItemInfoBefore
+{
+	TPtr PATH;
+	TPtr smallIcon, largeIcon, extraLargeIcon;
+	TPtr pidl;
+	TPtr newPidl;
+	int validFlags;
+	int refreshFlags;
+	bool bRefreshing, bRequeue, bIconOnly, bTemp, bLink, bMetroLink, bMetroApp, bProtectedLink, bNoPin, bNoNew, bExplicitAppId;
+	int location;
+	int accessWeight;
+	TPtr path;
+	TPtr targetPidl;
+	TPtr targetPATH;
+	TPtr appid;
+	TPtr metroName;
+	TPtr packagePath;
+	unsigned int writestamp[2];
+	unsigned int createstamp[2];
+	TPtr iconPath;
+	int iconIndex;
+	unsigned int iconColor;
+};
+
+struct ItemInfoColdAfter
+{
+	ItemInfoColdAfter( void ) { newPidl=targetPidl=targetPATH=metroName=packagePath=NULL; iconColor=0; }
+	bool IsEmpty( void ) const { return !newPidl && !targetPidl && !targetPATH && !metroName && !packagePath && iconColor==0; }
+
+	TPtr newPidl;
+	TPtr targetPidl;
+	TPtr targetPATH;
+	TPtr metroName;
+	TPtr packagePath;
+	unsigned int iconColor;
+};
+
+struct ItemInfoAfter
+{
+	TPtr PATH;
+	TPtr smallIcon, largeIcon, extraLargeIcon;
+	TPtr pidl;
+	int validFlags;
+	int refreshFlags;
+	bool bRefreshing, bRequeue, bIconOnly, bTemp, bLink, bMetroLink, bMetroApp, bProtectedLink, bNoPin, bNoNew, bExplicitAppId;
+	int location;
+	int accessWeight;
+	TPtr path;
+	TPtr appid;
+	unsigned int writestamp[2];
+	unsigned int createstamp[2];
+	TPtr iconPath;
+	int iconIndex;
+	CColdHolder<ItemInfoColdAfter> cold;
+};
+
+// Builds a map of items and scans it the way painting and searching do. Only the links have cold data. Returns the time of one scan in ms
+template<class T> static double ScanItems( int count, int linkPercent, T *(*init)( T &item, bool bLink ), int &result, double &buildTime )
+{
+	CTestRandom random(39);
+	std::multimap<unsigned int,T> items;
+	buildTime=GetBenchmarkTime();
+	for (int i=0;i<count;i++)
+	{
+		T item;
+		memset(&item,0,offsetof(T,iconIndex));
+		item.PATH=&items;
+		item.validFlags=random.Next(16);
+		item.location=random.Next(6);
+		init(item,random.Next(100)<linkPercent);
+		items.insert(std::pair<unsigned int,T>(random.Next(),item));
+	}
+	buildTime=(GetBenchmarkTime()-buildTime)*1000;
+
+	const int REPEAT=200;
+	double time=GetBenchmarkTime();
+	for (int r=0;r<REPEAT;r++)
+	{
+		for (typename std::multimap<unsigned int,T>::const_iterator it=items.begin();it!=items.end();++it)
+		{
+			const T &item=it->second;
+			if ((item.validFlags&(r&15)) && item.location==(r%6) && !item.bTemp)
+				result+=item.smallIcon?2:1;
+		}
+	}
+	return (GetBenchmarkTime()-time)*1000/REPEAT;
+}
+
+static ItemInfoBefore *InitBefore( ItemInfoBefore &item, bool bLink )
+{
+	item.newPidl=item.targetPidl=item.targetPATH=item.metroName=item.packagePath=NULL;
+	item.iconColor=0;
+	if (bLink)
+		item.targetPATH=&item;
+	return &item;
+}
+
+static ItemInfoAfter *InitAfter( ItemInfoAfter &item, bool bLink )
+{
+	if (bLink)
+		item.cold.Alloc().targetPATH=&item;
+	return &item;
+}
+
+BENCHMARK(ColdHolder,Scan)
+{
+	// sizes of the items, the time to build the map (each item is copied once) and the time for a scan over all items, with 30% links (the rest are folders, files and icon-only items)
+	printf("ColdHolder: ItemInfo %d bytes before, %d bytes after + %d bytes of cold data for the links\n",(int)sizeof(ItemInfoBefore),(int)sizeof(ItemInfoAfter),(int)sizeof(ItemInfoColdAfter));
+	static const int counts[]={2000,20000,200000};
+	for (int i=0;i<_countof(counts);i++)
+	{
+		int result1=0, result2=0;
+		double build1, build2;
+		double time1=ScanItems<ItemInfoBefore>(counts[i],30,InitBefore,result1,build1);
+		double time2=ScanItems<ItemInfoAfter>(counts[i],30,InitAfter,result2,build2);
+		CHECK(result1==result2);
+		printf("ColdHolder: %d items: build %.2f ms before, %.2f ms after. scan %.3f ms before, %.3f ms after\n",counts[i],build1,build2,time1,time2);
+	}
+}
@@ -0,0 +1,184 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+// stdafx.h for the portable tests - provides the few pieces of the Windows SDK and ATL that the tested sources use
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <wctype.h>
+#include <stdarg.h>
+#include <string>
+#include <algorithm>
+#include "Assert.h"
+
+// the tested sources only need Strlen and Strcpy from StringUtils.h
+#define _STRINGUTILS_H
+
+inline int Strlen( const char *str ) { return (int)strlen(str); }
+inline int Strlen( const wchar_t *str ) { return (int)wcslen(str); }
+
+// copies up to size-1 characters and returns the number of characters copied
+inline int Strcpy( wchar_t *dst, int size, const wchar_t *src )
+{
+	if (size<=0) return 0;
+	int len=Strlen(src);
+	if (len>size-1)
+		len=size-1;
+	memcpy(dst,src,len*sizeof(wchar_t));
+	dst[len]=0;
+	return len;
+}
+
+// appends up to size-1 characters in total and returns the new length
+inline int Strcat( wchar_t *dst, int size, const wchar_t *src )
+{
+	int len=Strlen(dst);
+	return len+Strcpy(dst+len,size-len,src);
+}
+
+#ifndef _WIN32
+typedef unsigned int DWORD;
+typedef int LONG;
+#define __int64 long long
+#define __declspec(x) __declspec_##x
+#define __declspec_align(n) __attribute__((aligned(n)))
+
+typedef long long LONG64;
+
+inline LONG InterlockedExchangeAdd( volatile LONG *pValue, LONG add ) { return __sync_fetch_and_add(pValue,add); }
+inline LONG64 ReadNoFence64( const volatile LONG64 *pValue ) { return __atomic_load_n(pValue,__ATOMIC_RELAXED); }
+inline void WriteNoFence64( volatile LONG64 *pValue, LONG64 value ) { __atomic_store_n(pValue,value,__ATOMIC_RELAXED); }
+
+// the Interlocked functions are full barriers, like on Windows
+inline LONG InterlockedIncrement( volatile LONG *pValue ) { return __atomic_add_fetch(pValue,1,__ATOMIC_SEQ_CST); }
+inline LONG InterlockedDecrement( volatile LONG *pValue ) { return __atomic_sub_fetch(pValue,1,__ATOMIC_SEQ_CST); }
+inline LONG InterlockedExchange( volatile LONG *pValue, LONG value ) { return __atomic_exchange_n(pValue,value,__ATOMIC_SEQ_CST); }
+inline LONG InterlockedCompareExchange( volatile LONG *pValue, LONG value, LONG comparand ) { __atomic_compare_exchange_n(pValue,&comparand,value,false,__ATOMIC_SEQ_CST,__ATOMIC_SEQ_CST); return comparand; }
+inline void *InterlockedExchangePointer( void *volatile *pValue, void *value ) { return __atomic_exchange_n(pValue,value,__ATOMIC_SEQ_CST); }
+inline void *InterlockedCompareExchangePointer( void *volatile *pValue, void *value, void *comparand ) { __atomic_compare_exchange_n(pValue,&comparand,value,false,__ATOMIC_SEQ_CST,__ATOMIC_SEQ_CST); return comparand; }
+inline LONG ReadAcquire( const volatile LONG *pValue ) { return __atomic_load_n(pValue,__ATOMIC_ACQUIRE); }
+inline void *ReadPointerAcquire( void *const volatile *pValue ) { return __atomic_load_n(pValue,__ATOMIC_ACQUIRE); }
+
+// different for each thread and a multiple of 4, like the Windows thread ids
+DWORD GetCurrentThreadId( void );
+
+// converts UTF-8 to UTF-16 like on Windows. the invalid sequences become U+FFFD. returns 0 if dst is too small
+enum
+{
+	CP_ACP=0,
+	CP_UTF8=65001,
+};
+int MultiByteToWideChar( unsigned int codePage, DWORD flags, const char *src, int size, wchar_t *dst, int dstSize );
+
+// the registry types. the registry keys are only passed around
+enum
+{
+	REG_SZ=1,
+	REG_EXPAND_SZ=2,
+	REG_DWORD=4,
+	REG_MULTI_SZ=7,
+};
+typedef struct HKEY__ *HKEY;
+class CRegKey;
+
+// the window types are only passed around by Settings.h
+typedef struct HWND__ *HWND;
+typedef struct HMENU__ *HMENU;
+struct RECT { LONG left, top, right, bottom; };
+struct MSG;
+
+using std::min;
+using std::max;
+
+struct FILETIME
+{
+	DWORD dwLowDateTime;
+	DWORD dwHighDateTime;
+};
+
+inline wchar_t *CharUpper( wchar_t *str )
+{
+	for (wchar_t *p=str;*p;p++)
+		*p=(wchar_t)towupper(*p);
+	return str;
+}
+#endif
+
+#ifndef _MAX_PATH
+#define _MAX_PATH 260
+#endif
+
+#ifndef _WIN32
+inline int _wcsicmp( const wchar_t *str1, const wchar_t *str2 ) { return wcscasecmp(str1,str2); }
+inline int _wcsnicmp( const wchar_t *str1, const wchar_t *str2, size_t len ) { return wcsncasecmp(str1,str2,len); }
+#endif
+
+#ifndef _countof
+#define _countof(array) (sizeof(array)/sizeof((array)[0]))
+#endif
+
+// a minimal replacement for the ATL CString
+class CString
+{
+public:
+	CString( void ) {}
+	CString( const wchar_t *str ) { if (str) m_Text=str; }
+	CString( const wchar_t *str, int len ) : m_Text(str,len) {}
+
+	int GetLength( void ) const { return (int)m_Text.size(); }
+	bool IsEmpty( void ) const { return m_Text.empty(); }
+	operator const wchar_t*( void ) const { return m_Text.c_str(); }
+	wchar_t operator[]( int index ) const { return m_Text[index]; }
+
+	wchar_t *GetBuffer( int len ) { m_Text.resize(len); return &m_Text[0]; }
+	void ReleaseBuffer( int len=-1 ) { m_Text.resize(len<0?wcslen(m_Text.c_str()):len); }
+	void Empty( void ) { m_Text.clear(); }
+	CString &MakeUpper( void ) { for (size_t i=0;i<m_Text.size();i++) m_Text[i]=(wchar_t)towupper(m_Text[i]); return *this; }
+
+	CString &operator=( const wchar_t *str ) { m_Text=str?str:L""; return *this; }
+	CString &operator+=( const wchar_t *str ) { m_Text+=str; return *this; }
+	bool operator==( const wchar_t *str ) const { return m_Text==str; }
+	bool operator!=( const wchar_t *str ) const { return m_Text!=str; }
+	bool operator<( const CString &str ) const { return m_Text<str.m_Text; }
+
+private:
+	std::wstring m_Text;
+};
+
+// a minimal replacement for the ATL CComVariant, with the int and string values that CSetting uses
+enum
+{
+	VT_EMPTY=0,
+	VT_I4=3,
+	VT_BSTR=8,
+};
+
+class CComVariant
+{
+public:
+	CComVariant( void ) { vt=VT_EMPTY; intVal=0; bstrVal=NULL; }
+	CComVariant( int val ) { vt=VT_I4; intVal=val; bstrVal=NULL; }
+	CComVariant( const wchar_t *str ) { vt=VT_BSTR; intVal=0; m_Text=str; bstrVal=&m_Text[0]; }
+	CComVariant( const CComVariant &var ) { *this=var; }
+
+	CComVariant &operator=( const CComVariant &var )
+	{
+		vt=var.vt;
+		intVal=var.intVal;
+		m_Text=var.m_Text;
+		bstrVal=var.bstrVal?&m_Text[0]:NULL;
+		return *this;
+	}
+
+	int vt;
+	int intVal;
+	wchar_t *bstrVal;
+
+private:
+	std::wstring m_Text;
+};
@@ -0,0 +1,192 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "ImageResampler.h"
+#include <stdio.h>
+
+// a random premultiplied pixel
+static unsigned int RandomPixel( CTestRandom &random )
+{
+	int a=random.Next(4)==0?255:random.Next(256);
+	return (a<<24)|(random.Next(a+1)<<16)|(random.Next(a+1)<<8)|random.Next(a+1);
+}
+
+// Checks that the colors don't exceed the alpha
+static bool IsPremultiplied( const std::vector<unsigned int> &pixels )
+{
+	for (std::vector<unsigned int>::const_iterator it=pixels.begin();it!=pixels.end();++it)
+	{
+		unsigned int a=*it>>24;
+		if (((*it>>16)&255)>a || ((*it>>8)&255)>a || (*it&255)>a)
+			return false;
+	}
+	return true;
+}
+
+TEST(ImageResampler,Weights)
+{
+	static const int sizes[][2]={
+		{100,37},{37,100},{1,7},{7,1},{1,1},{16,16},{3,2},{2,3},{1000,3},{5,64},{64,5},{48,32},{32,48},{2,1},{1,2},{255,254},
+	};
+	for (int i=0;i<_countof(sizes);i++)
+	{
+		int srcSize=sizes[i][0], dstSize=sizes[i][1];
+		CResampleFilter filter;
+		filter.Init(srcSize,dstSize);
+		CHECK(filter.GetSrcSize()==srcSize && filter.GetDstSize()==dstSize);
+		int taps=filter.GetTaps();
+		CHECK(taps>0 && taps<=srcSize);
+		bool bNegative=false;
+		for (int d=0;d<dstSize;d++)
+		{
+			int first=filter.GetFirst(d);
+			const short *weights=filter.GetWeights(d);
+			int sum=0;
+			for (int t=0;t<taps;t++)
+			{
+				sum+=weights[t];
+				if (weights[t]<0) bNegative=true;
+			}
+			if (first<0 || first+taps>srcSize || sum!=(1<<CResampleFilter::WEIGHT_BITS))
+			{
+				printf("ImageResampler: %d->%d, pixel %d: first %d, taps %d, sum %d\n",srcSize,dstSize,d,first,taps,sum);
+				CHECK(false);
+			}
+		}
+		// the box filter for shrinking has no negative lobes. the bicubic filter has them unless the source is too small
+		if (dstSize<srcSize)
+			CHECK(!bNegative);
+		else if (dstSize>srcSize && srcSize>=3)
+			CHECK(bNegative);
+	}
+
+	CResampleFilter filter;
+	filter.Init(0,5);
+	CHECK(filter.GetTaps()==0);
+	filter.Init(5,0);
+	CHECK(filter.GetTaps()==0);
+}
+
+TEST(ImageResampler,Identity)
+{
+	// the same size or a single source pixel doesn't change the pixels
+	CTestRandom random(37);
+	std::vector<unsigned int> src(17*13), dst(17*13);
+	for (std::vector<unsigned int>::iterator it=src.begin();it!=src.end();++it)
+		*it=RandomPixel(random);
+	for (int simd=0;simd<2;simd++)
+	{
+		SetResamplerSIMD(simd!=0);
+		ResizePixels(&src[0],17,13,17,&dst[0],17,13,17);
+		CHECK(dst==src);
+		ResizePixels(&src[0],1,1,17,&dst[0],17,13,17);
+		for (std::vector<unsigned int>::iterator it=dst.begin();it!=dst.end();++it)
+			CHECK(*it==src[0]);
+	}
+	SetResamplerSIMD(true);
+}
+
+TEST(ImageResampler,SIMD)
+{
+	bool bOld=SetResamplerSIMD(true);
+	if (!IsResamplerSIMD())
+	{
+		printf("ImageResampler: no SSE2 code on this platform\n");
+		SetResamplerSIMD(bOld);
+		return;
+	}
+	CTestRandom random(137);
+	for (int test=0;test<3000;test++)
+	{
+		int srcWidth=1+random.Next(40), srcHeight=1+random.Next(40);
+		int dstWidth=1+random.Next(80), dstHeight=1+random.Next(80);
+		int srcStride=srcWidth+random.Next(3), dstStride=dstWidth+random.Next(3);
+		std::vector<unsigned int> src(srcStride*srcHeight);
+		for (std::vector<unsigned int>::iterator it=src.begin();it!=src.end();++it)
+			*it=RandomPixel(random);
+		std::vector<unsigned int> ref(dstStride*dstHeight,0x12345678), res(ref);
+		SetResamplerSIMD(false);
+		ResizePixels(&src[0],srcWidth,srcHeight,srcStride,&ref[0],dstWidth,dstHeight,dstStride);
+		SetResamplerSIMD(true);
+		ResizePixels(&src[0],srcWidth,srcHeight,srcStride,&res[0],dstWidth,dstHeight,dstStride);
+		if (res!=ref)
+		{
+			printf("ImageResampler: SSE2 is different for %dx%d->%dx%d\n",srcWidth,srcHeight,dstWidth,dstHeight);
+			CHECK(res==ref);
+		}
+		for (int y=0;y<dstHeight;y++)
+			for (int x=dstWidth;x<dstStride;x++)
+				CHECK(ref[y*dstStride+x]==0x12345678); // the padding is not changed
+	}
+	SetResamplerSIMD(bOld);
+}
+
+TEST(ImageResampler,Overshoot)
+{
+	// a sharp edge in the color with a constant alpha. the negative lobes of the bicubic filter go over the alpha
+	const int SIZE=8;
+	std::vector<unsigned int> src(SIZE*SIZE);
+	for (int y=0;y<SIZE;y++)
+		for (int x=0;x<SIZE;x++)
+			src[y*SIZE+x]=(x<SIZE/2 && y<SIZE/2)?0xC8000000:0xC8C8C8C8;
+	CTestRandom random(237);
+	for (int simd=0;simd<2;simd++)
+	{
+		SetResamplerSIMD(simd!=0);
+		std::vector<unsigned int> dst(29*31);
+		ResizePixels(&src[0],SIZE,SIZE,SIZE,&dst[0],29,31,29);
+		CHECK(IsPremultiplied(dst));
+		// the alpha stays the same, so the colors next to the edge are clamped to it
+		for (std::vector<unsigned int>::const_iterator it=dst.begin();it!=dst.end();++it)
+			CHECK((*it>>24)==0xC8);
+
+		// random images, enlarged
+		for (int test=0;test<500;test++)
+		{
+			int srcWidth=2+random.Next(20), srcHeight=2+random.Next(20);
+			int dstWidth=srcWidth+random.Next(60), dstHeight=srcHeight+random.Next(60);
+			std::vector<unsigned int> pixels(srcWidth*srcHeight);
+			for (std::vector<unsigned int>::iterator it=pixels.begin();it!=pixels.end();++it)
+				*it=RandomPixel(random);
+			dst.resize(dstWidth*dstHeight);
+			ResizePixels(&pixels[0],srcWidth,srcHeight,srcWidth,&dst[0],dstWidth,dstHeight,dstWidth);
+			CHECK(IsPremultiplied(dst));
+		}
+	}
+	SetResamplerSIMD(true);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void BenchmarkResize( const char *name, int srcSize, int dstSize, int count )
+{
+	CTestRandom random(1);
+	std::vector<unsigned int> src(srcSize*srcSize), dst(dstSize*dstSize);
+	for (std::vector<unsigned int>::iterator it=src.begin();it!=src.end();++it)
+		*it=RandomPixel(random);
+	CResampleFilter filter;
+	filter.Init(srcSize,dstSize);
+	for (int simd=0;simd<2;simd++)
+	{
+		SetResamplerSIMD(simd!=0);
+		if (simd && !IsResamplerSIMD())
+			break;
+		double time=GetBenchmarkTime();
+		for (int i=0;i<count;i++)
+			ResizePixels(&src[0],srcSize,&dst[0],dstSize,filter,filter);
+		time=GetBenchmarkTime()-time;
+		printf("%-8s %3d->%3d %-6s %8.1f Mpixels/s\n",name,srcSize,dstSize,simd?"SSE2":"scalar",(double)dstSize*dstSize*count/time/1000000);
+	}
+	SetResamplerSIMD(true);
+}
+
+BENCHMARK(ImageResampler,Resize)
+{
+	BenchmarkResize("Shrink",256,48,500);
+	BenchmarkResize("Shrink",64,48,2000);
+	BenchmarkResize("Enlarge",32,96,2000);
+	BenchmarkResize("Enlarge",16,256,200);
+}
@@ -0,0 +1,258 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "ModuleValidator.h"
+#include "FNVHash.h"
+#include <stdio.h>
+#include <map>
+#include <vector>
+
+// a fake file system for the stat function. it counts how many times each file was checked
+static std::map<std::wstring,unsigned __int64> g_Files;
+static std::map<std::wstring,int> g_StatCalls;
+
+static bool FakeStat( const wchar_t *PATH, unsigned __int64 &timestamp )
+{
+	g_StatCalls[PATH]++;
+	std::map<std::wstring,unsigned __int64>::const_iterator it=g_Files.find(PATH);
+	if (it==g_Files.end())
+		return false;
+	timestamp=it->second;
+	return true;
+}
+
+static void ResetFiles( void )
+{
+	g_Files.clear();
+	g_StatCalls.clear();
+}
+
+// The check that LoadCacheFile did before the validator - a linear search, and a stat the first time a module is seen
+struct OldModuleInfo
+{
+	std::wstring PATH;
+	unsigned __int64 timestamp;
+	bool bExists;
+};
+
+static bool OldValidate( const wchar_t *PATH, unsigned __int64 timestamp, std::vector<OldModuleInfo> &modules )
+{
+	for (std::vector<OldModuleInfo>::const_iterator it=modules.begin();it!=modules.end();++it)
+	{
+		if (it->PATH==PATH)
+			return it->bExists && it->timestamp==timestamp;
+	}
+	OldModuleInfo info={PATH,0,false};
+	info.bExists=FakeStat(PATH,info.timestamp);
+	modules.push_back(info);
+	return info.bExists && info.timestamp==timestamp;
+}
+
+TEST(ModuleValidator,Validate)
+{
+	ResetFiles();
+	g_Files[L"C:\\WINDOWS\\SYSTEM32\\IMAGERES.DLL"]=100;
+	g_Files[L"C:\\PROGRAM FILES\\APP\\APP.EXE"]=0x123456789ALL;
+	CModuleValidator validator(FakeStat);
+
+	// a missing module is never valid, even with a timestamp of 0
+	CHECK(!validator.Validate(L"C:\\MISSING.DLL",0));
+	CHECK(validator.Validate(L"C:\\PROGRAM FILES\\APP\\APP.EXE",0x123456789ALL));
+	CHECK(!validator.Validate(L"C:\\PROGRAM FILES\\APP\\APP.EXE",0x123456789BLL));
+	CHECK(!validator.Validate(L"C:\\PROGRAM FILES\\APP\\APP.EXE",0x23456789ALL)); // only the high part matches
+	CHECK(!validator.Validate(L"C:\\WINDOWS\\SYSTEM32\\IMAGERES.DLL",101));
+	CHECK(validator.Validate(L"C:\\WINDOWS\\SYSTEM32\\IMAGERES.DLL",100));
+	// the comparison is case-sensitive. the caller passes the paths in upper case
+	CHECK(!validator.Validate(L"c:\\program files\\app\\app.exe",0x123456789ALL));
+
+	// each module is checked once
+	CHECK(validator.GetModuleCount()==4);
+	CHECK(validator.GetStatCount()==4);
+	CHECK(g_StatCalls.size()==4);
+	for (std::map<std::wstring,int>::const_iterator it=g_StatCalls.begin();it!=g_StatCalls.end();++it)
+		CHECK(it->second==1);
+
+	// the result doesn't change when the file changes later
+	g_Files[L"C:\\MISSING.DLL"]=5;
+	CHECK(!validator.Validate(L"C:\\MISSING.DLL",5));
+	CHECK(validator.GetStatCount()==4);
+}
+
+TEST(ModuleValidator,Batch)
+{
+	ResetFiles();
+	g_Files[L"A.DLL"]=1;
+	g_Files[L"B.DLL"]=2;
+	g_Files[L"SHELL32.DLL"]=1234;
+	CModuleValidator validator(FakeStat);
+
+	// the standard modules have a known timestamp and are never checked
+	validator.SetTimeStamp(L"SHELL32.DLL",0);
+	validator.SetTimeStamp(L"IMAGERES.DLL",0);
+	CHECK(validator.GetModuleCount()==2);
+
+	validator.AddModule(L"A.DLL");
+	validator.AddModule(L"B.DLL");
+	validator.AddModule(L"A.DLL");
+	validator.AddModule(L"C.DLL");
+	validator.AddModule(L"SHELL32.DLL");
+	CHECK(validator.GetModuleCount()==5);
+	CHECK(validator.GetStatCount()==0);
+	validator.StatModules();
+	CHECK(validator.GetStatCount()==3);
+	CHECK(g_StatCalls.size()==3 && g_StatCalls.count(L"SHELL32.DLL")==0);
+
+	// the collected modules are not checked again
+	CHECK(validator.Validate(L"A.DLL",1));
+	CHECK(validator.Validate(L"B.DLL",2));
+	CHECK(!validator.Validate(L"C.DLL",0));
+	CHECK(validator.Validate(L"SHELL32.DLL",0));
+	CHECK(!validator.Validate(L"SHELL32.DLL",1234));
+	CHECK(validator.Validate(L"IMAGERES.DLL",0));
+	CHECK(validator.GetStatCount()==3);
+	validator.StatModules();
+	CHECK(validator.GetStatCount()==3);
+
+	// a module that was not collected is checked when it is validated
+	g_Files[L"D.DLL"]=4;
+	CHECK(validator.Validate(L"D.DLL",4));
+	CHECK(validator.GetStatCount()==4);
+	CHECK(g_StatCalls[L"D.DLL"]==1);
+
+	// SetTimeStamp overrides the checked timestamp
+	validator.SetTimeStamp(L"A.DLL",7);
+	CHECK(validator.Validate(L"A.DLL",7));
+	CHECK(!validator.Validate(L"A.DLL",1));
+	CHECK(validator.GetModuleCount()==6);
+}
+
+TEST(ModuleValidator,Collision)
+{
+	// find two paths with the same hash. the hash depends on the size of wchar_t, so they are found at run time
+	CTestRandom random(133);
+	std::map<unsigned int,std::wstring> hashes;
+	std::wstring PATH1, PATH2;
+	while (PATH1.empty())
+	{
+		wchar_t text[9];
+		for (int i=0;i<8;i++)
+			text[i]=(wchar_t)('A'+random.Next(26));
+		text[8]=0;
+		std::pair<std::map<unsigned int,std::wstring>::iterator,bool> res=hashes.insert(std::pair<unsigned int,std::wstring>(CalcFNVHash(text),text));
+		if (!res.second && res.first->second!=text)
+		{
+			PATH1=text;
+			PATH2=res.first->second;
+		}
+	}
+
+	ResetFiles();
+	g_Files[PATH1]=1;
+	g_Files[PATH2]=2;
+	CModuleValidator validator(FakeStat);
+	validator.AddModule(PATH1.c_str());
+	validator.AddModule(PATH2.c_str());
+	CHECK(validator.GetModuleCount()==2);
+	validator.StatModules();
+	CHECK(validator.Validate(PATH1.c_str(),1));
+	CHECK(validator.Validate(PATH2.c_str(),2));
+	CHECK(!validator.Validate(PATH1.c_str(),2));
+	CHECK(validator.GetStatCount()==2);
+}
+
+TEST(ModuleValidator,Random)
+{
+	// random icons with random modules. the results must match the old linear search, with each module checked once
+	CTestRandom random(33);
+	for (int test=0;test<100;test++)
+	{
+		ResetFiles();
+		int moduleCount=1+random.Next(50);
+		std::vector<std::wstring> paths;
+		for (int i=0;i<moduleCount;i++)
+		{
+			wchar_t PATH[_MAX_PATH];
+			swprintf(PATH,_countof(PATH),L"C:\\MODULES\\M%d.DLL",i);
+			paths.push_back(PATH);
+			if (random.Next(5)>0)
+				g_Files[PATH]=random.Next(4);
+		}
+
+		std::vector<std::pair<int,unsigned __int64> > icons;
+		for (int i=random.Next(200);i>0;i--)
+			icons.push_back(std::pair<int,unsigned __int64>(random.Next(moduleCount),random.Next(4)));
+
+		std::vector<OldModuleInfo> oldModules;
+		std::vector<bool> oldResults;
+		for (std::vector<std::pair<int,unsigned __int64> >::const_iterator it=icons.begin();it!=icons.end();++it)
+			oldResults.push_back(OldValidate(paths[it->first].c_str(),it->second,oldModules));
+
+		// collect only some of the modules, the rest are checked by Validate
+		g_StatCalls.clear();
+		CModuleValidator validator(FakeStat);
+		for (std::vector<std::pair<int,unsigned __int64> >::const_iterator it=icons.begin();it!=icons.end();++it)
+			if (random.Next(4)>0)
+				validator.AddModule(paths[it->first].c_str());
+		validator.StatModules();
+		for (size_t i=0;i<icons.size();i++)
+			CHECK(validator.Validate(paths[icons[i].first].c_str(),icons[i].second)==oldResults[i]);
+		CHECK(validator.GetStatCount()==(int)oldModules.size());
+		CHECK(validator.GetModuleCount()==(int)oldModules.size());
+		for (std::map<std::wstring,int>::const_iterator it=g_StatCalls.begin();it!=g_StatCalls.end();++it)
+			CHECK(it->second==1);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+BENCHMARK(ModuleValidator,Validate)
+{
+	// the time to validate the icons of a cache file, with the old linear search and with the validator. the stat function is free,
+	// so this measures only the lookups. in the product each stat is a GetFileAttributesEx call, done once per module by both
+	static const int sizes[][2]={{2000,50},{5000,300},{20000,1500}}; // icons, modules
+	for (int s=0;s<_countof(sizes);s++)
+	{
+		int iconCount=sizes[s][0], moduleCount=sizes[s][1];
+		ResetFiles();
+		std::vector<std::wstring> paths;
+		for (int i=0;i<moduleCount;i++)
+		{
+			wchar_t PATH[_MAX_PATH];
+			swprintf(PATH,_countof(PATH),L"C:\\PROGRAM FILES\\VENDOR %d\\APPLICATION\\MODULE%d.EXE",i%37,i);
+			paths.push_back(PATH);
+			g_Files[PATH]=i;
+		}
+		CTestRandom random(1);
+		std::vector<int> icons;
+		for (int i=0;i<iconCount;i++)
+			icons.push_back(random.Next(moduleCount));
+
+		const int REPEAT=20;
+		int valid1=0, valid2=0;
+		double time=GetBenchmarkTime();
+		for (int r=0;r<REPEAT;r++)
+		{
+			std::vector<OldModuleInfo> modules;
+			for (std::vector<int>::const_iterator it=icons.begin();it!=icons.end();++it)
+				if (OldValidate(paths[*it].c_str(),*it,modules)) valid1++;
+		}
+		double time1=(GetBenchmarkTime()-time)/REPEAT;
+
+		time=GetBenchmarkTime();
+		for (int r=0;r<REPEAT;r++)
+		{
+			CModuleValidator validator(FakeStat);
+			for (std::vector<int>::const_iterator it=icons.begin();it!=icons.end();++it)
+				validator.AddModule(paths[*it].c_str());
+			validator.StatModules();
+			for (std::vector<int>::const_iterator it=icons.begin();it!=icons.end();++it)
+				if (validator.Validate(paths[*it].c_str(),*it)) valid2++;
+		}
+		double time2=(GetBenchmarkTime()-time)/REPEAT;
+		CHECK(valid1==valid2 && valid1==iconCount*REPEAT);
+		printf("ModuleValidator: %d icons, %d modules: linear search %.2f ms, validator %.2f ms\n",iconCount,moduleCount,time1*1000,time2*1000);
+	}
+}
@@ -0,0 +1,263 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "PixelOps.h"
+#include <stdio.h>
+
+static const char *g_LevelNames[]={"scalar","SSE2","AVX2"};
+
+// Returns the best instruction set of this CPU. The kernels are compared for all levels up to it
+static int GetMaxLevel( void )
+{
+	int old=SetPixelOpsLimit(PIXEL_OPS_AVX2);
+	int level=GetPixelOpsLevel();
+	SetPixelOpsLimit(old);
+	return level;
+}
+
+// a random gray pixel - the channels are within 2 of each other
+static unsigned int RandomGrayPixel( CTestRandom &random, int transparent )
+{
+	if (random.Next(100)<transparent)
+		return random.Next(3)|(random.Next(3)<<8)|(random.Next(3)<<16);
+	int base=random.Next(254);
+	unsigned int pixel=0;
+	for (int i=0;i<4;i++)
+		pixel|=(base+random.Next(3))<<(i*8);
+	return pixel;
+}
+
+TEST(PixelOps,Grayscale)
+{
+	int maxLevel=GetMaxLevel();
+	if (maxLevel<PIXEL_OPS_AVX2)
+		printf("PixelOps: the CPU supports only %s\n",g_LevelNames[maxLevel]);
+	CTestRandom random(35);
+	int counts[2]={0};
+	for (int test=0;test<5000;test++)
+	{
+		int width=1+random.Next(40);
+		int height=1+random.Next(5);
+		int stride=width+random.Next(3);
+		int transparent=random.Next(4)*3; // around the 5% that makes an image gray
+		std::vector<unsigned int> bits(stride*height);
+		for (int y=0;y<height;y++)
+		{
+			for (int x=0;x<stride;x++)
+				bits[y*stride+x]=x<width?RandomGrayPixel(random,transparent):0xFF00FF00; // the padding is not a part of the image
+		}
+		if (random.Next(2))
+		{
+			// one channel just outside of the range, anywhere including the last few pixels of a row
+			unsigned int &pixel=bits[random.Next(height)*stride+(random.Next(2)?width-1-random.Next(width<8?width:8):random.Next(width))];
+			int shift=random.Next(4)*8;
+			int c=(pixel>>shift)&255;
+			c=c<128?c+3+random.Next(3):c-3-random.Next(3);
+			pixel=(pixel&~(255u<<shift))|(c<<shift);
+		}
+
+		bool bGray=false;
+		for (int level=PIXEL_OPS_SCALAR;level<=maxLevel;level++)
+		{
+			SetPixelOpsLimit(level);
+			bool res=DetectGrayscaleImage(&bits[0],stride,width,height);
+			if (level==PIXEL_OPS_SCALAR)
+				bGray=res;
+			else if (res!=bGray)
+			{
+				printf("PixelOps: %s is different for %dx%d\n",g_LevelNames[level],width,height);
+				CHECK(res==bGray);
+			}
+		}
+		counts[bGray?1:0]++;
+	}
+	SetPixelOpsLimit(PIXEL_OPS_AVX2);
+	// both results must be tested
+	CHECK(counts[0]>1000 && counts[1]>1000);
+
+	unsigned int pixels[]={0x80808080,0x82808080,0x00000000,0x80838080};
+	CHECK(!DetectGrayscaleImage(pixels,4,0,1));
+	CHECK(DetectGrayscaleImage(pixels,4,3,1));
+	CHECK(!DetectGrayscaleImage(pixels,4,4,1));
+	CHECK(!DetectGrayscaleImage(pixels,4,2,1)); // no transparent pixels
+}
+
+TEST(PixelOps,Colorize)
+{
+	int maxLevel=GetMaxLevel();
+	CTestRandom random(135);
+	for (int test=0;test<5000;test++)
+	{
+		int width=1+random.Next(40);
+		int height=1+random.Next(5);
+		int stride=width+random.Next(3);
+		unsigned int color=random.Next()&0xFFFFFF;
+		if (test<256)
+			color=test*0x010101; // all values of the color
+		std::vector<unsigned int> bits(stride*height);
+		for (std::vector<unsigned int>::iterator it=bits.begin();it!=bits.end();++it)
+			*it=random.Next();
+		if (test<256)
+			bits[0]=(unsigned int)(255-test)<<24; // and of the alpha
+
+		std::vector<unsigned int> ref=bits;
+		SetPixelOpsLimit(PIXEL_OPS_SCALAR);
+		CreateMonochromeImage(&ref[0],stride,width,height,color);
+		for (int level=PIXEL_OPS_SSE2;level<=maxLevel;level++)
+		{
+			std::vector<unsigned int> res=bits;
+			SetPixelOpsLimit(level);
+			CreateMonochromeImage(&res[0],stride,width,height,color);
+			if (res!=ref)
+			{
+				printf("PixelOps: %s is different for %dx%d, color %06X\n",g_LevelNames[level],width,height,color);
+				CHECK(res==ref);
+			}
+		}
+		for (int y=0;y<height;y++)
+			for (int x=width;x<stride;x++)
+				CHECK(ref[y*stride+x]==bits[y*stride+x]); // the padding is not changed
+	}
+	SetPixelOpsLimit(PIXEL_OPS_AVX2);
+
+	unsigned int pixels[]={0xFF123456,0x80FFFFFF,0x00FFFFFF};
+	CreateMonochromeImage(pixels,3,3,1,0x4080FF);
+	CHECK(pixels[0]==0xFFFF8040);
+	CHECK(pixels[1]==0x80804020);
+	CHECK(pixels[2]==0);
+}
+
+// Compares the premultiplied pixels of all levels. Returns false if they are different
+static bool ComparePremultiply( const unsigned int *bits, int count, unsigned int color, int maxLevel )
+{
+	std::vector<unsigned int> ref(bits,bits+count+1);
+	SetPixelOpsLimit(PIXEL_OPS_SCALAR);
+	PremultiplyPixels(&ref[0],count,color);
+	bool bResult=true;
+	for (int level=PIXEL_OPS_SSE2;level<=maxLevel;level++)
+	{
+		std::vector<unsigned int> res(bits,bits+count+1);
+		SetPixelOpsLimit(level);
+		PremultiplyPixels(&res[0],count,color);
+		if (res!=ref)
+		{
+			printf("PixelOps: %s is different for %d pixels, color %06X\n",g_LevelNames[level],count,color);
+			bResult=false;
+		}
+	}
+	SetPixelOpsLimit(PIXEL_OPS_AVX2);
+	return bResult;
+}
+
+TEST(PixelOps,Premultiply)
+{
+	int maxLevel=GetMaxLevel();
+	// all combinations of a color channel and the alpha, with the default color and with the rounding of the division by 255*255
+	std::vector<unsigned int> bits(256*256+1);
+	for (int a=0;a<256;a++)
+		for (int c=0;c<256;c++)
+			bits[a*256+c]=(a<<24)|(c<<16)|((255-c)<<8)|((c*7)&255);
+	const unsigned int colors[]={0xFFFFFF,0xFEFFFF,0x000000,0x4080FF,0x010203,0x7F7F7F,0xFFFFFE};
+	for (int i=0;i<_countof(colors);i++)
+		CHECK(ComparePremultiply(&bits[0],256*256,colors[i],maxLevel));
+
+	// the tails after the last full vector, from unaligned addresses. the pixel after the end must not change
+	CTestRandom random(36);
+	for (int test=0;test<2000;test++)
+	{
+		int count=1+test%15;
+		if (test>=1000)
+			count=random.Next(100);
+		int offset=random.Next(8);
+		for (int i=0;i<offset+count+1;i++)
+			bits[i]=random.Next();
+		unsigned int color=random.Next(2)?0xFFFFFF:random.Next()&0xFFFFFF;
+		CHECK(ComparePremultiply(&bits[offset],count,color,maxLevel));
+	}
+
+	unsigned int pixels[]={0xFFFFFFFF,0x80FF8040,0x00FFFFFF,0x80FFFFFF};
+	PremultiplyPixels(pixels,3);
+	CHECK(pixels[0]==0xFFFFFFFF);
+	CHECK(pixels[1]==0x80804020);
+	CHECK(pixels[2]==0);
+	CHECK(pixels[3]==0x80FFFFFF);
+	PremultiplyPixels(pixels,1,0x4080FF);
+	CHECK(pixels[0]==0xFFFF8040);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void PrintSpeed( const char *name, int level, double time, double pixels )
+{
+	printf("%-12s %-6s %8.1f Mpixels/s\n",name,g_LevelNames[level],pixels/time/1000000);
+}
+
+BENCHMARK(PixelOps,Grayscale)
+{
+	const int SIZE=256, COUNT=2000;
+	CTestRandom random(1);
+	std::vector<unsigned int> bits(SIZE*SIZE);
+	for (std::vector<unsigned int>::iterator it=bits.begin();it!=bits.end();++it)
+		*it=RandomGrayPixel(random,10);
+	for (int level=PIXEL_OPS_SCALAR;level<=GetMaxLevel();level++)
+	{
+		SetPixelOpsLimit(level);
+		int gray=0;
+		double time=GetBenchmarkTime();
+		for (int i=0;i<COUNT;i++)
+			gray+=DetectGrayscaleImage(&bits[0],SIZE,SIZE,SIZE)?1:0;
+		time=GetBenchmarkTime()-time;
+		CHECK(gray==COUNT);
+		PrintSpeed("Grayscale",level,time,(double)SIZE*SIZE*COUNT);
+	}
+	SetPixelOpsLimit(PIXEL_OPS_AVX2);
+}
+
+BENCHMARK(PixelOps,Colorize)
+{
+	const int SIZE=256, COUNT=2000;
+	CTestRandom random(1);
+	std::vector<unsigned int> bits(SIZE*SIZE);
+	for (std::vector<unsigned int>::iterator it=bits.begin();it!=bits.end();++it)
+		*it=random.Next();
+	for (int level=PIXEL_OPS_SCALAR;level<=GetMaxLevel();level++)
+	{
+		SetPixelOpsLimit(level);
+		double time=GetBenchmarkTime();
+		for (int i=0;i<COUNT;i++)
+			CreateMonochromeImage(&bits[0],SIZE,SIZE,SIZE,0x4080FF+i);
+		time=GetBenchmarkTime()-time;
+		PrintSpeed("Colorize",level,time,(double)SIZE*SIZE*COUNT);
+	}
+	SetPixelOpsLimit(PIXEL_OPS_AVX2);
+}
+
+BENCHMARK(PixelOps,Premultiply)
+{
+	const int SIZE=256*256, COUNT=2000;
+	CTestRandom random(1);
+	std::vector<unsigned int> src(SIZE), bits(SIZE);
+	for (std::vector<unsigned int>::iterator it=src.begin();it!=src.end();++it)
+		*it=random.Next();
+	const unsigned int colors[]={0xFFFFFF,0x4080FF};
+	for (int c=0;c<_countof(colors);c++)
+	{
+		for (int level=PIXEL_OPS_SCALAR;level<=GetMaxLevel();level++)
+		{
+			SetPixelOpsLimit(level);
+			double time=0;
+			for (int i=0;i<COUNT;i++)
+			{
+				bits=src;
+				double start=GetBenchmarkTime();
+				PremultiplyPixels(&bits[0],SIZE,colors[c]);
+				time+=GetBenchmarkTime()-start;
+			}
+			PrintSpeed(c==0?"Premultiply":"Premul color",level,time,(double)SIZE*COUNT);
+		}
+	}
+	SetPixelOpsLimit(PIXEL_OPS_AVX2);
+}
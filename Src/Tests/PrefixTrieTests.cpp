@@ -0,0 +1,53 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "PrefixTrie.h"
+
+TEST(PrefixTrie,Find)
+{
+	CPrefixTrie trie;
+	CHECK(trie.IsEmpty());
+	CHECK(trie.Find(L"C:\\USERS\\")<0);
+	trie.Add(L"C:\\USERS\\IVO\\START MENU\\",1);
+	trie.Add(L"C:\\PROGRAMDATA\\START MENU\\",1);
+	trie.Add(L"C:\\USERS\\IVO\\DESKTOP\\",2);
+	trie.Add(L"",3); // ignored
+	trie.Add(NULL,3); // ignored
+	CHECK(!trie.IsEmpty());
+
+	int len=-1;
+	CHECK(trie.Find(L"C:\\USERS\\IVO\\START MENU\\PROGRAMS\\APP.LNK",&len)==1);
+	CHECK(len==24);
+	CHECK(trie.Find(L"C:\\PROGRAMDATA\\START MENU\\APP.LNK")==1);
+	CHECK(trie.Find(L"C:\\USERS\\IVO\\DESKTOP\\",&len)==2);
+	CHECK(len==21);
+	CHECK(trie.Find(L"C:\\USERS\\IVO\\DESKTOP",&len)<0); // the string is shorter than the prefix
+	CHECK(len==0);
+	CHECK(trie.Find(L"C:\\USERS\\IVO\\")<0);
+	CHECK(trie.Find(L"")<0);
+	CHECK(trie.Find(L"c:\\users\\ivo\\desktop\\app.lnk")<0); // case-sensitive
+
+	trie.Clear();
+	CHECK(trie.IsEmpty());
+	CHECK(trie.Find(L"C:\\USERS\\IVO\\DESKTOP\\APP.LNK")<0);
+}
+
+TEST(PrefixTrie,Priority)
+{
+	// the prefix that was added first wins, even if it is shorter or longer than another match
+	CPrefixTrie trie;
+	trie.Add(L"C:\\USERS\\IVO\\START MENU\\PROGRAMS\\GAMES\\",4);
+	trie.Add(L"C:\\USERS\\IVO\\START MENU\\",1);
+	trie.Add(L"C:\\USERS\\IVO\\START MENU\\PROGRAMS\\",5);
+	trie.Add(L"C:\\USERS\\IVO\\START MENU\\",6); // the same prefix again. the first value is kept
+
+	int len;
+	CHECK(trie.Find(L"C:\\USERS\\IVO\\START MENU\\PROGRAMS\\GAMES\\GAME.LNK",&len)==4);
+	CHECK(len==39);
+	CHECK(trie.Find(L"C:\\USERS\\IVO\\START MENU\\PROGRAMS\\APP.LNK",&len)==1);
+	CHECK(len==24);
+	CHECK(trie.Find(L"C:\\USERS\\IVO\\START MENU\\APP.LNK")==1);
+}
@@ -0,0 +1,176 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "PriorityQueue.h"
+
+static bool IsOdd( int item ) { return (item&1)!=0; }
+
+TEST(PriorityQueue,Order)
+{
+	CPriorityQueue<int,3> queue(1000);
+	int item=-1;
+	CHECK(queue.IsEmpty());
+	CHECK(!queue.Pop(item));
+	CHECK(queue.Push(20,2));
+	CHECK(queue.Push(10,1));
+	CHECK(queue.Push(21,2));
+	CHECK(queue.Push(0,0));
+	CHECK(queue.Push(11,1));
+	CHECK(queue.Push(1,0));
+	CHECK(queue.GetCount()==6);
+	CHECK(queue.GetCount(0)==2 && queue.GetCount(1)==2 && queue.GetCount(2)==2);
+
+	// higher levels first, each level in the order the items were added
+	const int order[]={0,1,10,11,20,21};
+	for (int i=0;i<_countof(order);i++)
+	{
+		CHECK(queue.Pop(item));
+		CHECK(item==order[i]);
+	}
+	CHECK(queue.IsEmpty());
+	CHECK(!queue.Pop(item));
+
+	queue.Push(1,1);
+	queue.Push(2,1);
+	queue.Push(3,1);
+	queue.Push(4,1);
+	CHECK(queue.Remove(2));
+	CHECK(!queue.Remove(2));
+	queue.RemoveIf(IsOdd);
+	CHECK(queue.GetCount()==1);
+	CHECK(queue.Pop(item) && item==4);
+	queue.Push(5,0);
+	queue.Push(6,2);
+	queue.Clear();
+	CHECK(queue.IsEmpty() && queue.GetCount(0)==0 && queue.GetCount(2)==0);
+}
+
+TEST(PriorityQueue,Boost)
+{
+	CPriorityQueue<int,3> queue(1000);
+	CHECK(queue.Push(1,1));
+	CHECK(queue.Push(2,1));
+	CHECK(queue.Push(3,2));
+	CHECK(queue.Push(4,2));
+
+	// pushing again doesn't add a duplicate, but can raise the priority
+	CHECK(!queue.Push(4,1));
+	CHECK(queue.GetCount()==4);
+	CHECK(queue.GetCount(1)==3 && queue.GetCount(2)==1);
+	// a lower priority doesn't move the item
+	CHECK(!queue.Push(1,2));
+	CHECK(queue.Boost(2,2));
+	CHECK(queue.GetCount(1)==3);
+	// the boosted item goes to the back of the new level
+	CHECK(queue.Boost(3,1));
+	CHECK(!queue.Boost(5,0));
+	CHECK(queue.GetCount()==4);
+	CHECK(queue.GetCount(1)==4 && queue.GetCount(2)==0);
+	CHECK(queue.Boost(2,0));
+
+	const int order[]={2,1,4,3};
+	int item;
+	for (int i=0;i<_countof(order);i++)
+	{
+		CHECK(queue.Pop(item));
+		CHECK(item==order[i]);
+	}
+	CHECK(queue.IsEmpty());
+}
+
+TEST(PriorityQueue,Starvation)
+{
+	const int LIMIT=4;
+	CPriorityQueue<int,3> queue(LIMIT);
+	for (int i=0;i<100;i++)
+		queue.Push(i,0);
+	for (int i=0;i<10;i++)
+	{
+		queue.Push(100+i,1);
+		queue.Push(200+i,2);
+	}
+
+	// after LIMIT items from the top level one is taken from a lower level. the lower levels take turns
+	int item;
+	for (int turn=0;turn<10;turn++)
+	{
+		for (int i=0;i<LIMIT;i++)
+		{
+			CHECK(queue.Pop(item));
+			CHECK(item<100);
+		}
+		CHECK(queue.Pop(item));
+		CHECK(item==((turn&1)?200:100)+turn/2);
+	}
+	CHECK(queue.GetCount(1)==5 && queue.GetCount(2)==5);
+
+	// the middle level is not starved while the lowest level has items
+	queue.Clear();
+	for (int i=0;i<100;i++)
+		queue.Push(i,0);
+	queue.Push(100,1);
+	for (int i=0;i<10;i++)
+		queue.Push(200+i,2);
+	int pops=0;
+	while (queue.GetCount(1)>0)
+	{
+		CHECK(queue.Pop(item));
+		pops++;
+	}
+	CHECK(pops<=LIMIT*2+2);
+
+	// no relief is needed while the lower levels are empty
+	queue.Clear();
+	for (int i=0;i<20;i++)
+		queue.Push(i,0);
+	for (int i=0;i<10;i++)
+	{
+		CHECK(queue.Pop(item));
+		CHECK(item==i);
+	}
+	queue.Push(100,1);
+	for (int i=0;i<LIMIT;i++)
+	{
+		CHECK(queue.Pop(item));
+		CHECK(item==10+i);
+	}
+	CHECK(queue.Pop(item));
+	CHECK(item==100);
+
+	// the top level is served first when it is the only one that has items left
+	queue.Clear();
+	for (int i=0;i<3;i++)
+		queue.Push(i,0);
+	queue.Push(200,2);
+	for (int i=0;i<3;i++)
+	{
+		CHECK(queue.Pop(item));
+		CHECK(item==i);
+	}
+	CHECK(queue.Pop(item) && item==200);
+	CHECK(queue.IsEmpty());
+}
+
+TEST(PriorityQueue,NoLoss)
+{
+	// random pushes, boosts and pops. every item is taken exactly once
+	CTestRandom random(29);
+	CPriorityQueue<int,4> queue(3);
+	std::vector<int> taken(2000,0);
+	int pushed=0, item;
+	while (pushed<2000 || !queue.IsEmpty())
+	{
+		int op=random.Next(10);
+		if (op<4 && pushed<2000)
+			queue.Push(pushed++,random.Next(4));
+		else if (op<6 && pushed>0)
+			queue.Boost(random.Next(pushed),random.Next(4));
+		else if (queue.Pop(item))
+			taken[item]++;
+	}
+	for (int i=0;i<2000;i++)
+		CHECK(taken[i]==1);
+}
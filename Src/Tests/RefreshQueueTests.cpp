@@ -0,0 +1,184 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "RefreshQueue.h"
+#include <stdio.h>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+// the fields of the ItemInfo that the queue uses, and what the fake loader did
+struct FakeItem
+{
+	int refreshFlags;
+	bool bRefreshing;
+	bool bRequeue;
+
+	std::atomic<int> loaders; // the number of threads refreshing the item
+	int requested; // all flags that were requested
+	int loaded; // all flags that were loaded
+
+	FakeItem( void ) : loaders(0) { refreshFlags=requested=loaded=0; bRefreshing=bRequeue=false; }
+};
+
+enum
+{
+	PRIORITY_VISIBLE,
+	PRIORITY_NEXT,
+	PRIORITY_PRELOAD,
+
+	PRIORITY_COUNT
+};
+
+TEST(RefreshQueue,Requeue)
+{
+	CRefreshQueue<FakeItem,PRIORITY_COUNT> queue;
+	FakeItem item1, item2;
+	FakeItem *pItem=NULL;
+	int flags=-1;
+	CHECK(!queue.BeginRefresh(pItem,flags));
+
+	item1.refreshFlags=3;
+	queue.Push(&item1,PRIORITY_NEXT);
+	queue.Push(&item2,PRIORITY_NEXT); // nothing to refresh
+	CHECK(queue.BeginRefresh(pItem,flags));
+	CHECK(pItem==&item1 && flags==3 && item1.bRefreshing);
+	CHECK(queue.BeginRefresh(pItem,flags));
+	CHECK(pItem==&item2 && flags==0 && !item2.bRefreshing);
+
+	// the item is requested again while the first thread is refreshing it. the second thread skips it
+	item1.refreshFlags|=4;
+	queue.Push(&item1,PRIORITY_PRELOAD);
+	CHECK(queue.BeginRefresh(pItem,flags));
+	CHECK(pItem==&item1 && flags==0 && item1.bRequeue);
+	CHECK(queue.IsEmpty());
+
+	// the first thread is done with its flags, and the item is queued again for the new one
+	item1.refreshFlags&=~3;
+	CHECK(queue.EndRefresh(&item1,PRIORITY_NEXT));
+	CHECK(!item1.bRefreshing && !item1.bRequeue);
+	CHECK(queue.GetCount(PRIORITY_NEXT)==1);
+	CHECK(queue.BeginRefresh(pItem,flags));
+	CHECK(pItem==&item1 && flags==4);
+	item1.refreshFlags=0;
+	CHECK(!queue.EndRefresh(&item1,PRIORITY_NEXT));
+	CHECK(queue.IsEmpty());
+
+	// no requeue if the refresh already handled the new flags
+	item1.refreshFlags=1;
+	queue.Push(&item1,PRIORITY_NEXT);
+	queue.BeginRefresh(pItem,flags);
+	queue.Push(&item1,PRIORITY_NEXT);
+	queue.BeginRefresh(pItem,flags);
+	CHECK(flags==0 && item1.bRequeue);
+	item1.refreshFlags=0;
+	CHECK(!queue.EndRefresh(&item1,PRIORITY_NEXT));
+	CHECK(queue.IsEmpty() && !item1.bRequeue);
+}
+
+TEST(RefreshQueue,Stress)
+{
+	// the refresh threads of CItemManager with a fake loader. two threads request random flags for a small set of items,
+	// so items are often requested again while they are refreshing
+	const int ITEMS=8, REQUESTS=20000, THREADS=4;
+	static FakeItem items[ITEMS];
+	CRefreshQueue<FakeItem,PRIORITY_COUNT> queue;
+	std::mutex lock; // the items lock
+	std::atomic<bool> bStop(false);
+	std::atomic<int> collisions(0), requeues(0), refreshes(0);
+
+	std::vector<std::thread> threads;
+	for (int t=0;t<THREADS;t++)
+	{
+		threads.push_back(std::thread([&]()
+		{
+			while (!bStop)
+			{
+				FakeItem *pItem;
+				int flags=0;
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					if (!queue.BeginRefresh(pItem,flags))
+						pItem=NULL;
+				}
+				if (!pItem)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+				if (!flags) continue;
+				// the loading is done outside of the lock
+				if (pItem->loaders.fetch_add(1)!=0)
+					collisions++;
+				for (int i=0;i<50;i++)
+					std::this_thread::yield();
+				pItem->loaders--;
+				refreshes++;
+				std::lock_guard<std::mutex> guard(lock);
+				pItem->loaded|=flags;
+				pItem->refreshFlags&=~flags;
+				if (queue.EndRefresh(pItem,PRIORITY_NEXT))
+					requeues++;
+			}
+		}));
+	}
+
+	std::thread requesters[2];
+	for (int r=0;r<2;r++)
+	{
+		requesters[r]=std::thread([&,r]()
+		{
+			CTestRandom random(30+r);
+			for (int i=0;i<REQUESTS;i++)
+			{
+				FakeItem &item=items[random.Next(ITEMS)];
+				int flags=1<<random.Next(16);
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					if (random.Next(8)==0)
+						queue.Boost(&item,PRIORITY_VISIBLE);
+					else
+					{
+						item.refreshFlags|=flags;
+						item.requested|=flags;
+						queue.Push(&item,r==0?PRIORITY_NEXT:PRIORITY_PRELOAD);
+					}
+				}
+				// give the refresh threads time to take the items
+				for (int y=random.Next(40);y>0;y--)
+					std::this_thread::yield();
+			}
+		});
+	}
+	requesters[0].join();
+	requesters[1].join();
+
+	// wait for the queue to drain
+	while (1)
+	{
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			bool bBusy=!queue.IsEmpty();
+			for (int i=0;i<ITEMS;i++)
+				if (items[i].bRefreshing) bBusy=true;
+			if (!bBusy) break;
+		}
+		std::this_thread::yield();
+	}
+	bStop=true;
+	for (std::vector<std::thread>::iterator it=threads.begin();it!=threads.end();++it)
+		it->join();
+
+	// no item was loaded by two threads at the same time, and no request was lost
+	CHECK(collisions==0);
+	for (int i=0;i<ITEMS;i++)
+	{
+		CHECK(items[i].refreshFlags==0);
+		CHECK(!items[i].bRefreshing && !items[i].bRequeue);
+		CHECK(items[i].loaded==items[i].requested);
+	}
+	printf("RefreshQueue: %d refreshes, %d requeued\n",(int)refreshes,(int)requeues);
+}
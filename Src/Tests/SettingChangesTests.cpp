@@ -0,0 +1,170 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "Settings.h"
+#include "SettingsSnapshot.h"
+
+// a small settings table with two groups, like the ones in SettingsUI.cpp
+static CSetting g_TestSettings[]={
+{L"Taskbar",CSetting::TYPE_GROUP},
+	{L"CustomTaskbar",CSetting::TYPE_BOOL,0,0,0},
+	{L"TaskbarLook",CSetting::TYPE_INT,0,0,1},
+		{L"Opaque",CSetting::TYPE_RADIO},
+		{L"Glass",CSetting::TYPE_RADIO},
+	{L"TaskbarTexture",CSetting::TYPE_BITMAP_JPG,0,0,L""},
+{L"StartButton",CSetting::TYPE_GROUP},
+	{L"EnableStartButton",CSetting::TYPE_BOOL,0,0,1},
+	{L"StartButtonText",CSetting::TYPE_STRING,0,0,L"Start"},
+	{L"StartButtonList",CSetting::TYPE_MULTISTRING,0,0,L"a\nb\n"},
+{NULL}
+};
+
+// sets all values to the defaults
+static CSetting *ResetTestSettings( void )
+{
+	for (CSetting *pSetting=g_TestSettings;pSetting->name;pSetting++)
+	{
+		pSetting->value=pSetting->defValue;
+		pSetting->flags=(pSetting->type>0)?CSetting::FLAG_DEFAULT:0;
+		pSetting->pLinkTo=NULL;
+	}
+	return g_TestSettings;
+}
+
+static CSetting *FindTestSetting( const wchar_t *name )
+{
+	for (CSetting *pSetting=g_TestSettings;pSetting->name;pSetting++)
+		if (wcscmp(pSetting->name,name)==0)
+			return pSetting;
+	return NULL;
+}
+
+TEST(SettingChanges,Snapshot)
+{
+	CSetting *pSettings=ResetTestSettings();
+	FindTestSetting(L"StartButtonText")->value=CComVariant(L"Go");
+	FindTestSetting(L"TaskbarLook")->flags|=CSetting::FLAG_LOCKED_REG;
+	CSettingsSnapshot snapshot(pSettings,7);
+	CHECK(snapshot.GetVersion()==7);
+	CHECK(snapshot.GetCount()==_countof(g_TestSettings)-1);
+	CHECK(snapshot.GetValue(1).intVal==0 && !snapshot.GetValue(1).str);
+	CHECK(snapshot.GetValue(2).intVal==1 && (snapshot.GetValue(2).flags&CSetting::FLAG_LOCKED_REG));
+	CHECK(snapshot.GetValue(5).str && wcscmp(snapshot.GetValue(5).str,L"")==0);
+	CHECK(snapshot.GetValue(8).str && wcscmp(snapshot.GetValue(8).str,L"Go")==0);
+	CHECK(snapshot.GetValue(9).str && wcscmp(snapshot.GetValue(9).str,L"a\nb\n")==0);
+
+	// the snapshot has its own copy of the strings
+	FindTestSetting(L"StartButtonText")->value=CComVariant(L"Start");
+	CHECK(wcscmp(snapshot.GetValue(8).str,L"Go")==0);
+}
+
+TEST(SettingChanges,Value)
+{
+	CSetting *pSettings=ResetTestSettings();
+	CSettingsSnapshot oldValues(pSettings,1);
+	CSettingChanges changes;
+	changes.Compare(pSettings,oldValues,CSettingsSnapshot(pSettings,2));
+	CHECK(changes.IsEmpty());
+	CHECK(!changes.IsGroupChanged(L"Taskbar") && !changes.IsGroupChanged(L"StartButton"));
+
+	// int
+	FindTestSetting(L"TaskbarLook")->value=CComVariant(2);
+	changes.Compare(pSettings,oldValues,CSettingsSnapshot(pSettings,2));
+	CHECK(changes.GetCount()==1);
+	CHECK(changes.GetChange(0).pSetting==FindTestSetting(L"TaskbarLook"));
+	CHECK(changes.GetChange(0).pGroup==FindTestSetting(L"Taskbar"));
+	CHECK(changes.GetChange(0).what==CSettingChanges::CHANGE_VALUE);
+	CHECK(changes.IsChanged(L"TaskbarLook") && !changes.IsChanged(L"CustomTaskbar"));
+	CHECK(changes.IsGroupChanged(L"Taskbar") && !changes.IsGroupChanged(L"StartButton"));
+	// the radio items and the groups are not settings
+	CHECK(!changes.IsChanged(L"Glass") && !changes.IsChanged(L"Taskbar"));
+
+	// bool, in the second group
+	ResetTestSettings();
+	FindTestSetting(L"EnableStartButton")->value=CComVariant(0);
+	changes.Compare(pSettings,oldValues,CSettingsSnapshot(pSettings,2));
+	CHECK(changes.GetCount()==1 && changes.IsChanged(L"EnableStartButton"));
+	CHECK(!changes.IsGroupChanged(L"Taskbar") && changes.IsGroupChanged(L"StartButton"));
+	CHECK(changes.GetChange(0).pGroup==FindTestSetting(L"StartButton"));
+
+	// Compare replaces the old list
+	ResetTestSettings();
+	changes.Compare(pSettings,oldValues,CSettingsSnapshot(pSettings,2));
+	CHECK(changes.IsEmpty());
+}
+
+TEST(SettingChanges,String)
+{
+	CSetting *pSettings=ResetTestSettings();
+	CSettingsSnapshot oldValues(pSettings,1);
+	CSettingChanges changes;
+
+	// the same text in a different string is not a change
+	FindTestSetting(L"StartButtonText")->value=CComVariant(L"Start");
+	changes.Compare(pSettings,oldValues,CSettingsSnapshot(pSettings,2));
+	CHECK(changes.IsEmpty());
+
+	FindTestSetting(L"StartButtonText")->value=CComVariant(L"start");
+	FindTestSetting(L"TaskbarTexture")->value=CComVariant(L"C:\\texture.png");
+	FindTestSetting(L"StartButtonList")->value=CComVariant(L"a\n");
+	changes.Compare(pSettings,oldValues,CSettingsSnapshot(pSettings,2));
+	CHECK(changes.GetCount()==3);
+	CHECK(changes.IsChanged(L"StartButtonText") && changes.IsChanged(L"TaskbarTexture") && changes.IsChanged(L"StartButtonList"));
+	for (int i=0;i<changes.GetCount();i++)
+		CHECK(changes.GetChange(i).what==CSettingChanges::CHANGE_VALUE);
+	CHECK(changes.IsGroupChanged(L"Taskbar") && changes.IsGroupChanged(L"StartButton"));
+
+	// a string that became empty
+	ResetTestSettings();
+	FindTestSetting(L"StartButtonText")->value=CComVariant(L"");
+	changes.Compare(pSettings,oldValues,CSettingsSnapshot(pSettings,2));
+	CHECK(changes.GetCount()==1 && changes.IsChanged(L"StartButtonText"));
+
+	// a string that had no value before
+	ResetTestSettings();
+	FindTestSetting(L"StartButtonText")->value=CComVariant();
+	CSettingsSnapshot emptyValues(pSettings,1);
+	FindTestSetting(L"StartButtonText")->value=CComVariant(L"");
+	changes.Compare(pSettings,emptyValues,CSettingsSnapshot(pSettings,2));
+	CHECK(changes.GetCount()==1 && changes.IsChanged(L"StartButtonText"));
+}
+
+TEST(SettingChanges,State)
+{
+	CSetting *pSettings=ResetTestSettings();
+	CSettingsSnapshot oldValues(pSettings,1);
+	CSettingChanges changes;
+
+	// the value is the same, but it is no longer the default
+	FindTestSetting(L"CustomTaskbar")->flags&=~CSetting::FLAG_DEFAULT;
+	// locked by the administrator
+	FindTestSetting(L"EnableStartButton")->flags|=CSetting::FLAG_LOCKED_GP;
+	// a new default value from a policy, and a different value
+	FindTestSetting(L"TaskbarLook")->flags|=CSetting::FLAG_FORCED_DEFAULT;
+	FindTestSetting(L"TaskbarLook")->value=CComVariant(3);
+	// the other flags are not part of the state
+	FindTestSetting(L"StartButtonText")->flags|=CSetting::FLAG_WARNING;
+	changes.Compare(pSettings,oldValues,CSettingsSnapshot(pSettings,2));
+	CHECK(changes.GetCount()==3);
+	for (int i=0;i<changes.GetCount();i++)
+	{
+		const CSettingChanges::Change &change=changes.GetChange(i);
+		if (wcscmp(change.pSetting->name,L"TaskbarLook")==0)
+			CHECK(change.what==(CSettingChanges::CHANGE_VALUE|CSettingChanges::CHANGE_STATE));
+		else
+			CHECK(change.what==CSettingChanges::CHANGE_STATE);
+	}
+	CHECK(!changes.IsChanged(L"StartButtonText"));
+
+	// a linked setting reports the state of the setting it is linked to
+	ResetTestSettings();
+	CSettingsSnapshot oldValues2(pSettings,1);
+	FindTestSetting(L"StartButtonText")->pLinkTo=FindTestSetting(L"TaskbarTexture");
+	FindTestSetting(L"TaskbarTexture")->flags|=CSetting::FLAG_LOCKED_REG;
+	changes.Compare(pSettings,oldValues2,CSettingsSnapshot(pSettings,2));
+	CHECK(changes.GetCount()==2 && changes.IsChanged(L"StartButtonText") && changes.IsChanged(L"TaskbarTexture"));
+	ResetTestSettings();
+}
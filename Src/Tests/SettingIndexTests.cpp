@@ -0,0 +1,76 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "SettingIndex.h"
+#include <stdio.h>
+
+TEST(SettingIndex,Find)
+{
+	std::vector<const wchar_t*> names;
+	names.push_back(L"MenuStyle");
+	names.push_back(NULL);
+	names.push_back(L"EnableJumplists");
+	names.push_back(L"SkinC1");
+	names.push_back(L"menustyle"); // duplicate, the first one wins
+	CSettingIndex index;
+	index.Build(names);
+	CHECK(index.Find(L"MenuStyle")==0);
+	CHECK(index.Find(L"MENUSTYLE")==0);
+	CHECK(index.Find(L"EnableJumplists")==2);
+	CHECK(index.Find(L"skinc1")==3);
+	CHECK(index.Find(L"SkinC")<0);
+	CHECK(index.Find(L"SkinC12")<0);
+	CHECK(index.Find(L"")<0);
+	// only the ASCII letters are folded
+	CHECK(index.Find(L"M\x00C9nuStyle")<0);
+}
+
+TEST(SettingIndex,Empty)
+{
+	CSettingIndex index;
+	CHECK(index.Find(L"MenuStyle")<0);
+	index.Build(std::vector<const wchar_t*>());
+	CHECK(index.Find(L"MenuStyle")<0);
+}
+
+TEST(SettingIndex,ManyNames)
+{
+	std::vector<std::wstring> strings;
+	for (int i=0;i<2000;i++)
+	{
+		wchar_t text[32];
+		swprintf(text,32,L"Setting%d",i);
+		strings.push_back(text);
+	}
+	std::vector<const wchar_t*> names;
+	for (std::vector<std::wstring>::const_iterator it=strings.begin();it!=strings.end();++it)
+		names.push_back(it->c_str());
+	CSettingIndex index;
+	index.Build(names);
+	bool bFound=true;
+	for (int i=0;i<(int)names.size();i++)
+	{
+		if (index.Find(names[i])!=i)
+			bFound=false;
+	}
+	CHECK(bFound);
+	CHECK(index.Find(L"Setting2000")<0);
+}
+
+TEST(SettingIndex,Collision)
+{
+	// the two names have the same hash, so no displacement can separate them. the index must fall back to the linear search
+	std::vector<const wchar_t*> names;
+	names.push_back(L"Setting7493");
+	names.push_back(L"MenuStyle");
+	names.push_back(L"Setting533150");
+	CSettingIndex index;
+	index.Build(names);
+	CHECK(index.Find(L"Setting7493")==0);
+	CHECK(index.Find(L"MenuStyle")==1);
+	CHECK(index.Find(L"SETTING533150")==2);
+	CHECK(index.Find(L"Setting1")<0);
+}
@@ -0,0 +1,142 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "SettingKeyIndex.h"
+#include <stdio.h>
+#include <wctype.h>
+
+// Splits the text into lines the same way as CSettingsParser::ParseText
+static void SplitLines( std::vector<wchar_t> &text, std::vector<const wchar_t*> &lines )
+{
+	if (text.empty()) return;
+	wchar_t *str=&text[0];
+	while (*str)
+	{
+		if (*str!=';') // ignore lines starting with ;
+		{
+			// trim leading whitespace
+			while (*str==' ' || *str=='\t')
+				str++;
+			lines.push_back(str);
+		}
+		wchar_t *p1=wcschr(str,'\r');
+		wchar_t *p2=wcschr(str,'\n');
+		wchar_t *end=&text[text.size()-1];
+		if (p1) end=p1;
+		if (p2 && p2<end) end=p2;
+
+		wchar_t *next=end;
+		while (*next=='\r' || *next=='\n')
+			next++;
+
+		// trim trailing whitespace
+		while (end>str && (*end==' ' || *end=='\t'))
+			end--;
+		*end=0;
+		str=next;
+	}
+}
+
+// The search that CSettingsParser did before the index - the last line that starts with the name, followed by '='
+static int FindLineLinear( const std::vector<const wchar_t*> &lines, const wchar_t *name, size_t len )
+{
+	for (int i=(int)lines.size()-1;i>=0;i--)
+	{
+		const wchar_t *str=lines[i];
+		if (_wcsnicmp(name,str,len)==0)
+		{
+			str+=len;
+			while (*str==' ' || *str=='\t')
+				str++;
+			if (*str=='=')
+				return i;
+		}
+	}
+	return -1;
+}
+
+static int FindLine( const CSettingKeyIndex &index, const std::vector<const wchar_t*> &lines, const wchar_t *name )
+{
+	return index.Find(lines,name,wcslen(name));
+}
+
+TEST(SettingKeyIndex,Find)
+{
+	wchar_t text[]=L"Main_bitmap=a.bmp\r\n; Main_bitmap=comment\r\n\tMain_Bitmap_Slices_X = 1,2,3\r\nmain_bitmap\t=b.bmp\r\n[SMALL_ICONS]\r\nNoValue\r\nEmpty=\r\nKey=A=B\r\n";
+	std::vector<wchar_t> buf(text,text+sizeof(text)/sizeof(text[0]));
+	std::vector<const wchar_t*> lines;
+	SplitLines(buf,lines);
+	CHECK(lines.size()==7);
+
+	CSettingKeyIndex index;
+	CHECK(FindLine(index,lines,L"Main_bitmap")<0); // not built yet
+	index.Build(lines);
+	CHECK(FindLine(index,lines,L"Main_bitmap")==2); // the last definition wins
+	CHECK(FindLine(index,lines,L"MAIN_BITMAP")==2);
+	CHECK(FindLine(index,lines,L"Main_Bitmap_Slices_X")==1);
+	CHECK(FindLine(index,lines,L"Main_Bitmap_Slices")<0);
+	CHECK(FindLine(index,lines,L"NoValue")<0);
+	CHECK(FindLine(index,lines,L"Empty")==5);
+	CHECK(FindLine(index,lines,L"Key")==6); // the key ends at the first '='
+	CHECK(FindLine(index,lines,L"Missing")<0);
+
+	index.Clear();
+	CHECK(FindLine(index,lines,L"Main_bitmap")<0);
+	index.Build(std::vector<const wchar_t*>());
+	CHECK(FindLine(index,lines,L"Main_bitmap")<0);
+}
+
+TEST(SettingKeyIndex,ShippedSkins)
+{
+	// the index must find the same line as the linear search for every key of the shipped skins, in any case
+	const std::vector<std::string> &files=GetSkinFiles();
+	int lookups=0, mismatches=0;
+	for (std::vector<std::string>::const_iterator it=files.begin();it!=files.end();++it)
+	{
+		std::vector<wchar_t> text;
+		CHECK(ReadTextFile(it->c_str(),text));
+		std::vector<const wchar_t*> lines;
+		SplitLines(text,lines);
+		CSettingKeyIndex index;
+		index.Build(lines);
+
+		std::vector<std::wstring> names;
+		for (std::vector<const wchar_t*>::const_iterator line=lines.begin();line!=lines.end();++line)
+		{
+			const wchar_t *end=wcschr(*line,'=');
+			if (!end) continue;
+			while (end>*line && (end[-1]==' ' || end[-1]=='\t'))
+				end--;
+			std::wstring name(*line,end);
+			names.push_back(name);
+			for (std::wstring::iterator c=name.begin();c!=name.end();++c)
+				*c=towupper(*c);
+			names.push_back(name);
+			for (std::wstring::iterator c=name.begin();c!=name.end();++c)
+				*c=towlower(*c);
+			names.push_back(name);
+			// a prefix of the key. the names that end with whitespace don't use the index
+			name.resize(name.size()/2);
+			if (name.empty() || (name[name.size()-1]!=' ' && name[name.size()-1]!='\t'))
+				names.push_back(name);
+		}
+		names.push_back(L"Missing_Key");
+		names.push_back(L"");
+
+		for (std::vector<std::wstring>::const_iterator name=names.begin();name!=names.end();++name)
+		{
+			lookups++;
+			if (index.Find(lines,name->c_str(),name->size())!=FindLineLinear(lines,name->c_str(),name->size()))
+			{
+				printf("%s: mismatch for '%ls'\n",it->c_str(),name->c_str());
+				mismatches++;
+			}
+		}
+	}
+	CHECK(files.size()>=10);
+	CHECK(lookups>1000);
+	CHECK(mismatches==0);
+}
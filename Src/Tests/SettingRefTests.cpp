@@ -0,0 +1,167 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include <vector>
+
+// a fake settings table with the parts of Settings.h that SettingRef.h uses
+struct CSetting
+{
+	enum Type
+	{
+		TYPE_BOOL=1,
+		TYPE_INT,
+		TYPE_STRING=6,
+	};
+};
+
+struct TestSetting
+{
+	const wchar_t *name;
+	CSetting::Type type;
+	int value;
+	const wchar_t *text;
+};
+
+static std::vector<TestSetting> g_Table;
+static int g_Generation;
+static int g_ResolveCalls;
+static int g_ReadCalls;
+
+// like the real ResolveSetting (without the Assert for the missing settings)
+static int ResolveSetting( const wchar_t *name, CSetting::Type type )
+{
+	g_ResolveCalls++;
+	for (int i=0;i<(int)g_Table.size();i++)
+		if (wcscmp(g_Table[i].name,name)==0)
+			return g_Table[i].type==type?i:-1;
+	return -1;
+}
+
+static int GetSettingsGeneration( void ) { return g_Generation; }
+static int ReadSettingInt( int index ) { g_ReadCalls++; return g_Table[index].value; }
+static CString ReadSettingString( int index ) { g_ReadCalls++; return g_Table[index].text; }
+
+#include "SettingRef.h"
+
+// simulates CSettingsManager::Init with a new table
+static void InitTable( void )
+{
+	g_Table.clear();
+	TestSetting settings[]={
+		{L"Bool1",CSetting::TYPE_BOOL,1,L""},
+		{L"Bool0",CSetting::TYPE_BOOL,0,L""},
+		{L"Int",CSetting::TYPE_INT,42,L""},
+		{L"String",CSetting::TYPE_STRING,0,L"text"},
+	};
+	g_Table.assign(settings,settings+_countof(settings));
+	g_Generation++;
+	g_ResolveCalls=g_ReadCalls=0;
+}
+
+TEST(SettingRef,Resolve)
+{
+	g_Generation=0;
+	InitTable();
+	CSettingRef<bool> bool1(L"Bool1"), bool0(L"Bool0");
+	CSettingRef<int> number(L"Int");
+	CSettingRef<CString> text(L"String");
+
+	// each setting is resolved once and the value is read every time
+	for (int i=0;i<3;i++)
+	{
+		CHECK(bool1 && !bool0);
+		CHECK(number==42);
+		CHECK(text.Get()==L"text");
+	}
+	CHECK(g_ResolveCalls==4);
+	CHECK(g_ReadCalls==12);
+
+	// the new values are seen without resolving again
+	g_Table[2].value=7;
+	g_Table[0].value=0;
+	CHECK(number==7);
+	CHECK(!bool1);
+	CHECK(g_ResolveCalls==4);
+}
+
+TEST(SettingRef,Generation)
+{
+	g_Generation=0;
+	InitTable();
+	CSettingRef<int> number(L"Int");
+	CSettingRef<CString> text(L"String");
+	CHECK(number==42);
+	CHECK(text.Get()==L"text");
+
+	// the settings are initialized again in a different order
+	InitTable();
+	std::swap(g_Table[2],g_Table[3]);
+	std::swap(g_Table[0],g_Table[2]);
+	CHECK(number==42);
+	CHECK(text.Get()==L"text");
+	CHECK(g_ResolveCalls==2);
+
+	// the generation wraps the low 16 bits. the old 16-bit state kept the stale index here
+	InitTable();
+	CHECK(number==42);
+	g_Generation+=0x10000;
+	g_Table[2].type=CSetting::TYPE_BOOL;
+	CHECK(number==0);
+	CHECK(g_ResolveCalls==2);
+	g_Generation+=0x10000;
+	g_Table[2].type=CSetting::TYPE_INT;
+	g_Table[2].value=5;
+	CHECK(number==5);
+	CHECK(g_ResolveCalls==3);
+}
+
+TEST(SettingRef,Missing)
+{
+	g_Generation=0;
+	InitTable();
+	CSettingRef<bool> missing(L"Missing");
+	CSettingRef<int> wrongType(L"Bool1");
+	CSettingRef<CString> wrongString(L"Int");
+
+	// a failed lookup returns the default and is remembered until the next generation
+	for (int i=0;i<5;i++)
+	{
+		CHECK(!missing);
+		CHECK(wrongType==0);
+		CHECK(wrongString.Get().IsEmpty());
+	}
+	CHECK(g_ResolveCalls==3);
+	CHECK(g_ReadCalls==0);
+
+	// the setting is found after it is added
+	InitTable();
+	TestSetting setting={L"Missing",CSetting::TYPE_BOOL,1,L""};
+	g_Table.push_back(setting);
+	CHECK(missing);
+	CHECK(missing);
+	CHECK(g_ResolveCalls==1);
+}
+
+TEST(SettingRef,NotInitialized)
+{
+	// before the first Init the defaults are returned and nothing is resolved
+	g_Generation=0;
+	g_Table.clear();
+	g_ResolveCalls=g_ReadCalls=0;
+	CSettingRef<bool> flag(L"Bool1");
+	CSettingRef<int> number(L"Int");
+	CSettingRef<CString> text(L"String");
+	CHECK(!flag);
+	CHECK(number==0);
+	CHECK(text.Get().IsEmpty());
+	CHECK(g_ResolveCalls==0);
+	CHECK(g_ReadCalls==0);
+
+	InitTable();
+	CHECK(flag);
+	CHECK(number==42);
+	CHECK(g_ResolveCalls==2);
+}
@@ -0,0 +1,230 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "SettingsStore.h"
+#include <vector>
+
+TEST(SettingsStore,ValueMap)
+{
+	CSettingsValueMap values;
+	values.SetDWORD(L"Number",5);
+	values.SetString(L"Text",L"text");
+	values.SetMultiString(L"List",L"a\nb\n");
+	CHECK(values.GetCount()==3);
+
+	// the names are case-insensitive
+	DWORD val=0;
+	CString text;
+	CHECK(values.QueryDWORD(L"NUMBER",val) && val==5);
+	CHECK(values.QueryString(L"text",text) && text==L"text");
+	CHECK(values.QueryMultiString(L"List",text) && text==L"a\nb\n");
+	CHECK(!values.QueryDWORD(L"Missing",val));
+
+	// the type must match
+	CHECK(!values.QueryString(L"Number",text));
+	CHECK(!values.QueryDWORD(L"Text",val));
+	CHECK(!values.QueryString(L"List",text));
+	CHECK(!values.QueryMultiString(L"Text",text));
+
+	// setting a value again replaces it with the new type
+	values.SetString(L"number",L"five");
+	CHECK(values.GetCount()==3);
+	CHECK(!values.QueryDWORD(L"Number",val));
+	CHECK(values.QueryString(L"Number",text) && text==L"five");
+
+	values.Clear();
+	CHECK(values.GetCount()==0);
+	CHECK(!values.QueryString(L"Number",text));
+}
+
+// Sets a value from raw registry data, with room for the 2 extra terminators. size is in bytes
+static void SetRegValue( CSettingsValueMap &values, const wchar_t *name, DWORD type, const wchar_t *data, DWORD size )
+{
+	std::vector<wchar_t> buf(size/sizeof(wchar_t)+3,L'#');
+	memcpy(&buf[0],data,size);
+	values.SetRegValue(name,type,&buf[0],size);
+}
+
+// Returns the text of a REG_MULTI_SZ value, or "?" if it is not found
+static CString GetMultiString( const wchar_t *data, DWORD size )
+{
+	CSettingsValueMap values;
+	SetRegValue(values,L"List",REG_MULTI_SZ,data,size);
+	CString text=L"?";
+	values.QueryMultiString(L"List",text);
+	return text;
+}
+
+TEST(SettingsStore,MultiString)
+{
+	const DWORD C=sizeof(wchar_t); // the sizes are in bytes
+
+	// every string is followed by '\n'
+	CHECK(GetMultiString(L"one\0two\0\0",9*C)==L"one\ntwo\n");
+	CHECK(GetMultiString(L"one\0\0",5*C)==L"one\n");
+	// the registry doesn't require the terminators
+	CHECK(GetMultiString(L"one\0two\0",8*C)==L"one\ntwo\n");
+	CHECK(GetMultiString(L"one\0two",7*C)==L"one\ntwo\n");
+	CHECK(GetMultiString(L"one",3*C)==L"one\n");
+	// odd size
+	CHECK(GetMultiString(L"one\0two",6*C+1)==L"one\ntw\n");
+	// empty lists
+	CHECK(GetMultiString(L"",0)==L"");
+	CHECK(GetMultiString(L"\0",C)==L"");
+	CHECK(GetMultiString(L"",1)==L"");
+
+	CSettingsValueMap values;
+	CString text;
+	DWORD val=0;
+	SetRegValue(values,L"Text",REG_SZ,L"abc",3*C); // not terminated
+	CHECK(values.QueryString(L"Text",text) && text==L"abc");
+	SetRegValue(values,L"Text",REG_SZ,L"abc",3*C+1); // odd size
+	CHECK(values.QueryString(L"Text",text) && text==L"abc");
+	SetRegValue(values,L"Text",REG_EXPAND_SZ,L"%windir%",9*C);
+	CHECK(values.QueryString(L"Text",text) && text==L"%windir%");
+	DWORD dword=0x12345678;
+	SetRegValue(values,L"Number",REG_DWORD,(const wchar_t*)&dword,4);
+	CHECK(values.QueryDWORD(L"Number",val) && val==0x12345678);
+
+	// the values with the wrong size or unknown type are ignored
+	SetRegValue(values,L"Short",REG_DWORD,(const wchar_t*)&dword,2);
+	SetRegValue(values,L"Binary",3,L"abcd",4*C);
+	CHECK(values.GetCount()==2);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// reads DWORD values, like CSetting::ReadValue for a bool or int setting
+class TestReader: public ISettingValueReader
+{
+public:
+	TestReader( int defValue ) { value=this->defValue=defValue; }
+
+	virtual bool ReadValue( const ISettingsStore &store, const wchar_t *valName )
+	{
+		DWORD val;
+		if (!store.QueryDWORD(valName,val)) return false;
+		value=(int)val;
+		return true;
+	}
+
+	virtual void SetDefault( void ) { defValue=value; }
+
+	int value;
+	int defValue;
+};
+
+// the four stores of one setting
+struct TestStores
+{
+	CSettingsValueMap settings, settingsUser, policy, policyUser;
+
+	// loads the setting "Value" with the default 1. returns the flags
+	int Load( TestReader &reader ) const
+	{
+		return LoadSettingValue(L"Value",reader,&settings,&settingsUser,&policy,&policyUser);
+	}
+};
+
+TEST(SettingsStore,Precedence)
+{
+	{
+		// no stores, or no values
+		TestReader reader(1);
+		CHECK(LoadSettingValue(L"Value",reader,NULL,NULL,NULL,NULL)==SETTING_LOAD_DEFAULT);
+		CHECK(reader.value==1);
+		TestStores stores;
+		CHECK(stores.Load(reader)==SETTING_LOAD_DEFAULT && reader.value==1);
+	}
+	{
+		// the user value
+		TestStores stores;
+		stores.settingsUser.SetDWORD(L"Value",2);
+		TestReader reader(1);
+		CHECK(stores.Load(reader)==0 && reader.value==2);
+
+		// the shared value wins and locks the setting
+		stores.settings.SetDWORD(L"Value",3);
+		TestReader reader2(1);
+		CHECK(stores.Load(reader2)==SETTING_LOAD_LOCKED && reader2.value==3);
+
+		// 0xDEFA in the shared settings locks it to the default
+		stores.settings.SetDWORD(L"Value",0xDEFA);
+		TestReader reader3(1);
+		CHECK(stores.Load(reader3)==(SETTING_LOAD_LOCKED|SETTING_LOAD_DEFAULT) && reader3.value==1);
+	}
+	{
+		// the shared default
+		TestStores stores;
+		stores.settings.SetDWORD(L"Value_Default",4);
+		TestReader reader(1);
+		CHECK(stores.Load(reader)==(SETTING_LOAD_DEFAULT|SETTING_LOAD_FORCED_DEFAULT));
+		CHECK(reader.value==4 && reader.defValue==4);
+
+		// the user can still change it
+		stores.settingsUser.SetDWORD(L"Value",2);
+		TestReader reader2(1);
+		CHECK(stores.Load(reader2)==SETTING_LOAD_FORCED_DEFAULT);
+		CHECK(reader2.value==2 && reader2.defValue==4);
+	}
+}
+
+TEST(SettingsStore,Policy)
+{
+	for (int user=0;user<2;user++)
+	{
+		// the same rules for the HKLM and the HKCU policies
+		TestStores stores;
+		CSettingsValueMap &policy=user?stores.policyUser:stores.policy;
+		stores.settingsUser.SetDWORD(L"Value",2);
+		policy.SetDWORD(L"Value",5);
+
+		// locked to value
+		policy.SetDWORD(L"Value_State",0);
+		TestReader reader(1);
+		CHECK(stores.Load(reader)==SETTING_LOAD_LOCKED && reader.value==5);
+
+		// locked to default. the policy value is used as the default
+		policy.SetDWORD(L"Value_State",1);
+		TestReader reader2(1);
+		CHECK(stores.Load(reader2)==(SETTING_LOAD_LOCKED|SETTING_LOAD_DEFAULT) && reader2.value==5);
+
+		// change default. the user value still wins
+		policy.SetDWORD(L"Value_State",2);
+		TestReader reader3(1);
+		CHECK(stores.Load(reader3)==SETTING_LOAD_FORCED_DEFAULT);
+		CHECK(reader3.value==2 && reader3.defValue==5);
+
+		// an unknown state, or a state without a value, is ignored
+		policy.SetDWORD(L"Value_State",3);
+		TestReader reader4(1);
+		CHECK(stores.Load(reader4)==0 && reader4.value==2 && reader4.defValue==1);
+		policy.SetDWORD(L"Value_State",0);
+		policy.SetString(L"Value",L"text");
+		TestReader reader5(1);
+		CHECK(stores.Load(reader5)==0 && reader5.value==2);
+	}
+	{
+		// the HKLM policy wins over the shared settings, and the shared settings win over the HKCU policy
+		TestStores stores;
+		stores.settings.SetDWORD(L"Value",3);
+		stores.policyUser.SetDWORD(L"Value",6);
+		stores.policyUser.SetDWORD(L"Value_State",0);
+		TestReader reader(1);
+		CHECK(stores.Load(reader)==SETTING_LOAD_LOCKED && reader.value==3);
+		stores.policy.SetDWORD(L"Value",5);
+		stores.policy.SetDWORD(L"Value_State",0);
+		TestReader reader2(1);
+		CHECK(stores.Load(reader2)==SETTING_LOAD_LOCKED && reader2.value==5);
+
+		// a changed default in the HKLM policy, and a locked value in the HKCU policy
+		stores.settings.Clear();
+		stores.policy.SetDWORD(L"Value_State",2);
+		TestReader reader3(1);
+		CHECK(stores.Load(reader3)==(SETTING_LOAD_LOCKED|SETTING_LOAD_FORCED_DEFAULT));
+		CHECK(reader3.value==6 && reader3.defValue==5);
+	}
+}
@@ -0,0 +1,325 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "SkinConditions.h"
+#include <stdio.h>
+#include <wctype.h>
+#include <set>
+
+///////////////////////////////////////////////////////////////////////////////
+// The evaluator that CSkinParser used before CSkinConditions. The compiled programs must give the same results
+
+enum TType
+{
+	TYPE_AND,
+	TYPE_OR,
+	TYPE_NOT,
+	TYPE_PAR, // '('
+};
+
+static bool ApplyOperator( bool *valStack, int &vsp, TType op )
+{
+	switch (op)
+	{
+	case TYPE_AND:
+		if (vsp<2) return false;
+		vsp--;
+		valStack[vsp-1]=valStack[vsp-1] && valStack[vsp];
+		return true;
+	case TYPE_OR:
+		if (vsp<2) return false;
+		vsp--;
+		valStack[vsp-1]=valStack[vsp-1] || valStack[vsp];
+		return true;
+	case TYPE_NOT:
+		if (vsp<1) return false;
+		valStack[vsp-1]=!valStack[vsp-1];
+		return true;
+	default:
+		return false;
+	}
+}
+
+static int EvalConditionOld( const wchar_t *condition, const wchar_t *const *values, int count )
+{
+	wchar_t token[256];
+	TType opStack[16];
+	int osp=0;
+	bool valStack[16];
+	int vsp=0;
+
+	while (1)
+	{
+		// skip leading whitespace
+		while (*condition==' ' || *condition=='\t')
+			condition++;
+		if (!*condition) break;
+
+		if (*condition=='(')
+		{
+			if (osp>=(int)_countof(opStack)) return -1; // too much nesting
+			opStack[osp]=TYPE_PAR;
+			osp++;
+			condition++;
+			continue;
+		}
+
+		if (*condition==')')
+		{
+			bool found=false;
+			while (osp>0)
+			{
+				osp--;
+				if (opStack[osp]==TYPE_PAR)
+				{
+					found=true;
+					break;
+				}
+				if (!ApplyOperator(valStack,vsp,opStack[osp])) return -1; // invalid operation
+			}
+			if (!found) return -1; // too many )
+			condition++;
+			continue;
+		}
+
+		// find token
+		const wchar_t *end=condition;
+		while (*end && *end!=' ' && *end!='\t' && *end!='(' && *end!=')')
+			end++;
+
+		int len=(int)(end-condition);
+		if (len>=(int)_countof(token)) return -1; // too long token
+		memcpy(token,condition,len*sizeof(wchar_t));
+		token[len]=0;
+		condition=end;
+		while (*condition==' ' || *condition=='\t')
+			condition++;
+
+		if (_wcsicmp(token,L"and")==0 || _wcsicmp(token,L"or")==0)
+		{
+			while (osp>0 && opStack[osp-1]!=TYPE_PAR)
+			{
+				osp--;
+				if (!ApplyOperator(valStack,vsp,opStack[osp])) return -1; // invalid operation
+			}
+			if (osp>=(int)_countof(opStack)) return -1; // too much nesting
+			opStack[osp]=(token[0]=='a' || token[0]=='A')?TYPE_AND:TYPE_OR;
+			osp++;
+		}
+		else if (_wcsicmp(token,L"not")==0)
+		{
+			while (osp>0 && opStack[osp-1]==TYPE_NOT)
+			{
+				osp--;
+				if (!ApplyOperator(valStack,vsp,opStack[osp])) return -1; // invalid operation
+			}
+			if (osp>=(int)_countof(opStack)) return -1; // too much nesting
+			opStack[osp]=TYPE_NOT;
+			osp++;
+		}
+		else
+		{
+			if (vsp>=(int)_countof(valStack)) return -1; // too much nesting
+			bool bValue=false;
+			if (_wcsicmp(token,L"true")==0)
+				bValue=true;
+			else
+			{
+				for (int i=0;i<count;i++)
+					if (_wcsicmp(token,values[i])==0)
+					{
+						bValue=true;
+						break;
+					}
+			}
+			valStack[vsp++]=bValue;
+		}
+	}
+
+	while (osp>0)
+	{
+		osp--;
+		if (opStack[osp]==TYPE_PAR) return -1; // unclosed (
+		if (!ApplyOperator(valStack,vsp,opStack[osp])) return -1; // invalid operation
+	}
+
+	if (vsp!=1) return -1; // unbalanced expression
+	return valStack[0]?1:0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int Evaluate( const wchar_t *condition, const wchar_t *const *values, int count )
+{
+	CSkinConditions conditions;
+	conditions.Add(condition);
+	std::vector<char> results;
+	conditions.Evaluate(values,count,results);
+	return results[0];
+}
+
+TEST(SkinConditions,Evaluate)
+{
+	const wchar_t *values[]={L"SMALL_ICONS",L"two_columns"};
+	CHECK(Evaluate(L"SMALL_ICONS",values,2)==1);
+	CHECK(Evaluate(L"small_icons",values,2)==1);
+	CHECK(Evaluate(L"NO_ICONS",values,2)==0);
+	CHECK(Evaluate(L"NO_ICONS",NULL,0)==0);
+	CHECK(Evaluate(L"True",NULL,0)==1);
+	CHECK(Evaluate(L"NOT SMALL_ICONS AND (TWO_COLUMNS OR TRUE)",values,2)==0);
+	CHECK(Evaluate(L"not NO_ICONS and (TWO_COLUMNS or NO_ICONS)",values,2)==1);
+	CHECK(Evaluate(L"NO_ICONS OR SMALL_ICONS AND NOT TWO_COLUMNS",values,2)==0); // left to right, no precedence
+	CHECK(Evaluate(L"NOT (NOT SMALL_ICONS)",values,2)==1);
+	CHECK(Evaluate(L"\t(SMALL_ICONS)and(TWO_COLUMNS) ",values,2)==1);
+
+	// errors
+	CHECK(Evaluate(L"",values,2)==-1);
+	CHECK(Evaluate(L"(",values,2)==-1);
+	CHECK(Evaluate(L")",values,2)==-1);
+	CHECK(Evaluate(L"SMALL_ICONS AND",values,2)==-1);
+	CHECK(Evaluate(L"SMALL_ICONS TWO_COLUMNS",values,2)==-1);
+	CHECK(Evaluate(L"NOT",values,2)==-1);
+	CHECK(Evaluate(L"NOT NOT SMALL_ICONS",values,2)==-1); // the first NOT is applied when the second one is found, before it has an operand
+	CHECK(Evaluate(L"((SMALL_ICONS)",values,2)==-1);
+	CHECK(Evaluate(L"(((((((((((((((SMALL_ICONS)))))))))))))))",values,2)==1); // 15 levels
+	CHECK(Evaluate(L"((((((((((((((((SMALL_ICONS))))))))))))))))",values,2)==1); // 16 levels
+	CHECK(Evaluate(L"(((((((((((((((((SMALL_ICONS)))))))))))))))))",values,2)==-1); // 17 levels
+}
+
+TEST(SkinConditions,SharedPrograms)
+{
+	CSkinConditions conditions;
+	int a=conditions.Add(L"SMALL_ICONS");
+	int b=conditions.Add(L"NOT SMALL_ICONS");
+	int c=conditions.Add(L"SMALL_ICONS)",11); // only the first 11 characters
+	int d=conditions.Add(L"AND");
+	CHECK(a!=b);
+	CHECK(c==a);
+	CHECK(conditions.GetCount()==3);
+	const wchar_t *values[]={L"small_icons"};
+	std::vector<char> results;
+	conditions.Evaluate(values,1,results);
+	CHECK(results.size()==3);
+	CHECK(results[a]==1 && results[b]==0 && results[d]==-1);
+	conditions.Evaluate(NULL,0,results);
+	CHECK(results[a]==0 && results[b]==1 && results[d]==-1);
+}
+
+// Collects the conditions of the groups ([condition]) and of the options (OPTION name=label,value,condition,...)
+static void ReadConditions( const char *fname, std::set<std::wstring> &conditions )
+{
+	std::vector<wchar_t> text;
+	CHECK(ReadTextFile(fname,text));
+	const wchar_t *str=&text[0];
+	while (*str)
+	{
+		const wchar_t *end=str;
+		while (*end && *end!='\r' && *end!='\n')
+			end++;
+		std::wstring line(str,end);
+		str=end;
+		while (*str=='\r' || *str=='\n')
+			str++;
+
+		size_t start=line.find_first_not_of(L" \t");
+		if (start==std::wstring::npos) continue;
+		line.erase(0,start);
+		if (line[0]=='[')
+		{
+			size_t close=line.find(']');
+			if (close!=std::wstring::npos)
+				conditions.insert(line.substr(1,close-1));
+		}
+		else if (_wcsnicmp(line.c_str(),L"OPTION",6)==0)
+		{
+			size_t pos=line.find('=');
+			for (int field=0;field<2 && pos!=std::wstring::npos;field++)
+				pos=line.find(',',pos+1);
+			if (pos==std::wstring::npos) continue;
+			size_t next=line.find(',',pos+1);
+			conditions.insert(line.substr(pos+1,next==std::wstring::npos?std::wstring::npos:next-pos-1));
+		}
+	}
+}
+
+TEST(SkinConditions,ShippedSkins)
+{
+	// every condition of the shipped skins must give the same result as the old evaluator, for random sets of options
+	std::set<std::wstring> conditions;
+	const std::vector<std::string> &files=GetSkinFiles();
+	for (std::vector<std::string>::const_iterator it=files.begin();it!=files.end();++it)
+		ReadConditions(it->c_str(),conditions);
+	CHECK(conditions.size()>100);
+
+	// the edge cases that are not in the skins
+	const wchar_t *extra[]={L"",L"(",L")",L"a and",L"not",L"a b",L"((a)",L"a or b and not c",L"NOT NOT a",L"(((((((((((((((((a)))))))))))))))))",L"True",L"a AND (b OR (c AND NOT d))",L" x "};
+	conditions.insert(extra,extra+_countof(extra));
+
+	// the variable names
+	std::set<std::wstring> variables;
+	for (std::set<std::wstring>::const_iterator it=conditions.begin();it!=conditions.end();++it)
+	{
+		std::wstring token;
+		std::wstring condition=*it+L" ";
+		for (std::wstring::const_iterator c=condition.begin();c!=condition.end();++c)
+		{
+			if (*c==' ' || *c=='\t' || *c=='(' || *c==')')
+			{
+				if (!token.empty())
+					variables.insert(token);
+				token.clear();
+			}
+			else
+				token+=*c;
+		}
+	}
+
+	CSkinConditions compiled;
+	std::vector<int> indices;
+	for (std::set<std::wstring>::const_iterator it=conditions.begin();it!=conditions.end();++it)
+		indices.push_back(compiled.Add(it->c_str()));
+
+	unsigned int seed=1;
+	int checks=0, mismatches=0;
+	for (int round=0;round<3000;round++)
+	{
+		// a random subset of the variables. some of them in lower case
+		std::vector<std::wstring> names;
+		for (std::set<std::wstring>::const_iterator it=variables.begin();it!=variables.end();++it)
+		{
+			seed=seed*1103515245+12345;
+			if (!(seed&0x10000)) continue;
+			std::wstring name=*it;
+			if (seed&0x20000)
+			{
+				for (std::wstring::iterator c=name.begin();c!=name.end();++c)
+					*c=towlower(*c);
+			}
+			names.push_back(name);
+		}
+		std::vector<const wchar_t*> values;
+		for (std::vector<std::wstring>::const_iterator it=names.begin();it!=names.end();++it)
+			values.push_back(it->c_str());
+		const wchar_t *const *pValues=values.empty()?NULL:&values[0];
+
+		std::vector<char> results;
+		compiled.Evaluate(pValues,(int)values.size(),results);
+		int index=0;
+		for (std::set<std::wstring>::const_iterator it=conditions.begin();it!=conditions.end();++it,index++)
+		{
+			checks++;
+			int old=EvalConditionOld(it->c_str(),pValues,(int)values.size());
+			if (old!=results[indices[index]])
+			{
+				if (mismatches<10)
+					printf("mismatch for [%ls]: old %d, new %d\n",it->c_str(),old,results[indices[index]]);
+				mismatches++;
+			}
+		}
+	}
+	CHECK(checks>0);
+	CHECK(mismatches==0);
+}
@@ -0,0 +1,278 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "SnapshotPublisher.h"
+#include <stdio.h>
+#include <thread>
+#include <mutex>
+#include <vector>
+
+// a snapshot with a version and a few values that are all equal to the version. counts the live snapshots to find leaks and double deletes
+// the destructor overwrites the values, so a reader that sees a freed snapshot finds values that don't match
+class TestSnapshot: public CPublishedSnapshot
+{
+public:
+	TestSnapshot( int version )
+	{
+		m_Version=version;
+		for (int i=0;i<VALUE_COUNT;i++)
+			m_Values[i]=version;
+		InterlockedIncrement(&s_Count);
+	}
+
+	~TestSnapshot( void )
+	{
+		m_Version=-1;
+		for (int i=0;i<VALUE_COUNT;i++)
+			m_Values[i]=-1;
+		InterlockedDecrement(&s_Count);
+	}
+
+	int GetVersion( void ) const { return m_Version; }
+
+	// returns true if all values match the version
+	bool IsValid( void ) const
+	{
+		if (m_Version<0) return false;
+		for (int i=0;i<VALUE_COUNT;i++)
+			if (m_Values[i]!=m_Version)
+				return false;
+		return true;
+	}
+
+	static volatile LONG s_Count;
+
+private:
+	enum { VALUE_COUNT=16 };
+	int m_Version;
+	int m_Values[VALUE_COUNT];
+};
+
+volatile LONG TestSnapshot::s_Count;
+
+static const TestSnapshot *GetTestSnapshot( const CSnapshotReader &reader )
+{
+	return (const TestSnapshot*)reader.GetSnapshot();
+}
+
+TEST(SnapshotPublisher,Publish)
+{
+	TestSnapshot::s_Count=0;
+	{
+		CSnapshotPublisher publisher;
+		{
+			CSnapshotReader reader(publisher);
+			CHECK(!reader.GetSnapshot());
+		}
+
+		publisher.Publish(new TestSnapshot(publisher.GetNextVersion()));
+		{
+			CSnapshotReader reader(publisher);
+			CHECK(GetTestSnapshot(reader) && GetTestSnapshot(reader)->GetVersion()==1);
+		}
+
+		// the old snapshot is freed right away if there are no readers
+		publisher.Publish(new TestSnapshot(publisher.GetNextVersion()));
+		CHECK(TestSnapshot::s_Count==1);
+
+		{
+			// a reader keeps its snapshot alive after a newer one is published
+			CSnapshotReader reader1(publisher);
+			publisher.Publish(new TestSnapshot(publisher.GetNextVersion()));
+			CSnapshotReader reader2(publisher);
+			publisher.Publish(new TestSnapshot(publisher.GetNextVersion()));
+			CHECK(TestSnapshot::s_Count==3);
+			CHECK(GetTestSnapshot(reader1)->GetVersion()==2 && GetTestSnapshot(reader1)->IsValid());
+			CHECK(GetTestSnapshot(reader2)->GetVersion()==3 && GetTestSnapshot(reader2)->IsValid());
+			{
+				CSnapshotReader reader3(publisher);
+				CHECK(GetTestSnapshot(reader3)->GetVersion()==4);
+			}
+			// the other readers are in the same slot, so nothing is freed yet
+			CHECK(TestSnapshot::s_Count==3);
+			CHECK(GetTestSnapshot(reader1)->IsValid());
+		}
+		// the last reader frees the retired snapshots
+		CHECK(TestSnapshot::s_Count==1);
+
+		// Clear frees the current snapshot
+		publisher.Clear();
+		CHECK(TestSnapshot::s_Count==0);
+		{
+			CSnapshotReader reader(publisher);
+			CHECK(!reader.GetSnapshot());
+		}
+		publisher.Publish(new TestSnapshot(publisher.GetNextVersion()));
+		CHECK(TestSnapshot::s_Count==1);
+	}
+	// the destructor frees everything
+	CHECK(TestSnapshot::s_Count==0);
+}
+
+TEST(SnapshotPublisher,OtherThread)
+{
+	// a reader on another thread keeps the retired snapshots alive, and frees them when it is done
+	TestSnapshot::s_Count=0;
+	CSnapshotPublisher publisher;
+	publisher.Publish(new TestSnapshot(publisher.GetNextVersion()));
+	std::mutex mutex;
+	mutex.lock();
+	volatile LONG version=0;
+	bool bValid=false;
+	std::thread thread([&]()
+	{
+		CSnapshotReader reader(publisher);
+		InterlockedExchange(&version,GetTestSnapshot(reader)->GetVersion());
+		mutex.lock(); // wait for the publisher
+		bValid=GetTestSnapshot(reader)->IsValid();
+		mutex.unlock();
+	});
+	while (ReadAcquire(&version)==0)
+		std::this_thread::yield();
+	// publish a few times while the reader is alive. all retired snapshots are kept while there are readers
+	for (int i=0;i<10;i++)
+		publisher.Publish(new TestSnapshot(publisher.GetNextVersion()));
+	CHECK(TestSnapshot::s_Count==11);
+	mutex.unlock();
+	thread.join();
+	CHECK(version==1 && bValid);
+	CHECK(TestSnapshot::s_Count==1);
+}
+
+// One writer publishes new snapshots while many readers read them. Returns false if a reader saw a freed or older snapshot
+static bool RunStress( int readerCount, int publishCount, int &reads )
+{
+	LONG startCount=TestSnapshot::s_Count;
+	CSnapshotPublisher publisher;
+	publisher.Publish(new TestSnapshot(publisher.GetNextVersion()));
+	volatile LONG done=0, errors=0, totalReads=0;
+	std::vector<std::thread> threads;
+	for (int t=0;t<readerCount;t++)
+	{
+		threads.push_back(std::thread([&publisher,&done,&errors,&totalReads,t]()
+		{
+			int lastVersion=0, count=0;
+			while (!ReadAcquire(&done))
+			{
+				// some readers nest a second reader, which must see the same or a newer snapshot
+				CSnapshotReader reader(publisher);
+				const TestSnapshot *pSnapshot=GetTestSnapshot(reader);
+				if (!pSnapshot->IsValid() || pSnapshot->GetVersion()<lastVersion)
+					InterlockedIncrement(&errors);
+				lastVersion=pSnapshot->GetVersion();
+				if (t%2)
+				{
+					CSnapshotReader reader2(publisher);
+					if (!GetTestSnapshot(reader2)->IsValid() || GetTestSnapshot(reader2)->GetVersion()<lastVersion)
+						InterlockedIncrement(&errors);
+				}
+				if (!pSnapshot->IsValid())
+					InterlockedIncrement(&errors);
+				count++;
+			}
+			InterlockedExchangeAdd(&totalReads,count);
+		}));
+	}
+	for (int i=0;i<publishCount;i++)
+	{
+		publisher.Publish(new TestSnapshot(publisher.GetNextVersion()));
+		if (i%16==0)
+			std::this_thread::yield();
+	}
+	InterlockedExchange(&done,1);
+	for (std::vector<std::thread>::iterator it=threads.begin();it!=threads.end();++it)
+		it->join();
+	reads=totalReads;
+
+	// without readers the next Publish frees all retired snapshots
+	publisher.Publish(new TestSnapshot(publisher.GetNextVersion()));
+	bool bLeaked=TestSnapshot::s_Count!=startCount+1;
+	return errors==0 && !bLeaked;
+}
+
+TEST(SnapshotPublisher,Stress)
+{
+	TestSnapshot::s_Count=0;
+	int reads;
+	CHECK(RunStress(8,5000,reads));
+	CHECK(reads>0);
+	CHECK(TestSnapshot::s_Count==0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+BENCHMARK(SnapshotPublisher,Read)
+{
+	// the cost of one read with a snapshot reader and with a mutex around the current snapshot (like the read lock it replaced), on one thread
+	const int COUNT=2000000;
+	TestSnapshot::s_Count=0;
+	CSnapshotPublisher publisher;
+	publisher.Publish(new TestSnapshot(publisher.GetNextVersion()));
+	int sum=0;
+	double time1=GetBenchmarkTime();
+	for (int i=0;i<COUNT;i++)
+	{
+		CSnapshotReader reader(publisher);
+		sum+=GetTestSnapshot(reader)->GetVersion();
+	}
+	time1=(GetBenchmarkTime()-time1)*1e9/COUNT;
+
+	std::mutex mutex;
+	TestSnapshot snapshot(1);
+	double time2=GetBenchmarkTime();
+	for (int i=0;i<COUNT;i++)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		sum+=snapshot.GetVersion();
+	}
+	time2=(GetBenchmarkTime()-time2)*1e9/COUNT;
+	CHECK(sum==2*COUNT);
+	printf("SnapshotPublisher: one read %.1f ns with a reader, %.1f ns with a mutex\n",time1,time2);
+
+	// 4 readers while the writer publishes new snapshots, and the same with a mutex. the writer replaces the snapshot under the mutex
+	const int PUBLISH_COUNT=20000;
+	int reads;
+	time1=GetBenchmarkTime();
+	CHECK(RunStress(4,PUBLISH_COUNT,reads));
+	time1=GetBenchmarkTime()-time1;
+	printf("SnapshotPublisher: 4 readers and %d publishes with a reader: %d reads in %.0f ms\n",PUBLISH_COUNT,reads,time1*1000);
+
+	TestSnapshot *pCurrent=new TestSnapshot(1);
+	volatile LONG done=0, totalReads=0;
+	std::vector<std::thread> threads;
+	time2=GetBenchmarkTime();
+	for (int t=0;t<4;t++)
+	{
+		threads.push_back(std::thread([&mutex,&pCurrent,&done,&totalReads]()
+		{
+			int count=0;
+			while (!ReadAcquire(&done))
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				CHECK(pCurrent->IsValid());
+				count++;
+			}
+			InterlockedExchangeAdd(&totalReads,count);
+		}));
+	}
+	for (int i=0;i<PUBLISH_COUNT;i++)
+	{
+		TestSnapshot *pNew=new TestSnapshot(i+2);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			std::swap(pCurrent,pNew);
+		}
+		delete pNew;
+		if (i%16==0)
+			std::this_thread::yield();
+	}
+	InterlockedExchange(&done,1);
+	for (std::vector<std::thread>::iterator it=threads.begin();it!=threads.end();++it)
+		it->join();
+	time2=GetBenchmarkTime()-time2;
+	delete pCurrent;
+	printf("SnapshotPublisher: 4 readers and %d publishes with a mutex: %d reads in %.0f ms\n",PUBLISH_COUNT,(int)totalReads,time2*1000);
+}
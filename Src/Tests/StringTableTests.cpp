@@ -0,0 +1,376 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "StringTable.h"
+#include "FNVHash.h"
+#include <stdio.h>
+#include <wctype.h>
+#include <map>
+
+TEST(StringTable,Intern)
+{
+	CStringTable table;
+	CStringTable::Stats stats;
+	table.GetStats(stats);
+	CHECK(stats.count==0 && stats.bytes==0 && stats.hits==0 && stats.savedBytes==0);
+
+	// empty strings are not stored
+	CHECK(table.Intern(CString()).IsEmpty());
+	CHECK(!table.Mark(CString()));
+	table.GetStats(stats);
+	CHECK(stats.count==0);
+
+	CString str1=table.Intern(CString(L"C:\\Windows\\explorer.exe"));
+	CHECK(str1==L"C:\\Windows\\explorer.exe");
+	CString str2=table.Intern(CString(L"C:\\WINDOWS\\EXPLORER.EXE"));
+	CHECK(str2==L"C:\\WINDOWS\\EXPLORER.EXE");
+	// only the first 10 characters
+	CString str3=table.Intern(CString(L"C:\\Windows\\System32",10));
+	CHECK(str3==L"C:\\Windows" && str3.GetLength()==10);
+	table.GetStats(stats);
+	CHECK(stats.count==3);
+	CHECK(stats.bytes==(24+24+11)*2);
+	CHECK(stats.hits==0);
+
+	// the same text is stored once
+	CHECK(table.Intern(CString(L"C:\\Windows\\explorer.exe"))==L"C:\\Windows\\explorer.exe");
+	CHECK(table.Intern(CString(L"C:\\Windows"))==L"C:\\Windows");
+	table.GetStats(stats);
+	CHECK(stats.count==3);
+	CHECK(stats.hits==2);
+	CHECK(stats.savedBytes==(24+11)*2);
+
+	table.Clear();
+	table.GetStats(stats);
+	CHECK(stats.count==0 && stats.bytes==0 && stats.hits==0 && stats.savedBytes==0);
+	CHECK(!table.Mark(CString(L"C:\\Windows")));
+}
+
+TEST(StringTable,Purge)
+{
+	CStringTable table;
+	CStringTable::Stats stats;
+	table.Intern(CString(L"alpha"));
+	table.Intern(CString(L"beta"));
+	table.Intern(CString(L"gamma"));
+
+	// the new strings survive the first purge, even if nobody marked them. they may not be stored in an item yet
+	CHECK(table.Purge()==0);
+	table.GetStats(stats);
+	CHECK(stats.count==3);
+
+	// only the marked strings are kept
+	CHECK(table.Mark(CString(L"alpha")));
+	CHECK(!table.Mark(CString(L"delta")));
+	CHECK(table.Purge()==2);
+	table.GetStats(stats);
+	CHECK(stats.count==1 && stats.bytes==6*2);
+	CHECK(table.Mark(CString(L"alpha")));
+	CHECK(!table.Mark(CString(L"beta")));
+
+	// interning an existing string marks it too
+	table.Purge();
+	table.Intern(CString(L"alpha"));
+	CHECK(table.Purge()==0);
+
+	// a string that is marked in one period and not in the next one is removed
+	CHECK(table.Purge()==1);
+	table.GetStats(stats);
+	CHECK(stats.count==0);
+
+	// a removed string can be added again
+	table.Intern(CString(L"beta"));
+	CHECK(table.Mark(CString(L"beta")));
+	table.GetStats(stats);
+	CHECK(stats.count==1);
+}
+
+TEST(StringTable,PurgeNeeded)
+{
+	CStringTable table;
+	CHECK(!table.IsPurgeNeeded());
+	std::vector<CString> strings;
+	for (int i=0;i<1000;i++)
+	{
+		wchar_t text[20];
+		swprintf(text,_countof(text),L"string %d",i);
+		strings.push_back(CString(text));
+	}
+
+	// a small table is not purged
+	for (int i=0;i<64;i++)
+		table.Intern(strings[i]);
+	CHECK(!table.IsPurgeNeeded());
+	table.Intern(strings[64]);
+	CHECK(table.IsPurgeNeeded());
+	table.Purge();
+	CHECK(!table.IsPurgeNeeded());
+
+	// 400 strings after the purge. the next one is needed after 100+64 more
+	table.Clear();
+	for (int i=0;i<400;i++)
+		table.Intern(strings[i]);
+	CHECK(table.Purge()==0);
+	for (int i=400;i<564;i++)
+		table.Intern(strings[i]);
+	CHECK(!table.IsPurgeNeeded());
+	table.Intern(strings[564]);
+	CHECK(table.IsPurgeNeeded());
+
+	// all strings are still used. interning them again doesn't grow the table
+	for (int i=0;i<400;i++)
+		table.Mark(strings[i]);
+	CHECK(table.Purge()==0);
+	for (int i=0;i<565;i++)
+		table.Intern(strings[i]);
+	CHECK(!table.IsPurgeNeeded());
+
+	// 165 strings are not used any more. the next purge is needed when the 400 used strings grow by a quarter
+	CHECK(table.Purge()==0);
+	for (int i=0;i<400;i++)
+		table.Mark(strings[i]);
+	CHECK(table.Purge()==165);
+	for (int i=565;i<729;i++)
+		table.Intern(strings[i]);
+	CHECK(!table.IsPurgeNeeded());
+	table.Intern(strings[729]);
+	CHECK(table.IsPurgeNeeded());
+
+	table.Clear();
+	CHECK(!table.IsPurgeNeeded());
+}
+
+TEST(StringTable,Collision)
+{
+	// find two strings with the same hash. the hash depends on the size of wchar_t, so they are found at run time
+	CTestRandom random(131);
+	std::map<unsigned int,CString> hashes;
+	CString str1, str2;
+	while (str1.IsEmpty())
+	{
+		wchar_t text[9];
+		for (int i=0;i<8;i++)
+			text[i]=(wchar_t)('a'+random.Next(26));
+		text[8]=0;
+		std::pair<std::map<unsigned int,CString>::iterator,bool> res=hashes.insert(std::pair<unsigned int,CString>(CalcFNVHash(text),CString(text)));
+		if (!res.second && res.first->second!=text)
+		{
+			str1=text;
+			str2=res.first->second;
+		}
+	}
+	CHECK(CalcFNVHash(str1)==CalcFNVHash(str2));
+
+	CStringTable table;
+	CHECK(table.Intern(str1)==(const wchar_t*)str1);
+	CHECK(!table.Mark(str2));
+	CHECK(table.Intern(str2)==(const wchar_t*)str2);
+	CStringTable::Stats stats;
+	table.GetStats(stats);
+	CHECK(stats.count==2 && stats.hits==0);
+	CHECK(table.Intern(str1)==(const wchar_t*)str1);
+	CHECK(table.Intern(str2)==(const wchar_t*)str2);
+
+	// only one of them is used
+	table.Purge();
+	CHECK(table.Mark(str2));
+	CHECK(table.Purge()==1);
+	CHECK(!table.Mark(str1));
+	CHECK(table.Mark(str2));
+}
+
+TEST(StringTable,Random)
+{
+	// random strings from a small set. Purge must keep exactly the strings that were interned or marked since the last purge
+	CTestRandom random(31);
+	CStringTable table;
+	const int COUNT=300;
+	std::vector<CString> strings;
+	for (int i=0;i<COUNT;i++)
+	{
+		wchar_t text[50];
+		swprintf(text,_countof(text),L"C:\\Program Files\\Vendor%d\\App%d.exe",i%17,i);
+		strings.push_back(CString(text));
+	}
+	std::vector<bool> bStored(COUNT,false), bUsed(COUNT,false);
+	for (int pass=0;pass<50;pass++)
+	{
+		for (int i=0;i<200;i++)
+		{
+			int index=random.Next(COUNT);
+			if (random.Next(2))
+			{
+				CHECK(table.Intern(strings[index])==(const wchar_t*)strings[index]);
+				bStored[index]=bUsed[index]=true;
+			}
+			else
+			{
+				CHECK(table.Mark(strings[index])==bStored[index]);
+				if (bStored[index]) bUsed[index]=true;
+			}
+		}
+		int removed=0;
+		for (int i=0;i<COUNT;i++)
+		{
+			if (bStored[i] && !bUsed[i])
+			{
+				bStored[i]=false;
+				removed++;
+			}
+			bUsed[i]=false;
+		}
+		CHECK(table.Purge()==removed);
+		int count=0;
+		for (int i=0;i<COUNT;i++)
+			if (bStored[i]) count++;
+		CStringTable::Stats stats;
+		table.GetStats(stats);
+		CHECK(stats.count==count);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// the strings of one ItemInfo or IconInfo
+struct FakeItemStrings
+{
+	CString PATH, path, appid, iconPath, targetPATH, metroName, packagePath;
+};
+
+static CString FormatString( const wchar_t *format, int param1, int param2=0 )
+{
+	wchar_t text[256];
+	swprintf(text,_countof(text),format,param1,param2,param2);
+	return CString(text);
+}
+
+static CString UpperString( const CString &str )
+{
+	std::wstring text=(const wchar_t*)str;
+	for (size_t i=0;i<text.size();i++)
+		text[i]=towupper(text[i]);
+	return CString(text.c_str());
+}
+
+// Creates the strings of a cache with 10000 items:
+// 1000 desktop applications with 3 links each (Start menu, desktop, taskbar). the links have the target, the appid and the icon path of the application
+// 1000 executables of these applications. the PATH is the same as the target of the links
+// 5500 documents in 100 folders. the icon paths are the 10 programs that open them
+// 500 Metro apps with appids, names, package paths and logo paths
+// 2020 icons - small and large for each application and each document program
+static void CreateFakeCache( std::vector<FakeItemStrings> &items )
+{
+	for (int app=0;app<1000;app++)
+	{
+		CString exe=FormatString(L"C:\\Program Files\\Vendor %d\\Application %d\\App%d.exe",app/4,app);
+		CString EXE=UpperString(exe);
+		static const wchar_t *linkFolders[]={
+			L"C:\\ProgramData\\Microsoft\\Windows\\Start Menu\\Programs\\Vendor %d\\Application %d.lnk",
+			L"C:\\Users\\User\\Desktop\\Application %d %d.lnk",
+			L"C:\\Users\\User\\AppData\\Roaming\\Microsoft\\Internet Explorer\\Quick Launch\\User Pinned\\TaskBar\\Application %d %d.lnk",
+		};
+		for (int i=0;i<3;i++)
+		{
+			FakeItemStrings item;
+			item.path=FormatString(linkFolders[i],app/4,app);
+			item.PATH=UpperString(item.path);
+			item.targetPATH=EXE;
+			item.appid=FormatString(L"Vendor%d.Application%d",app/4,app);
+			item.iconPath=exe;
+			items.push_back(item);
+		}
+		FakeItemStrings item;
+		item.path=exe;
+		item.PATH=EXE;
+		item.iconPath=exe;
+		items.push_back(item);
+		for (int i=0;i<2;i++)
+		{
+			FakeItemStrings icon;
+			icon.PATH=EXE;
+			items.push_back(icon);
+		}
+	}
+	for (int doc=0;doc<5500;doc++)
+	{
+		FakeItemStrings item;
+		item.path=FormatString(L"C:\\Users\\User\\Documents\\Project %d\\Document %d.docx",doc%100,doc);
+		item.PATH=UpperString(item.path);
+		item.iconPath=FormatString(L"C:\\Program Files\\Office\\Program%d.exe",doc%10);
+		items.push_back(item);
+	}
+	for (int i=0;i<10;i++)
+	{
+		for (int j=0;j<2;j++)
+		{
+			FakeItemStrings icon;
+			icon.PATH=UpperString(FormatString(L"C:\\Program Files\\Office\\Program%d.exe",i));
+			items.push_back(icon);
+		}
+	}
+	for (int app=0;app<500;app++)
+	{
+		FakeItemStrings item;
+		item.appid=FormatString(L"Microsoft.Application%d_8wekyb3d8bbwe!App",app);
+		item.PATH=UpperString(item.appid);
+		item.metroName=FormatString(L"Application %d",app);
+		item.packagePath=FormatString(L"C:\\Program Files\\WindowsApps\\Microsoft.Application%d_1.0.%d.0_x64__8wekyb3d8bbwe",app,app%7);
+		item.iconPath=item.packagePath;
+		item.iconPath+=L"\\Assets\\Square44x44Logo.png";
+		items.push_back(item);
+	}
+}
+
+BENCHMARK(StringTable,WorkingSet)
+{
+	// the memory used by the item strings of a 10000 item cache, with and without the pool
+	std::vector<FakeItemStrings> items;
+	CreateFakeCache(items);
+	CStringTable table;
+	int buffers=0, bytes=0;
+	double time=GetBenchmarkTime();
+	for (std::vector<FakeItemStrings>::iterator it=items.begin();it!=items.end();++it)
+	{
+		CString *strings[]={&it->PATH,&it->path,&it->appid,&it->iconPath,&it->targetPATH,&it->metroName,&it->packagePath};
+		for (int i=0;i<_countof(strings);i++)
+		{
+			if (strings[i]->IsEmpty()) continue;
+			buffers++;
+			bytes+=(strings[i]->GetLength()+1)*2;
+			*strings[i]=table.Intern(*strings[i]);
+		}
+	}
+	double internTime=GetBenchmarkTime()-time;
+
+	// the Mark and Purge in CItemManager::ResetTempIcons
+	const int PURGES=20;
+	time=GetBenchmarkTime();
+	for (int pass=0;pass<PURGES;pass++)
+	{
+		for (std::vector<FakeItemStrings>::const_iterator it=items.begin();it!=items.end();++it)
+		{
+			table.Mark(it->PATH);
+			table.Mark(it->path);
+			table.Mark(it->appid);
+			table.Mark(it->iconPath);
+			table.Mark(it->targetPATH);
+			table.Mark(it->metroName);
+			table.Mark(it->packagePath);
+		}
+		table.Purge();
+	}
+	double purgeTime=(GetBenchmarkTime()-time)/PURGES;
+
+	CStringTable::Stats stats;
+	table.GetStats(stats);
+	CHECK(stats.bytes+stats.savedBytes==bytes);
+	// each CString buffer also has a header (CStringData, 24 bytes on x64) and a heap block header (about 16 bytes)
+	const int OVERHEAD=40;
+	int before=bytes+buffers*OVERHEAD, after=stats.bytes+stats.count*OVERHEAD;
+	printf("StringTable: %d items and icons, %d strings, %d distinct\n",(int)items.size(),buffers,stats.count);
+	printf("StringTable: text %d KB -> %d KB, with the buffer headers %d KB -> %d KB (%.0f%% less)\n",bytes/1024,stats.bytes/1024,before/1024,after/1024,100.0*(before-after)/before);
+	printf("StringTable: Intern %.1f ms for all strings, Mark+Purge %.1f ms\n",internTime*1000,purgeTime*1000);
+}
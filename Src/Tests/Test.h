@@ -0,0 +1,54 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Test.h - a minimal test harness for the classes that don't depend on the OS
+// TEST(group,name) defines a test and registers it. CHECK reports a failed condition and continues with the test.
+// BENCHMARK(group,name) defines a benchmark in the group "<group>Benchmark". The benchmarks run only when their group is given on the command line.
+// The test program runs the groups given on the command line, or all test groups if none are given
+
+typedef void (*TTestFunc)( void );
+
+struct CTestRegistrar
+{
+	CTestRegistrar( const char *group, const char *name, TTestFunc func, bool bBenchmark=false );
+};
+
+void ReportFailure( const char *exp, const char *file, int line );
+
+// the SkinDescription.txt files of the skins in the Skins folder
+const std::vector<std::string> &GetSkinFiles( void );
+// reads a UTF-8 text file and adds a terminating 0
+bool ReadTextFile( const char *fname, std::vector<wchar_t> &text );
+// the time in seconds, for measuring the benchmarks
+double GetBenchmarkTime( void );
+
+// a repeatable sequence of random numbers for the tests
+class CTestRandom
+{
+public:
+	CTestRandom( unsigned int seed=1 ) { m_State=seed; }
+	unsigned int Next( void ) { m_State^=m_State<<13; m_State^=m_State>>17; m_State^=m_State<<5; return m_State; }
+	// a number from 0 to range-1
+	int Next( int range ) { return (int)(Next()%(unsigned int)range); }
+
+private:
+	unsigned int m_State;
+};
+
+#define TEST(group,name) \
+	static void Test_##group##_##name( void ); \
+	static CTestRegistrar g_Test_##group##_##name(#group,#name,Test_##group##_##name); \
+	static void Test_##group##_##name( void )
+
+#define BENCHMARK(group,name) \
+	static void Benchmark_##group##_##name( void ); \
+	static CTestRegistrar g_Benchmark_##group##_##name(#group "Benchmark",#name,Benchmark_##group##_##name,true); \
+	static void Benchmark_##group##_##name( void )
+
+#define CHECK(exp) do { if (!(exp)) ReportFailure(#exp,__FILE__,__LINE__); } while (0)
@@ -0,0 +1,135 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "SkinFiles.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <locale.h>
+#include <chrono>
+
+struct TestInfo
+{
+	const char *group;
+	const char *name;
+	TTestFunc func;
+	bool bBenchmark;
+};
+
+static std::vector<TestInfo> &GetTests( void )
+{
+	static std::vector<TestInfo> tests; // not a global, so it is constructed before the first registrar uses it
+	return tests;
+}
+
+static int g_Failures;
+
+CTestRegistrar::CTestRegistrar( const char *group, const char *name, TTestFunc func, bool bBenchmark )
+{
+	TestInfo info={group,name,func,bBenchmark};
+	GetTests().push_back(info);
+}
+
+void ReportFailure( const char *exp, const char *file, int line )
+{
+	printf("%s(%d): CHECK(%s) failed\n",file,line,exp);
+	g_Failures++;
+}
+
+const std::vector<std::string> &GetSkinFiles( void )
+{
+	static std::vector<std::string> files(g_SkinFiles,g_SkinFiles+sizeof(g_SkinFiles)/sizeof(g_SkinFiles[0]));
+	return files;
+}
+
+bool ReadTextFile( const char *fname, std::vector<wchar_t> &text )
+{
+	FILE *f=fopen(fname,"rb");
+	if (!f) return false;
+	std::string data;
+	char buf[4096];
+	size_t size;
+	while ((size=fread(buf,1,sizeof(buf),f))>0)
+		data.append(buf,size);
+	fclose(f);
+	size_t start=(data.compare(0,3,"\xEF\xBB\xBF")==0)?3:0;
+	size_t len=mbstowcs(NULL,data.c_str()+start,0);
+	if (len==(size_t)-1) return false;
+	text.resize(len+1);
+	mbstowcs(&text[0],data.c_str()+start,len+1);
+	return true;
+}
+
+double GetBenchmarkTime( void )
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+DWORD GetCurrentThreadId( void )
+{
+	static volatile LONG s_LastId;
+	static thread_local DWORD s_Id;
+	if (!s_Id)
+		s_Id=(DWORD)InterlockedIncrement(&s_LastId)*4;
+	return s_Id;
+}
+
+int MultiByteToWideChar( unsigned int codePage, DWORD flags, const char *src, int size, wchar_t *dst, int dstSize )
+{
+	Assert(codePage==CP_UTF8 && flags==0);
+	const unsigned char *p=(const unsigned char*)src, *end=p+size;
+	int len=0;
+	while (p<end)
+	{
+		unsigned int c=*p++;
+		int extra=0;
+		unsigned int minChar=0;
+		if (c>=0xC2 && c<0xE0) { extra=1; c&=0x1F; minChar=0x80; }
+		else if (c>=0xE0 && c<0xF0) { extra=2; c&=0x0F; minChar=0x800; }
+		else if (c>=0xF0 && c<0xF5) { extra=3; c&=0x07; minChar=0x10000; }
+		else if (c>=0x80) c=0xFFFD;
+		for (;extra>0 && p<end && (*p&0xC0)==0x80;extra--)
+			c=(c<<6)|(*p++&0x3F);
+		if (extra>0 || c<minChar || c>0x10FFFF || (c>=0xD800 && c<0xE000))
+			c=0xFFFD;
+		int count=c>=0x10000?2:1;
+		if (len+count>dstSize) return 0;
+		if (count==2)
+		{
+			dst[len++]=(wchar_t)(0xD800+((c-0x10000)>>10));
+			dst[len++]=(wchar_t)(0xDC00+((c-0x10000)&0x3FF));
+		}
+		else
+			dst[len++]=(wchar_t)c;
+	}
+	return len;
+}
+
+int main( int argc, char **argv )
+{
+	setlocale(LC_ALL,"C.UTF-8");
+	int count=0, failed=0;
+	const std::vector<TestInfo> &tests=GetTests();
+	for (std::vector<TestInfo>::const_iterator it=tests.begin();it!=tests.end();++it)
+	{
+		bool bRun=(argc<2 && !it->bBenchmark);
+		for (int i=1;i<argc;i++)
+		{
+			if (strcmp(argv[i],it->group)==0)
+				bRun=true;
+		}
+		if (!bRun) continue;
+		int failures=g_Failures;
+		it->func();
+		count++;
+		if (g_Failures!=failures)
+		{
+			printf("FAILED: %s.%s\n",it->group,it->name);
+			failed++;
+		}
+	}
+	printf("%d tests, %d failed\n",count,failed);
+	return (failed>0 || count==0)?1:0;
+}
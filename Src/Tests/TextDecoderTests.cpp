@@ -0,0 +1,62 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "TextDecoder.h"
+
+// Decodes the first size bytes of data. The bytes are copied to a buffer of the exact size, so reading past the end can be detected by the sanitizers
+static std::wstring Decode( const char *data, int size )
+{
+	std::vector<unsigned char> buf(data,data+size);
+	std::vector<wchar_t> text;
+	DecodeText(size?&buf[0]:NULL,size,text);
+	if (text.empty() || text.back()!=0) return L"<not terminated>";
+	return std::wstring(&text[0],text.size()-1);
+}
+
+TEST(TextDecoder,UTF16)
+{
+	CHECK(Decode("\xFF\xFE" "a\0b\0",6)==L"ab");
+	CHECK(Decode("\xFF\xFE" "\xE9\0\x3B\x04",6)==L"\xE9\x43B");
+	CHECK(Decode("\xFF\xFE",2)==L"");
+	// a stray byte at the end is ignored
+	CHECK(Decode("\xFF\xFE" "a\0b",5)==L"a");
+	CHECK(Decode("\xFF\xFE" "a",3)==L"");
+	// the text is not split into lines here
+	CHECK(Decode("\xFF\xFE" "a\0\r\0\n\0",8)==L"a\r\n");
+}
+
+TEST(TextDecoder,UTF8)
+{
+	// with a BOM
+	CHECK(Decode("\xEF\xBB\xBF" "abc",6)==L"abc");
+	CHECK(Decode("\xEF\xBB\xBF" "\xC3\xA9\xD0\xBB",7)==L"\xE9\x43B");
+	CHECK(Decode("\xEF\xBB\xBF",3)==L"");
+	// without a BOM the text is UTF-8 too (not the ANSI code page)
+	CHECK(Decode("abc",3)==L"abc");
+	CHECK(Decode("\xC3\xA9t\xC3\xA9",5)==L"\xE9t\xE9");
+	CHECK(Decode("",0)==L"");
+	// a character outside of the BMP needs 2 UTF-16 characters for 4 bytes
+	std::wstring text=Decode("\xF0\x9F\x98\x80!",5);
+	CHECK(text.size()==3 && text[0]==0xD83D && text[1]==0xDE00 && text[2]=='!');
+	// the whole buffer is converted, even if it is all multi-byte characters
+	std::string big;
+	for (int i=0;i<10000;i++)
+		big+="\xE2\x82\xAC";
+	CHECK(Decode(big.c_str(),(int)big.size())==std::wstring(10000,0x20AC));
+}
+
+TEST(TextDecoder,Short)
+{
+	// the BOM is only detected if it fits in the buffer. the partial BOM is decoded as invalid UTF-8
+	CHECK(Decode("\xFF\xFE",1).size()==1);
+	CHECK(!Decode("\xEF\xBB\xBF",2).empty());
+	CHECK(!Decode("\xEF\xBB\xBF",1).empty());
+	CHECK(Decode("a\xFE",1)==L"a");
+	CHECK(Decode("ab",2)==L"ab");
+	// a BOM with nothing after it
+	CHECK(Decode("\xEF\xBB\xBF" "a",3)==L"");
+	CHECK(Decode("\xFF\xFE" "a",2)==L"");
+}
@@ -0,0 +1,81 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "ThreadCounters.h"
+#include <thread>
+#include <vector>
+
+// the counters of CItemManager - 5 counters, the main and preload threads and 4 refresh threads
+typedef CThreadCounters<5,6> TTestCounters;
+
+TEST(ThreadCounters,Sum)
+{
+	TTestCounters counters;
+	int sum[5];
+	counters.Sum(sum);
+	for (int c=0;c<5;c++)
+		CHECK(sum[c]==0);
+
+	counters.Add(0,0,1);
+	counters.Add(1,0,2);
+	counters.Add(5,0,4);
+	counters.Add(-1,0,8);
+	counters.Add(2,3,100);
+	counters.Add(-1,4,-3);
+	counters.Add(-1,4,10);
+	counters.Add(3,1,0);
+	counters.Sum(sum);
+	CHECK(sum[0]==15);
+	CHECK(sum[1]==0);
+	CHECK(sum[2]==0);
+	CHECK(sum[3]==100);
+	CHECK(sum[4]==7);
+
+	// Sum overwrites the output
+	counters.Sum(sum);
+	CHECK(sum[0]==15);
+
+	counters.Clear();
+	counters.Sum(sum);
+	for (int c=0;c<5;c++)
+		CHECK(sum[c]==0);
+
+	// each slot is in its own cache line
+	CHECK(sizeof(TTestCounters)==7*64);
+	CHECK(sizeof(CThreadCounters<20,1>)==2*128);
+}
+
+TEST(ThreadCounters,Threads)
+{
+	// each thread with a slot adds to its own slot, and more threads without a slot add to the shared one at the same time
+	const int SLOTS=6, SHARED=4, COUNT=200000;
+	TTestCounters counters;
+	std::vector<std::thread> threads;
+	for (int t=0;t<SLOTS+SHARED;t++)
+	{
+		threads.push_back(std::thread([&counters,t]()
+		{
+			int slot=t<SLOTS?t:-1;
+			for (int i=0;i<COUNT;i++)
+			{
+				counters.Add(slot,i%5,1);
+				if (i%100==0)
+					counters.Add(slot,4,t);
+			}
+		}));
+	}
+	for (std::vector<std::thread>::iterator it=threads.begin();it!=threads.end();++it)
+		it->join();
+
+	int sum[5];
+	counters.Sum(sum);
+	int extra=0;
+	for (int t=0;t<SLOTS+SHARED;t++)
+		extra+=t*(COUNT/100);
+	for (int c=0;c<4;c++)
+		CHECK(sum[c]==(SLOTS+SHARED)*COUNT/5);
+	CHECK(sum[4]==(SLOTS+SHARED)*COUNT/5+extra);
+}
@@ -0,0 +1,220 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "UserAssistTable.h"
+#include "FNVHash.h"
+#include <map>
+#include <set>
+
+// known folders in the order of g_KnownPrefixes, as SHGetKnownFolderPath returns them. some of them are inside the others
+static const wchar_t *g_TestFolders[][2]=
+{
+	{L"C:\\Windows\\SysWOW64",L"{D65231B0-B2F1-4857-A4CE-A8E7C6EA7D27}"},
+	{L"C:\\Windows\\system32",L"{1AC14E77-02E7-4E5D-B744-2EB1AE5198B7}"},
+	{L"C:\\Windows",L"{F38BF404-1D43-42F2-9305-67DE0B28FC23}"},
+	{L"C:\\Program Files (x86)",L"{7C5A40EF-A0FB-4BFC-874A-C0F2E0B9FA8E}"},
+	{L"C:\\Program Files",L"{6D809377-6AF0-444B-8957-A3773F02200E}"},
+	{L"C:\\Users\\Test\\AppData\\Roaming\\Microsoft\\Windows\\Start Menu\\Programs",L"{A77F5D77-2E2B-44C3-A6A2-ABA601054A51}"},
+	{L"C:\\ProgramData\\Microsoft\\Windows\\Start Menu\\Programs",L"{0139D44E-6AFE-49F2-8690-3DAFCAE6FFB8}"},
+	{L"C:\\Users\\Test\\AppData\\Roaming\\Microsoft\\Windows\\Start Menu",L"{625B53C3-AB48-4EC1-BA1F-A1EF4146FC19}"},
+	{L"C:\\ProgramData\\Microsoft\\Windows\\Start Menu",L"{A4115719-D62E-491D-AA7C-E74B8BE3B067}"},
+};
+
+// The registry name for a path, like MetroLinkManager creates it with EncodeUserAssistPath and EncodeRot13
+static void EncodeName( const wchar_t *path, wchar_t *name )
+{
+	Strcpy(name,_MAX_PATH,path);
+	for (int i=0;i<_countof(g_TestFolders);i++)
+	{
+		if (ReplaceKnownFolder(name,_MAX_PATH,g_TestFolders[i][0],g_TestFolders[i][1]))
+			break;
+	}
+	EncodeRot13(name);
+}
+
+static void AddTestFolders( CUserAssistTable &table )
+{
+	for (int i=0;i<_countof(g_TestFolders);i++)
+	{
+		wchar_t PATH[_MAX_PATH];
+		Strcpy(PATH,_countof(PATH),g_TestFolders[i][0]);
+		CharUpper(PATH);
+		table.AddKnownFolder(PATH,g_TestFolders[i][1]);
+	}
+}
+
+static UserAssistData MakeData( int count )
+{
+	UserAssistData data;
+	memset(&data,0,sizeof(data));
+	data.count=count;
+	data.timestamp.dwLowDateTime=count*7;
+	return data;
+}
+
+TEST(UserAssistTable,Rot13)
+{
+	wchar_t text[]=L"{F38BF404}\\Notepad.EXE Zz 09_\x00E9\x0410";
+	EncodeRot13(text);
+	CHECK(wcscmp(text,L"{S38OS404}\\Abgrcnq.RKR Mm 09_\x00E9\x0410")==0);
+	// ROT13 is its own inverse
+	EncodeRot13(text);
+	CHECK(wcscmp(text,L"{F38BF404}\\Notepad.EXE Zz 09_\x00E9\x0410")==0);
+
+	// all letters change, nothing else does
+	for (wchar_t c=1;c<0x500;c++)
+	{
+		wchar_t str[2]={c,0};
+		EncodeRot13(str);
+		bool bLetter=(c>='a' && c<='z') || (c>='A' && c<='Z');
+		CHECK(bLetter?str[0]!=c:str[0]==c);
+		EncodeRot13(str);
+		CHECK(str[0]==c);
+	}
+}
+
+TEST(UserAssistTable,ReplaceKnownFolder)
+{
+	const wchar_t *GUID=L"{F38BF404-1D43-42F2-9305-67DE0B28FC23}";
+	wchar_t path[_MAX_PATH];
+	Strcpy(path,_countof(path),L"c:\\WINDOWS\\notepad.exe");
+	CHECK(ReplaceKnownFolder(path,_countof(path),L"C:\\Windows",GUID));
+	CHECK(wcscmp(path,L"{F38BF404-1D43-42F2-9305-67DE0B28FC23}\\notepad.exe")==0);
+
+	// the folder itself
+	Strcpy(path,_countof(path),L"C:\\Windows");
+	CHECK(ReplaceKnownFolder(path,_countof(path),L"C:\\Windows",GUID));
+	CHECK(wcscmp(path,GUID)==0);
+
+	// not in the folder. the path doesn't change
+	Strcpy(path,_countof(path),L"C:\\Win\\notepad.exe");
+	CHECK(!ReplaceKnownFolder(path,_countof(path),L"C:\\Windows",GUID));
+	CHECK(wcscmp(path,L"C:\\Win\\notepad.exe")==0);
+	CHECK(!ReplaceKnownFolder(path,_countof(path),L"",GUID));
+	CHECK(wcscmp(path,L"C:\\Win\\notepad.exe")==0);
+
+	// the result is truncated to the size
+	wchar_t small[20];
+	Strcpy(small,_countof(small),L"C:\\Windows\\a.exe");
+	CHECK(ReplaceKnownFolder(small,_countof(small),L"C:\\Windows",GUID));
+	CHECK(wcscmp(small,L"{F38BF404-1D43-42F2")==0);
+}
+
+TEST(UserAssistTable,Find)
+{
+	CUserAssistTable table;
+	AddTestFolders(table);
+	CHECK(table.GetCount()==0);
+	CHECK(!table.FindPath(L"C:\\WINDOWS\\NOTEPAD.EXE"));
+
+	// the registry names are not case-sensitive
+	wchar_t name[_MAX_PATH];
+	EncodeName(L"c:\\windows\\Notepad.exe",name);
+	table.Add(name,MakeData(1));
+	EncodeName(L"Microsoft.Windows.Explorer",name);
+	table.Add(name,MakeData(2));
+	EncodeName(L"C:\\Windows\\System32\\cmd.exe",name);
+	table.Add(name,MakeData(3));
+	CHECK(table.GetCount()==3);
+
+	const UserAssistData *pData=table.FindPath(L"C:\\WINDOWS\\NOTEPAD.EXE");
+	CHECK(pData && pData->count==1 && pData->timestamp.dwLowDateTime==7);
+	pData=table.FindPath(L"MICROSOFT.WINDOWS.EXPLORER");
+	CHECK(pData && pData->count==2);
+	pData=table.FindPath(L"C:\\WINDOWS\\SYSTEM32\\CMD.EXE");
+	CHECK(pData && pData->count==3);
+	pData=table.Find(L"{1AC14E77-02E7-4E5D-B744-2EB1AE5198B7}\\CMD.EXE");
+	CHECK(pData && pData->count==3);
+
+	// the System32 folder is checked before Windows
+	CHECK(!table.Find(L"{F38BF404-1D43-42F2-9305-67DE0B28FC23}\\SYSTEM32\\CMD.EXE"));
+	CHECK(!table.FindPath(L"C:\\WINDOWS\\NOTEPAD.EX"));
+	CHECK(!table.FindPath(L"D:\\WINDOWS\\NOTEPAD.EXE"));
+
+	table.Clear();
+	CHECK(table.GetCount()==0);
+	CHECK(!table.FindPath(L"C:\\WINDOWS\\NOTEPAD.EXE"));
+	// without the known folders the path is used as it is
+	table.Add(name,MakeData(3));
+	CHECK(!table.FindPath(L"C:\\WINDOWS\\SYSTEM32\\CMD.EXE"));
+	CHECK(table.Find(L"{1AC14E77-02E7-4E5D-B744-2EB1AE5198B7}\\CMD.EXE"));
+}
+
+TEST(UserAssistTable,Collision)
+{
+	// find two names with the same hash. the hash depends on the size of wchar_t, so they are found at run time
+	CTestRandom random(134);
+	std::map<unsigned int,std::wstring> hashes;
+	std::wstring NAME1, NAME2;
+	while (NAME1.empty())
+	{
+		wchar_t text[9];
+		for (int i=0;i<8;i++)
+			text[i]=(wchar_t)('A'+random.Next(26));
+		text[8]=0;
+		std::pair<std::map<unsigned int,std::wstring>::iterator,bool> res=hashes.insert(std::pair<unsigned int,std::wstring>(CalcFNVHash(text),text));
+		if (!res.second && res.first->second!=text)
+		{
+			NAME1=text;
+			NAME2=res.first->second;
+		}
+	}
+
+	CUserAssistTable table;
+	wchar_t name[_MAX_PATH];
+	EncodeName(NAME1.c_str(),name);
+	table.Add(name,MakeData(1));
+	CHECK(!table.FindPath(NAME2.c_str()));
+	EncodeName(NAME2.c_str(),name);
+	table.Add(name,MakeData(2));
+	const UserAssistData *pData1=table.FindPath(NAME1.c_str()), *pData2=table.FindPath(NAME2.c_str());
+	CHECK(pData1 && pData1->count==1);
+	CHECK(pData2 && pData2->count==2);
+}
+
+TEST(UserAssistTable,Random)
+{
+	// random paths with the names encoded the way the registry stores them. the table must find each one from its upper case path
+	static const wchar_t *roots[]={L"D:\\Games",L"Microsoft.",L"\\\\server\\share",L"C:\\Win"};
+	static const wchar_t chars[]=L"abcXYZmnop019 _.-\\{}()\x00E9";
+	CTestRandom random(34);
+	CUserAssistTable table;
+	AddTestFolders(table);
+	std::vector<std::wstring> paths;
+	std::set<std::wstring> names;
+	for (int i=0;i<5000;i++)
+	{
+		int root=random.Next(_countof(g_TestFolders)+_countof(roots));
+		std::wstring path=root<_countof(g_TestFolders)?g_TestFolders[root][0]:roots[root-_countof(g_TestFolders)];
+		// sometimes the next character is not a backslash, like in C:\WindowsApps
+		if (random.Next(4)>0)
+			path+=L'\\';
+		int len=random.Next(30);
+		for (int j=0;j<len;j++)
+			path+=chars[random.Next(_countof(chars)-1)];
+
+		wchar_t PATH[_MAX_PATH];
+		Strcpy(PATH,_countof(PATH),path.c_str());
+		CharUpper(PATH);
+		if (!names.insert(PATH).second)
+			continue;
+		paths.push_back(PATH);
+		wchar_t name[_MAX_PATH];
+		EncodeName(path.c_str(),name);
+		table.Add(name,MakeData((int)paths.size()-1));
+	}
+	CHECK(table.GetCount()==(int)paths.size());
+
+	for (int i=0;i<(int)paths.size();i++)
+	{
+		const UserAssistData *pData=table.FindPath(paths[i].c_str());
+		CHECK(pData && pData->count==i);
+		// a path that was not added
+		std::wstring path=paths[i]+L"X";
+		if (names.find(path)==names.end())
+			CHECK(!table.FindPath(path.c_str()));
+	}
+}
@@ -0,0 +1,163 @@
+// Classic Shell (c) 2009-2017, Ivo Beltchev
+// Open-Shell (c) 2017-2018, The Open-Shell Team
+// Confidential information of Ivo Beltchev. Not for disclosure or distribution without prior written consent from the author
+
+#include <stdafx.h>
+#include "Test.h"
+#include "XmlStream.h"
+
+static bool LoadXml( CXmlReader &reader, const char *text )
+{
+	return reader.Load((const unsigned char*)text,(int)strlen(text));
+}
+
+// Reads the next node and checks that it is an element with the given name
+static bool ReadElement( CXmlReader &reader, const wchar_t *name )
+{
+	return reader.Read()==CXmlReader::NODE_ELEMENT && wcscmp(reader.GetName(),name)==0;
+}
+
+static bool ReadEndElement( CXmlReader &reader, const wchar_t *name )
+{
+	return reader.Read()==CXmlReader::NODE_END_ELEMENT && wcscmp(reader.GetName(),name)==0;
+}
+
+static bool ReadText( CXmlReader &reader, const wchar_t *text )
+{
+	return reader.Read()==CXmlReader::NODE_TEXT && reader.GetTextLength()==(int)wcslen(text) && wcscmp(reader.GetText(),text)==0;
+}
+
+// Checks that reading the document fails
+static bool IsInvalid( const char *text )
+{
+	CXmlReader reader;
+	if (!LoadXml(reader,text))
+		return true;
+	while (1)
+	{
+		CXmlReader::TNode node=reader.Read();
+		if (node==CXmlReader::NODE_EOF)
+			return false;
+		if (node==CXmlReader::NODE_ERROR)
+			return *reader.GetError()!=0;
+	}
+}
+
+TEST(XmlStream,Read)
+{
+	CXmlReader reader;
+	CHECK(LoadXml(reader,"<?xml version=\"1.0\"?>\r\n<!-- comment --><Settings component=\"Menu\">\r\n\t<A value='a&amp;b&#10;c\td'/>\r\n<B><Line>x&lt;y&#x41;</Line><Line><![CDATA[<q>\r\n]]></Line></B></Settings>\r\n"));
+	CHECK(ReadElement(reader,L"Settings"));
+	CHECK(wcscmp(reader.GetAttribute(L"component"),L"Menu")==0);
+	CHECK(reader.GetAttribute(L"value")==NULL);
+	CHECK(reader.GetDepth()==1);
+	CHECK(reader.Read()==CXmlReader::NODE_TEXT && reader.IsWhiteSpace());
+	CHECK(ReadElement(reader,L"A"));
+	// the white space in attributes is normalized, the references are kept
+	CHECK(wcscmp(reader.GetAttribute(L"value"),L"a&b\nc d")==0);
+	CHECK(reader.GetDepth()==2);
+	CHECK(ReadEndElement(reader,L"A"));
+	CHECK(reader.GetDepth()==1);
+	CHECK(ReadText(reader,L"\n"));
+	CHECK(ReadElement(reader,L"B"));
+	CHECK(ReadElement(reader,L"Line"));
+	CHECK(ReadText(reader,L"x<yA"));
+	CHECK(!reader.IsWhiteSpace());
+	CHECK(ReadEndElement(reader,L"Line"));
+	CHECK(ReadElement(reader,L"Line"));
+	CHECK(ReadText(reader,L"<q>\n"));
+	CHECK(ReadEndElement(reader,L"Line"));
+	CHECK(ReadEndElement(reader,L"B"));
+	CHECK(ReadEndElement(reader,L"Settings"));
+	CHECK(reader.GetDepth()==0);
+	CHECK(reader.Read()==CXmlReader::NODE_EOF);
+	CHECK(reader.Read()==CXmlReader::NODE_EOF);
+}
+
+TEST(XmlStream,Encodings)
+{
+	CXmlReader reader;
+	CHECK(LoadXml(reader,"\xEF\xBB\xBF<a>\xC3\xA9\xE2\x82\xAC</a>"));
+	CHECK(ReadElement(reader,L"a"));
+	CHECK(ReadText(reader,L"\x00E9\x20AC"));
+
+	CHECK(LoadXml(reader,"<?xml version=\"1.0\" encoding=\"windows-1252\"?><a>\x80\xE9</a>"));
+	CHECK(ReadElement(reader,L"a"));
+	CHECK(ReadText(reader,L"\x20AC\x00E9"));
+
+	CHECK(LoadXml(reader,"<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?><a>\x80\xE9</a>"));
+	CHECK(ReadElement(reader,L"a"));
+	CHECK(ReadText(reader,L"\x0080\x00E9"));
+
+	const unsigned char utf16[]={0xFF,0xFE,'<',0,'a',0,'>',0,0xAC,0x20,'<',0,'/',0,'a',0,'>',0};
+	CHECK(reader.Load(utf16,sizeof(utf16)));
+	CHECK(ReadElement(reader,L"a"));
+	CHECK(ReadText(reader,L"\x20AC"));
+
+	CHECK(!LoadXml(reader,"<?xml version=\"1.0\" encoding=\"shift_jis\"?><a/>"));
+	CHECK(!LoadXml(reader,"<a>\xFF</a>"));
+	CHECK(!LoadXml(reader,"<a>\xC0\x80</a>")); // overlong
+}
+
+TEST(XmlStream,Errors)
+{
+	CHECK(IsInvalid(""));
+	CHECK(IsInvalid("<a>"));
+	CHECK(IsInvalid("<a><b></a>"));
+	CHECK(IsInvalid("<a/><b/>"));
+	CHECK(IsInvalid("text<a/>"));
+	CHECK(IsInvalid("<a x='1' x='2'/>"));
+	CHECK(IsInvalid("<a x=1/>"));
+	CHECK(IsInvalid("<a x='<'/>"));
+	CHECK(IsInvalid("<a>&foo;</a>"));
+	CHECK(IsInvalid("<a>&#0;</a>"));
+	CHECK(IsInvalid("<a>&#x110000;</a>"));
+	CHECK(IsInvalid("<a><![CDATA[x</a>"));
+	CHECK(IsInvalid("<a><!-- x</a>"));
+	CHECK(!IsInvalid("<!DOCTYPE a [<!ENTITY x \"]>\">]><a/>"));
+
+	// the error includes the position
+	CXmlReader reader;
+	CHECK(LoadXml(reader,"<a>\n<b></c></a>"));
+	while (reader.Read()!=CXmlReader::NODE_ERROR)
+		;
+	CHECK(wcsstr(reader.GetError(),L"Line 2, position 8.")!=NULL);
+	CHECK(reader.Read()==CXmlReader::NODE_ERROR);
+}
+
+TEST(XmlStream,RoundTrip)
+{
+	const wchar_t *value=L"a\"<&>'\t\n\r\x00E9\U0001F600 end";
+	const wchar_t *text=L"x&<>\t\n]]>\x0001\x20AC";
+	CXmlWriter writer;
+	writer.WriteDeclaration();
+	writer.StartElement(L"Settings");
+	writer.WriteAttribute(L"component",L"Menu");
+	writer.StartElement(L"Empty");
+	writer.EndElement();
+	writer.StartElement(L"Value");
+	writer.WriteAttribute(L"value",value);
+	writer.WriteText(text);
+	writer.EndElement();
+	writer.EndElement();
+
+	const std::vector<char> &data=writer.GetData();
+	std::string xml(data.begin(),data.end());
+	CHECK(xml.compare(0,23,"<?xml version=\"1.0\"?>\r\n")==0);
+	CHECK(xml.find("<Empty/>")!=std::string::npos);
+	CHECK(xml.find("\xF0\x9F\x98\x80")!=std::string::npos); // the character outside of the BMP is written as one sequence, even as a surrogate pair in UTF-16
+
+	CXmlReader reader;
+	CHECK(LoadXml(reader,xml.c_str()));
+	CHECK(ReadElement(reader,L"Settings"));
+	CHECK(wcscmp(reader.GetAttribute(L"component"),L"Menu")==0);
+	CHECK(ReadElement(reader,L"Empty"));
+	CHECK(ReadEndElement(reader,L"Empty"));
+	CHECK(ReadElement(reader,L"Value"));
+	const wchar_t *value2=reader.GetAttribute(L"value");
+	CHECK(value2 && wcscmp(value2,value)==0);
+	CHECK(ReadText(reader,text));
+	CHECK(ReadEndElement(reader,L"Value"));
+	CHECK(ReadEndElement(reader,L"Settings"));
+	CHECK(reader.Read()==CXmlReader::NODE_EOF);
+}